@@ -0,0 +1,32 @@
+#include "benchmark/benchmark.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Unless an output file is given on the command line, results are written
+// as JSON to al_benchmarks.json for regression tracking, in addition to the
+// usual console report.
+int main(int argc, char **argv) {
+  std::vector<char *> args(argv, argv + argc);
+  bool hasOutput = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--benchmark_out=", 16) == 0) {
+      hasOutput = true;
+    }
+  }
+  std::string outArg = "--benchmark_out=al_benchmarks.json";
+  std::string formatArg = "--benchmark_out_format=json";
+  if (!hasOutput) {
+    args.push_back(&outArg[0]);
+    args.push_back(&formatArg[0]);
+  }
+  int numArgs = int(args.size());
+  ::benchmark::Initialize(&numArgs, args.data());
+  if (::benchmark::ReportUnrecognizedArguments(numArgs, args.data())) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,243 @@
+#include "benchmark/benchmark.h"
+
+#include "al/scene/al_DynamicScene.hpp"
+#include "al/sound/al_Ambisonics.hpp"
+#include "al/sphere/al_AlloSphereSpeakerLayout.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const int kFrames = 256;
+
+// Speakers spread over the sphere on a golden angle spiral
+al::Speakers sphereLayout(int n) {
+  al::Speakers speakers;
+  for (int i = 0; i < n; i++) {
+    float z = 1.0f - 2.0f * (i + 0.5f) / n;
+    float el = std::asin(z) * 180.f / float(M_PI);
+    float az = std::fmod(i * 137.508f, 360.f);
+    speakers.emplace_back(i, az, el);
+  }
+  return speakers;
+}
+
+void orderSpeakerArgs(benchmark::internal::Benchmark *b) {
+  for (int order = 1; order <= 7; order++) {
+    for (int speakers : {16, 64, 128}) {
+      b->Args({order, speakers});
+    }
+  }
+}
+
+void fillAmbi(std::vector<float> &ambi) {
+  for (size_t i = 0; i < ambi.size(); i++) {
+    ambi[i] = std::sin(i * 0.01f);
+  }
+}
+
+class SineVoice : public al::PositionedVoice {
+public:
+  void onProcess(al::AudioIOData &io) override {
+    while (io()) {
+      io.out(0) += 0.1f * std::sin(mPhase);
+      mPhase += 0.05f;
+    }
+  }
+
+private:
+  float mPhase{0};
+};
+
+} // namespace
+
+static void BM_AmbiEncodeWeightsACN(benchmark::State &state) {
+  const int order = int(state.range(0));
+  std::vector<float> ws(al::AmbiBase::orderToChannels(3, order));
+  float az = 0;
+  for (auto _ : state) {
+    az += 0.01f;
+    al::AmbiBase::encodeWeightsACN(ws.data(), 3, order, az, 0.3f);
+    benchmark::DoNotOptimize(ws.data());
+  }
+  state.counters["channels"] = ws.size();
+}
+BENCHMARK(BM_AmbiEncodeWeightsACN)->DenseRange(1, 7);
+
+static void BM_AmbiEncodeWeightsFuMa(benchmark::State &state) {
+  const int order = int(state.range(0));
+  std::vector<float> ws(al::AmbiBase::orderToChannels(3, order));
+  float az = 0;
+  for (auto _ : state) {
+    az += 0.01f;
+    al::AmbiBase::encodeWeightsFuMa(ws.data(), 3, order, az, 0.3f);
+    benchmark::DoNotOptimize(ws.data());
+  }
+  state.counters["channels"] = ws.size();
+}
+BENCHMARK(BM_AmbiEncodeWeightsFuMa)->DenseRange(1, 3);
+
+// Tiled matrix decode of one block
+static void BM_AmbiDecode(benchmark::State &state) {
+  const int order = int(state.range(0));
+  const int numSpeakers = int(state.range(1));
+  al::Speakers speakers = sphereLayout(numSpeakers);
+  al::AmbiDecode decoder(3, order, numSpeakers);
+  decoder.setSpeakers(speakers);
+
+  std::vector<float> ambi(decoder.channels() * kFrames);
+  std::vector<float> out(numSpeakers * kFrames);
+  fillAmbi(ambi);
+
+  for (auto _ : state) {
+    decoder.decode(out.data(), ambi.data(), kFrames);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSpeakers * kFrames);
+  state.counters["channels"] = decoder.channels();
+  state.counters["MACs/s"] = benchmark::Counter(
+      double(state.iterations()) * numSpeakers * decoder.channels() * kFrames,
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_AmbiDecode)->Apply(orderSpeakerArgs);
+
+// Speaker x channel x frame loop as previously used by AmbiDecode::decode(),
+// kept as a baseline for the tiled decode
+static void BM_AmbiDecodeReference(benchmark::State &state) {
+  const int order = int(state.range(0));
+  const int numSpeakers = int(state.range(1));
+  al::Speakers speakers = sphereLayout(numSpeakers);
+  al::AmbiDecode decoder(3, order, numSpeakers);
+  decoder.setSpeakers(speakers);
+
+  const int channels = decoder.channels();
+  std::vector<float> ambi(channels * kFrames);
+  std::vector<float> out(numSpeakers * kFrames);
+  fillAmbi(ambi);
+
+  for (auto _ : state) {
+    for (int s = 0; s < numSpeakers; ++s) {
+      float *o = out.data() + s * kFrames;
+      for (int c = 0; c < channels; ++c) {
+        const float *in = ambi.data() + c * kFrames;
+        float w = decoder.decodeWeight(s, c);
+        for (int i = 0; i < kFrames; ++i) {
+          o[i] += in[i] * w;
+        }
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSpeakers * kFrames);
+  state.counters["channels"] = channels;
+  state.counters["MACs/s"] = benchmark::Counter(
+      double(state.iterations()) * numSpeakers * channels * kFrames,
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_AmbiDecodeReference)->Apply(orderSpeakerArgs);
+
+// Encode and decode of 16 sources over the AlloSphere layout
+static void BM_AmbisonicsAlloSphere(benchmark::State &state) {
+  const int order = int(state.range(0));
+  const int numSources = 16;
+  auto speakers = al::AlloSphereSpeakerLayoutCompensated();
+  int numChannels = 0;
+  for (const auto &s : speakers) {
+    numChannels = std::max(numChannels, int(s.deviceChannel) + 1);
+  }
+  al::AmbisonicsSpatializer spatializer(speakers, 3, order);
+  spatializer.compile();
+  spatializer.numFrames(kFrames);
+
+  al::AudioIOData io;
+  io.framesPerSecond(48000);
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(numChannels);
+
+  std::vector<float> samples(kFrames);
+  for (int i = 0; i < kFrames; i++) {
+    samples[i] = std::sin(i * 0.05f);
+  }
+
+  for (auto _ : state) {
+    io.zeroOut();
+    spatializer.prepare(io);
+    for (int i = 0; i < numSources; i++) {
+      float angle = float(i) * 0.618f * float(M_2PI);
+      al::Vec3f dir(std::cos(angle), std::sin(angle), float(i % 3) * 0.3f);
+      spatializer.renderBuffer(io, dir.normalize(), samples.data(), kFrames);
+    }
+    spatializer.finalize(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSources * kFrames);
+  state.counters["speakers"] = speakers.size();
+}
+BENCHMARK(BM_AmbisonicsAlloSphere)->DenseRange(1, 7);
+
+static void BM_AmbiRotate(benchmark::State &state) {
+  const int order = int(state.range(0));
+  al::AmbiRotate rotate(3, order);
+  std::vector<float> ambi(rotate.channels() * kFrames);
+  fillAmbi(ambi);
+  rotate.numFrames(kFrames);
+
+  al::Quatd q;
+  double angle = 0;
+  for (auto _ : state) {
+    angle += 0.01;
+    q.fromAxisAngle(angle, al::Vec3d(0.2, 1, 0.1).normalize());
+    rotate.rotation(q);
+    rotate.rotate(ambi.data(), kFrames);
+    benchmark::ClobberMemory();
+  }
+  state.counters["channels"] = rotate.channels();
+}
+BENCHMARK(BM_AmbiRotate)->DenseRange(1, 7);
+
+// Scene with a listener turning every block. Argument 2 selects rotating each
+// source position (0) or the Ambisonic mix once before decode (1).
+static void BM_AmbisonicsHeadTracking(benchmark::State &state) {
+  const int order = int(state.range(0));
+  const int numSources = int(state.range(1));
+  auto speakers = al::AlloSphereSpeakerLayoutCompensated();
+  int numChannels = 0;
+  for (const auto &s : speakers) {
+    numChannels = std::max(numChannels, int(s.deviceChannel) + 1);
+  }
+  al::AudioIOData io;
+  io.framesPerSecond(48000);
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(numChannels);
+
+  al::DynamicScene scene(0, al::TimeMasterMode::TIME_MASTER_FREE);
+  auto spatializer = scene.setSpatializer<al::AmbisonicsSpatializer>(speakers);
+  spatializer->configure(3, order, 1);
+  spatializer->sceneCoordinates(true);
+  spatializer->compile();
+  spatializer->soundfieldRotation(state.range(2) == 1);
+  for (int i = 0; i < numSources; i++) {
+    auto *voice = scene.getVoice<SineVoice>();
+    float angle = float(i) * 0.618f * float(M_2PI);
+    voice->setPose(al::Pose({std::cos(angle) * 3.0f, float(i % 5) - 2.0f,
+                             std::sin(angle) * 3.0f}));
+    scene.triggerOn(voice);
+  }
+  scene.processVoices();
+  scene.prepare(io);
+
+  double heading = 0;
+  for (auto _ : state) {
+    heading += 0.01;
+    scene.listenerPose().quat().fromAxisAngle(heading, al::Vec3d(0, 1, 0));
+    io.zeroOut();
+    io.frame(0);
+    scene.render(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSources * kFrames);
+  state.counters["sources"] = numSources;
+}
+BENCHMARK(BM_AmbisonicsHeadTracking)
+    ->ArgsProduct({{3, 5, 7}, {128, 512}, {0, 1}});
@@ -0,0 +1,107 @@
+#include "benchmark/benchmark.h"
+
+#include "al/io/al_AudioGraph.hpp"
+#include "al/sound/al_Biquad.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace al;
+
+// Independent effect chains, one per output channel, each made of four
+// filter stages. Arguments are the number of chains and, for the graph,
+// the number of worker threads.
+
+namespace {
+
+const int kFrames = 256;
+const int kStages = 4;
+
+// Eight cascaded filters on the input, written to the output
+class FilterStage : public AudioCallback {
+public:
+  FilterStage() : mFilter(8, BIQUAD_LPF, 48000) { mFilter.set(2000.0); }
+
+  void onAudioCB(AudioIOData &io) override {
+    memcpy(io.outBuffer(0), io.inBuffer(0), io.framesPerBuffer() * 4);
+    mFilter.processBuffer(io.outBuffer(0), int(io.framesPerBuffer()));
+  }
+
+  // In place on a channel, as a serial callback list would do
+  void process(float *buffer, int count) {
+    mFilter.processBuffer(buffer, count);
+  }
+
+private:
+  BiQuadNX mFilter;
+};
+
+void fill(AudioIOData &io) {
+  for (unsigned int c = 0; c < io.channelsOut(); c++) {
+    for (int i = 0; i < kFrames; i++) {
+      io.outBuffer(c)[i] = std::sin(0.05f * (i + c));
+    }
+  }
+}
+
+} // namespace
+
+// All stages of all chains one after the other, as PolySynth post
+// processing runs its callbacks
+static void BM_EffectChainsSerial(benchmark::State &state) {
+  const int numChains = int(state.range(0));
+  AudioIOData io;
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(numChains);
+  std::vector<std::unique_ptr<FilterStage>> stages;
+  for (int i = 0; i < numChains * kStages; i++) {
+    stages.emplace_back(new FilterStage);
+  }
+  for (auto _ : state) {
+    fill(io);
+    for (int chain = 0; chain < numChains; chain++) {
+      for (int s = 0; s < kStages; s++) {
+        stages[chain * kStages + s]->process(io.outBuffer(chain), kFrames);
+      }
+    }
+    benchmark::DoNotOptimize(io.outBuffer(0));
+  }
+  state.SetItemsProcessed(state.iterations() * kFrames);
+}
+BENCHMARK(BM_EffectChainsSerial)->Arg(16)->Arg(32)->UseRealTime();
+
+static void BM_EffectChainsGraph(benchmark::State &state) {
+  const int numChains = int(state.range(0));
+  const unsigned int workers = unsigned(state.range(1));
+  AudioIOData io;
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(numChains);
+  std::vector<std::unique_ptr<FilterStage>> stages;
+  AudioGraph graph(workers);
+  for (int chain = 0; chain < numChains; chain++) {
+    int node = graph.input(chain, 1);
+    for (int s = 0; s < kStages; s++) {
+      stages.emplace_back(new FilterStage);
+      node = graph.addNode(*stages.back(), {node}, 1);
+    }
+    graph.output(node, chain);
+  }
+  graph.prepare(io);
+  for (auto _ : state) {
+    fill(io);
+    graph.onAudioCB(io);
+    benchmark::DoNotOptimize(io.outBuffer(0));
+  }
+  state.SetItemsProcessed(state.iterations() * kFrames);
+  state.counters["workers"] = workers;
+  state.counters["bufferChannels"] = double(graph.bufferChannels());
+  state.counters["totalChannels"] = double(graph.totalChannels());
+}
+BENCHMARK(BM_EffectChainsGraph)
+    ->Args({16, 0})
+    ->Args({16, 3})
+    ->Args({32, 0})
+    ->Args({32, 3})
+    ->UseRealTime();
@@ -0,0 +1,137 @@
+#include "benchmark/benchmark.h"
+
+#include "al/io/al_AudioIO.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Output finalization as done by the device callbacks, without opening a
+// device. Arguments are channels, frames per buffer and whether the device
+// buffer is interleaved.
+
+namespace {
+
+void outputArgs(benchmark::internal::Benchmark *b) {
+  for (int interleaved : {0, 1}) {
+    for (int frames : {64, 256}) {
+      for (int channels : {2, 8, 32, 64, 128}) {
+        b->Args({channels, frames, interleaved});
+      }
+    }
+  }
+}
+
+// Callback output with some samples out of range, copied in every iteration
+// as the passes work in place
+std::vector<float> makeSignal(size_t size) {
+  std::vector<float> signal(size);
+  for (size_t i = 0; i < size; i++) {
+    signal[i] = 1.5f * std::sin(i * 0.01f);
+  }
+  return signal;
+}
+
+} // namespace
+
+// Separate gain, NaN and clip passes followed by the copy to the device, as
+// previously done by the callbacks
+static void BM_AudioOutputReference(benchmark::State &state) {
+  const int channels = int(state.range(0));
+  const unsigned frames = unsigned(state.range(1));
+  const bool interleaved = state.range(2) == 1;
+  std::vector<float> out(channels * frames), device(channels * frames);
+  const std::vector<float> signal = makeSignal(out.size());
+  float gainPrev = 0.5f, gain = 0.8f;
+
+  for (auto _ : state) {
+    out = signal;
+    float dgain = (gain - gainPrev) / frames;
+    for (int j = 0; j < channels; ++j) {
+      float *o = out.data() + j * frames;
+      float g = gainPrev;
+      for (unsigned i = 0; i < frames; ++i) {
+        o[i] *= g;
+        g += dgain;
+      }
+    }
+    std::swap(gain, gainPrev);
+    for (auto &s : out) {
+      if (s != s)
+        s = 0.f;
+    }
+    for (auto &s : out) {
+      if (s < -1.f)
+        s = -1.f;
+      else if (s > 1.f)
+        s = 1.f;
+    }
+    if (interleaved) {
+      float *d = device.data();
+      for (unsigned frame = 0; frame < frames; frame++) {
+        for (int i = 0; i < channels; i++) {
+          *d++ = out[i * frames + frame];
+        }
+      }
+    } else {
+      for (int i = 0; i < channels; i++) {
+        std::memcpy(device.data() + i * frames, out.data() + i * frames,
+                    frames * sizeof(float));
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+}
+BENCHMARK(BM_AudioOutputReference)->Apply(outputArgs);
+
+static void BM_AudioOutputPass(benchmark::State &state) {
+  const int channels = int(state.range(0));
+  const unsigned frames = unsigned(state.range(1));
+  const bool interleaved = state.range(2) == 1;
+  std::vector<float> out(channels * frames), device(channels * frames);
+  const std::vector<float> signal = makeSignal(out.size());
+  al::AudioOutputPass pass;
+  pass.gainStart = 0.5f;
+  pass.gainEnd = 0.8f;
+
+  for (auto _ : state) {
+    out = signal;
+    if (interleaved) {
+      pass.processInterleaved(out.data(), device.data(), channels, frames);
+    } else {
+      for (int i = 0; i < channels; i++) {
+        pass.process(out.data() + i * frames, device.data() + i * frames,
+                     frames);
+      }
+    }
+    std::swap(pass.gainStart, pass.gainEnd);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+}
+BENCHMARK(BM_AudioOutputPass)->Apply(outputArgs);
+
+// Direct output: finalized in place, no copy to the device
+static void BM_AudioOutputPassInPlace(benchmark::State &state) {
+  const int channels = int(state.range(0));
+  const unsigned frames = unsigned(state.range(1));
+  std::vector<float> out(channels * frames);
+  const std::vector<float> signal = makeSignal(out.size());
+  al::AudioOutputPass pass;
+  pass.gainStart = 0.5f;
+  pass.gainEnd = 0.8f;
+
+  for (auto _ : state) {
+    out = signal;
+    for (int i = 0; i < channels; i++) {
+      float *o = out.data() + i * frames;
+      pass.process(o, o, frames);
+    }
+    std::swap(pass.gainStart, pass.gainEnd);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * frames);
+}
+BENCHMARK(BM_AudioOutputPassInPlace)
+    ->ArgsProduct({{2, 8, 32, 64, 128}, {64, 256}});
@@ -0,0 +1,135 @@
+#include "benchmark/benchmark.h"
+
+#include "al/protocol/al_CommandConnection.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifndef AL_WINDOWS
+
+namespace {
+
+enum {
+  BENCH_ECHO = al::CommandConnection::COMMAND_LAST_INTERNAL,
+  BENCH_REPLY,
+  BENCH_BROADCAST
+};
+
+const size_t kBroadcastSize = 64;
+
+class BenchServer : public al::CommandServer {
+public:
+  bool processIncomingMessage(al::Message &m, al::Socket *src) override {
+    if (m.getByte() == BENCH_ECHO) {
+      uint8_t reply[1] = {BENCH_REPLY};
+      sendMessage(reply, 1, src);
+      return true;
+    }
+    return false;
+  }
+};
+
+class BenchClient : public al::CommandClient {
+public:
+  bool processIncomingMessage(al::Message &m, al::Socket * /*src*/) override {
+    uint8_t command = m.getByte();
+    if (command == BENCH_REPLY) {
+      received->fetch_add(1, std::memory_order_relaxed);
+      return true;
+    } else if (command == BENCH_BROADCAST) {
+      m.pushReadIndex(m.remainingBytes());
+      received->fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    return false;
+  }
+
+  std::atomic<int64_t> *received{nullptr};
+};
+
+struct Cluster {
+  Cluster(int numClients, uint16_t port) {
+    server.start(port, "127.0.0.1");
+    loop->start();
+    for (int i = 0; i < numClients; i++) {
+      clients.emplace_back(new BenchClient);
+      clients.back()->received = &received;
+      clients.back()->setEventLoop(loop);
+      clients.back()->start(port, "127.0.0.1");
+    }
+    server.waitForConnections(uint16_t(numClients), 10.0);
+  }
+
+  ~Cluster() {
+    for (auto &client : clients) {
+      client->stop();
+    }
+    loop->stop();
+    server.stop();
+  }
+
+  // Wait until count messages have arrived, giving up after a second
+  bool waitFor(int64_t count) {
+    double start = al::al_steady_time();
+    while (received.load() < count) {
+      if (al::al_steady_time() - start > 1.0) {
+        return false;
+      }
+      std::this_thread::yield();
+    }
+    return true;
+  }
+
+  BenchServer server;
+  std::shared_ptr<al::CommandLoop> loop = std::make_shared<al::CommandLoop>();
+  std::vector<std::unique_ptr<BenchClient>> clients;
+  std::atomic<int64_t> received{0};
+};
+
+} // namespace
+
+// Server sends a command to all clients. All clients share one loop thread.
+static void BM_CommandBroadcast(benchmark::State &state) {
+  const int numClients = int(state.range(0));
+  Cluster cluster(numClients, 16150);
+  uint8_t message[kBroadcastSize] = {BENCH_BROADCAST};
+
+  int64_t expected = 0;
+  for (auto _ : state) {
+    cluster.server.sendMessage(message, kBroadcastSize);
+    expected += numClients;
+    if (!cluster.waitFor(expected)) {
+      state.SkipWithError("broadcast not received");
+      break;
+    }
+  }
+  state.SetItemsProcessed(cluster.received.load());
+  state.counters["clients"] = numClients;
+}
+BENCHMARK(BM_CommandBroadcast)->Arg(10)->Arg(100)->UseRealTime();
+
+// Every client sends a command and waits for the server's reply
+static void BM_CommandRoundTrip(benchmark::State &state) {
+  const int numClients = int(state.range(0));
+  Cluster cluster(numClients, 16151);
+  uint8_t message[1] = {BENCH_ECHO};
+
+  int64_t expected = 0;
+  for (auto _ : state) {
+    for (auto &client : cluster.clients) {
+      client->sendMessage(message, 1);
+    }
+    expected += numClients;
+    if (!cluster.waitFor(expected)) {
+      state.SkipWithError("replies not received");
+      break;
+    }
+  }
+  state.SetItemsProcessed(cluster.received.load());
+  state.counters["clients"] = numClients;
+}
+BENCHMARK(BM_CommandRoundTrip)->Arg(10)->Arg(100)->UseRealTime();
+
+#endif
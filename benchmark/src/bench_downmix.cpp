@@ -0,0 +1,119 @@
+#include "benchmark/benchmark.h"
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/sound/al_DownMixer.hpp"
+#include "al/sphere/al_AlloSphereSpeakerLayout.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <vector>
+
+using namespace al;
+
+// Downmix of the AlloSphere output channels as used for monitor mixes.
+// Arguments are frames per buffer and the number of target channels (2 uses
+// layoutToStereo(), more folds to a ring of speakers).
+
+namespace {
+
+void downMixArgs(benchmark::internal::Benchmark *b) {
+  for (int frames : {64, 256, 512}) {
+    for (int targets : {2, 6}) {
+      b->Args({frames, targets});
+    }
+  }
+}
+
+Speakers ring(int numSpeakers) {
+  Speakers layout;
+  for (int i = 0; i < numSpeakers; i++) {
+    layout.emplace_back(i, 360.f * i / numSpeakers, 0.f);
+  }
+  return layout;
+}
+
+void configure(DownMixer &downMixer, AudioIOData &io, int frames,
+               int targets) {
+  io.framesPerBuffer(frames);
+  io.channelsOut(64);
+  for (int c = 0; c < 64; c++) {
+    for (int i = 0; i < frames; i++) {
+      io.outBuffer(c)[i] = std::sin(0.01f * (i + 7 * c));
+    }
+  }
+  if (targets == 2) {
+    downMixer.layoutToStereo(AlloSphereSpeakerLayoutCompensated(), io);
+  } else {
+    downMixer.layoutToLayout(AlloSphereSpeakerLayoutCompensated(),
+                             ring(targets), io);
+  }
+}
+
+} // namespace
+
+// Per frame walk of the routing map, then a copy of the buses to the
+// outputs, as DownMixer previously did
+static void BM_DownMixReference(benchmark::State &state) {
+  const int frames = int(state.range(0));
+  const int targets = int(state.range(1));
+  AudioIOData io;
+  DownMixer downMixer;
+  configure(downMixer, io, frames, targets);
+
+  // Rebuild the routing from the compiled mixer through a unit impulse per
+  // input
+  std::map<uint32_t, std::vector<std::pair<uint32_t, float>>> routingMap;
+  std::vector<float> saved(io.outBuffer(0), io.outBuffer(0) + 64 * frames);
+  for (uint32_t c = 0; c < 64; c++) {
+    io.zeroOut();
+    io.outBuffer(c)[0] = 1.0f;
+    downMixer.downMixToBus(io);
+    for (int b = 0; b < targets; b++) {
+      if (io.busBuffer(b)[0] != 0.0f) {
+        routingMap[c].push_back({uint32_t(b), io.busBuffer(b)[0]});
+      }
+    }
+  }
+  memcpy(io.outBuffer(0), saved.data(), saved.size() * sizeof(float));
+
+  for (auto _ : state) {
+    for (int i = 0; i < int(io.channelsBus()); i++) {
+      memset(io.busBuffer(i), 0, frames * sizeof(float));
+    }
+    io.frame(0);
+    while (io()) {
+      for (const auto &mapEntry : routingMap) {
+        for (const auto &routing : mapEntry.second) {
+          io.bus(routing.first) += io.out(mapEntry.first) * routing.second;
+        }
+      }
+    }
+    for (int b = 0; b < targets; b++) {
+      memcpy(io.outBuffer(32 + b), io.busBuffer(b), frames * sizeof(float));
+    }
+    benchmark::DoNotOptimize(io.busBuffer(0));
+  }
+  state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(BM_DownMixReference)->Apply(downMixArgs);
+
+static void BM_DownMix(benchmark::State &state) {
+  const int frames = int(state.range(0));
+  const int targets = int(state.range(1));
+  AudioIOData io;
+  DownMixer downMixer;
+  configure(downMixer, io, frames, targets);
+  std::vector<uint32_t> outs;
+  for (int b = 0; b < targets; b++) {
+    outs.push_back(32 + b);
+  }
+  downMixer.setOutputs(outs);
+
+  for (auto _ : state) {
+    downMixer.downMix(io);
+    benchmark::DoNotOptimize(io.busBuffer(0));
+  }
+  state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(BM_DownMix)->Apply(downMixArgs);
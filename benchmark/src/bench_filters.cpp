@@ -0,0 +1,357 @@
+#include "benchmark/benchmark.h"
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/sound/al_BassManagement.hpp"
+#include "al/sound/al_Biquad.hpp"
+#include "al/sound/al_Crossover.hpp"
+#include "al/sound/al_Reverb.hpp"
+#include "al/sound/al_SpeakerAdjustment.hpp"
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// Speaker EQ over many output channels: a cascade of biquads per channel on
+// planar buffers. Arguments are channels and stages per channel.
+
+namespace {
+
+const int kFrames = 256;
+const double kSampleRate = 48000;
+
+void eqArgs(benchmark::internal::Benchmark *b) {
+  b->ArgsProduct({{2, 16, 64, 128}, {1, 4}});
+}
+
+std::vector<float> makeSignal(int channels) {
+  std::vector<float> signal(channels * kFrames);
+  for (size_t i = 0; i < signal.size(); i++) {
+    signal[i] = 0.5f * std::sin(i * 0.07f);
+  }
+  return signal;
+}
+
+} // namespace
+
+static void BM_BiQuad(benchmark::State &state) {
+  const int channels = int(state.range(0));
+  const int stages = int(state.range(1));
+  std::vector<std::vector<al::BiQuad>> filters(channels);
+  for (auto &cascade : filters) {
+    for (int s = 0; s < stages; s++) {
+      cascade.emplace_back(al::BIQUAD_PEQ, kSampleRate);
+      cascade.back().set(250.0 * (s + 1), 1.0, 3.0);
+    }
+  }
+  std::vector<float> buffer = makeSignal(channels);
+
+  for (auto _ : state) {
+    for (int c = 0; c < channels; c++) {
+      for (auto &filter : filters[c]) {
+        filter.processBuffer(buffer.data() + c * kFrames, kFrames);
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * kFrames);
+}
+BENCHMARK(BM_BiQuad)->Apply(eqArgs);
+
+static void BM_BiQuadNX(benchmark::State &state) {
+  const int channels = int(state.range(0));
+  const int stages = int(state.range(1));
+  std::vector<std::unique_ptr<al::BiQuadNX>> filters;
+  for (int c = 0; c < channels; c++) {
+    filters.emplace_back(
+        new al::BiQuadNX(stages, al::BIQUAD_PEQ, kSampleRate));
+    filters.back()->set(250.0, 1.0, 3.0);
+  }
+  std::vector<float> buffer = makeSignal(channels);
+
+  for (auto _ : state) {
+    for (int c = 0; c < channels; c++) {
+      filters[c]->processBuffer(buffer.data() + c * kFrames, kFrames);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * kFrames);
+}
+BENCHMARK(BM_BiQuadNX)->Apply(eqArgs);
+
+template <typename T, int Lanes>
+static void BM_BiQuadBank(benchmark::State &state) {
+  const int channels = int(state.range(0));
+  const int stages = int(state.range(1));
+  al::BiQuadBank<T, Lanes> bank(channels, stages, kSampleRate);
+  for (int c = 0; c < channels; c++) {
+    for (int s = 0; s < stages; s++) {
+      bank.set(c, s, al::BIQUAD_PEQ, 250.0 * (s + 1), 1.0, 3.0);
+    }
+  }
+  std::vector<float> buffer = makeSignal(channels);
+
+  for (auto _ : state) {
+    bank.process(buffer.data(), kFrames, kFrames);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * kFrames);
+}
+BENCHMARK_TEMPLATE(BM_BiQuadBank, float, 4)->Apply(eqArgs);
+BENCHMARK_TEMPLATE(BM_BiQuadBank, float, 8)->Apply(eqArgs);
+BENCHMARK_TEMPLATE(BM_BiQuadBank, double, 4)->Apply(eqArgs);
+
+// Gain sweeping every block, so every tile ramps coefficients
+static void BM_BiQuadBankSmoothing(benchmark::State &state) {
+  const int channels = int(state.range(0));
+  const int stages = int(state.range(1));
+  al::BiQuadBank<float, 8> bank(channels, stages, kSampleRate);
+  bank.smoothing(kFrames);
+  std::vector<float> buffer = makeSignal(channels);
+
+  double gain = 0;
+  for (auto _ : state) {
+    gain = gain > 6 ? -6 : gain + 0.1;
+    for (int c = 0; c < channels; c++) {
+      for (int s = 0; s < stages; s++) {
+        bank.set(c, s, al::BIQUAD_PEQ, 250.0 * (s + 1), 1.0, gain);
+      }
+    }
+    bank.process(buffer.data(), kFrames, kFrames);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * channels * kFrames);
+}
+BENCHMARK(BM_BiQuadBankSmoothing)->Apply(eqArgs);
+
+// Bass management of speakers plus two subwoofers. Argument is the number of
+// speakers.
+
+namespace {
+
+void makeBassIO(al::AudioIOData &io, int numSpeakers) {
+  io.framesPerSecond(kSampleRate);
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(numSpeakers + 2);
+}
+
+} // namespace
+
+// Crossover::next() per channel and sample, lows summed into the subwoofers
+static void BM_BassManagementReference(benchmark::State &state) {
+  const int numSpeakers = int(state.range(0));
+  al::AudioIOData io;
+  makeBassIO(io, numSpeakers);
+  std::vector<al::Crossover<float>> crossovers(
+      numSpeakers, al::Crossover<float>(80.f, float(kSampleRate)));
+  std::vector<float> signal = makeSignal(numSpeakers + 2);
+
+  for (auto _ : state) {
+    std::copy(signal.begin(), signal.end(), io.outBuffer(0));
+    float *sub1 = io.outBuffer(numSpeakers);
+    float *sub2 = io.outBuffer(numSpeakers + 1);
+    for (int c = 0; c < numSpeakers; c++) {
+      float *out = io.outBuffer(c);
+      for (int i = 0; i < kFrames; i++) {
+        float lo, hi;
+        crossovers[c].next(out[i], &lo, &hi);
+        out[i] = hi;
+        sub1[i] += 0.5f * lo;
+        sub2[i] += 0.5f * lo;
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSpeakers * kFrames);
+}
+BENCHMARK(BM_BassManagementReference)->Arg(16)->Arg(64)->Arg(128);
+
+// Argument 2 enables distance compensation delays and gains
+static void BM_BassManagement(benchmark::State &state) {
+  const int numSpeakers = int(state.range(0));
+  al::AudioIOData io;
+  makeBassIO(io, numSpeakers);
+  al::Speakers speakers;
+  for (int i = 0; i < numSpeakers; i++) {
+    speakers.emplace_back(i, i * 360.f / numSpeakers, 0.f, 0,
+                          4.f + float(i % 5) * 0.5f);
+  }
+  al::BassManagement bass(80.f, kSampleRate);
+  bass.setSpeakers(speakers, {numSpeakers, numSpeakers + 1});
+  bass.prepare(io);
+  if (state.range(1) == 1) {
+    bass.compensateDistances();
+  }
+  std::vector<float> signal = makeSignal(numSpeakers + 2);
+
+  for (auto _ : state) {
+    std::copy(signal.begin(), signal.end(), io.outBuffer(0));
+    bass.onAudioCB(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSpeakers * kFrames);
+}
+BENCHMARK(BM_BassManagement)->ArgsProduct({{16, 64, 128}, {0, 1}});
+
+// Speaker distance compensation. Argument is the number of speakers, spread
+// from 2 to 4.5 m so delays reach 2.5 m / 343 m/s * 48 kHz = 350 frames.
+
+namespace {
+
+al::Speakers distanceLayout(int numSpeakers) {
+  al::Speakers speakers;
+  for (int i = 0; i < numSpeakers; i++) {
+    speakers.emplace_back(i, i * 360.f / numSpeakers, 0.f, 0,
+                          2.f + 2.5f * float(i) / numSpeakers);
+  }
+  return speakers;
+}
+
+} // namespace
+
+// Per sample ring buffer with wrapped indices, linear interpolation
+static void BM_SpeakerDelayReference(benchmark::State &state) {
+  const int numSpeakers = int(state.range(0));
+  al::Speakers speakers = distanceLayout(numSpeakers);
+  al::SpeakerDistanceTimeAdjustment adjustment;
+  adjustment.configure(speakers, kSampleRate, kFrames);
+  al::AudioIOData io;
+  io.framesPerSecond(kSampleRate);
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(numSpeakers);
+  const int size = 1024;
+  std::vector<std::vector<float>> rings(numSpeakers,
+                                        std::vector<float>(size));
+  int write = 0;
+  std::vector<float> signal = makeSignal(numSpeakers);
+
+  for (auto _ : state) {
+    std::copy(signal.begin(), signal.end(), io.outBuffer(0));
+    for (int c = 0; c < numSpeakers; c++) {
+      float *out = io.outBuffer(c);
+      float delay = adjustment.mDelays[c];
+      int frames = int(delay);
+      float fraction = delay - frames;
+      std::vector<float> &ring = rings[c];
+      for (int i = 0; i < kFrames; i++) {
+        ring[(write + i) % size] = out[i];
+        out[i] = (1.f - fraction) * ring[(write + i - frames + size) % size] +
+                 fraction * ring[(write + i - frames - 1 + size) % size];
+      }
+    }
+    write = (write + kFrames) % size;
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSpeakers * kFrames);
+}
+BENCHMARK(BM_SpeakerDelayReference)->Arg(64)->Arg(128);
+
+static void BM_SpeakerDistanceTimeAdjustment(benchmark::State &state) {
+  const int numSpeakers = int(state.range(0));
+  al::SpeakerDistanceTimeAdjustment adjustment;
+  adjustment.configure(distanceLayout(numSpeakers), kSampleRate, kFrames);
+  al::AudioIOData io;
+  io.framesPerSecond(kSampleRate);
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(numSpeakers);
+  std::vector<float> signal = makeSignal(numSpeakers);
+
+  for (auto _ : state) {
+    std::copy(signal.begin(), signal.end(), io.outBuffer(0));
+    adjustment.processDelays(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSpeakers * kFrames);
+}
+BENCHMARK(BM_SpeakerDistanceTimeAdjustment)->Arg(64)->Arg(128);
+
+static void BM_SpeakerDistanceGainAdjustment(benchmark::State &state) {
+  const int numSpeakers = int(state.range(0));
+  al::SpeakerDistanceGainAdjustment adjustment;
+  adjustment.configure(distanceLayout(numSpeakers));
+  al::AudioIOData io;
+  io.framesPerSecond(kSampleRate);
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(numSpeakers);
+  std::vector<float> signal = makeSignal(numSpeakers);
+
+  for (auto _ : state) {
+    std::copy(signal.begin(), signal.end(), io.outBuffer(0));
+    adjustment.processGains(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSpeakers * kFrames);
+}
+BENCHMARK(BM_SpeakerDistanceGainAdjustment)->Arg(64)->Arg(128);
+
+// Plate reverb instances, each with one input and two outputs. The
+// "realtime" counter is how many instances one core runs in real time at
+// 48 kHz.
+
+static void BM_Reverb(benchmark::State &state) {
+  const int numInstances = int(state.range(0));
+  std::vector<al::Reverb<float>> reverbs(numInstances);
+  std::vector<float> in = makeSignal(numInstances);
+  std::vector<float> out1(in.size()), out2(in.size());
+
+  for (auto _ : state) {
+    for (int k = 0; k < numInstances; k++) {
+      const int offset = k * kFrames;
+      for (int i = 0; i < kFrames; i++) {
+        reverbs[k](in[offset + i], out1[offset + i], out2[offset + i]);
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.counters["realtime"] = benchmark::Counter(
+      double(state.iterations()) * numInstances * kFrames / kSampleRate,
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Reverb)->Arg(1)->Arg(8)->Arg(16);
+
+static void BM_ReverbBlock(benchmark::State &state) {
+  const int numInstances = int(state.range(0));
+  std::vector<al::Reverb<float>> reverbs(numInstances);
+  std::vector<float> in = makeSignal(numInstances);
+  std::vector<float> out1(in.size()), out2(in.size());
+
+  for (auto _ : state) {
+    for (int k = 0; k < numInstances; k++) {
+      const int offset = k * kFrames;
+      reverbs[k].processBlock(in.data() + offset, out1.data() + offset,
+                              out2.data() + offset, kFrames);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.counters["realtime"] = benchmark::Counter(
+      double(state.iterations()) * numInstances * kFrames / kSampleRate,
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ReverbBlock)->Arg(1)->Arg(8)->Arg(16);
+
+// Argument is the number of MultiReverb objects
+template <int N> static void BM_MultiReverb(benchmark::State &state) {
+  const int numBanks = int(state.range(0));
+  std::vector<std::unique_ptr<al::MultiReverb<N>>> reverbs;
+  for (int b = 0; b < numBanks; b++) {
+    reverbs.emplace_back(new al::MultiReverb<N>());
+  }
+  const int numInstances = numBanks * N;
+  std::vector<float> in = makeSignal(numInstances);
+  std::vector<float> out1(in.size()), out2(in.size());
+
+  for (auto _ : state) {
+    for (int b = 0; b < numBanks; b++) {
+      const int offset = b * N * kFrames;
+      reverbs[b]->processBlock(in.data() + offset, out1.data() + offset,
+                               out2.data() + offset, kFrames, kFrames);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.counters["instances"] = numInstances;
+  state.counters["realtime"] = benchmark::Counter(
+      double(state.iterations()) * numInstances * kFrames / kSampleRate,
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK_TEMPLATE(BM_MultiReverb, 4)->Arg(1)->Arg(4);
+BENCHMARK_TEMPLATE(BM_MultiReverb, 8)->Arg(1)->Arg(2);
+BENCHMARK_TEMPLATE(BM_MultiReverb, 16)->Arg(1);
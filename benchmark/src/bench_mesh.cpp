@@ -0,0 +1,82 @@
+#include "benchmark/benchmark.h"
+
+#include "al/graphics/al_Isosurface.hpp"
+#include "al/graphics/al_Mesh.hpp"
+#include "al/graphics/al_Shapes.hpp"
+
+#include <cmath>
+#include <vector>
+
+static void BM_MeshGenerateNormals(benchmark::State &state) {
+  al::Mesh mesh;
+  al::addSphere(mesh, 1.0, int(state.range(0)), int(state.range(0)));
+  for (auto _ : state) {
+    mesh.normals().clear();
+    mesh.generateNormals();
+    benchmark::DoNotOptimize(mesh.normals().data());
+  }
+  state.SetItemsProcessed(state.iterations() * mesh.vertices().size());
+  state.counters["vertices"] = mesh.vertices().size();
+}
+BENCHMARK(BM_MeshGenerateNormals)->RangeMultiplier(4)->Range(16, 256);
+
+static void BM_MeshCompress(benchmark::State &state) {
+  al::Mesh source;
+  al::addSphere(source, 1.0, int(state.range(0)), int(state.range(0)));
+  source.decompress();
+  al::Mesh mesh;
+  for (auto _ : state) {
+    state.PauseTiming();
+    mesh.copy(source);
+    state.ResumeTiming();
+    mesh.compress();
+    benchmark::DoNotOptimize(mesh.indices().data());
+  }
+  state.SetItemsProcessed(state.iterations() * source.vertices().size());
+  state.counters["vertices"] = source.vertices().size();
+}
+BENCHMARK(BM_MeshCompress)->RangeMultiplier(4)->Range(16, 64);
+
+static void BM_MeshMerge(benchmark::State &state) {
+  al::Mesh part;
+  al::addIcosphere(part, 1.0, 2);
+  part.generateNormals();
+  const int numParts = int(state.range(0));
+  al::Mesh mesh;
+  for (auto _ : state) {
+    mesh.reset();
+    for (int i = 0; i < numParts; i++) {
+      mesh.merge(part);
+    }
+    benchmark::DoNotOptimize(mesh.vertices().data());
+  }
+  state.SetItemsProcessed(state.iterations() * numParts *
+                          part.vertices().size());
+  state.counters["parts"] = numParts;
+}
+BENCHMARK(BM_MeshMerge)->RangeMultiplier(8)->Range(1, 512);
+
+static void BM_IsosurfaceGenerate(benchmark::State &state) {
+  const int n = int(state.range(0));
+  // Field of two overlapping spheres
+  std::vector<float> field(n * n * n);
+  for (int z = 0; z < n; z++) {
+    for (int y = 0; y < n; y++) {
+      for (int x = 0; x < n; x++) {
+        float fx = float(x) / n - 0.5f, fy = float(y) / n - 0.5f,
+              fz = float(z) / n - 0.5f;
+        float d1 = std::sqrt((fx - 0.1f) * (fx - 0.1f) + fy * fy + fz * fz);
+        float d2 = std::sqrt((fx + 0.1f) * (fx + 0.1f) + fy * fy + fz * fz);
+        field[x + n * (y + n * z)] = 0.3f - std::min(d1, d2);
+      }
+    }
+  }
+  al::Isosurface iso;
+  for (auto _ : state) {
+    iso.generate(field.data(), n, 1.0f / n);
+    benchmark::DoNotOptimize(iso.vertices().data());
+  }
+  state.SetItemsProcessed(state.iterations() * (n - 1) * (n - 1) * (n - 1));
+  state.counters["cells"] = (n - 1) * (n - 1) * (n - 1);
+}
+BENCHMARK(BM_IsosurfaceGenerate)->RangeMultiplier(2)->Range(16, 128);
@@ -0,0 +1,299 @@
+#include "benchmark/benchmark.h"
+
+#include "al/protocol/al_OSC.hpp"
+#include "al/protocol/al_OSCRecvGroup.hpp"
+#include "al/ui/al_Parameter.hpp"
+#include "al/ui/al_ParameterServer.hpp"
+
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+static void BM_OSCEncode(benchmark::State &state) {
+  al::osc::Packet packet(1024);
+  for (auto _ : state) {
+    packet.clear();
+    packet.addMessage("/voice/3/frequency", 440.0f, 12, std::string("sine"));
+    benchmark::DoNotOptimize(packet.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OSCEncode);
+
+static void BM_OSCEncodeBundle(benchmark::State &state) {
+  const int numMessages = int(state.range(0));
+  al::osc::Packet packet(64 * numMessages + 64);
+  for (auto _ : state) {
+    packet.clear();
+    packet.beginBundle();
+    for (int i = 0; i < numMessages; i++) {
+      packet.addMessage("/voice/frequency", float(i));
+    }
+    packet.endBundle();
+    benchmark::DoNotOptimize(packet.data());
+  }
+  state.SetItemsProcessed(state.iterations() * numMessages);
+}
+BENCHMARK(BM_OSCEncodeBundle)->RangeMultiplier(4)->Range(4, 256);
+
+static void BM_OSCDecode(benchmark::State &state) {
+  al::osc::Packet packet(1024);
+  packet.addMessage("/voice/3/frequency", 440.0f, 12, std::string("sine"));
+  float f;
+  int i;
+  std::string s;
+  for (auto _ : state) {
+    al::osc::Message m(packet.data(), int(packet.size()));
+    m >> f >> i >> s;
+    benchmark::DoNotOptimize(f);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OSCDecode);
+
+// Same message as BM_OSCEncode through a PacketWriter on a stack buffer
+static void BM_OSCWriterEncode(benchmark::State &state) {
+  char buffer[1024];
+  al::osc::PacketWriter writer(buffer, sizeof(buffer));
+  for (auto _ : state) {
+    writer.clear();
+    writer.addMessage("/voice/3/frequency", 440.0f, 12, "sine");
+    benchmark::DoNotOptimize(writer.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OSCWriterEncode);
+
+static void BM_OSCWriterEncodeBundle(benchmark::State &state) {
+  const int numMessages = int(state.range(0));
+  std::vector<char> buffer(64 * numMessages + 64);
+  al::osc::PacketWriter writer(buffer.data(), buffer.size());
+  for (auto _ : state) {
+    writer.clear();
+    writer.beginBundle();
+    for (int i = 0; i < numMessages; i++) {
+      writer.addMessage("/voice/frequency", float(i));
+    }
+    writer.endBundle();
+    benchmark::DoNotOptimize(writer.data());
+  }
+  state.SetItemsProcessed(state.iterations() * numMessages);
+}
+BENCHMARK(BM_OSCWriterEncodeBundle)->RangeMultiplier(4)->Range(4, 256);
+
+// Same message as BM_OSCDecode read in place
+static void BM_OSCDecodeView(benchmark::State &state) {
+  al::osc::Packet packet(1024);
+  packet.addMessage("/voice/3/frequency", 440.0f, 12, std::string("sine"));
+  float f;
+  int i;
+  const char *s;
+  al::osc::MessageView m;
+  for (auto _ : state) {
+    m.parse(packet.data(), packet.size());
+    m >> f >> i >> s;
+    benchmark::DoNotOptimize(f);
+    benchmark::DoNotOptimize(s);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OSCDecodeView);
+
+namespace {
+
+struct SumHandler : public al::osc::PacketHandler {
+  void onMessage(al::osc::Message &m) override {
+    float v;
+    m >> v;
+    sum += v;
+  }
+  bool onMessageView(al::osc::MessageView &m) override {
+    if (!views) {
+      return false;
+    }
+    float v;
+    m >> v;
+    sum += v;
+    return true;
+  }
+  bool views{false};
+  float sum{0};
+};
+
+} // namespace
+
+// osc::Recv handling of a bundle of messages without network I/O. Argument 1
+// selects handling Message (0) or MessageView (1).
+static void BM_OSCRecvDispatch(benchmark::State &state) {
+  const int numMessages = int(state.range(0));
+  al::osc::Packet packet(64 * numMessages + 64);
+  packet.beginBundle();
+  for (int i = 0; i < numMessages; i++) {
+    packet.addMessage("/sensor/value", float(i));
+  }
+  packet.endBundle();
+
+  SumHandler handler;
+  handler.views = state.range(1) == 1;
+  al::osc::Recv recv;
+  recv.bufferSize(int(packet.size()));
+  recv.handler(handler);
+  for (auto _ : state) {
+    recv.parse(packet.data(), int(packet.size()), "127.0.0.1", 9000);
+    benchmark::DoNotOptimize(handler.sum);
+  }
+  state.SetItemsProcessed(state.iterations() * numMessages);
+}
+BENCHMARK(BM_OSCRecvDispatch)->ArgsProduct({{1, 16, 128}, {0, 1}});
+
+#ifndef AL_WINDOWS
+namespace {
+
+struct CountHandler : public al::osc::PacketHandler {
+  void onMessage(al::osc::Message & /*m*/) override {}
+  bool onMessageView(al::osc::MessageView & /*m*/) override {
+    count.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  std::atomic<int> count{0};
+};
+
+double processCpuTime() {
+  timespec t;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+} // namespace
+
+// Loopback bursts of packets spread over numPorts ports. Argument 2 selects
+// one osc::Recv thread per port (0) or a single osc::RecvGroup (1). Process
+// CPU time includes sending.
+static void BM_OSCReceiveLoopback(benchmark::State &state) {
+  const int numPorts = int(state.range(0));
+  const bool group = state.range(1) == 1;
+  const int burst = 128;
+  const uint16_t firstPort = 10900;
+
+  CountHandler handler;
+  std::vector<std::unique_ptr<al::osc::Recv>> receivers;
+  al::osc::RecvGroup recvGroup;
+  std::vector<std::unique_ptr<al::osc::Send>> senders;
+  for (int i = 0; i < numPorts; i++) {
+    uint16_t port = uint16_t(firstPort + i);
+    if (group) {
+      recvGroup.open(port, handler, "localhost");
+    } else {
+      receivers.emplace_back(new al::osc::Recv(port, "localhost"));
+      receivers.back()->handler(handler);
+      receivers.back()->start();
+    }
+    senders.emplace_back(new al::osc::Send(port, "localhost"));
+  }
+  if (group) {
+    recvGroup.start();
+  }
+  al::osc::Packet packet(64);
+  packet.addMessage("/sensor/value", 0.5f);
+
+  int64_t received = 0;
+  int64_t sent = 0;
+  double cpuStart = processCpuTime();
+  for (auto _ : state) {
+    handler.count = 0;
+    for (int i = 0; i < burst; i++) {
+      senders[i % numPorts]->send(packet);
+    }
+    // Wait for the burst, giving up on dropped packets
+    double start = al::al_steady_time();
+    while (handler.count.load() < burst &&
+           al::al_steady_time() - start < 0.05) {
+      std::this_thread::yield();
+    }
+    received += handler.count.load();
+    sent += burst;
+  }
+  double cpu = processCpuTime() - cpuStart;
+  recvGroup.close();
+  for (auto &r : receivers) {
+    r->stop();
+  }
+
+  state.SetItemsProcessed(received);
+  state.counters["dropped"] = double(sent - received);
+  state.counters["cpu_us_per_packet"] =
+      received > 0 ? cpu * 1e6 / received : 0;
+  if (group) {
+    auto stats = recvGroup.stats();
+    state.counters["packets_per_call"] =
+        stats.receiveCalls ? double(stats.packets) / stats.receiveCalls : 0;
+  }
+}
+BENCHMARK(BM_OSCReceiveLoopback)
+    ->ArgsProduct({{1, 8, 32}, {0, 1}})
+    ->UseRealTime();
+
+// Parameter change notifications to numListeners listeners on loopback,
+// sent in bursts and flushed so the time includes sending.
+static void BM_OSCNotifyListeners(benchmark::State &state) {
+  const int numListeners = int(state.range(0));
+  const int burst = 64;
+  const uint16_t firstPort = 10950;
+
+  CountHandler handler;
+  al::osc::RecvGroup recvGroup;
+  al::ParameterServer server("", 9010, false);
+  for (int i = 0; i < numListeners; i++) {
+    recvGroup.open(uint16_t(firstPort + i), handler, "127.0.0.1");
+    server.addListener("127.0.0.1", uint16_t(firstPort + i));
+  }
+  recvGroup.start();
+
+  float value = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < burst; i++) {
+      server.notifyListeners("/bench/param", value);
+      value += 1.0f;
+    }
+    server.flush();
+  }
+  // Let the receiver catch up before reading the counts
+  al::al_sleep(0.1);
+  recvGroup.stop();
+
+  const double notifications = double(state.iterations()) * burst;
+  const auto stats = recvGroup.stats();
+  state.SetItemsProcessed(int64_t(notifications));
+  state.counters["listeners"] = numListeners;
+  state.counters["messages_per_datagram"] =
+      stats.packets ? handler.count.load() / double(stats.packets) : 0;
+  state.counters["delivered"] =
+      handler.count.load() / (notifications * numListeners);
+}
+BENCHMARK(BM_OSCNotifyListeners)->Arg(10)->Arg(25)->Arg(50)->UseRealTime();
+#endif
+
+// Dispatch of an incoming message to the matching parameter among
+// numParameters registered parameters, without network I/O.
+static void BM_ParameterServerDispatch(benchmark::State &state) {
+  const int numParameters = int(state.range(0));
+  al::ParameterServer server("", 9010, false);
+  std::vector<std::unique_ptr<al::Parameter>> parameters;
+  for (int i = 0; i < numParameters; i++) {
+    parameters.emplace_back(std::make_unique<al::Parameter>(
+        "param" + std::to_string(i), "bench", 0.0f, 0.0f, 1.0f));
+    server.registerParameter(*parameters.back());
+  }
+  al::osc::Packet packet(256);
+  packet.addMessage(parameters.back()->getFullAddress(), 0.5f);
+
+  for (auto _ : state) {
+    al::osc::Message m(packet.data(), int(packet.size()));
+    server.onMessage(m);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["parameters"] = numParameters;
+}
+BENCHMARK(BM_ParameterServerDispatch)->RangeMultiplier(8)->Range(1, 512);
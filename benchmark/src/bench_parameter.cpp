@@ -0,0 +1,61 @@
+#include "benchmark/benchmark.h"
+
+#include "al/ui/al_Parameter.hpp"
+#include "al/ui/al_ParameterAutomation.hpp"
+
+#include <atomic>
+#include <thread>
+
+// Parameter::set() without automation, for comparison
+static void BM_ParameterSet(benchmark::State &state) {
+  al::Parameter param("bench");
+  float value = 0.0f;
+  for (auto _ : state) {
+    param.set(value);
+    value += 0.001f;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParameterSet);
+
+// Parameter::set() with an automation consuming the events on a second
+// thread, as the audio thread would
+static void BM_ParameterSetAutomated(benchmark::State &state) {
+  al::Parameter param("bench");
+  al::ParameterAutomation automation(param, 48000.0, 512, 0.005f, 4096);
+  std::atomic<bool> running{true};
+  std::thread audio([&]() {
+    while (running) {
+      benchmark::DoNotOptimize(automation.process(512));
+      std::this_thread::yield();
+    }
+  });
+  float value = 0.0f;
+  for (auto _ : state) {
+    param.set(value);
+    value += 0.001f;
+  }
+  running = false;
+  audio.join();
+  state.SetItemsProcessed(state.iterations());
+  state.counters["dropped"] = double(automation.stats().dropped);
+}
+BENCHMARK(BM_ParameterSetAutomated)->UseRealTime();
+
+// Audio thread cost of a 512 frame block with a number of events in it
+static void BM_ParameterAutomationBlock(benchmark::State &state) {
+  const unsigned int blockSize = 512;
+  const int eventsPerBlock = int(state.range(0));
+  al::ParameterAutomation automation(0.0f, 48000.0, blockSize, 0.001f, 4096);
+  uint64_t frame = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < eventsPerBlock; i++) {
+      automation.schedule(float(i), frame + i * blockSize / eventsPerBlock);
+    }
+    benchmark::DoNotOptimize(automation.process(blockSize));
+    frame += blockSize;
+  }
+  state.SetItemsProcessed(state.iterations() * blockSize);
+  state.counters["events"] = eventsPerBlock;
+}
+BENCHMARK(BM_ParameterAutomationBlock)->Arg(0)->Arg(1)->Arg(16)->Arg(128);
@@ -0,0 +1,110 @@
+#include "benchmark/benchmark.h"
+
+#include "al/types/al_SingleRWRingBuffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Single thread cost of pushing and popping batches of floats
+static void BM_RingBufferBatch(benchmark::State &state) {
+  const size_t batch = size_t(state.range(0));
+  al::SPSCRingBuffer<float> ring(4096);
+  std::vector<float> in(batch, 1.0f), out(batch);
+  for (auto _ : state) {
+    ring.push(in.data(), batch);
+    ring.pop(out.data(), batch);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+  state.SetBytesProcessed(state.iterations() * batch * sizeof(float));
+}
+BENCHMARK(BM_RingBufferBatch)->RangeMultiplier(4)->Range(1, 1024);
+
+// Byte oriented interface for comparison
+static void BM_SingleRWRingBufferBatch(benchmark::State &state) {
+  const size_t batch = size_t(state.range(0));
+  al::SingleRWRingBuffer ring(4096 * sizeof(float));
+  std::vector<float> in(batch, 1.0f), out(batch);
+  for (auto _ : state) {
+    ring.write((const char *)in.data(), batch * sizeof(float));
+    ring.read((char *)out.data(), batch * sizeof(float));
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+  state.SetBytesProcessed(state.iterations() * batch * sizeof(float));
+}
+BENCHMARK(BM_SingleRWRingBufferBatch)->RangeMultiplier(4)->Range(1, 1024);
+
+// Throughput between two threads, writing in place with writeRegions()
+static void BM_RingBufferThroughput(benchmark::State &state) {
+  const size_t block = size_t(state.range(0));
+  const uint64_t itemsPerIteration = 1 << 20;
+  al::SPSCRingBuffer<float> ring(8192);
+  for (auto _ : state) {
+    std::thread consumer([&]() {
+      uint64_t received = 0;
+      std::vector<float> out(block);
+      while (received < itemsPerIteration) {
+        size_t n = ring.pop(out.data(), block);
+        if (n == 0) {
+          std::this_thread::yield();
+        }
+        received += n;
+      }
+    });
+    uint64_t sent = 0;
+    while (sent < itemsPerIteration) {
+      auto region = ring.writeRegions(block);
+      for (size_t i = 0; i < region.size(); i++) {
+        region[i] = float(i);
+      }
+      ring.commitWrite(region.size());
+      if (region.size() == 0) {
+        std::this_thread::yield();
+      }
+      sent += region.size();
+    }
+    consumer.join();
+  }
+  state.SetItemsProcessed(state.iterations() * itemsPerIteration);
+}
+BENCHMARK(BM_RingBufferThroughput)
+    ->RangeMultiplier(8)
+    ->Range(8, 512)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Latency from push to pop of a single timestamp between two threads
+static void BM_RingBufferLatency(benchmark::State &state) {
+  using clock = std::chrono::steady_clock;
+  al::SPSCRingBuffer<clock::time_point> ring(64);
+  al::SPSCRingBuffer<clock::time_point> replies(64);
+  std::atomic<bool> running{true};
+  std::thread echo([&]() {
+    clock::time_point t;
+    while (running.load()) {
+      if (ring.pop(t)) {
+        replies.push(t);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  double totalNs = 0;
+  for (auto _ : state) {
+    ring.push(clock::now());
+    clock::time_point t;
+    while (!replies.pop(t)) {
+      std::this_thread::yield();
+    }
+    totalNs += std::chrono::duration<double, std::nano>(clock::now() - t)
+                   .count();
+  }
+  running = false;
+  echo.join();
+  state.counters["round_trip_ns"] =
+      benchmark::Counter(totalNs / state.iterations());
+}
+BENCHMARK(BM_RingBufferLatency)->UseRealTime();
@@ -0,0 +1,321 @@
+#include "benchmark/benchmark.h"
+
+#include "al/scene/al_DynamicScene.hpp"
+#include "al/scene/al_PolySynth.hpp"
+#include "al/sound/al_Lbap.hpp"
+#include "al/sphere/al_AlloSphereSpeakerLayout.hpp"
+
+#include <cmath>
+#include <vector>
+
+// Audio is rendered directly into an AudioIOData object, so no audio device
+// is opened and the benchmarks run headless with any audio backend.
+
+namespace {
+
+class SineVoice : public al::SynthVoice {
+public:
+  void onProcess(al::AudioIOData &io) override {
+    while (io()) {
+      io.out(0) += 0.1f * std::sin(mPhase);
+      mPhase += 0.05f;
+    }
+  }
+
+private:
+  float mPhase{0};
+};
+
+class PositionedSineVoice : public al::PositionedVoice {
+public:
+  void onProcess(al::AudioIOData &io) override {
+    while (io()) {
+      io.out(0) += 0.1f * std::sin(mPhase);
+      mPhase += 0.05f;
+    }
+  }
+
+private:
+  float mPhase{0};
+};
+
+void makeIO(al::AudioIOData &io, int channels, int frames = 256) {
+  io.framesPerSecond(48000);
+  io.framesPerBuffer(frames);
+  io.channelsOut(channels);
+  io.zeroOut();
+}
+
+} // namespace
+
+static void BM_PolySynthRender(benchmark::State &state) {
+  const int numVoices = int(state.range(0));
+  al::AudioIOData io;
+  makeIO(io, 2);
+
+  al::PolySynth synth(al::TimeMasterMode::TIME_MASTER_FREE);
+  for (int i = 0; i < numVoices; i++) {
+    synth.triggerOn(synth.getVoice<SineVoice>());
+  }
+  synth.processVoices();
+  synth.render(io); // Allocates internal buffers
+
+  for (auto _ : state) {
+    io.zeroOut();
+    io.frame(0);
+    synth.render(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numVoices * io.framesPerBuffer());
+  state.counters["voices"] = numVoices;
+}
+BENCHMARK(BM_PolySynthRender)->RangeMultiplier(4)->Range(1, 1024);
+
+namespace {
+
+// Writes a constant to every output, so rendering cost is mostly mixing
+class ConstantVoice : public al::SynthVoice {
+public:
+  void onProcess(al::AudioIOData &io) override {
+    for (unsigned int c = 0; c < io.channelsOut(); c++) {
+      float *buffer = io.outBuffer(c);
+      for (unsigned int i = 0; i < io.framesPerBuffer(); i++) {
+        buffer[i] = 0.01f;
+      }
+    }
+  }
+};
+
+} // namespace
+
+// Mixing voices with many output channels into the master buffers. Argument 1
+// is the number of channels per voice.
+static void BM_PolySynthMix(benchmark::State &state) {
+  const int numVoices = int(state.range(0));
+  const int numChannels = int(state.range(1));
+  al::AudioIOData io;
+  makeIO(io, numChannels);
+
+  al::PolySynth synth(al::TimeMasterMode::TIME_MASTER_FREE);
+  synth.setVoiceMaxOutputChannels(uint16_t(numChannels));
+  for (int i = 0; i < numVoices; i++) {
+    synth.triggerOn(synth.getVoice<ConstantVoice>());
+  }
+  synth.processVoices();
+  synth.prepare(io);
+
+  for (auto _ : state) {
+    io.zeroOut();
+    synth.render(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numVoices * numChannels *
+                          io.framesPerBuffer());
+  state.counters["voices"] = numVoices;
+  state.counters["channels"] = numChannels;
+}
+BENCHMARK(BM_PolySynthMix)->ArgsProduct({{16, 128, 512}, {2, 8, 32}});
+
+template <class TSpatializer>
+static void BM_DynamicSceneRender(benchmark::State &state) {
+  const int numVoices = int(state.range(0));
+  al::AudioIOData io;
+  auto speakers = al::AlloSphereSpeakerLayoutCompensated();
+  int numChannels = 0;
+  for (const auto &s : speakers) {
+    numChannels = std::max(numChannels, int(s.deviceChannel) + 1);
+  }
+  makeIO(io, numChannels);
+
+  al::DynamicScene scene(0, al::TimeMasterMode::TIME_MASTER_FREE);
+  scene.setSpatializer<TSpatializer>(speakers);
+  for (int i = 0; i < numVoices; i++) {
+    auto *voice = scene.getVoice<PositionedSineVoice>();
+    float angle = float(i) * 0.618f * float(M_2PI);
+    voice->setPose(al::Pose({std::cos(angle) * 3.0f, float(i % 5) - 2.0f,
+                             std::sin(angle) * 3.0f}));
+    scene.triggerOn(voice);
+  }
+  scene.processVoices();
+  scene.prepare(io);
+
+  for (auto _ : state) {
+    io.zeroOut();
+    io.frame(0);
+    scene.render(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numVoices * io.framesPerBuffer());
+  state.counters["voices"] = numVoices;
+  state.counters["channels"] = numChannels;
+}
+BENCHMARK_TEMPLATE(BM_DynamicSceneRender, al::Lbap)
+    ->RangeMultiplier(4)
+    ->Range(1, 256);
+
+namespace {
+
+// Voice with some per frame simulation work, so update() cost is realistic
+class MovingVoice : public al::PositionedVoice {
+public:
+  void update(double dt) override {
+    al::Pose p = pose();
+    for (int i = 0; i < 16; i++) {
+      mAngle += dt;
+      p.pos(std::cos(mAngle) * 3.0, std::sin(mAngle * 0.5),
+            std::sin(mAngle) * 3.0);
+      p.faceToward(al::Vec3d(0, 0, 0));
+    }
+    setPose(p);
+  }
+
+private:
+  double mAngle{0};
+};
+
+} // namespace
+
+// Argument 1 is the number of threads used by update(), 0 runs it serially
+static void BM_DynamicSceneUpdate(benchmark::State &state) {
+  const int numVoices = int(state.range(0));
+  const int numThreads = int(state.range(1));
+
+  al::DynamicScene scene(numThreads, al::TimeMasterMode::TIME_MASTER_FREE);
+  scene.setUpdateThreaded(numThreads > 0);
+  for (int i = 0; i < numVoices; i++) {
+    scene.triggerOn(scene.getVoice<MovingVoice>());
+  }
+  scene.processVoices();
+
+  for (auto _ : state) {
+    scene.update(0.001);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numVoices);
+  state.counters["voices"] = numVoices;
+}
+BENCHMARK(BM_DynamicSceneUpdate)
+    ->ArgsProduct({{100, 1000, 10000}, {0, 2, 4, 8}})
+    ->UseRealTime();
+
+namespace {
+
+// Voice that only records being drawn, so the benchmark measures the scene's
+// per frame work and runs without a graphics context
+class BoundedVoice : public al::PositionedVoice {
+public:
+  void onProcess(al::Graphics & /*g*/) override { mDrawCount++; }
+
+private:
+  uint64_t mDrawCount{0};
+};
+
+} // namespace
+
+// Positioned voices spread around the listener. Argument 1 selects sorting by
+// distance, argument 2 frustum culling.
+static void BM_DynamicSceneRenderGraphics(benchmark::State &state) {
+  const int numVoices = int(state.range(0));
+  al::DynamicScene scene(0, al::TimeMasterMode::TIME_MASTER_FREE);
+  scene.sortDrawingByDistance(state.range(1) == 1);
+  scene.cullDrawing(state.range(2) == 1);
+  for (int i = 0; i < numVoices; i++) {
+    auto *voice = scene.getVoice<BoundedVoice>();
+    float z = 1.0f - 2.0f * (i + 0.5f) / numVoices;
+    float r = std::sqrt(1.0f - z * z);
+    float angle = float(i) * 2.39996f;
+    float dist = 5.0f + float(i % 17);
+    voice->setPose(al::Pose(
+        {r * std::cos(angle) * dist, z * dist, r * std::sin(angle) * dist}));
+    voice->setBoundingRadius(0.5f);
+    scene.triggerOn(voice);
+  }
+  scene.processVoices();
+
+  al::Graphics g;
+  g.projMatrix(al::Matrix4f::perspective(60, 16.0f / 9.0f, 0.1f, 100));
+  g.viewMatrix(al::Matrix4f::lookAt(al::Vec3f(0, 0, 0), al::Vec3f(0, 0, -1),
+                                    al::Vec3f(0, 1, 0)));
+  for (auto _ : state) {
+    scene.render(g);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numVoices);
+  state.counters["voices"] = numVoices;
+}
+BENCHMARK(BM_DynamicSceneRenderGraphics)
+    ->ArgsProduct({{1000, 10000}, {0, 1}, {0, 1}});
+
+namespace {
+
+// Sine with an exponential release that never frees the voice, like a long
+// reverb or envelope tail
+class TailVoice : public al::PositionedVoice {
+public:
+  void onProcess(al::AudioIOData &io) override {
+    while (io()) {
+      io.out(0) += mGain * std::sin(mPhase);
+      mPhase += 0.05f;
+      mGain *= mDecay;
+    }
+  }
+
+  void onTriggerOff() override { mDecay = 0.995f; }
+
+private:
+  float mPhase{0};
+  float mGain{0.1f};
+  float mDecay{1.0f};
+};
+
+} // namespace
+
+// 500 voices between 2 and 182 units from the listener, half of them released.
+// Argument 0 culls voices quieter than the attenuation at 60 units, argument 1
+// enables silence detection.
+static void BM_DynamicSceneVirtualVoices(benchmark::State &state) {
+  const int numVoices = 500;
+  al::AudioIOData io;
+  makeIO(io, 2);
+
+  al::DynamicScene scene(0, al::TimeMasterMode::TIME_MASTER_FREE);
+  if (state.range(0) == 1) {
+    scene.audibilityThreshold(scene.distanceAttenuation().attenuation(60.0f));
+  }
+  std::vector<int> released;
+  for (int i = 0; i < numVoices; i++) {
+    auto *voice = scene.getVoice<TailVoice>();
+    if (state.range(1) == 1) {
+      voice->silenceDetection(1e-4f, 4);
+    }
+    float angle = float(i) * 0.618f * float(M_2PI);
+    float dist = 2.0f + float(i % 10) * 20.0f;
+    voice->setPose(
+        al::Pose({std::cos(angle) * dist, 0.0f, std::sin(angle) * dist}));
+    int id = scene.triggerOn(voice);
+    if (i % 2 == 1) {
+      released.push_back(id);
+    }
+  }
+  scene.processVoices();
+  scene.prepare(io);
+  for (int id : released) {
+    scene.triggerOff(id);
+  }
+  scene.processVoiceTurnOff();
+  // Let the released voices decay
+  for (int i = 0; i < 16; i++) {
+    scene.render(io);
+  }
+
+  for (auto _ : state) {
+    io.zeroOut();
+    io.frame(0);
+    scene.render(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numVoices * io.framesPerBuffer());
+  state.counters["culling"] = double(state.range(0));
+  state.counters["silence"] = double(state.range(1));
+}
+BENCHMARK(BM_DynamicSceneVirtualVoices)->ArgsProduct({{0, 1}, {0, 1}});
@@ -0,0 +1,44 @@
+#include "benchmark/benchmark.h"
+
+#include "al/math/al_Random.hpp"
+#include "al/spatial/al_HashSpace.hpp"
+
+static void BM_HashSpaceMove(benchmark::State &state) {
+  const int numObjects = int(state.range(0));
+  al::HashSpace space(6, numObjects);
+  al::rnd::Random<> rng(1234);
+  double dim = space.dim();
+  for (auto _ : state) {
+    for (int i = 0; i < numObjects; i++) {
+      space.move(i, rng.uniform(dim), rng.uniform(dim), rng.uniform(dim));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * numObjects);
+}
+BENCHMARK(BM_HashSpaceMove)->RangeMultiplier(8)->Range(64, 32768);
+
+static void BM_HashSpaceQuery(benchmark::State &state) {
+  const int numObjects = int(state.range(0));
+  const double radius = double(state.range(1));
+  al::HashSpace space(6, numObjects);
+  al::rnd::Random<> rng(1234);
+  double dim = space.dim();
+  for (int i = 0; i < numObjects; i++) {
+    space.move(i, rng.uniform(dim), rng.uniform(dim), rng.uniform(dim));
+  }
+  al::HashSpace::Query query(128);
+  int found = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < numObjects; i++) {
+      query.clear();
+      found += query(space, &space.object(i), radius);
+    }
+  }
+  benchmark::DoNotOptimize(found);
+  state.SetItemsProcessed(state.iterations() * numObjects);
+  state.counters["objects"] = numObjects;
+  state.counters["radius"] = radius;
+}
+BENCHMARK(BM_HashSpaceQuery)
+    ->ArgsProduct({{64, 1024, 8192}, {2, 8}})
+    ->Unit(benchmark::kMicrosecond);
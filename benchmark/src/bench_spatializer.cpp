@@ -0,0 +1,125 @@
+#include "benchmark/benchmark.h"
+
+#include "al/sound/al_Ambisonics.hpp"
+#include "al/sound/al_Dbap.hpp"
+#include "al/sound/al_Lbap.hpp"
+#include "al/sound/al_StereoPanner.hpp"
+#include "al/sound/al_Vbap.hpp"
+#include "al/sphere/al_AlloSphereSpeakerLayout.hpp"
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const int kFrames = 256;
+
+// Ring of n speakers at ear level
+al::Speakers ringLayout(int n) {
+  al::Speakers speakers;
+  for (int i = 0; i < n; i++) {
+    speakers.emplace_back(i, 360.f * i / n, 0.f);
+  }
+  return speakers;
+}
+
+int channelCount(const al::Speakers &speakers) {
+  int numChannels = 0;
+  for (const auto &s : speakers) {
+    numChannels = std::max(numChannels, int(s.deviceChannel) + 1);
+  }
+  return numChannels;
+}
+
+// Renders numSources sources distributed around the listener for each
+// iteration, including the per-block prepare() and finalize() stages.
+void renderSources(benchmark::State &state, al::Spatializer &spatializer,
+                   int numSources) {
+  al::AudioIOData io;
+  io.framesPerSecond(48000);
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(channelCount(spatializer.speakerLayout()));
+
+  spatializer.numFrames(kFrames);
+  spatializer.compile();
+
+  std::vector<float> samples(kFrames);
+  for (int i = 0; i < kFrames; i++) {
+    samples[i] = std::sin(i * 0.05f);
+  }
+  std::vector<al::Vec3f> positions;
+  for (int i = 0; i < numSources; i++) {
+    float angle = float(i) * 0.618f * float(M_2PI);
+    positions.emplace_back(std::cos(angle) * 3.0f, float(i % 3) - 1.0f,
+                           std::sin(angle) * 3.0f);
+  }
+
+  for (auto _ : state) {
+    io.zeroOut();
+    io.frame(0);
+    spatializer.prepare(io);
+    for (const auto &pos : positions) {
+      io.frame(0);
+      spatializer.renderBuffer(io, pos, samples.data(), kFrames);
+    }
+    spatializer.finalize(io);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numSources * kFrames);
+  state.counters["speakers"] = spatializer.numSpeakers();
+  state.counters["sources"] = numSources;
+}
+
+void ringArgs(benchmark::internal::Benchmark *b) {
+  for (int speakers : {8, 16, 32, 64}) {
+    for (int sources : {1, 16, 128}) {
+      b->Args({speakers, sources});
+    }
+  }
+}
+
+void sourceArgs(benchmark::internal::Benchmark *b) {
+  for (int sources : {1, 16, 128}) {
+    b->Args({0, sources});
+  }
+}
+
+} // namespace
+
+static void BM_StereoPanner(benchmark::State &state) {
+  al::StereoPanner spatializer(al::StereoSpeakerLayout());
+  renderSources(state, spatializer, int(state.range(1)));
+}
+BENCHMARK(BM_StereoPanner)->Apply(sourceArgs);
+
+static void BM_Vbap2D(benchmark::State &state) {
+  al::Vbap spatializer(ringLayout(int(state.range(0))));
+  renderSources(state, spatializer, int(state.range(1)));
+}
+BENCHMARK(BM_Vbap2D)->Apply(ringArgs);
+
+static void BM_Dbap(benchmark::State &state) {
+  al::Dbap spatializer(ringLayout(int(state.range(0))));
+  renderSources(state, spatializer, int(state.range(1)));
+}
+BENCHMARK(BM_Dbap)->Apply(ringArgs);
+
+static void BM_Ambisonics2D(benchmark::State &state) {
+  al::AmbisonicsSpatializer spatializer(ringLayout(int(state.range(0))), 2, 3);
+  renderSources(state, spatializer, int(state.range(1)));
+}
+BENCHMARK(BM_Ambisonics2D)->Apply(ringArgs);
+
+// Full sphere layout: 3D VBAP and LBAP over the AlloSphere speakers
+static void BM_Vbap3DAlloSphere(benchmark::State &state) {
+  al::Vbap spatializer(al::AlloSphereSpeakerLayoutCompensated(), true);
+  renderSources(state, spatializer, int(state.range(1)));
+}
+BENCHMARK(BM_Vbap3DAlloSphere)->Apply(sourceArgs);
+
+static void BM_LbapAlloSphere(benchmark::State &state) {
+  al::Lbap spatializer(al::AlloSphereSpeakerLayoutCompensated());
+  renderSources(state, spatializer, int(state.range(1)));
+}
+BENCHMARK(BM_LbapAlloSphere)->Apply(sourceArgs);
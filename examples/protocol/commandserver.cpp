@@ -17,8 +17,7 @@ public:
       unsigned char message[8] = {0, 0};
 
       message[0] = ASK_CLIENT_FOR_ORDER;
-      if (listener->send((const char *)message, 2) == 2) {
-      } else {
+      if (!sendMessage(message, 2, listener.get())) {
         std::cerr << "ERROR sending command" << std::endl;
       }
     }
@@ -44,7 +43,7 @@ public:
 
       uint8_t message[7] = {TELL_SERVER_ORDER, 'w', 'a', 't', 'e', 'r', 0};
 
-      if (!(mSocket.send((const char *)message, 7) == 7)) {
+      if (!sendMessage(message, 7)) {
         std::cerr << "ERROR sending reply" << std::endl;
         return false;
       }
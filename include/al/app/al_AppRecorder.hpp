@@ -8,8 +8,11 @@
 #include "al/app/al_ComputationDomain.hpp"
 #include "al/app/al_OpenGLGraphicsDomain.hpp"
 #include "al/app/al_SimulationDomain.hpp"
+#include "al/graphics/al_FrameEncoder.hpp"
 #include "al/io/al_File.hpp"
 
+#include <thread>
+
 /** @defgroup App Tools for recording audio and video from an App
  *
  */
@@ -40,7 +43,10 @@ class AppRecorder {
 public:
   AppRecorder() {}
 
-  ~AppRecorder() { stopRecording(); }
+  ~AppRecorder() {
+    stopRecording();
+    waitForEncoding();
+  }
 
   void connectApp(App *app) {
     mGraphicsDomain = app->graphicsDomain();
@@ -55,6 +61,30 @@ public:
 
   void stopRecording() { mRunning = false; }
 
+  /**
+   * @brief Set how frames are captured
+   *
+   * PNG writes numbered images that are joined by ffmpeg at the end. RAW
+   * appends frames to a single uncompressed file. PIPE sends the frames
+   * directly to an ffmpeg process while recording, without intermediate
+   * files.
+   */
+  void captureFormat(FrameEncoder::Format format) { mFormat = format; }
+  FrameEncoder::Format captureFormat() const { return mFormat; }
+
+  /// Threads used to compress PNG frames while recording
+  void encoderThreads(unsigned int numThreads) { mEncoderThreads = numThreads; }
+
+  /// Frame throughput of the current or last recording
+  FrameEncoder::Metrics metrics() const { return mEncoder.metrics(); }
+
+  /// Wait until the ffmpeg call joining the last recording has finished
+  void waitForEncoding() {
+    if (mFfmpegThread.joinable()) {
+      mFfmpegThread.join();
+    }
+  }
+
 private:
   std::shared_ptr<OpenGLGraphicsDomain> mGraphicsDomain;
   std::shared_ptr<GLFWOpenGLWindowDomain> mWindowDomain;
@@ -62,6 +92,11 @@ private:
   std::shared_ptr<SimulationDomain> mSimulationDomain;
 
   bool mRunning;
+
+  FrameEncoder mEncoder;
+  FrameEncoder::Format mFormat{FrameEncoder::Format::PNG};
+  unsigned int mEncoderThreads{2};
+  std::thread mFfmpegThread;
 };
 
 } // namespace al
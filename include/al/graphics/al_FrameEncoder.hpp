@@ -0,0 +1,196 @@
+#ifndef AL_FRAMEENCODER_H
+#define AL_FRAMEENCODER_H
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2022. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   File description:
+   Encoding of captured video frames on worker threads
+*/
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace al {
+
+/**
+ * @brief The FrameEncoder class writes video frames from worker threads.
+ * @ingroup Graphics
+ *
+ * Frames are taken from a fixed pool of pixel buffers with acquire(), filled
+ * by the caller (e.g. with glReadPixels) and queued with submit(). When all
+ * buffers are queued acquire() blocks until a worker is done with one, so a
+ * fast producer is slowed down to the encoding rate instead of buffering an
+ * unbounded number of frames.
+ *
+ * Frames can be written as numbered PNG files, appended to a single raw
+ * file, or piped raw to an external encoder process:
+ *
+ * @code
+ * FrameEncoder encoder;
+ * encoder.open(FrameEncoder::Format::PIPE,
+ *              "ffmpeg -f rawvideo -pix_fmt rgb24 -s 1920x1080 -r 30 -i - "
+ *              "movie.mp4",
+ *              1920, 1080);
+ * auto *frame = encoder.acquire();
+ * // ... fill frame->pixels
+ * encoder.submit(frame);
+ * encoder.close();
+ * @endcode
+ *
+ * Raw and piped frames are written in submission order by a single worker.
+ * PNG files are independent and are compressed by all workers in parallel.
+ * Nothing here needs a graphics context.
+ */
+class FrameEncoder {
+public:
+  enum class Format : unsigned char {
+    PNG, ///< Numbered files <destination><index>.png
+    RAW, ///< Frames appended to the file <destination>
+    PIPE ///< Frames written to the standard input of command <destination>
+  };
+
+  struct Frame {
+    std::vector<unsigned char> pixels; ///< width * height * components bytes
+    uint64_t index{0};                 ///< Set by submit()
+  };
+
+  struct Metrics {
+    uint64_t framesSubmitted{0};
+    uint64_t framesWritten{0};
+    uint64_t bytesEncoded{0}; ///< Pixel bytes of the frames written
+    uint64_t errors{0};
+    double encodeTime{0}; ///< Seconds spent encoding, summed over workers
+    double stallTime{0};  ///< Seconds acquire() waited for a free buffer
+    double elapsed{0};    ///< Seconds since open()
+
+    double framesPerSecond() const {
+      return elapsed > 0 ? framesWritten / elapsed : 0;
+    }
+  };
+
+  FrameEncoder() {}
+
+  ~FrameEncoder() { close(); }
+
+  FrameEncoder(const FrameEncoder &) = delete;
+  FrameEncoder &operator=(const FrameEncoder &) = delete;
+
+  /**
+   * @brief Allocate the buffer pool and start the workers
+   * @param format output format
+   * @param destination file prefix, file name or command depending on format
+   * @param width frame width in pixels
+   * @param height frame height in pixels
+   * @param components bytes per pixel
+   * @param numWorkers worker threads for PNG. RAW and PIPE use one.
+   * @param numBuffers frames in the pool. 0 uses two per worker plus one.
+   * @return false if the output could not be opened
+   */
+  bool open(Format format, const std::string &destination, int width,
+            int height, int components = 3, unsigned int numWorkers = 2,
+            unsigned int numBuffers = 0);
+
+  /// Write queued frames, stop the workers and close the output
+  /// @return false if any frame failed to write
+  bool close();
+
+  bool isOpen() const { return mOpen; }
+
+  /// Get a free frame, waiting for one if all are queued
+  ///
+  /// The frame is owned by the encoder. It stays valid after close(), but
+  /// open() and the destructor free it, so don't keep it past those.
+  Frame *acquire();
+
+  /// Queue a frame obtained from acquire() for writing
+  void submit(Frame *frame);
+
+  /// Copy frameBytes() bytes into a free frame and queue it
+  void write(const unsigned char *pixels);
+
+  /// Write rows bottom to top, as read from OpenGL framebuffers.
+  /// Set before open(). For PNG this sets stb's global flip flag, which
+  /// Image::saveImage() also sets, so don't save images while encoding.
+  void flipVertically(bool flip) { mFlip = flip; }
+  bool flipVertically() const { return mFlip; }
+
+  Metrics metrics() const;
+
+  Format format() const { return mFormat; }
+  int width() const { return mWidth; }
+  int height() const { return mHeight; }
+  int components() const { return mComponents; }
+  size_t frameBytes() const { return size_t(mWidth) * mHeight * mComponents; }
+  unsigned int numBuffers() const { return (unsigned int)mPool.size(); }
+
+private:
+  void workerFunction();
+  bool writeFrame(Frame &frame);
+
+  Format mFormat{Format::PNG};
+  std::string mDestination;
+  int mWidth{0};
+  int mHeight{0};
+  int mComponents{3};
+  bool mFlip{true};
+  bool mOpen{false};
+  FILE *mFile{nullptr};
+
+  std::vector<std::unique_ptr<Frame>> mPool;
+  std::vector<Frame *> mFree;
+  // Ring of submitted frames, as large as the pool so pushing never grows it
+  std::vector<Frame *> mQueue;
+  size_t mQueueHead{0};
+  size_t mQueueCount{0};
+  uint64_t mNextIndex{0};
+  bool mStop{false};
+
+  mutable std::mutex mLock;
+  std::condition_variable mFrameQueued;
+  std::condition_variable mFrameFreed;
+  std::vector<std::thread> mWorkers;
+
+  Metrics mMetrics;
+  double mOpenTime{0};
+};
+
+} // namespace al
+
+#endif // AL_FRAMEENCODER_H
@@ -0,0 +1,207 @@
+#ifndef INCLUDE_AL_AUDIOGRAPH_HPP
+#define INCLUDE_AL_AUDIOGRAPH_HPP
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2022. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+   File description:
+   Audio processing graph with concurrent branches
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/system/al_JobSystem.hpp"
+
+namespace al {
+
+/**
+ * @brief The AudioGraph class runs a graph of audio processing nodes, running
+ * independent branches concurrently.
+ * @ingroup IO
+ *
+ * Each node is an AudioCallback (or a function) that reads the outputs of
+ * the nodes it takes as inputs and writes its own output channels. Nodes see
+ * a regular AudioIOData: in() holds the channels of its inputs one after the
+ * other and out() its own channels, zeroed before the call. Graph inputs are
+ * taken from the output channels of the AudioIOData the graph is called
+ * with, and node outputs connected with output() replace those channels when
+ * all nodes are done. Host channels not connected to any node output are
+ * left as they were.
+ *
+ * As a node can only take nodes that already exist as inputs, the graph has
+ * no cycles. A node runs as soon as all its inputs are done. Ready nodes go
+ * to a fixed size lock-free queue served by worker threads that belong to
+ * the graph. Workers run at real-time priority when the system allows it and
+ * sleep on a semaphore between blocks. The callback thread runs nodes too,
+ * and yields while other threads finish theirs. With no worker threads the
+ * nodes run in order on the callback thread. onAudioCB() doesn't allocate
+ * or take locks.
+ *
+ * Node buffers are placed in a single block of memory when the graph is
+ * prepared. A buffer is reused by a later node when every node that reads it
+ * is upstream of the later node, so the reuse holds no matter how branches
+ * are scheduled. A chain of effects needs two buffers, however long it is.
+ *
+ * Build and prepare() the graph before audio starts. The graph is an
+ * AudioCallback, so it can be appended to AudioIO or used as PolySynth post
+ * processing:
+ * @code
+ * AudioGraph graph;
+ * for (int i = 0; i < 16; i++) {
+ *   int in = graph.input(i, 1);
+ *   int eq = graph.addNode(eqs[i], {in}, 1);
+ *   int reverb = graph.addNode(reverbs[i], {eq}, 1);
+ *   graph.output(reverb, i);
+ * }
+ * graph.prepare(audioIO);
+ * synth.append(graph);
+ * @endcode
+ */
+class AudioGraph : public AudioCallback {
+public:
+  typedef std::function<void(AudioIOData &io)> ProcessFunction;
+
+  /**
+   * @param numWorkers threads running nodes besides the callback thread
+   * @param workerPriority real-time priority of the workers in [1, 99], or 0
+   * for normal priority
+   */
+  AudioGraph(unsigned int numWorkers = JobSystem::defaultWorkerCount(),
+             int workerPriority = 70);
+
+  ~AudioGraph();
+
+  AudioGraph(const AudioGraph &) = delete;
+  AudioGraph &operator=(const AudioGraph &) = delete;
+
+  /**
+   * @brief Use output channels of the host AudioIOData as a node
+   * @return node index, or -1 on error
+   *
+   * The channels are read in place.
+   */
+  int input(unsigned int firstChannel, unsigned int numChannels);
+
+  /**
+   * @brief Add a processing node
+   * @param callback processes the node. Must outlive the graph.
+   * @param inputs nodes whose outputs are the node's input channels, in
+   * order
+   * @param numOutputs output channels of the node
+   * @return node index, or -1 on error
+   */
+  int addNode(AudioCallback &callback, const std::vector<int> &inputs,
+              unsigned int numOutputs);
+
+  int addNode(ProcessFunction function, const std::vector<int> &inputs,
+              unsigned int numOutputs);
+
+  /**
+   * @brief Write the outputs of a node to the host channels starting at
+   * firstChannel
+   *
+   * When more than one node writes to a channel, their outputs are summed.
+   */
+  bool output(int node, unsigned int firstChannel);
+
+  /// Remove all nodes
+  void clear();
+
+  /**
+   * @brief Allocate buffers for the configuration of io and start the
+   * workers
+   *
+   * Call after building the graph and before audio starts, never while
+   * onAudioCB() may run.
+   */
+  void prepare(const AudioIOData &io);
+
+  /// Process a block. Blocks are left as they are if the graph changed
+  /// since prepare(), or if io has another buffer size or channel count.
+  void onAudioCB(AudioIOData &io) override;
+
+  unsigned int numNodes() const { return (unsigned int)mNodes.size(); }
+
+  unsigned int numWorkers() const { return mNumWorkers; }
+
+  /// Channels of buffer memory used after reuse
+  size_t bufferChannels() const { return mBufferChannels; }
+
+  /// Channels of buffer memory without reuse, i.e. all node outputs
+  size_t totalChannels() const;
+
+private:
+  struct Node;
+  class NodeIO;
+  class NodeQueue;
+  class Semaphore;
+
+  int addNode(std::unique_ptr<Node> node, const std::vector<int> &inputs);
+  void allocateBuffers();
+  void runNode(size_t index);
+  void startWorkers();
+  void stopWorkers();
+  void workerFunction();
+
+  std::vector<std::unique_ptr<Node>> mNodes;
+  std::vector<std::pair<int, unsigned int>> mOutputs; // node, first channel
+  std::vector<size_t> mRoots; // Nodes that have no processing node inputs
+  unsigned int mNumProcessingNodes{0};
+
+  unsigned int mNumWorkers;
+  int mWorkerPriority;
+  std::vector<std::thread> mWorkers;
+  std::unique_ptr<Semaphore> mWake;
+  std::unique_ptr<NodeQueue> mQueue; // Ready nodes
+  std::atomic<bool> mStop{false};
+  std::atomic<int> mPending{0};
+
+  bool mPrepared{false};
+  bool mWarned{false};
+  unsigned int mFramesPerBuffer{0};
+  double mFramesPerSecond{0};
+  unsigned int mHostChannels{0};
+  std::vector<float> mBuffer;
+  size_t mBufferChannels{0};
+};
+
+} // namespace al
+
+#endif
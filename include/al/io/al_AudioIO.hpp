@@ -44,12 +44,14 @@
         Andres Cabrera, 2017 mantaraya36@gmail.com
 */
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "al/io/al_AudioIOData.hpp"
+#include "al/io/al_AudioProfiler.hpp"
 
 namespace al {
 
@@ -159,6 +161,28 @@ inline AudioDevice::StreamMode operator|(const AudioDevice::StreamMode &a,
   return static_cast<AudioDevice::StreamMode>(+a | +b);
 }
 
+/// Final processing of output samples on their way to the device
+///
+/// Applies a linear gain ramp, replaces NaNs with zero and clips to [-1, 1]
+/// in a single pass while copying to the destination, which may be the
+/// source itself.
+///
+/// @ingroup IO
+struct AudioOutputPass {
+  float gainStart{1.f}; ///< Gain of the first frame
+  float gainEnd{1.f};   ///< Gain the ramp reaches after the last frame
+  bool zeroNANs{true};  ///< Replace NaNs with zero
+  bool clip{true};      ///< Clip between -1 and 1
+
+  /// Process one channel of numFrames samples
+  void process(const float *src, float *dst, unsigned int numFrames) const;
+
+  /// Process planar src, numChannels blocks of numFrames samples, into
+  /// interleaved dst
+  void processInterleaved(const float *src, float *dst, int numChannels,
+                          unsigned int numFrames) const;
+};
+
 /// Audio input/output streaming
 ///
 /// @ingroup IO
@@ -239,6 +263,35 @@ public:
     mZeroNANs = v;
   } ///< Set whether to zero NANs in output buffer going to DAC
 
+  /// Set whether to render straight into the device's output buffer when the
+  /// backend allows it, saving a copy per block. Currently only RtAudio
+  /// supports it, with as many output channels as device channels. Must be
+  /// set before the stream is opened.
+  void directOutput(bool v);
+  bool directOutput() const { return mDirectOutput; }
+
+  /// Gain ramp, NaN and clip settings for the current block
+  AudioOutputPass outputPass() const;
+
+  /// Finalize the device output channels of the current block in place,
+  /// copy them into one buffer per channel and advance the gain ramp. The
+  /// output buffers are left holding what the device plays, so NaNs do not
+  /// carry over to the next block when autoZeroOut() is off. Buffers may be
+  /// the output buffers themselves. Called by the audio backends.
+  void finalizeOutput(float *const *buffers);
+
+  /// Finalize the device output channels of the current block in place and
+  /// copy them into one contiguous buffer, interleaved or planar with
+  /// framesPerBuffer() samples per channel, and advance the gain ramp. A
+  /// planar buffer may be the output buffer itself. Called by the audio
+  /// backends.
+  void finalizeOutput(float *buffer, bool interleaved);
+
+  /// Point the output buffer at channelsOut() planar channels of
+  /// framesPerBuffer() samples owned by the device. nullptr restores the
+  /// internal buffer. Called by the audio backends for direct output.
+  void deviceOutBuffer(float *buffer);
+
   void print() const; ///< Prints info about current i/o devices to stdout.
   static const char *errorText(int errNum); ///< Returns error string.
 
@@ -254,6 +307,10 @@ public:
   /// Remove all input event handlers matching argument
   AudioIO &remove(AudioCallback &v);
 
+  /// Time blocks and their stages with profiler. nullptr disables profiling.
+  void profiler(AudioProfiler *profiler) { mProfiler = profiler; }
+  AudioProfiler *profiler() const { return mProfiler; }
+
   using AudioIOData::channelsBus;
   using AudioIOData::channelsIn;
   using AudioIOData::channelsOut;
@@ -267,7 +324,11 @@ private:
   bool mZeroNANs;    // whether to zero NANs
   bool mClipOut;     // whether to clip output between -1 and 1
   bool mAutoZeroOut; // whether to automatically zero output buffers each block
+  bool mDirectOutput{false}; // whether to render into device memory
+  // Own output buffer while mBufO points to device memory
+  float *mInternalOutBuffer{nullptr};
   std::vector<AudioCallback *> mAudioCallbacks;
+  std::atomic<AudioProfiler *> mProfiler{nullptr};
 
   void reopen(); // reopen stream (restarts stream if needed)
   void resizeBuffer(bool forOutput);
@@ -0,0 +1,266 @@
+#ifndef INCLUDE_AL_AUDIOPROFILER_HPP
+#define INCLUDE_AL_AUDIOPROFILER_HPP
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2022. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   File description:
+   Per stage timing of audio callbacks
+*/
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "al/types/al_SingleRWRingBuffer.hpp"
+
+namespace al {
+
+class OSCNotifier;
+
+namespace osc {
+class Packet;
+class Send;
+} // namespace osc
+
+/**
+ * @brief The AudioProfiler class measures how long the stages of each audio
+ * block take.
+ * @ingroup IO
+ *
+ * Set a profiler on an AudioIO object with AudioIO::profiler(). The audio
+ * backends then time each block and the built in stages. PolySynth and
+ * DynamicScene time voice rendering, spatialization and post processing.
+ * Stage times are inclusive, so VOICES is also part of IO_CALLBACK when the
+ * synth is rendered from onSound().
+ *
+ * The audio thread writes one record per block to a lock-free ring buffer
+ * and never blocks or allocates. The query functions read the ring buffer
+ * into a history of recent blocks and must all be called from the same
+ * thread.
+ *
+ * Custom stages can be added with addStage() and timed with a Scope:
+ * @code
+ * int reverbStage = profiler.addStage("reverb");
+ * ...
+ * void onSound(AudioIOData &io) {
+ *   AudioProfiler::Scope scope(reverbStage);
+ *   reverb(io);
+ * }
+ * @endcode
+ */
+class AudioProfiler {
+public:
+  /// Stages timed by the library
+  enum Stage : int {
+    IO_CALLBACK = 0, ///< AudioIO callback, usually App::onSound()
+    AUDIO_CALLBACKS, ///< AudioCallback objects appended to AudioIO
+    VOICES,          ///< Voice rendering in PolySynth and DynamicScene
+    SPATIALIZER,     ///< Spatialization in DynamicScene
+    POST_PROCESSING, ///< Post processing callbacks in PolySynth
+    OUTPUT,          ///< Gain, NaN removal, clipping and copy to device
+    NUM_BUILTIN_STAGES
+  };
+
+  static const int kMaxStages = 16;
+
+  /// Timing statistics in seconds
+  struct Stats {
+    uint64_t count{0};
+    double mean{0};
+    double p50{0};
+    double p90{0};
+    double p99{0};
+    double max{0};
+  };
+
+  /**
+   * @param historySize number of recent blocks used for statistics, at
+   * least 1
+   */
+  AudioProfiler(size_t historySize = 2048);
+
+  /**
+   * @brief Add a custom stage
+   * @return stage id for Scope, or -1 if there are already kMaxStages
+   *
+   * Add stages before audio starts. Timing stage -1 does nothing.
+   */
+  int addStage(const std::string &name);
+
+  int numStages() const { return mNumStages; }
+  /// Name of a stage, empty if there is no such stage
+  const std::string &stageName(int stage) const {
+    static const std::string noName;
+    return validStage(stage) ? mNames[stage] : noName;
+  }
+
+  /// Whether stage is a stage of this profiler
+  bool validStage(int stage) const { return stage >= 0 && stage < mNumStages; }
+
+  // Audio thread ______________________________________________________________
+
+  /// Start timing a block lasting blockPeriod seconds. Makes this profiler
+  /// current in the calling thread.
+  void beginBlock(double blockPeriod);
+  /// Finish timing a block and queue its record
+  void endBlock();
+  /// Add time to a stage of the current block. Invalid stages are ignored.
+  void addTime(int stage, double seconds) {
+    assert(stage == -1 || validStage(stage));
+    if (validStage(stage)) {
+      mStageTimes[stage] += seconds;
+    }
+  }
+
+  /// Profiler timing a block in the calling thread, or nullptr
+  static AudioProfiler *current();
+
+  /// Times a block in its lifetime. Does nothing if profiler is nullptr.
+  class Block {
+  public:
+    Block(AudioProfiler *profiler, double blockPeriod) : mProfiler(profiler) {
+      if (mProfiler) {
+        mProfiler->beginBlock(blockPeriod);
+      }
+    }
+    ~Block() {
+      if (mProfiler) {
+        mProfiler->endBlock();
+      }
+    }
+
+  private:
+    AudioProfiler *mProfiler;
+  };
+
+  /// Adds its lifetime to a stage of the current profiler, if any. Does
+  /// nothing for stages the profiler does not have.
+  class Scope {
+  public:
+    Scope(int stage) : mProfiler(current()), mStage(stage) {
+      if (mProfiler && !mProfiler->validStage(stage)) {
+        mProfiler = nullptr;
+      }
+      if (mProfiler) {
+        mStart = std::chrono::steady_clock::now();
+      }
+    }
+    ~Scope() {
+      if (mProfiler) {
+        mProfiler->addTime(
+            mStage, std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - mStart)
+                        .count());
+      }
+    }
+
+  private:
+    AudioProfiler *mProfiler;
+    int mStage;
+    std::chrono::steady_clock::time_point mStart;
+  };
+
+  // Query thread ______________________________________________________________
+
+  /// Statistics of whole blocks over the history
+  Stats blockStats();
+  /// Statistics of a stage over the history
+  Stats stageStats(int stage);
+
+  /// Blocks timed since creation or reset()
+  uint64_t blocks() const { return mBlocks; }
+  /// Blocks that took longer than their period since creation or reset()
+  uint64_t deadlineMisses() const { return mDeadlineMisses; }
+  /// Records lost because the history was not read fast enough
+  uint64_t dropped() const { return mDropped; }
+
+  /// Mean block time relative to the block period over the history
+  double load();
+
+  /// Clear history and counters
+  void reset();
+
+  void print(std::ostream &stream = std::cout);
+
+  /**
+   * @brief Add statistics as OSC messages
+   *
+   * Each stage is sent to prefix/<stage name> with mean, p50, p90, p99 and
+   * max in milliseconds. The block is sent to prefix/block the same way.
+   * prefix/load, prefix/deadlineMisses and prefix/blocks are also sent.
+   */
+  void addMessages(osc::Packet &packet, const std::string &prefix = "/audio");
+
+  /// Send statistics through an OSC socket
+  void publish(osc::Send &sender, const std::string &prefix = "/audio");
+  /// Send statistics to the listeners of an OSCNotifier or ParameterServer
+  void publish(OSCNotifier &notifier, const std::string &prefix = "/audio");
+
+private:
+  struct Record {
+    double total;
+    double period;
+    double stages[kMaxStages];
+  };
+
+  void readRecords();
+  Stats computeStats(int stage);
+
+  int mNumStages{NUM_BUILTIN_STAGES};
+  std::string mNames[kMaxStages];
+
+  // Audio thread
+  std::chrono::steady_clock::time_point mBlockStart;
+  double mBlockPeriod{0};
+  double mStageTimes[kMaxStages];
+  AudioProfiler *mPrevious{nullptr};
+  SPSCRingBuffer<Record> mRecords;
+  std::atomic<uint64_t> mBlocks{0};
+  std::atomic<uint64_t> mDeadlineMisses{0};
+  std::atomic<uint64_t> mDropped{0};
+
+  // Query thread
+  std::vector<Record> mHistory;
+  size_t mHistoryWrite{0};
+  size_t mHistoryCount{0};
+  std::vector<double> mScratch;
+};
+
+} // namespace al
+
+#endif // INCLUDE_AL_AUDIOPROFILER_HPP
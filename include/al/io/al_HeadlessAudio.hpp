@@ -0,0 +1,160 @@
+#ifndef INCLUDE_AL_HEADLESSAUDIO_HPP
+#define INCLUDE_AL_HEADLESSAUDIO_HPP
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2022. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   File description:
+   Drives AudioIO processing without an audio device
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "al/io/al_AudioIO.hpp"
+#include "al/sound/al_SoundFile.hpp"
+
+namespace al {
+
+/**
+ * @brief The HeadlessAudio class runs the processing of an AudioIO object
+ * from its own thread, without an audio device.
+ * @ingroup IO
+ *
+ * Each block is processed as a device backend would: output buffers are
+ * cleared if AudioIO::autoZeroOut() is set, AudioIO::processAudio() is called
+ * and gain, NaN removal and clipping are applied to all output channels.
+ *
+ * With the REALTIME clock blocks are processed at the rate a device would
+ * request them. Blocks that finish after the time the device would have
+ * needed them are counted as deadline misses. With the FREEWHEEL clock blocks
+ * are processed back to back, for offline rendering.
+ *
+ * Output can be written to a WAV file.
+ *
+ * @code
+ * AudioIO io;
+ * io.init(callback, nullptr, 256, 48000, 2, 0);
+ * HeadlessAudio headless(io, HeadlessAudio::Clock::FREEWHEEL);
+ * headless.record("bounce.wav");
+ * headless.render(48000 * 60); // One minute
+ * @endcode
+ */
+class HeadlessAudio {
+public:
+  enum class Clock {
+    REALTIME, ///< Process blocks at the audio rate
+    FREEWHEEL ///< Process blocks as fast as possible
+  };
+
+  HeadlessAudio(AudioIO &io, Clock clock = Clock::REALTIME);
+
+  ~HeadlessAudio();
+
+  HeadlessAudio(const HeadlessAudio &) = delete;
+  HeadlessAudio &operator=(const HeadlessAudio &) = delete;
+
+  void clock(Clock clock) { mClock = clock; }
+  Clock clock() const { return mClock; }
+
+  /**
+   * @brief Write output to WAV file
+   * @param path file to write. An empty string disables writing.
+   *
+   * The file is created on the next start() or render() and holds all
+   * output channels of the AudioIO object.
+   */
+  void record(const std::string &path) { mRecordPath = path; }
+
+  /**
+   * @brief Start processing in a separate thread
+   * @param numFrames number of frames to process before stopping. 0 runs
+   * until stop() is called.
+   * @return false if already running or the output file can't be opened
+   */
+  bool start(uint64_t numFrames = 0);
+
+  /// Stop processing and close the output file
+  void stop();
+
+  /// Wait until the number of frames passed to start() have been processed
+  void wait();
+
+  bool isRunning() const { return mRunning; }
+
+  /**
+   * @brief Process numFrames frames in the calling thread
+   *
+   * The clock is respected, so with REALTIME this takes as long as the audio
+   * would. Must not be called while running.
+   */
+  bool render(uint64_t numFrames);
+
+  /// Number of frames processed since the last start(). The last block of
+  /// a start() or render() with a frame count is only counted up to it.
+  uint64_t framesProcessed() const { return mFramesProcessed; }
+
+  /// Blocks that finished after their deadline, only counted with REALTIME
+  uint64_t deadlineMisses() const { return mDeadlineMisses; }
+
+  /// Processing time of the last block relative to its duration
+  double cpu() const { return mCpu; }
+
+  /// Stream time in seconds
+  double time() const;
+
+private:
+  bool prepare();
+  void run(uint64_t numFrames);
+  void processBlock();
+  void finish();
+
+  AudioIO &mIO;
+  Clock mClock;
+  std::string mRecordPath;
+  SoundFileWriter mWriter;
+  std::vector<float> mInterleaved;
+
+  std::thread mThread;
+  std::atomic<bool> mRunning{false};
+  std::atomic<uint64_t> mFramesProcessed{0};
+  std::atomic<uint64_t> mDeadlineMisses{0};
+  std::atomic<double> mCpu{0.0};
+};
+
+} // namespace al
+
+#endif // INCLUDE_AL_HEADLESSAUDIO_HPP
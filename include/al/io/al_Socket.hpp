@@ -99,6 +99,10 @@ public:
   /// Returns whether socket is open
   bool opened() const;
 
+  /// Native socket handle (file descriptor on POSIX), -1 if not open.
+  /// For waiting on many sockets with poll() or epoll.
+  intptr_t handle() const;
+
   /// Get IP address string
   const std::string &address() const;
 
@@ -42,6 +42,7 @@
   Lance Putnam, 2011, putnam.lance@gmail.com
 */
 
+#include "al/math/al_Mat.hpp"
 #include "al/math/al_Plane.hpp"
 #include "al/math/al_Vec.hpp"
 
@@ -120,6 +121,14 @@ class Frustum {
   ///
   void computePlanes();
 
+  /// Set planes and corners from a projection matrix
+
+  /// The matrix is usually projection * view, which gives the frustum in
+  /// world space. Multiplying by a model matrix gives the frustum in model
+  /// space. Planes are extracted directly from the matrix rows.
+  template <class U>
+  void fromMatrix(const Mat<4, U>& m);
+
  private:
   template <class Tf, class Tv>
   static Tv lerp(Tf f, const Tv& x, const Tv& y) {
@@ -153,6 +162,26 @@ void Frustum<T>::computePlanes() {
   pl[FARP].from3Points(ftr, ftl, fbl);
 }
 
+template <class T>
+template <class U>
+void Frustum<T>::fromMatrix(const Mat<4, U>& m) {
+  // Gribb & Hartmann: each plane is the last row plus or minus another row
+  Vec<4, T> r0(m.row(0)), r1(m.row(1)), r2(m.row(2)), r3(m.row(3));
+  const Vec<4, T> p[6] = {r3 - r1, r3 + r1, r3 + r0, r3 - r0, r3 + r2, r3 - r2};
+  for (int i = 0; i < 6; ++i) {
+    pl[i].fromCoefficients(p[i][0], p[i][1], p[i][2], p[i][3]);
+  }
+
+  // Corners are the normalized device cube transformed back
+  Mat<4, T> inv(m);
+  invert(inv);
+  for (int i = 0; i < 8; ++i) {
+    Vec<4, T> ndc(i & 1 ? 1 : -1, i & 2 ? -1 : 1, i & 4 ? 1 : -1, 1);
+    Vec<4, T> v = inv * ndc;
+    (&ntl)[i] = Vec<3, T>(v[0], v[1], v[2]) / v[3];
+  }
+}
+
 template <class T>
 int Frustum<T>::testPoint(const Vec<3, T>& p) const {
   for (int i = 0; i < 6; ++i) {
@@ -112,9 +112,9 @@ Plane<T>& Plane<T>::fromNormalAndPoint(const Vec3& nrm, const Vec3& point) {
 
 template <class T>
 Plane<T>& Plane<T>::fromCoefficients(T a, T b, T c, T d) {
-  mNormal(a, b, c);
+  mNormal.set(a, b, c);
   T l = mNormal.mag();
-  mNormal(a / l, b / l, c / l);
+  mNormal.set(a / l, b / l, c / l);
   mD = d / l;
   return *this;
 }
@@ -0,0 +1,101 @@
+#ifndef INCLUDE_AL_MATH_TILE_HPP
+#define INCLUDE_AL_MATH_TILE_HPP
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2022. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   File description:
+   Tiled loops over sample buffers
+*/
+
+#include <cstddef>
+#include <cstring>
+
+namespace al {
+
+/// Frames computed per tile by the tiled buffer functions
+const unsigned int kTileFrames = 16;
+
+/// Write op(i) to dst[i * stride] for every frame i in [0, numFrames)
+
+/// Frames are computed into a fixed size local tile and then stored. The
+/// fixed trip count into a buffer that cannot alias anything lets the
+/// compiler vectorize op at -O2 without runtime overlap checks, even when op
+/// reads from dst itself. Frames past the last full tile are done one by one.
+///
+/// @ingroup Math
+template <class Op>
+inline void tiledWrite(float *dst, unsigned int numFrames, const Op &op,
+                       unsigned int stride = 1) {
+  unsigned int i = 0;
+  for (; i + kTileFrames <= numFrames; i += kTileFrames) {
+    float tile[kTileFrames];
+    for (unsigned int j = 0; j < kTileFrames; ++j) {
+      tile[j] = op(i + j);
+    }
+    float *out = dst + size_t(i) * stride;
+    if (stride == 1) {
+      std::memcpy(out, tile, sizeof(tile));
+    } else {
+      for (unsigned int j = 0; j < kTileFrames; ++j) {
+        out[size_t(j) * stride] = tile[j];
+      }
+    }
+  }
+  for (; i < numFrames; ++i) {
+    dst[size_t(i) * stride] = op(i);
+  }
+}
+
+/// Add src to dst
+///
+/// @ingroup Math
+inline void tiledAdd(float *dst, const float *src, unsigned int numFrames) {
+  tiledWrite(dst, numFrames, [dst, src](unsigned int i) {
+    return dst[i] + src[i];
+  });
+}
+
+/// Add src scaled by gain to dst
+///
+/// @ingroup Math
+inline void tiledAddScaled(float *dst, const float *src, float gain,
+                           unsigned int numFrames) {
+  tiledWrite(dst, numFrames, [dst, src, gain](unsigned int i) {
+    return dst[i] + gain * src[i];
+  });
+}
+
+} // namespace al
+
+#endif
@@ -46,6 +46,7 @@
         Keehong Youn, 2017, younkeehong@gmail.com
 */
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <cstring>
@@ -59,6 +60,7 @@
 #include <vector>
 
 #include "al/io/al_Socket.hpp"
+#include "al/protocol/al_CommandLoop.hpp"
 #include "al/types/al_SingleRWRingBuffer.hpp"
 #include "al/types/al_ValueSource.hpp"
 
@@ -84,30 +86,30 @@ public:
   bool empty() { return mSize == 0 || mReadIndex == mSize; }
 
   uint8_t getByte() {
+    if (!canRead(1)) {
+      return 0;
+    }
     uint8_t val = mData[mReadIndex];
     mReadIndex++;
     return val;
   }
 
   template <typename DataType> DataType get() {
-    DataType val;
+    DataType val{};
+    if (!canRead(sizeof(DataType))) {
+      return val;
+    }
     memcpy(&val, &mData[mReadIndex], sizeof(DataType));
     mReadIndex += sizeof(DataType);
     return val;
   }
 
-  uint32_t getUint32() {
-    uint32_t val;
-    memcpy(&val, &mData[mReadIndex], 4);
-    mReadIndex += 4;
-    return val;
-  }
+  uint32_t getUint32() { return get<uint32_t>(); }
 
   std::vector<std::string> getVectorString() {
     std::vector<std::string> vs;
-    uint8_t count = mData[mReadIndex];
-    mReadIndex++;
-    for (uint8_t i = 0; i < count; i++) {
+    uint8_t count = getByte();
+    for (uint8_t i = 0; i < count && mReadIndex < mSize; i++) {
       vs.push_back(getString());
     }
     return vs;
@@ -135,11 +137,28 @@ public:
   void setReadIndex(size_t numBytes) { mReadIndex = numBytes; }
 
 private:
+  // Reads past the end of the message return zeros and leave it empty
+  bool canRead(size_t numBytes) {
+    if (mSize - std::min(mReadIndex, mSize) < numBytes) {
+      std::cerr << "Message read past end" << std::endl;
+      mReadIndex = mSize;
+      return false;
+    }
+    return true;
+  }
+
   uint8_t *mData;
   const size_t mSize;
   size_t mReadIndex{0};
 };
 
+/**
+ * @brief Base of the command server and client
+ *
+ * After the handshake, every command is sent as its size in 4 little endian
+ * bytes followed by the command bytes, so the receiver can split the stream
+ * into commands without knowing what they contain.
+ */
 class CommandConnection {
 public:
   typedef enum {
@@ -174,7 +193,30 @@ public:
 
   void setVerbose(bool verbose) { mVerbose = verbose; }
 
+  /**
+   * @brief Run on a shared event loop instead of a private one
+   *
+   * Connections, accepting and reading run on a CommandLoop thread. By
+   * default each server or client starts its own loop. Many of them can
+   * share one loop to use a single thread, in which case the caller starts
+   * and stops the loop. Set before start().
+   */
+  void setEventLoop(std::shared_ptr<CommandLoop> loop) {
+    mLoop = loop;
+    mPrivateLoop = false;
+  }
+
+  std::shared_ptr<CommandLoop> eventLoop() { return mLoop; }
+
 protected:
+  /**
+   * @brief Handle a command received from src
+   * @return false if the command is not recognized
+   *
+   * message holds exactly the bytes of one command, as passed to
+   * sendMessage() by the sender. Commands split across network reads are
+   * put back together before this is called.
+   */
   virtual bool processIncomingMessage(Message &message, Socket *src) {
     auto command = message.getByte();
     if (command == PONG) {
@@ -192,6 +234,25 @@ protected:
 
   virtual void onConnection(Socket *newConnection){};
 
+  // Pass the complete commands in data to processIncomingMessage(). Replies
+  // to pings. Returns bytes consumed.
+  size_t dispatchMessages(uint8_t *data, size_t size, Socket &src);
+
+  // Receive into buffer on a blocking socket and dispatch the complete
+  // commands. Returns false if a command does not fit in the buffer.
+  bool receiveMessages(Socket &src, std::vector<uint8_t> &buffer,
+                       size_t &bufferSize);
+
+  // Send one command with its size prefix
+  bool sendCommand(Socket &dst, const void *data, size_t size);
+
+  // Send through the event loop, queuing what can't be sent right away
+  bool sendBytes(Socket &dst, const void *data, size_t size);
+
+  // Create and start a private event loop if none was set
+  bool startLoop();
+  void stopLoop();
+
   uint16_t mVersion = 0,
            mRevision = 0; // Subclasses must set these to ensure compatibility
 
@@ -207,6 +268,9 @@ protected:
   std::vector<std::pair<uint16_t, uint16_t>> mConnectionVersions;
   al::Socket mSocket; // Bootstrap socket for server, main socket for client.
   bool mVerbose{false};
+
+  std::shared_ptr<CommandLoop> mLoop;
+  bool mPrivateLoop{false};
 };
 
 class CommandServer : public CommandConnection {
@@ -247,6 +311,11 @@ public:
 
 protected:
 private:
+  // Handshake on a new connection and register it. Returns bytes consumed.
+  size_t acceptHandshake(std::shared_ptr<Socket> client, uint8_t *data,
+                         size_t size);
+  void removeConnection(Socket *client);
+
   std::unique_ptr<std::thread> mBootstrapServerThread;
 
   uint16_t mPortOffset = 12000;
@@ -262,10 +331,15 @@ public:
 
   bool isConnected() { return mRunning && mSocket.opened(); }
 
+  void stop() override;
+
 protected:
   void clientHandlePing(Socket &client);
 
 private:
+  // Send the handshake on the connected socket and wait for the ack
+  bool handshake();
+
   uint16_t mPortOffset = 12000;
   std::atomic<bool> mBusy{false};
 };
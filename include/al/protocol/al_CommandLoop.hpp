@@ -0,0 +1,193 @@
+#ifndef INCLUDE_AL_COMMANDLOOP_HPP
+#define INCLUDE_AL_COMMANDLOOP_HPP
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2022. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   File description:
+   Event loop for many TCP command connections on one thread
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "al/io/al_Socket.hpp"
+
+namespace al {
+
+/**
+ * @brief The CommandLoop class accepts, reads and writes many TCP connections
+ * from a single thread.
+ * @ingroup allocore
+ *
+ * Sockets are switched to non-blocking mode and waited on together, with
+ * epoll on Linux and poll() on other POSIX systems. It is not available on
+ * Windows.
+ *
+ * Each connection has an input buffer that grows as needed. Whenever new
+ * bytes arrive the data callback gets everything buffered so far and returns
+ * how many bytes it consumed, so commands split across reads are completed
+ * on a later call. send() can be called from any thread. It writes what the
+ * socket takes right away and queues the rest, to be written when the socket
+ * is ready again, so a slow peer never blocks the caller or the loop.
+ *
+ * CommandServer and CommandClient run on a CommandLoop. Many of them can
+ * share one loop, see CommandConnection::setEventLoop().
+ */
+class CommandLoop {
+public:
+  /// Called for each connection accepted on a listening socket
+  typedef std::function<void(std::shared_ptr<Socket>)> AcceptCallback;
+  /// Called with all bytes buffered for a connection. Returns bytes consumed.
+  typedef std::function<size_t(Socket &, uint8_t *, size_t)> DataCallback;
+  /// Called after a connection was closed by the peer or failed
+  typedef std::function<void(Socket &)> CloseCallback;
+
+  struct Stats {
+    uint64_t accepted{0};      ///< Connections accepted
+    uint64_t closed{0};        ///< Connections closed by peers or errors
+    uint64_t bytesReceived{0}; ///< Bytes read from connections
+    uint64_t bytesSent{0};     ///< Bytes written to connections
+    uint64_t sendsQueued{0};   ///< Sends that could not be written at once
+    uint64_t wakeups{0};       ///< Returns from waiting on the sockets
+  };
+
+  /**
+   * @param maxBufferSize largest number of bytes queued for sending, or
+   * buffered unconsumed, per connection. A connection whose unconsumed
+   * input fills the buffer is closed, as its commands can't be framed.
+   */
+  CommandLoop(size_t maxBufferSize = 64 * 1024 * 1024);
+
+  ~CommandLoop();
+
+  CommandLoop(const CommandLoop &) = delete;
+  CommandLoop &operator=(const CommandLoop &) = delete;
+
+  /// Whether the loop can be used on this platform
+  static bool available();
+
+  /**
+   * @brief Accept connections on a bound, listening TCP socket
+   * @param socket is not owned and must outlive its registration
+   * @param onAccept receives each new connection, which is not added to the
+   * loop
+   */
+  bool listen(Socket &socket, AcceptCallback onAccept);
+
+  /// Read from a connected socket and write queued data to it
+  bool add(std::shared_ptr<Socket> socket, DataCallback onData,
+           CloseCallback onClose = nullptr);
+
+  /**
+   * @brief Stop watching a socket. The socket is not closed.
+   *
+   * When called from another thread, waits until no callback for the
+   * socket is running.
+   */
+  void remove(Socket *socket);
+
+  /**
+   * @brief Write data to a connection, queuing what can't be written now
+   * @return false if the socket is not in the loop, failed, or has more than
+   * maxBufferSize bytes queued
+   */
+  bool send(Socket *socket, const void *data, size_t size);
+
+  /// Bytes waiting to be written to socket
+  size_t queuedBytes(Socket *socket);
+
+  /// Number of connected sockets, not counting listening sockets
+  size_t numConnections();
+
+  /// Start a thread that runs the loop
+  bool start();
+
+  /// Stop the loop thread
+  void stop();
+
+  bool running() const { return mThread.joinable(); }
+
+  /**
+   * @brief Handle pending events from the calling thread
+   * @param timeout seconds to wait. < 0 waits forever.
+   * @return number of sockets that had events
+   */
+  int poll(double timeout = 0);
+
+  Stats stats() const;
+
+private:
+  struct Connection;
+  struct PollState;
+
+  bool addConnection(std::shared_ptr<Connection> connection);
+  void handleEvents(Connection &connection, bool readable, bool writable,
+                    bool error);
+  void acceptConnections(Connection &connection);
+  void readConnection(Connection &connection);
+  void consumeInput(Connection &connection);
+  void writeQueued(Connection &connection);
+  void closeConnection(Connection &connection);
+  void watchWritable(Connection &connection, bool watch);
+  void wake();
+  void loop();
+
+  size_t mMaxBufferSize;
+  std::mutex mLock; // Guards mConnections and mRemoved
+  std::unordered_map<const Socket *, std::shared_ptr<Connection>> mConnections;
+  // Removed while events for them may still be pending, freed by poll()
+  std::vector<std::shared_ptr<Connection>> mRemoved;
+  // Held by the loop while running callbacks, so remove() can wait for them
+  std::mutex mDispatchLock;
+  std::unique_ptr<PollState> mPollState;
+
+  int mPollFd{-1};        // epoll instance on Linux
+  int mWakeFd[2]{-1, -1}; // pipe to interrupt waiting
+  std::thread mThread;
+  std::atomic<bool> mRunning{false};
+  std::atomic<std::thread::id> mLoopThread;
+
+  mutable std::mutex mStatsLock;
+  Stats mStats;
+};
+
+} // namespace al
+
+#endif
@@ -269,6 +269,196 @@ protected:
   uint16_t mSenderPort;
 };
 
+/// Inbound OSC message read in place
+
+/// A MessageView points into the received packet bytes instead of copying
+/// them, so the address pattern and type tags are only valid while the packet
+/// is. Parsing and extracting arguments never allocate. Extracting an argument
+/// of the wrong type leaves the value untouched and clears good().
+///
+/// @ingroup allocore
+class MessageView {
+public:
+  MessageView() {}
+
+  /// @param[in] message		raw OSC message bytes
+  /// @param[in] size			number of bytes in message
+  /// @param[in] timeTag		time tag of message (inherited from
+  /// bundle)
+  /// @return false if the bytes are not a well-formed message
+  bool parse(const char *message, size_t size, const TimeTag &timeTag = 1);
+
+  /// Set sender of message. The address is not copied.
+  void sender(const char *address, uint16_t port) {
+    mSenderAddr = address;
+    mSenderPort = port;
+  }
+
+  const char *senderAddress() const { return mSenderAddr ? mSenderAddr : ""; }
+  uint16_t senderPort() const { return mSenderPort; }
+
+  const TimeTag &timeTag() const { return mTimeTag; }
+
+  /// Get address pattern as a null terminated string
+  const char *addressPattern() const { return mAddress; }
+  size_t addressPatternSize() const { return mAddressSize; }
+
+  /// Whether the address pattern is equal to address
+  bool addressIs(const char *address) const;
+
+  /// Get type tags, without the leading comma, as a null terminated string
+  const char *typeTags() const { return mTypeTags; }
+  int argumentCount() const { return int(mArgumentCount); }
+
+  /// Raw message bytes
+  const char *data() const { return mData; }
+  size_t size() const { return mSize; }
+
+  /// Type tag of the next argument in the stream, or '\0' at the end
+  char nextType() const { return mTypeTags[mArgument]; }
+
+  /// Whether all extractions so far matched the argument types
+  bool good() const { return mGood; }
+
+  /// Rewind the stream to the first argument
+  MessageView &resetStream();
+
+  MessageView &operator>>(int &v);         ///< Extract int32
+  MessageView &operator>>(int64_t &v);     ///< Extract int64
+  MessageView &operator>>(float &v);       ///< Extract float
+  MessageView &operator>>(double &v);      ///< Extract double
+  MessageView &operator>>(char &v);        ///< Extract char
+  MessageView &operator>>(const char *&v); ///< Extract string in place
+  MessageView &operator>>(std::string &v); ///< Extract string (copies)
+  MessageView &operator>>(Blob &v);        ///< Extract blob in place
+
+protected:
+  const char *mData{nullptr};
+  size_t mSize{0};
+  const char *mAddress{""};
+  size_t mAddressSize{0};
+  const char *mTypeTags{""};
+  size_t mArgumentCount{0};
+  const char *mArguments{nullptr};
+  TimeTag mTimeTag{1};
+  const char *mSenderAddr{nullptr};
+  uint16_t mSenderPort{0};
+
+  // Stream position
+  size_t mArgument{0};
+  const char *mNext{nullptr};
+  bool mGood{true};
+};
+
+/// Writer of outbound OSC packets into a caller provided buffer
+
+/// Unlike Packet, a PacketWriter neither owns its buffer nor allocates, so it
+/// can live on the stack and be cleared and reused for every message. Writes
+/// that do not fit in the buffer are dropped and set overflow().
+///
+/// @code
+/// char buffer[256];
+/// osc::PacketWriter writer(buffer, sizeof(buffer));
+/// writer.addMessage("/voice/frequency", 440.0f);
+/// sender.send(writer);
+/// @endcode
+///
+/// @ingroup allocore
+class PacketWriter {
+public:
+  PacketWriter() {}
+
+  /// @param[in] buffer		memory to write packets to
+  /// @param[in] capacity		size, in bytes, of buffer
+  PacketWriter(char *buffer, size_t capacity) { this->buffer(buffer, capacity); }
+
+  /// Set buffer to write to and clear contents
+  PacketWriter &buffer(char *buffer, size_t capacity);
+
+  const char *data() const { return mBuffer; }
+  size_t size() const { return mSize; }
+  size_t capacity() const { return mCapacity; }
+
+  /// Whether a write did not fit in the buffer since the last clear()
+  bool overflow() const { return mOverflow; }
+
+  /// Clear current packet contents
+  PacketWriter &clear();
+
+  /// Begin a new bundle. Bundles can be nested up to 8 levels.
+  PacketWriter &beginBundle(TimeTag timeTag = 1);
+
+  /// End bundle
+  PacketWriter &endBundle();
+
+  /// Start a new message
+  PacketWriter &beginMessage(const char *addressPattern);
+  PacketWriter &beginMessage(const std::string &addressPattern) {
+    return beginMessage(addressPattern.c_str());
+  }
+
+  /// End message
+  PacketWriter &endMessage();
+
+  /// Add message with any number of arguments
+  template <class... Args>
+  PacketWriter &addMessage(const char *addr, const Args &...args) {
+    beginMessage(addr);
+    addArguments(args...);
+    return endMessage();
+  }
+
+  template <class... Args>
+  PacketWriter &addMessage(const std::string &addr, const Args &...args) {
+    return addMessage(addr.c_str(), args...);
+  }
+
+  /// Add an encoded message or bundle, e.g. as the next element of a bundle
+  PacketWriter &addPacket(const char *data, size_t size);
+
+  PacketWriter &operator<<(int v);                ///< Add integer to message
+  PacketWriter &operator<<(unsigned v);           ///< Add integer to message
+  PacketWriter &operator<<(int64_t v);            ///< Add integer to message
+  PacketWriter &operator<<(uint64_t v);           ///< Add integer to message
+  PacketWriter &operator<<(float v);              ///< Add float to message
+  PacketWriter &operator<<(double v);             ///< Add double to message
+  PacketWriter &operator<<(char v);               ///< Add char to message
+  PacketWriter &operator<<(const char *v);        ///< Add C-string to message
+  PacketWriter &operator<<(const std::string &v); ///< Add string to message
+  PacketWriter &operator<<(const Blob &v);        ///< Add Blob to message
+
+private:
+  void addArguments() {}
+  template <class A, class... Args>
+  void addArguments(const A &a, const Args &...args) {
+    (*this) << a;
+    addArguments(args...);
+  }
+
+  // Reserve n bytes of argument data and the type tag t
+  char *reserveArgument(char t, size_t n);
+  char *reserve(size_t n);
+  void beginElement();
+
+  static const int kMaxBundleDepth = 8;
+
+  char *mBuffer{nullptr};
+  size_t mCapacity{0};
+  size_t mSize{0};
+  bool mOverflow{false};
+
+  // Position of the size field of open bundles, 0 for top level bundles
+  size_t mBundleSizes[kMaxBundleDepth];
+  int mBundleDepth{0};
+
+  // Open message. Type tags are collected backwards from the end of the
+  // buffer and moved in front of the arguments by endMessage().
+  bool mInMessage{false};
+  size_t mMessageSize{0}; // position of size field, 0 if not in a bundle
+  size_t mTypeTagsStart{0};
+  size_t mNumTypeTags{0};
+};
+
 /// Interface for classes that can be registered as handlers with a osc::Recv
 /// server object
 ///
@@ -279,6 +469,10 @@ public:
 
   /// Called for each message contained in packet
   virtual void onMessage(Message &m) = 0;
+
+  /// Called for each message before onMessage(). Return true if the message
+  /// was handled, so onMessage() is not called and no Message is allocated.
+  virtual bool onMessageView(MessageView & /*m*/) { return false; }
 };
 
 /// Interface for classes that can consume OSC messages
@@ -329,6 +523,12 @@ public:
   /// Send a packet
   size_t send(const Packet &p);
 
+  /// Send a packet written by a PacketWriter
+  size_t send(const PacketWriter &p) { return sendRaw(p.data(), p.size()); }
+
+  /// Send raw packet bytes
+  size_t sendRaw(const char *data, size_t size);
+
   /// Send zero argument message immediately
   size_t send(const std::string &addr) {
     addMessage(addr);
@@ -469,7 +669,18 @@ public:
   parse(const char *packet, int size, TimeTag timeTag = 1,
         const char *senderAddr = nullptr, uint16_t senderPort = 0);
 
+  /// Call f(MessageView &) for each message in packet, including messages in
+  /// nested bundles, without allocating
+  /// @return false if the packet is malformed
+  template <class F>
+  static bool forEachMessage(const char *packet, size_t size, const F &f,
+                             TimeTag timeTag = 1);
+
 protected:
+  // Pass messages in packet to the handlers
+  void dispatch(const char *packet, size_t size, const char *senderAddr,
+                uint16_t senderPort);
+
   std::vector<PacketHandler *> mHandlers;
   std::vector<char> mBuffer;
   al::Thread mThread;
@@ -479,6 +690,50 @@ protected:
   bool mOpen{false};
 };
 
+// Implementation ______________________________________________________________
+
+namespace detail {
+// Time tag and contents of the bundle element at data, or false if data is
+// not a well-formed bundle
+bool bundleHeader(const char *data, size_t size, TimeTag &timeTag);
+bool bundleElement(const char *&data, const char *end, const char *&element,
+                   size_t &elementSize);
+// Pass the messages in packet to handlers, as osc::Recv does
+bool dispatchPacket(PacketHandler *const *handlers, size_t numHandlers,
+                    const char *packet, size_t size, const char *senderAddr,
+                    uint16_t senderPort);
+} // namespace detail
+
+template <class F>
+bool Recv::forEachMessage(const char *packet, size_t size, const F &f,
+                          TimeTag timeTag) {
+  if (size == 0) {
+    return false;
+  }
+  if (packet[0] == '#') {
+    if (!detail::bundleHeader(packet, size, timeTag)) {
+      return false;
+    }
+    const char *it = packet + 16;
+    const char *end = packet + size;
+    while (it < end) {
+      const char *element;
+      size_t elementSize;
+      if (!detail::bundleElement(it, end, element, elementSize) ||
+          !forEachMessage(element, elementSize, f, timeTag)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  MessageView view;
+  if (!view.parse(packet, size, timeTag)) {
+    return false;
+  }
+  f(view);
+  return true;
+}
+
 } // namespace osc
 } // namespace al
 
@@ -0,0 +1,162 @@
+#ifndef INCLUDE_AL_OSCRECVGROUP_HPP
+#define INCLUDE_AL_OSCRECVGROUP_HPP
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2022. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   File description:
+   Receiving OSC packets on many ports from one thread
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "al/protocol/al_OSC.hpp"
+
+namespace al {
+namespace osc {
+
+/**
+ * @brief The RecvGroup class receives OSC packets on many UDP ports from a
+ * single thread.
+ * @ingroup allocore
+ *
+ * osc::Recv runs one thread per port and reads one datagram per system call.
+ * A RecvGroup waits on all of its sockets at once and drains each ready
+ * socket in batches into a preallocated packet arena, so nodes listening on
+ * many ports need one mostly idle thread. On Linux it uses epoll and
+ * recvmmsg(), on other POSIX systems poll() and recvfrom(). It is not
+ * available on Windows.
+ *
+ * Packets are passed to the same PacketHandler interface as osc::Recv, from
+ * the receiving thread. Handlers that implement onMessageView() receive
+ * messages without allocation.
+ *
+ * @code
+ * osc::RecvGroup group;
+ * group.open(9010, parameterHandler);
+ * group.open(9011, stateHandler);
+ * group.start();
+ * @endcode
+ */
+class RecvGroup {
+public:
+  struct Stats {
+    uint64_t packets{0};   ///< Datagrams received
+    uint64_t bytes{0};     ///< Bytes received
+    uint64_t malformed{0}; ///< Datagrams that were not valid OSC
+    uint64_t wakeups{0};   ///< Returns from waiting on the sockets
+    uint64_t receiveCalls{0}; ///< System calls reading datagrams
+  };
+
+  /**
+   * @param batchSize datagrams read per system call
+   * @param maxPacketSize largest datagram received, longer ones are truncated
+   * and dropped
+   */
+  RecvGroup(unsigned int batchSize = 32, unsigned int maxPacketSize = 4096);
+
+  ~RecvGroup();
+
+  RecvGroup(const RecvGroup &) = delete;
+  RecvGroup &operator=(const RecvGroup &) = delete;
+
+  /**
+   * @brief Open a port and pass its packets to handler
+   * @param port UDP port
+   * @param handler receives all messages on port
+   * @param address interface to bind to. If empty, all interfaces.
+   * @return false if the port could not be opened
+   *
+   * Opening a port that is already open adds another handler to it. Ports
+   * can only be opened while the group is not running.
+   */
+  bool open(uint16_t port, PacketHandler &handler, const char *address = "");
+
+  /// Close all ports
+  void close();
+
+  /// Number of open ports
+  unsigned int numPorts() const { return (unsigned int)mPorts.size(); }
+
+  /// Start a thread that receives on all ports
+  bool start();
+
+  /// Stop the receiving thread
+  void stop();
+
+  bool running() const { return mThread.joinable(); }
+
+  /**
+   * @brief Receive and handle pending packets from the calling thread
+   * @param timeout seconds to wait for packets. < 0 waits forever.
+   * @return number of packets handled
+   *
+   * Use instead of start() to receive from an existing loop.
+   */
+  int poll(double timeout = 0);
+
+  Stats stats() const;
+
+private:
+  struct Port;
+
+  void receiveLoop();
+  int receive(Port &port);
+
+  std::vector<std::unique_ptr<Port>> mPorts;
+  unsigned int mBatchSize;
+  unsigned int mMaxPacketSize;
+
+  // Packet arena and per datagram receive state, reused for every batch
+  std::vector<char> mArena;
+  struct Batch;
+  std::unique_ptr<Batch> mBatch;
+
+  int mPollFd{-1};   // epoll instance on Linux
+  int mWakeFd[2]{-1, -1}; // pipe to interrupt waiting in stop()
+  std::thread mThread;
+  std::atomic<bool> mRunning{false};
+
+  mutable std::mutex mStatsLock;
+  Stats mStats;
+};
+
+} // namespace osc
+} // namespace al
+
+#endif
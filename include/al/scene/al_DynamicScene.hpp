@@ -45,6 +45,7 @@
 */
 
 #include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <queue>
 #include <thread>
@@ -55,51 +56,12 @@
 #include "al/sound/al_StereoPanner.hpp"
 #include "al/spatial/al_DistAtten.hpp"
 #include "al/spatial/al_Pose.hpp"
+#include "al/system/al_JobSystem.hpp"
 
 #include "al/scene/al_PositionedVoice.hpp"
 
 namespace al {
 
-struct UpdateThreadFuncData {
-  SynthVoice *voice;
-  double dt;
-};
-
-// thread pool from
-// https://stackoverflow.com/questions/23896421/efficiently-waiting-for-all-tasks-in-a-threadpool-to-finish
-class ThreadPool {
-public:
-  ThreadPool(unsigned int n = std::thread::hardware_concurrency());
-
-  template <class F> void enqueue(F &&f, UpdateThreadFuncData &data);
-  void waitForProcessingDone();
-  ~ThreadPool();
-
-  size_t size() { return workers.size(); }
-
-  void stopThreads();
-
-private:
-  std::vector<std::thread> workers;
-  std::deque<std::pair<std::function<void(UpdateThreadFuncData)>,
-                       UpdateThreadFuncData>>
-      tasks;
-  std::mutex queue_mutex;
-  std::condition_variable cv_task;
-  std::condition_variable cv_finished;
-  unsigned int busy;
-  bool stop{false};
-
-  void thread_proc();
-};
-
-template <class F> void ThreadPool::enqueue(F &&f, UpdateThreadFuncData &data) {
-  std::unique_lock<std::mutex> lock(queue_mutex);
-  tasks.emplace_back(std::pair<std::function<void(UpdateThreadFuncData)>,
-                               UpdateThreadFuncData>(std::forward<F>(f), data));
-  cv_task.notify_one();
-}
-
 /**
  * @brief The DynamicScene class
  * @ingroup Scene
@@ -195,6 +157,18 @@ public:
    */
   DistAtten<> &distanceAttenuation();
 
+  /**
+   * @brief Skip processing voices too far away to be heard
+   * @param gain distance attenuation below which a voice is not processed.
+   * 0 disables culling.
+   *
+   * Culled voices that use distance attenuation become virtual: they keep
+   * their id, timing and state but their onProcess() is not called until
+   * they come close enough again. Culled voices that are triggered off are
+   * freed, as their release would not be heard.
+   */
+  void audibilityThreshold(float gain) { mAudibilityThreshold = gain; }
+
   void print(std::ostream &stream = std::cout);
 
   /**
@@ -208,6 +182,14 @@ public:
    */
   void sortDrawingByDistance(bool sort = true);
 
+  /**
+   * @brief Enables/disables skipping voices outside the view on graphics render
+   *
+   * Only voices with a bounding radius are culled. See
+   * PositionedVoice::setBoundingRadius()
+   */
+  void cullDrawing(bool cull = true);
+
   /**
    * @brief Stop all audio threads. No processing is possible after calling this
    * function
@@ -225,11 +207,22 @@ private:
 
   Pose mListenerPose;
   DistAtten<> mDistAtten;
+  float mAudibilityThreshold{0.0f};
 
   bool mSortDrawingByDistance{false};
+  bool mCullDrawing{true};
+  // Voices to draw, reused across frames
+  struct DrawItem {
+    uint32_t key; // Squared distance to listener as float bits
+    SynthVoice *voice;
+    PositionedVoice *positionedVoice;
+  };
+  std::vector<DrawItem> mDrawVoices;
+  std::vector<DrawItem> mDrawSortBuffer;
   // For threaded simulation
-  std::unique_ptr<ThreadPool> mWorkerThreads; // Update worker threads
+  std::unique_ptr<JobSystem> mWorkerThreads; // Update worker threads
   bool mThreadedUpdate{true};
+  std::vector<SynthVoice *> mUpdateVoices; // Active voices for update()
 
   // For threaded audio
   bool mThreadedAudio{false};
@@ -248,8 +241,6 @@ private:
   bool mSynthRunning{true};
   unsigned int mAudioBusy = 0;
 
-  static void updateThreadFunc(UpdateThreadFuncData data);
-
   static void audioThreadFunc(DynamicScene *scene, int id);
 
   // World marker
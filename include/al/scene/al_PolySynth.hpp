@@ -41,9 +41,11 @@
     Andrés Cabrera mantaraya36@gmail.com
 */
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
 #include <thread>
 #include <typeindex>
@@ -51,6 +53,7 @@
 
 #include "al/graphics/al_Graphics.hpp"
 #include "al/io/al_AudioIOData.hpp"
+#include "al/io/al_AudioProfiler.hpp"
 #include "al/io/al_File.hpp"
 #include "al/scene/al_SynthVoice.hpp"
 #include "al/types/al_SingleRWRingBuffer.hpp"
@@ -104,6 +107,8 @@ public:
    * Returns a free voice from the internal dynamic allocated pool.
    * You must call triggerVoice to put the voice back in the rendering
    * chain after setting its properties, otherwise it will be lost.
+   * Types reserved with reserveVoices() are only taken from their pool and
+   * forceAlloc is ignored.
    */
   template <class TSynthVoice> TSynthVoice *getVoice(bool forceAlloc = false);
 
@@ -136,6 +141,16 @@ public:
    */
   virtual void render(AudioIOData &io);
 
+  /**
+   * @brief Allocate the buffers used by render(AudioIOData &io)
+   * @param io The audio device AudioIO/AudioIOData object
+   *
+   * render() calls it on its first block if it has not been called, so call
+   * it before audio starts to keep allocation out of the audio thread. Call
+   * it again after changing the voice channel or bus counts.
+   */
+  virtual void prepare(AudioIOData &io);
+
   /**
    * @brief render graphics for all active voices
    */
@@ -162,6 +177,50 @@ public:
    */
   void allocatePolyphony(std::string name, int number);
 
+  /// What getVoice() does when all voices of a reserved type are in use
+  enum class VoiceStealing {
+    NONE,    ///< Return nullptr
+    OLDEST,  ///< Stop the voice that was triggered first
+    QUIETEST ///< Stop the voice with the lowest peak in its last audio block
+  };
+
+  /**
+   * @brief Reserve a fixed pool of voices of type TSynthVoice
+   * @param capacity maximum number of voices of this type in use at once
+   * @param stealing what getVoice() does when all voices are in use
+   * @param spareVoices voices handed out while stolen voices are stopped. If
+   * negative, capacity / 4 + 1 when stealing and none otherwise.
+   * @return false if the type already has a pool or capacity is not positive
+   *
+   * All the voices are constructed and initialized here in a single block,
+   * and automatic allocation is disabled for the type, so getVoice() never
+   * allocates it. When the pool is exhausted getVoice() returns nullptr or,
+   * with a stealing policy, marks a sounding voice to be faded out over the
+   * next block and returns one of the spare voices. Reserve voices before
+   * audio starts.
+   */
+  template <class TSynthVoice>
+  bool reserveVoices(int capacity, VoiceStealing stealing = VoiceStealing::NONE,
+                     int spareVoices = -1);
+
+  /**
+   * @brief Reserve a fixed pool of voices of a registered type
+   *
+   * The name must be registered using registerSynthClass()
+   */
+  bool reserveVoices(std::string name, int capacity,
+                     VoiceStealing stealing = VoiceStealing::NONE,
+                     int spareVoices = -1);
+
+  /**
+   * @brief Number of voices taken from a reserved pool
+   * @return -1 if no pool has been reserved for name
+   *
+   * Voices being stopped after they have been stolen are counted until they
+   * are returned to the pool.
+   */
+  int voicesInUse(std::string name);
+
   /**
    * @brief Use this function to insert a voice allocated externally into the
    * free voice pool
@@ -344,20 +403,16 @@ public:
       TSynthVoice *voice = allocateVoice<TSynthVoice>();
       return voice;
     };
+    mPoolCreators[name] = [](int size) {
+      return makeVoicePool<TSynthVoice>(size);
+    };
   }
 
   SynthVoice *allocateVoice(std::string name);
 
   template <class TSynthVoice> TSynthVoice *allocateVoice() {
     TSynthVoice *voice = new TSynthVoice;
-    voice->next = nullptr;
-    if (mDefaultUserData) {
-      voice->userData(mDefaultUserData);
-    }
-    voice->init();
-    for (auto allocCb : mAllocationCallbacks) {
-      allocCb.first(voice, allocCb.second);
-    }
+    initializeVoice(voice);
     return voice;
   }
 
@@ -477,8 +532,10 @@ public:
           auto voice = mActiveVoices->next;
           SynthVoice *previousVoice = mActiveVoices;
           previousVoice->id(-1);
+          releasePooledVoice(previousVoice);
           while (voice) {
             voice->id(-1);
+            releasePooledVoice(voice);
             previousVoice = voice;
             voice = voice->next;
           }
@@ -533,6 +590,9 @@ public:
         }
       }
     }
+    if (mStealRequests.load(std::memory_order_acquire) > 0) {
+      stopStolenVoices();
+    }
   }
 
   /**
@@ -558,6 +618,7 @@ public:
             mFreeVoices = voice; // Insert as head in free voices
             voice->id(-1);       // Reset voice id
             voice->onFree();
+            releasePooledVoice(voice);
             voice = previousVoice; // prepare next iteration
           } else {                 // Inactive is head of the list
             auto *nextVoice = voice->next;
@@ -566,6 +627,7 @@ public:
             mFreeVoices = voice; // Insert as head in free voices
             voice->id(-1);       // Reset voice id
             voice->onFree();
+            releasePooledVoice(voice);
             voice = voice->next; // prepare next iteration
           }
           for (const auto &cbNode : mFreeCallbacks) {
@@ -597,7 +659,84 @@ protected:
     }
   }
 
-  virtual void prepare(AudioIOData &io);
+  // Fixed block of voices of one type, created by reserveVoices()
+  struct VoicePool {
+    struct Slot {
+      std::atomic<bool> inUse{false};
+      std::atomic<bool> steal{false}; // Fade out in the next audio block
+      std::atomic<uint64_t> triggered{0}; // Trigger order, 0 if not triggered
+      std::atomic<float> peak{0.0f};
+    };
+
+    int index(const SynthVoice *voice) const {
+      uintptr_t offset = uintptr_t(voice) - uintptr_t(first);
+      if (uintptr_t(voice) < uintptr_t(first) || offset >= stride * size) {
+        return -1;
+      }
+      return int(offset / stride);
+    }
+
+    SynthVoice *voice(int index) {
+      return reinterpret_cast<SynthVoice *>(reinterpret_cast<char *>(first) +
+                                            stride * index);
+    }
+
+    std::string name;
+    std::type_index type{typeid(void)};
+    std::shared_ptr<void> storage; // Owns the voices
+    SynthVoice *first{nullptr};
+    size_t stride{0};
+    size_t size{0}; // Capacity and spare voices
+    int capacity{0};
+    VoiceStealing stealing{VoiceStealing::NONE};
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<int> inUse{0};
+    std::atomic<uint64_t> triggerCount{0};
+  };
+
+  template <class TSynthVoice>
+  static std::unique_ptr<VoicePool> makeVoicePool(int size) {
+    std::unique_ptr<VoicePool> pool(new VoicePool);
+    TSynthVoice *voices = new TSynthVoice[size];
+    pool->storage = std::shared_ptr<void>(voices,
+                                          std::default_delete<TSynthVoice[]>());
+    pool->first = voices;
+    pool->stride = sizeof(TSynthVoice);
+    pool->size = size_t(size);
+    pool->type = typeid(TSynthVoice);
+    return pool;
+  }
+
+  bool addVoicePool(std::unique_ptr<VoicePool> pool, std::string name,
+                    int capacity, VoiceStealing stealing);
+  VoicePool *findPool(const SynthVoice *voice);
+  VoicePool *findPool(const std::type_index &type);
+  VoicePool *findPool(const std::string &name);
+  // Must be called with mFreeVoiceLock held
+  SynthVoice *takePooledVoice(VoicePool &pool);
+  bool stealVoice(VoicePool &pool);
+  void acquirePooledVoice(SynthVoice *voice);
+  void releaseVoiceSlot(SynthVoice *voice);
+  void stopStolenVoices();
+  void markTriggered(SynthVoice *voice);
+
+  // Called around each voice's audio processing. beginVoiceBlock() returns
+  // false if the voice is virtual and is not processed in this block.
+  // endVoiceBlock() measures the output for silence detection and stealing.
+  bool beginVoiceBlock(SynthVoice *voice, bool inaudible = false);
+  void endVoiceBlock(SynthVoice *voice, AudioIOData &io, int offset);
+
+  // Add the internal voice outputs and buses to io from offset on, applying
+  // the channel map
+  void mixVoiceOutput(AudioIOData &io, int offset);
+
+  inline void releasePooledVoice(SynthVoice *voice) {
+    if (!mVoicePools.empty()) {
+      releaseVoiceSlot(voice);
+    }
+  }
+
+  void initializeVoice(SynthVoice *voice);
 
   /// Voices to be inserted in the realtime context. Internal voices are
   /// allocated in PolySynth and shared with the outside.
@@ -656,6 +795,11 @@ protected:
   void *mDefaultUserData{nullptr};
 
   Creators mCreators;
+  std::map<std::string, std::function<std::unique_ptr<VoicePool>(int)>>
+      mPoolCreators;
+  std::vector<std::unique_ptr<VoicePool>> mVoicePools;
+  std::atomic<int> mStealRequests{0};
+  bool mMeasurePeaks{false}; // A pool steals the quietest voice
   // Disallow auto allocation for class name. Set in allocateVoice()
   std::vector<std::string> mNoAllocationList;
   std::vector<size_t> mChannelMap; // Maps synth output to audio channels
@@ -677,6 +821,11 @@ template <class TSynthVoice> TSynthVoice *PolySynth::getVoice(bool forceAlloc) {
       mFreeVoiceLock); // Only one getVoice() call at a time
   SynthVoice *freeVoice = mFreeVoices;
   SynthVoice *previousVoice = nullptr;
+  if (!mVoicePools.empty()) {
+    if (auto *pool = findPool(std::type_index(typeid(TSynthVoice)))) {
+      return static_cast<TSynthVoice *>(takePooledVoice(*pool));
+    }
+  }
   if (forceAlloc) {
     freeVoice = nullptr;
   } else {
@@ -715,6 +864,21 @@ template <class TSynthVoice> TSynthVoice *PolySynth::getVoice(bool forceAlloc) {
   return static_cast<TSynthVoice *>(freeVoice);
 }
 
+template <class TSynthVoice>
+bool PolySynth::reserveVoices(int capacity, VoiceStealing stealing,
+                              int spareVoices) {
+  if (spareVoices < 0) {
+    spareVoices = stealing == VoiceStealing::NONE ? 0 : capacity / 4 + 1;
+  }
+  if (capacity <= 0) {
+    std::cerr << "ERROR: voice pool capacity must be positive" << std::endl;
+    return false;
+  }
+  return addVoicePool(makeVoicePool<TSynthVoice>(capacity + spareVoices),
+                      demangle(typeid(TSynthVoice).name()), capacity,
+                      stealing);
+}
+
 template <class TSynthVoice> void PolySynth::allocatePolyphony(int number) {
   std::unique_lock<std::mutex> lk(mFreeVoiceLock);
   SynthVoice *lastVoice = mFreeVoices;
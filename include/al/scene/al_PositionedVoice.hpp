@@ -80,6 +80,16 @@ public:
 
   std::vector<Vec3f> &audioOutOffsets() { return mAudioOutPositionOffsets; }
 
+  /**
+   * @brief Radius of a sphere around the voice position that contains its
+   * graphics, before scaling by size()
+   *
+   * DynamicScene does not draw voices whose bounding sphere is outside the
+   * view. A negative radius (the default) means the voice is never culled.
+   */
+  float boundingRadius() { return mBoundingRadius; }
+  void setBoundingRadius(float radius) { mBoundingRadius = radius; }
+
   /**
    * @brief Test whether voice is primary or a replica
    *
@@ -165,6 +175,7 @@ protected:
                                 // audio out
 
   bool mUseDistAtten{true};
+  float mBoundingRadius{-1.0f};
 };
 
 } // namespace al
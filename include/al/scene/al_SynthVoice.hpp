@@ -400,6 +400,30 @@ the other
    */
   void free() { mActive = false; } // Mark this voice as done.
 
+  /**
+   * @brief Stop processing the voice while its output is silent
+   * @param threshold peak level below which a block is silent. 0 disables.
+   * @param blocks consecutive silent blocks before the voice stops processing
+   *
+   * PolySynth and DynamicScene check the voice output and bus channels after
+   * each block. Once it has been silent for the given number of blocks, a
+   * voice that has been triggered off is freed, so decayed release tails are
+   * not rendered until the voice calls free(). A voice that is still on
+   * becomes virtual: it keeps its id and trigger timing but is only processed
+   * one block in every `blocks` to check whether it is audible again, for
+   * example after being unmuted.
+   */
+  void silenceDetection(float threshold, int blocks = 8) {
+    mSilenceThreshold = threshold;
+    mSilenceBlocks = blocks > 0 ? blocks : 1;
+  }
+
+  /**
+   * @brief Returns true while the voice is not processed because it is
+   * silent or too far away to be heard.
+   */
+  bool isVirtual() { return mSilent || mCulled; }
+
   /**
    * @brief Set voice as part of a replica distributed scene
    */
@@ -435,6 +459,17 @@ private:
   bool mActive{false};
   int mOnOffsetFrames{0};
   int mOffOffsetFrames{0};
+  bool mReleased{false}; // Triggered off
+
+  // Virtual voice state. See silenceDetection()
+  float mSilenceThreshold{0.0f};
+  int mSilenceBlocks{8};
+  int mSilentBlocks{0};  // Consecutive silent blocks
+  int mSkippedBlocks{0}; // Blocks not processed since last check
+  bool mSilent{false};
+  bool mCulled{false}; // Inaudible at its distance in DynamicScene
+  bool mStolen{false}; // Faded out over its next block, then freed
+
   void *mUserData;
   unsigned int mNumOutChannels{1};
 };
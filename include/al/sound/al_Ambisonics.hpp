@@ -50,9 +50,11 @@
 */
 
 #include <stdio.h>
+#include <cmath>
 #include <cstring>
 
 #include <iostream>
+#include <vector>
 
 #include "al/math/al_Vec.hpp"
 #include "al/sound/al_Spatializer.hpp"
@@ -114,8 +116,19 @@ namespace al {
 /// @ingroup Sound
 class AmbiBase {
 public:
+  /// Channel ordering and normalization of the Ambisonic domain channels
+  ///
+  /// FUMA is the Furse-Malham set, which is only defined up to third order.
+  /// ACN_SN3D uses Ambisonic Channel Numbering (channel = l*l + l + m) with
+  /// Schmidt semi-normalization and is computed to any order. In 2D, ACN_SN3D
+  /// keeps only the sectoral harmonics (W, then sin and cos of each order)
+  /// with circular normalization.
+  enum Convention { FUMA = 0, ACN_SN3D };
+
   /// @param[in] dim		number of spatial dimensions (2 or 3)
-  /// @param[in] order	highest spherical harmonic order
+  /// @param[in] order	highest spherical harmonic order. Orders above 3
+  /// switch the convention to ACN_SN3D with a warning if it was FUMA.
+  /// Set convention(ACN_SN3D) first to avoid the warning.
   AmbiBase(int dim, int order);
 
   virtual ~AmbiBase();
@@ -136,8 +149,17 @@ public:
   void dim(int dim);
 
   /// Set the order
+  ///
+  /// Orders above 3 are not available in FuMa, so the convention switches
+  /// to ACN_SN3D and a warning is printed if it was FUMA.
   void order(int order);
 
+  /// Get channel convention
+  Convention convention() const { return mConvention; }
+
+  /// Set channel convention
+  void convention(Convention c);
+
   /// Called whenever the number of Ambisonic channels changes
   virtual void onChannelsChange() {}
 
@@ -159,18 +181,57 @@ public:
   /// (x,y,z unit vector in the listener's coordinate frame)
   static void encodeWeightsFuMa16(float *ws, float x, float y, float z);
 
+  /// Compute ACN/SN3D spherical harmonic weights of any order based on a unit
+  /// direction vector (in the listener's coordinate frame)
+  ///
+  /// The associated Legendre functions are computed by recurrence in the
+  /// degree, so no trigonometric functions are evaluated.
+  /// ws must hold orderToChannels(dim, order) values.
+  static void encodeWeightsACN(float *ws, int dim, int order, float x, float y,
+                               float z);
+
+  /// Compute ACN/SN3D spherical harmonic weights based on azimuth and
+  /// elevation in radians
+  static void encodeWeightsACN(float *ws, int dim, int order, float azimuth,
+                               float elevation);
+
+  /// Compute weights in the given convention from a unit direction vector
+  static void encodeWeights(float *ws, Convention convention, int dim,
+                            int order, float x, float y, float z);
+
+  /// Returns the harmonic degree (order) of an Ambisonic channel
+  static int channelDegree(Convention convention, int dim, int order,
+                           int channel);
+
+  /// Returns the harmonic index m (-degree to degree) of an Ambisonic channel.
+  /// Negative m are the sine terms.
+  static int channelIndex(Convention convention, int dim, int order,
+                          int channel);
+
   static int orderToChannels(int dim, int order);
   static int orderToChannelsH(int orderH);
   static int orderToChannelsV(int orderV);
 
+  /// Returns the order of a dim dimensional layout with the given number of
+  /// channels, or -1 if there is none
+  static int channelsToOrder(int dim, int channels);
+
+  /// Returns the order of a layout with the given number of channels, or -1
+  /// if there is none. Odd squares other than 1 (9, 25, 49, ...) are 2D and
+  /// 3D layouts of different orders and also return -1, use
+  /// channelsToOrder(dim, channels) for them.
   static int channelsToOrder(int channels);
+
+  /// Returns 2 or 3 for the number of channels, or -1 if no layout or both
+  /// 2D and 3D layouts have that many channels
   static int channelsToDimensions(int channels);
 
 protected:
-  int mDim;        // dimensions - 2d or 3d
-  int mOrder;      // order - 0th, 1st, 2nd, or 3rd
-  int mChannels;   // cached for efficiency
-  float *mWeights; // weights for each ambi channel
+  int mDim;                     // dimensions - 2d or 3d
+  int mOrder;                   // order - 0th, 1st, 2nd, ...
+  int mChannels;                // cached for efficiency
+  float *mWeights;              // weights for each ambi channel
+  Convention mConvention{FUMA}; // channel ordering and normalization
 
   template <typename T> static void resize(T *&a, int n);
 };
@@ -188,6 +249,13 @@ public:
 
   virtual ~AmbiDecode();
 
+  /// Decode a block by multiplying the (speakers x channels) decode matrix
+  /// with the (channels x frames) Ambisonic block.
+  ///
+  /// The product is computed in register blocks of 4 speakers by 8 frames
+  /// over cache-sized frame tiles. The inner loops are fixed-size
+  /// multiply-adds that the compiler vectorizes.
+  ///
   /// @param[out] dec				output time domain buffers
   /// (non-interleaved)
   /// @param[in ] enc				input Ambisonic domain buffers
@@ -231,6 +299,13 @@ public:
   void setSpeakers(Speakers *spkrs);
   void setSpeakers(Speakers &spkrs);
 
+  /// Read Speaker azimuths as clockwise, as documented in Speaker
+  ///
+  /// Disabled by default, in which case Speaker azimuths are read as
+  /// anti-clockwise like the Ambisonic azimuth. Set before the speakers.
+  void clockwiseAzimuth(bool enable);
+  bool clockwiseAzimuth() const { return mClockwiseAzimuth; }
+
   //	float * azimuths();				///< Returns pointer to
   // speaker azimuths.
   //	float * elevations();			///< Returns pointer to speaker
@@ -245,15 +320,23 @@ public:
 protected:
   int mNumSpeakers;
   int mFlavor;          // decode flavor
+  bool mClockwiseAzimuth{false};
   float *mDecodeMatrix; // deccoding matrix for each ambi channel & speaker
                         // cols are channels and rows are speakers
-  float mWOrder[5];     // weights for each order
+  std::vector<float> mWOrder; // weights for each order
   Speakers mSpeakers;
+  // Decode gains of speakers with non-zero gain including the channel
+  // weights, interleaved in groups of 4 speakers for decode()
+  mutable std::vector<float> mDecodeGains;
+  mutable std::vector<int> mDecodeOutputs; // device channel of active speakers
+  mutable bool mDecodeGainsDirty{true};
   // float * mPositions;		// speakers' azimuths + elevations
   // float * mFrame;			// an ambisonic channel frame used for
   // decode(int)
 
   void updateChanWeights();
+  void updateDecodeGains() const;
+  void computeSpeakerRow(int index);
   void resizeArrays(int numChannels, int numSpeakers);
 
   float decode(float *encFrame, int encNumChannels,
@@ -318,8 +401,66 @@ public:
   void print(std::ostream &stream);
 };
 
+/// Rotation of an Ambisonic soundfield
+///
+/// Applies per degree rotation matrices to Ambisonic domain buffers. The
+/// 3D matrices are computed from the first order rotation with the
+/// Ivanic-Ruedenberg recurrence. In 2D only the rotation about the vertical
+/// axis is applied.
+///
+/// @ingroup Sound
+class AmbiRotate : public AmbiBase {
+public:
+  /// @param[in] dim			number of spatial dimensions (2 or 3)
+  /// @param[in] order		highest spherical harmonic order
+  AmbiRotate(int dim, int order);
+
+  /// Set rotation from a row-major 3x3 matrix in Ambisonic coordinates
+  /// (+x forward, +y left, +z up). Directions d are mapped to r * d.
+  void matrix(const double *r);
+
+  /// Set rotation from a quaternion in Ambisonic coordinates
+  void rotation(const Quatd &q);
+
+  /// Returns the gain from input channel to output channel
+  float rotationWeight(int outChannel, int inChannel) const;
+
+  /// Allocate the scratch buffer used by rotate() for a block size
+  void numFrames(int numFrames);
+
+  /// Rotate Ambisonic domain buffers in place
+  ///
+  /// Does not allocate. numFrames() must have been called with at least
+  /// numFrames, otherwise the buffers are left unrotated.
+  ///
+  /// @param[in,out] ambiChans	Ambisonic domain channels (non-interleaved)
+  /// @param[in] numFrames		number of frames in each channel
+  void rotate(float *ambiChans, int numFrames);
+
+  virtual void onChannelsChange() override;
+
+protected:
+  // Channels of each degree ordered by harmonic index and the rotation
+  // matrix between them, including the normalization of the convention
+  struct Degree {
+    std::vector<int> channels;
+    std::vector<float> matrix; // row-major, channels.size() squared
+  };
+  std::vector<Degree> mDegrees;
+  std::vector<float> mScales; // channel gain relative to ACN/SN3D
+  std::vector<float> mBuffer; // copy of the input channels of one degree
+  // ACN/SN3D rotation of the current and previous degree for matrix(),
+  // sized for the highest degree
+  std::vector<double> mRotation, mPrevRotation;
+};
+
 /// Ambisonic coder
 ///
+/// By default source positions are passed to the encoder unchanged and
+/// Speaker azimuths are read as anti-clockwise. Enable sceneCoordinates() to
+/// convert positions from graphics coordinates and to rotate the mix to the
+/// listener orientation with soundfieldRotation().
+///
 /// @ingroup Sound
 class AmbisonicsSpatializer : public Spatializer {
 public:
@@ -331,6 +472,32 @@ public:
 
   void configure(int dim, int order, int flavor);
 
+  /// Set channel convention of encoder and decoder. Call compile() after.
+  void convention(AmbiBase::Convention c);
+
+  /// Use the coordinate conventions of the scene
+  ///
+  /// When enabled, source positions are converted from graphics coordinates
+  /// (+x right, +y up, +z backward) to the Ambisonic frame described above
+  /// and normalized, and Speaker azimuths are read as clockwise. Disabled by
+  /// default, which keeps the previous mapping. Call compile() after.
+  void sceneCoordinates(bool enable);
+
+  /// Enable or disable rotation of the mix to the listener orientation
+  ///
+  /// When enabled sources are encoded relative to the listener position
+  /// only and the orientation set with listenerOrientation() is applied
+  /// once to the Ambisonic mix in finalize(). Disabled by default. Only
+  /// takes effect with sceneCoordinates() enabled, as the rotation is
+  /// computed in the Ambisonic frame.
+  void soundfieldRotation(bool enable) { mRotateSoundfield = enable; }
+
+  virtual bool rotatesSoundfield() const override {
+    return mRotateSoundfield && mSceneCoordinates;
+  }
+
+  virtual void listenerOrientation(const Quatd &orientation) override;
+
   float *ambiChans(unsigned channel = 0);
 
   virtual void compile() override;
@@ -356,8 +523,14 @@ public:
   virtual void print(std::ostream &stream = std::cout) override;
 
 private:
+  void encoderDirection(const Vec3f &pos);
+
   AmbiDecode mDecoder;
   AmbiEncode mEncoder;
+  AmbiRotate mRotate;
+  bool mSceneCoordinates{false};
+  bool mRotateSoundfield{false};
+  bool mRotationIdentity{true};
   std::vector<float> mAmbiDomainChannels;
   //	Listener* mListener;
 };
@@ -373,40 +546,72 @@ inline int AmbiBase::orderToChannels(int dim, int order) {
 inline int AmbiBase::orderToChannelsH(int orderH) { return (orderH << 1) + 1; }
 inline int AmbiBase::orderToChannelsV(int orderV) { return orderV * orderV; }
 
+inline int AmbiBase::channelsToOrder(int dim, int channels) {
+  if (channels < 1) {
+    return -1;
+  }
+  // 3D layouts have (order + 1)^2 channels, 2D layouts 2 * order + 1
+  if (dim == 3) {
+    int root = channelsToUniformOrder(channels) + 1;
+    return root * root == channels ? root - 1 : -1;
+  } else if (dim == 2) {
+    return (channels & 1) ? (channels - 1) >> 1 : -1;
+  }
+  return -1;
+}
+
 inline int AmbiBase::channelsToOrder(int channels) {
-  int order = -1;
-  switch (channels) {
-  case 3:
-  case 4:
-    order = 1;
-    break;
-  case 9:
-    order = 2;
-    break;
-  case 16:
-    order = 3;
-    break;
-  default:
-    order = -1;
+  const int order2 = channelsToOrder(2, channels);
+  const int order3 = channelsToOrder(3, channels);
+  if (order2 >= 0 && order3 >= 0) {
+    return order2 == order3 ? order2 : -1;
   }
-  return order;
+  return order2 >= 0 ? order2 : order3;
 }
 
 inline int AmbiBase::channelsToDimensions(int channels) {
-  int dim = 3;
-  switch (channels) {
-  case 3:
-    dim = 2;
-    break;
-  case 4:
-  case 9:
-  case 16:
-    dim = 3;
-    break;
-  default:
-    dim = -1;
+  const int order2 = channelsToOrder(2, channels);
+  const int order3 = channelsToOrder(3, channels);
+  if (order2 >= 0 && order3 >= 0) {
+    return -1;
   }
-  return dim;
+  return order2 >= 0 ? 2 : (order3 >= 0 ? 3 : -1);
+}
+
+inline int AmbiBase::channelDegree(Convention convention, int dim, int order,
+                                   int channel) {
+  if (convention == ACN_SN3D) {
+    return dim == 2 ? (channel + 1) >> 1 : int(std::sqrt(double(channel)));
+  }
+  // FuMa: W X Y U V P Q up to the order, then Z S T R N O L M K in 3D
+  static const int degreesH[] = {0, 1, 1, 2, 2, 3, 3};
+  static const int degreesV[] = {1, 2, 2, 2, 3, 3, 3, 3, 3};
+  int numH = orderToChannelsH(order);
+  if (channel < numH) {
+    return channel < 7 ? degreesH[channel] : -1;
+  }
+  channel -= numH;
+  return (dim == 3 && channel < 9) ? degreesV[channel] : -1;
+}
+
+inline int AmbiBase::channelIndex(Convention convention, int dim, int order,
+                                  int channel) {
+  if (convention == ACN_SN3D) {
+    int l = channelDegree(convention, dim, order, channel);
+    if (dim == 2) {
+      return (channel & 1) ? -l : l;
+    }
+    return channel - l * l - l;
+  }
+  // FuMa: W X Y U V P Q, then Z S T R N O L M K
+  static const int indicesH[] = {0, 1, -1, 2, -2, 3, -3};
+  static const int indicesV[] = {0, 1, -1, 0, 2, -2, 1, -1, 0};
+  int numH = orderToChannelsH(order);
+  if (channel < numH) {
+    return channel < 7 ? indicesH[channel] : 0;
+  }
+  channel -= numH;
+  return (dim == 3 && channel < 9) ? indicesV[channel] : 0;
 }
 
 template <typename T> void AmbiBase::resize(T *&a, int n) {
@@ -447,16 +652,19 @@ inline float AmbiDecode::decode(float *encFrame, int encNumChannels,
 //}
 
 inline void AmbiEncode::direction(float az, float el) {
-  AmbiBase::encodeWeightsFuMa(mWeights, mDim, mOrder, az, el);
+  if (mConvention == ACN_SN3D) {
+    AmbiBase::encodeWeightsACN(mWeights, mDim, mOrder, az, el);
+  } else {
+    AmbiBase::encodeWeightsFuMa(mWeights, mDim, mOrder, az, el);
+  }
 }
 
 inline void AmbiEncode::direction(Vec3f vector) {
-  AmbiBase::encodeWeightsFuMa(mWeights, mDim, mOrder, vector.x, vector.y,
-                              vector.z);
+  direction(vector.x, vector.y, vector.z);
 }
 
 inline void AmbiEncode::direction(float x, float y, float z) {
-  AmbiBase::encodeWeightsFuMa(mWeights, mDim, mOrder, x, y, z);
+  AmbiBase::encodeWeights(mWeights, mConvention, mDim, mOrder, x, y, z);
 }
 
 inline void AmbiEncode::encode(float *ambiChans, int numFrames, int timeIndex,
@@ -468,6 +676,10 @@ inline void AmbiEncode::encode(float *ambiChans, int numFrames, int timeIndex,
     ambiChans[chanindex * numFrames + timeIndex] +=                            \
         weights()[chanindex] * timeSample;
   int ch = channels() - 1;
+  // Orders above 3 have more channels than the unrolled cases
+  for (; ch > 15; --ch) {
+    ambiChans[ch * numFrames + timeIndex] += weights()[ch] * timeSample;
+  }
   switch (ch) {
     CS(15)
     CS(14)
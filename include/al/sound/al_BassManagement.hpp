@@ -0,0 +1,115 @@
+#ifndef AL_BASSMANAGEMENT
+#define AL_BASSMANAGEMENT
+
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/sound/al_Speaker.hpp"
+
+namespace al {
+
+/**
+ * @brief Move the low frequencies of a speaker layout to subwoofers
+ *
+ * Every speaker channel is split with a Crossover. The highs stay on the
+ * speaker and the lows of all speakers are summed and shared equally by the
+ * subwoofer channels, adding to what is already on them. Since each split
+ * sums to an allpass, speakers and subwoofers together keep a flat magnitude
+ * response. Each device channel, speaker or subwoofer, can then be delayed
+ * and scaled to compensate for its placement.
+ *
+ * Channels are filtered eight at a time, one per vector lane.
+ *
+ * @code
+ * BassManagement bassManagement(80.f, audioIO().framesPerSecond());
+ * bassManagement.setSpeakers(speakerLayout, {60, 61});
+ * bassManagement.compensateDistances();
+ * audioIO().append(bassManagement);
+ * @endcode
+ */
+class BassManagement : public AudioCallback {
+ public:
+  BassManagement(float crossoverFrequency = 80.f, double sampleRate = 44100);
+
+  /// Set the speakers to split and the device channels of the subwoofers
+  void setSpeakers(const Speakers& speakers,
+                   const std::vector<int>& subwooferChannels);
+
+  void crossoverFrequency(float frequency);
+  float crossoverFrequency() const { return mFrequency; }
+
+  /// Set sample rate. Reallocates delay lines, so don't call it from the
+  /// audio thread. Delays keep their length in seconds.
+  void sampleRate(double rate);
+  double sampleRate() const { return mSampleRate; }
+
+  /// Take sample rate and block size from io. Call before starting audio.
+  void prepare(const AudioIOData& io);
+
+  /// Set the longest delay in seconds. Allocates delay lines.
+  void maxDelay(float seconds);
+  float maxDelay() const { return mMaxDelay; }
+
+  /// Set delay in seconds of a speaker or subwoofer device channel. Delays
+  /// are rounded to whole frames.
+  void delay(int deviceChannel, float seconds);
+  float delay(int deviceChannel) const;
+
+  /// Set gain of a speaker or subwoofer device channel
+  void gain(int deviceChannel, float gain);
+  float gain(int deviceChannel) const;
+
+  /**
+   * @brief Align speakers to the farthest one
+   *
+   * Nearer speakers are delayed by the difference in distance and
+   * attenuated by the ratio of distances, using Speaker::radius.
+   */
+  void compensateDistances(float speedOfSound = 343.f);
+
+  /// Clear filter state and delay lines
+  void reset();
+
+  /// Process the output channels of io in place
+  ///
+  /// Doesn't allocate. Uses the sample rate set with prepare() or
+  /// sampleRate(), and processes blocks longer than the one passed to
+  /// prepare() in several parts.
+  void onAudioCB(AudioIOData& io) override;
+
+ private:
+  static const int kLanes = 8;
+  static const int kTile = 16;
+
+  struct Channel {
+    int deviceChannel;
+    float gain{1.f};
+    int delay{0};  // in frames
+    float delayTime{0.f};  // in seconds, as requested
+    std::vector<float> delayLine;
+    size_t writeIndex{0};
+  };
+
+  Channel* findChannel(int deviceChannel);
+  const Channel* findChannel(int deviceChannel) const;
+  void updateCoefficients();
+  void allocateDelays();
+  void process(AudioIOData& io, int offset, int numFrames);
+  void applyDelayAndGain(Channel& channel, float* buffer, int numFrames);
+
+  float mFrequency;
+  double mSampleRate;
+  float mMaxDelay{0.05f};
+  float mC0{0}, mC1{0};
+
+  Speakers mSpeakers;
+  std::vector<Channel> mSpeakerChannels;
+  std::vector<Channel> mSubwooferChannels;
+  // Crossover state, one entry per speaker padded to whole groups of lanes
+  std::vector<float> mZ0, mZ1, mZ2;
+  std::vector<float> mLows;  // lows summed over all speakers for a block
+};
+
+}  // namespace al
+
+#endif  // AL_BASSMANAGEMENT
@@ -5,6 +5,9 @@
 #ifndef __AL_BIQUAD__
 #define __AL_BIQUAD__
 
+#include <algorithm>
+#include <vector>
+
 namespace al {
 
 /* this holds the data required to update samples thru a filter */
@@ -40,6 +43,10 @@ class BiQuad {
 
   void enable(bool on) { enabled = on; }
 
+  /// Compute normalized coefficients a0-a4 of bd for a filter design
+  static void design(BiquadData &bd, BIQUADTYPE type, double sampleRate,
+                     double freq, double bandwidth = 1.9, double dbGain = 0);
+
  private:
   BIQUADTYPE mType;
   BiquadData mBD;
@@ -69,6 +76,265 @@ class BiQuadNX {
   BiQuad *mFilters;
 };
 
+/// Bank of cascaded biquads filtering many channels at once
+///
+/// Channels are grouped by Lanes and each group is filtered with one channel
+/// per lane in transposed direct form II, so the inner loops vectorize across
+/// channels. Each channel has a cascade of stages() sections with their own
+/// coefficients. T is the precision of coefficients and filter state; audio
+/// buffers are float. Use 8 lanes for float and 4 for double to fill 256 bit
+/// vectors.
+///
+/// Coefficient changes are smoothed: sections move linearly to the new
+/// coefficients every 16 frames over the smoothing time. Set coefficients
+/// from the thread that calls process().
+///
+/// @code
+/// BiQuadBank<float> eq(io.channelsOut(), 2, io.framesPerSecond());
+/// for (int c = 0; c < io.channelsOut(); c++) {
+///   eq.set(c, 0, BIQUAD_HPF, 40);
+///   eq.set(c, 1, BIQUAD_PEQ, 2000, 1.0, gains[c]);
+/// }
+/// ...
+/// eq.process(io.outBuffer(0), io.framesPerBuffer(), io.framesPerBuffer());
+/// @endcode
+///
+/// @ingroup Sound
+template <typename T = float, int Lanes = 8>
+class BiQuadBank {
+ public:
+  BiQuadBank(int numChannels = 0, int numStages = 1,
+             double sampleRate = 44100)
+      : mSampleRate(sampleRate) {
+    resize(numChannels, numStages);
+  }
+
+  /// Set number of channels and stages per channel. All sections pass signal
+  /// through until set.
+  void resize(int numChannels, int numStages);
+
+  int channels() const { return mNumChannels; }
+  int stages() const { return mNumStages; }
+
+  void setSampleRate(double rate) { mSampleRate = rate; }
+  double sampleRate() const { return mSampleRate; }
+
+  /// Set number of frames over which coefficient changes are spread. 0
+  /// applies them at once.
+  void smoothing(int frames) { mSmoothingFrames = std::max(frames, 0); }
+  int smoothing() const { return mSmoothingFrames; }
+
+  /// Design a section of a channel as BiQuad::set() does
+  void set(int channel, int stage, BIQUADTYPE type, double freq,
+           double bandwidth = 1.9, double dbGain = 0);
+
+  /// Set normalized coefficients of a section, with a0 = 1
+  void setCoefficients(int channel, int stage, double b0, double b1,
+                       double b2, double a1, double a2);
+
+  /// Jump to the latest coefficients, skipping smoothing
+  void settle();
+
+  /// Clear filter state
+  void reset();
+
+  /// Filter channels in place. Channel c starts at buffer + c * stride.
+  void process(float *buffer, int numFrames, int stride);
+
+  /// Filter channels in place, one buffer per channel
+  void process(float *const *buffers, int numFrames);
+
+ private:
+  static const int kTile = 16;  // frames between coefficient steps
+
+  // One section for each lane of a group, structure of arrays
+  struct Section {
+    T coefs[5][Lanes];   // b0 b1 b2 a1 a2
+    T targets[5][Lanes];
+    T steps[5][Lanes];
+    T z1[Lanes];
+    T z2[Lanes];
+    int rampTiles;
+  };
+
+  void processGroup(int group, float *const *buffers, int numFrames);
+
+  std::vector<Section> mSections;  // group major, then stage
+  int mNumChannels{0};
+  int mNumStages{0};
+  int mSmoothingFrames{0};
+  double mSampleRate;
+};
+
+// Implementation ______________________________________________________________
+
+template <typename T, int Lanes>
+void BiQuadBank<T, Lanes>::resize(int numChannels, int numStages) {
+  mNumChannels = std::max(numChannels, 0);
+  mNumStages = std::max(numStages, 0);
+  const int numGroups = (mNumChannels + Lanes - 1) / Lanes;
+  Section passThrough;
+  for (int l = 0; l < Lanes; l++) {
+    for (int k = 0; k < 5; k++) {
+      passThrough.coefs[k][l] = k == 0 ? T(1) : T(0);
+      passThrough.targets[k][l] = passThrough.coefs[k][l];
+      passThrough.steps[k][l] = T(0);
+    }
+    passThrough.z1[l] = passThrough.z2[l] = T(0);
+  }
+  passThrough.rampTiles = 0;
+  mSections.assign(numGroups * mNumStages, passThrough);
+}
+
+template <typename T, int Lanes>
+void BiQuadBank<T, Lanes>::set(int channel, int stage, BIQUADTYPE type,
+                               double freq, double bandwidth, double dbGain) {
+  BiquadData bd;
+  BiQuad::design(bd, type, mSampleRate, freq, bandwidth, dbGain);
+  setCoefficients(channel, stage, bd.a0, bd.a1, bd.a2, bd.a3, bd.a4);
+}
+
+template <typename T, int Lanes>
+void BiQuadBank<T, Lanes>::setCoefficients(int channel, int stage, double b0,
+                                           double b1, double b2, double a1,
+                                           double a2) {
+  if (channel < 0 || channel >= mNumChannels || stage < 0 ||
+      stage >= mNumStages) {
+    return;
+  }
+  Section &section = mSections[(channel / Lanes) * mNumStages + stage];
+  const int lane = channel % Lanes;
+  const double values[5] = {b0, b1, b2, a1, a2};
+  for (int k = 0; k < 5; k++) {
+    section.targets[k][lane] = T(values[k]);
+  }
+  if (mSmoothingFrames == 0) {
+    for (int k = 0; k < 5; k++) {
+      section.coefs[k][lane] = section.targets[k][lane];
+    }
+    return;
+  }
+  // Restart the ramp of the section from where each lane is now
+  section.rampTiles = (mSmoothingFrames + kTile - 1) / kTile;
+  for (int k = 0; k < 5; k++) {
+    for (int l = 0; l < Lanes; l++) {
+      section.steps[k][l] =
+          (section.targets[k][l] - section.coefs[k][l]) / section.rampTiles;
+    }
+  }
+}
+
+template <typename T, int Lanes>
+void BiQuadBank<T, Lanes>::settle() {
+  for (auto &section : mSections) {
+    for (int k = 0; k < 5; k++) {
+      for (int l = 0; l < Lanes; l++) {
+        section.coefs[k][l] = section.targets[k][l];
+      }
+    }
+    section.rampTiles = 0;
+  }
+}
+
+template <typename T, int Lanes>
+void BiQuadBank<T, Lanes>::reset() {
+  for (auto &section : mSections) {
+    for (int l = 0; l < Lanes; l++) {
+      section.z1[l] = section.z2[l] = T(0);
+    }
+  }
+}
+
+template <typename T, int Lanes>
+void BiQuadBank<T, Lanes>::process(float *buffer, int numFrames, int stride) {
+  float *buffers[Lanes];
+  for (int g = 0; g * Lanes < mNumChannels; g++) {
+    for (int l = 0; l < Lanes; l++) {
+      const int channel = g * Lanes + l;
+      buffers[l] = channel < mNumChannels ? buffer + channel * stride : nullptr;
+    }
+    processGroup(g, buffers, numFrames);
+  }
+}
+
+template <typename T, int Lanes>
+void BiQuadBank<T, Lanes>::process(float *const *buffers, int numFrames) {
+  float *groupBuffers[Lanes];
+  for (int g = 0; g * Lanes < mNumChannels; g++) {
+    for (int l = 0; l < Lanes; l++) {
+      const int channel = g * Lanes + l;
+      groupBuffers[l] = channel < mNumChannels ? buffers[channel] : nullptr;
+    }
+    processGroup(g, groupBuffers, numFrames);
+  }
+}
+
+template <typename T, int Lanes>
+void BiQuadBank<T, Lanes>::processGroup(int group, float *const *buffers,
+                                        int numFrames) {
+  Section *sections = mSections.data() + group * mNumStages;
+  // Frames are transposed into a tile with the lanes contiguous
+  T x[kTile][Lanes];
+  for (int i = 0; i < numFrames; i += kTile) {
+    const int n = std::min(kTile, numFrames - i);
+    for (int l = 0; l < Lanes; l++) {
+      for (int j = 0; j < n; j++) {
+        x[j][l] = buffers[l] ? T(buffers[l][i + j]) : T(0);
+      }
+    }
+
+    for (int s = 0; s < mNumStages; s++) {
+      Section &section = sections[s];
+      if (section.rampTiles > 0) {
+        if (--section.rampTiles == 0) {
+          std::copy(&section.targets[0][0], &section.targets[0][0] + 5 * Lanes,
+                    &section.coefs[0][0]);
+        } else {
+          for (int k = 0; k < 5; k++) {
+            for (int l = 0; l < Lanes; l++) {
+              section.coefs[k][l] += section.steps[k][l];
+            }
+          }
+        }
+      }
+
+      // Local copies stay in registers across the tile
+      T b0[Lanes], b1[Lanes], b2[Lanes], a1[Lanes], a2[Lanes];
+      T z1[Lanes], z2[Lanes];
+      for (int l = 0; l < Lanes; l++) {
+        b0[l] = section.coefs[0][l];
+        b1[l] = section.coefs[1][l];
+        b2[l] = section.coefs[2][l];
+        a1[l] = section.coefs[3][l];
+        a2[l] = section.coefs[4][l];
+        z1[l] = section.z1[l];
+        z2[l] = section.z2[l];
+      }
+      for (int j = 0; j < n; j++) {
+        for (int l = 0; l < Lanes; l++) {
+          const T in = x[j][l];
+          const T out = b0[l] * in + z1[l];
+          z1[l] = b1[l] * in - a1[l] * out + z2[l];
+          z2[l] = b2[l] * in - a2[l] * out;
+          x[j][l] = out;
+        }
+      }
+      for (int l = 0; l < Lanes; l++) {
+        section.z1[l] = z1[l];
+        section.z2[l] = z2[l];
+      }
+    }
+
+    for (int l = 0; l < Lanes; l++) {
+      if (buffers[l]) {
+        for (int j = 0; j < n; j++) {
+          buffers[l][i + j] = float(x[j][l]);
+        }
+      }
+    }
+  }
+}
+
 }  // namespace al
 
 #endif /* defined(__AL_BIQUAD__) */
@@ -48,6 +48,8 @@
 #include <float.h>
 #include <stdio.h>
 
+#include <cmath>
+
 #include "al/math/al_Constants.hpp"
 
 namespace al {
@@ -63,6 +65,9 @@ public:
   /// set the cross-over middle frequency
   void freq(T f, T fs);
 
+  /// compute the coefficients used by freq() for processing many channels
+  static void coefficients(T f, T fs, T &c0, T &c1);
+
   Crossover(T f = (T)600, T fs = (T)44100.) {
     freq(f, fs);
     clear();
@@ -82,16 +87,21 @@ protected:
   T mC0, mC1, mZ0, mZ1, mZ2;
 };
 
-template <> void Crossover<double>::freq(double f, double fs) {
-  double rad = M_PI * 2. * f / fs;
-  double cosine = cos(rad);
-  double sine = sin(rad);
-  if (abs(c) > 0.0001) {
-    mC0 = (sine - 1.) / cosine;
+template <typename T>
+inline void Crossover<T>::coefficients(T f, T fs, T &c0, T &c1) {
+  T rad = T(M_PI * 2.) * f / fs;
+  T cosine = std::cos(rad);
+  T sine = std::sin(rad);
+  if (std::abs(cosine) > T(0.0001)) {
+    c0 = (sine - T(1)) / cosine;
   } else {
-    mC0 = cosine * 0.5;
+    c0 = cosine * T(0.5);
   }
-  mC1 = (1. + mC0) * 0.5;
+  c1 = (T(1) + c0) * T(0.5);
+}
+
+template <typename T> inline void Crossover<T>::freq(T f, T fs) {
+  coefficients(f, fs, mC0, mC1);
 }
 
 template <>
@@ -115,18 +125,6 @@ inline void Crossover<double>::next(const double in, double *lo, double *hi) {
   *hi = x0 - x2;
 }
 
-template <> void Crossover<float>::freq(float f, float fs) {
-  float rad = M_PI * 2.f * f / fs;
-  float cosine = cosf(rad);
-  float sine = sinf(rad);
-  if (fabs(cosine) > 0.0001f) {
-    mC0 = (sine - 1.f) / cosine;
-  } else {
-    mC0 = cosine * 0.5f;
-  }
-  mC1 = (1.f + mC0) * 0.5f;
-}
-
 template <>
 inline void Crossover<float>::next(const float in, float *lo, float *hi) {
   static const float denorm_offset = FLT_EPSILON * 2.;
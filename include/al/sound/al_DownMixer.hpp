@@ -19,6 +19,12 @@ on the first buffer it processes.
 
 DownMixer will downmix to buffers, and can optionally copy the buses to outputs
                                        using the setOutputs() function.
+
+The routing set by the configuration functions is compiled into a sparse
+matrix with one row of (input, gain) pairs per downmix bus. Mixing works on
+tiles of frames that are accumulated for all buses before being written, so
+the inner loops run over contiguous channel buffers and the outputs may also
+be inputs.
  */
 class DownMixer {
 public:
@@ -26,18 +32,61 @@ public:
   void layoutToStereo(const Speakers &sl, AudioIOData &io);
   void set5_1toStereo(AudioIOData &io);
 
+  /**
+   * @brief Fold one speaker layout down to another
+   * @param from layout of the output channels to downmix
+   * @param to target layout. Bus i feeds speaker to[i].
+   * @param io buses are added here
+   *
+   * Each source speaker is shared between the target speakers in front of it
+   * in proportion to the cosine of the angle to them, normalized to keep its
+   * power. A speaker that has no target within 90 degrees goes to the closest
+   * one.
+   */
+  void layoutToLayout(const Speakers &from, const Speakers &to,
+                      AudioIOData &io);
+
+  /**
+   * @brief Set an arbitrary N to M mix
+   * @param gains gains[output][input], one row per downmix bus
+   * @param io buses are added here
+   *
+   * Zero gains are left out of the compiled matrix.
+   */
+  void setMatrix(const std::vector<std::vector<float>> &gains,
+                 AudioIOData &io);
+
   void setStereoOutput();
   void setOutputs(std::vector<uint32_t> outs);
 
+  /// Number of buses the downmix writes to
+  uint32_t numOutputs() const { return uint32_t(mRowStart.size()) - 1; }
+
   // process
   void downMix(AudioIOData &io);
   void downMixToBus(AudioIOData &io);
   void copyBusToOuts(AudioIOData &io);
 
 private:
+  struct Route {
+    uint32_t input;
+    float gain;
+  };
+
+  // Build the sparse matrix from mRoutingMap and reserve the buses
+  void compile(AudioIOData &io, uint32_t numOutputs);
+  void mix(AudioIOData &io, bool toOuts);
+
   std::map<uint32_t, std::vector<std::pair<uint32_t, float>>> mRoutingMap;
   std::vector<uint32_t> mOuts;
   int mBusStartNumber = -1;
+  int mNumBuses = 0;
+
+  // Compiled routing, mRoutes[mRowStart[o]] to mRoutes[mRowStart[o + 1]]
+  // feed bus o
+  std::vector<Route> mRoutes;
+  std::vector<uint32_t> mRowStart{0};
+  std::vector<float> mScratch; // one tile per bus
 };
 
 } // namespace al
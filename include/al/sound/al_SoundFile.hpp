@@ -96,6 +96,29 @@ class SoundFileStreaming {
   void* mImpl{nullptr};
 };
 
+/// @brief Writes interleaved float frames to a 32 bit float WAV file
+/// @ingroup Sound
+class SoundFileWriter {
+ public:
+  SoundFileWriter() {}
+  ~SoundFileWriter();
+
+  SoundFileWriter(const SoundFileWriter&) = delete;
+  SoundFileWriter& operator=(const SoundFileWriter&) = delete;
+
+  bool isOpen() { return mImpl != nullptr; }
+
+  /// Create file for writing. Overwrites existing files.
+  bool open(const char* path, uint32_t sampleRate, uint16_t numChannels);
+  /// Finish writing header and close file
+  void close();
+  /// Write interleaved frames. Returns number of frames written.
+  uint64_t write(const float* buffer, uint64_t numFrames);
+
+ private:
+  void* mImpl{nullptr};
+};
+
 /// @brief Soundfile player class with thread-safe access to playback controls
 /// @ingroup Sound
 struct SoundFilePlayerTS {
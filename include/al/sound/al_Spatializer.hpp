@@ -83,6 +83,15 @@ public:
   /// decode
   virtual void finalize(AudioIOData &io) {}
 
+  /// Returns true if the spatializer applies the listener orientation to its
+  /// whole mix. Source positions passed to renderBuffer() and renderSample()
+  /// are then relative to the listener position but not rotated.
+  virtual bool rotatesSoundfield() const { return false; }
+
+  /// Set the listener orientation for the next block. Only used when
+  /// rotatesSoundfield() returns true.
+  virtual void listenerOrientation(const Quatd &orientation) {}
+
   /// Print out information about spatializer
   virtual void print(std::ostream &stream = std::cout) {}
 
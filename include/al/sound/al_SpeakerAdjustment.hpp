@@ -54,20 +54,51 @@ class SpeakerDistanceGainAdjustmentProcessor
   using SpeakerDistanceGainAdjustment::processGains;
 };
 
-// FIXME implemement time adjustment for speaker distances
+/**
+ * @brief Delay speakers so sound from all of them arrives at the center
+ * together
+ *
+ * Each speaker is delayed by the time sound takes to travel the difference
+ * between its distance and the farthest speaker's distance. Delays have a
+ * fractional part applied with linear interpolation.
+ *
+ * Every speaker has a contiguous delay line holding the history the delay
+ * needs followed by the current block, so the block is processed with plain
+ * loops over contiguous memory.
+ */
 class SpeakerDistanceTimeAdjustment {
  public:
-  //  void configure(Speakers layout, uint64_t framesPerBuffer);
+  /**
+   * @brief Compute the delays of a layout
+   * @param framesPerBuffer size of the delay lines' block. Larger blocks
+   * are processed in several parts, processDelays() never allocates.
+   */
+  void configure(Speakers layout, double framesPerSecond,
+                 uint64_t framesPerBuffer = 512, float speedOfSound = 343.f);
 
   void processDelays(AudioIOData& io);
 
+  /// Clear the delay lines
+  void reset();
+
  public:
-  //  std::vector<float> mGains;
+  std::vector<float> mDelays;  // in frames
   Speakers mLayout;
+
+ private:
+  struct DelayLine {
+    std::vector<float> buffer;  // history, then the current block
+    unsigned int history{0};
+    unsigned int frames{0};  // integer part of the delay
+    float fraction{0.f};
+  };
+  void processLine(DelayLine& line, float* ioBus, unsigned int samples);
+  std::vector<DelayLine> mLines;
 };
 
-class SpeakerDistanceTimeAdjustmentProcessor : public AudioCallback,
-                                               SpeakerDistanceTimeAdjustment {
+class SpeakerDistanceTimeAdjustmentProcessor
+    : public AudioCallback,
+      public SpeakerDistanceTimeAdjustment {
  public:
   virtual void onAudioCB(AudioIOData& io) { this->processDelays(io); }
 
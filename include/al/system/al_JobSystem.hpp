@@ -0,0 +1,235 @@
+#ifndef AL_JOBSYSTEM_H
+#define AL_JOBSYSTEM_H
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2022. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   File description:
+   Work-stealing job system
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace al {
+
+/**
+ * @brief The JobSystem class runs jobs on a fixed set of worker threads.
+ * @ingroup System
+ *
+ * Each worker owns a deque of jobs. Jobs submitted from other threads go
+ * to one shared deque. Workers take jobs from the back of their own deque
+ * and steal from the front of the other deques when theirs is empty.
+ * Threads waiting for jobs to finish run pending jobs themselves, so jobs
+ * can submit and wait for other jobs, and sleep while the remaining jobs
+ * run on other threads.
+ *
+ * Deques have a fixed capacity of 256 jobs. Jobs that don't fit run in the
+ * submitting thread, so submitting never allocates.
+ *
+ * parallelFor() splits an index range into chunks and does not allocate.
+ * Use TaskGroup to run and wait for arbitrary functions.
+ *
+ * Jobs must not throw.
+ *
+ * @code
+ * JobSystem jobs;
+ * jobs.parallelFor(0, particles.size(),
+ *                  [&](size_t i) { particles[i].update(dt); });
+ * @endcode
+ */
+class JobSystem {
+public:
+  /**
+   * @param numWorkers number of worker threads. With 0 workers all jobs run
+   * in the thread that waits for them.
+   */
+  JobSystem(unsigned int numWorkers = defaultWorkerCount());
+
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  /// Number of worker threads
+  unsigned int numWorkers() const { return (unsigned int)mWorkers.size(); }
+
+  /**
+   * @brief Call f(i) for every i in [begin, end) and wait until done
+   * @param grainSize number of indices per job. 0 chooses a size that makes
+   * about four jobs per thread.
+   *
+   * The calling thread runs jobs while waiting.
+   */
+  template <class F>
+  void parallelFor(size_t begin, size_t end, const F &f, size_t grainSize = 0);
+
+  /// Shared job system using one worker less than the hardware threads
+  static JobSystem &global();
+
+  /// One less than the number of hardware threads, as the thread that waits
+  /// for jobs also runs them
+  static unsigned int defaultWorkerCount();
+
+  /// A unit of work. Jobs are plain data so queuing them does not allocate.
+  struct Job {
+    void (*function)(void *context, size_t begin, size_t end);
+    void *context;
+    size_t begin;
+    size_t end;
+    std::atomic<int> *pending; // decremented when the job is done
+  };
+
+  /// Queue jobs. pending must already count them. Jobs that don't fit in
+  /// the queue are run before returning.
+  void submit(const Job *jobs, size_t count);
+
+  /// Run queued jobs until pending reaches zero, sleeping while there are
+  /// none to run
+  void wait(std::atomic<int> &pending);
+
+private:
+  static const size_t kQueueCapacity = 256;
+
+  // Fixed size ring buffer deque guarded by a mutex. Padded so neighbouring
+  // queues do not share cache lines.
+  struct WorkQueue {
+    char paddingBefore[64];
+    std::mutex lock;
+    Job jobs[kQueueCapacity];
+    size_t head{0};
+    size_t count{0};
+    char paddingAfter[64];
+
+    bool push(const Job &job);
+    bool popBack(Job &job);
+    bool popFront(Job &job);
+  };
+
+  void workerFunction(unsigned int index);
+  bool findJob(int index, Job &job);
+  void run(const Job &job);
+  int currentIndex() const;
+
+  std::vector<std::thread> mWorkers;
+  // One queue per worker plus one for jobs submitted by other threads
+  std::unique_ptr<WorkQueue[]> mQueues;
+  unsigned int mNumQueues{0};
+
+  std::atomic<int> mQueued{0};
+  std::mutex mSleepLock;
+  std::condition_variable mSleepCondition;
+  bool mStop{false};
+};
+
+/**
+ * @brief The TaskGroup class runs functions on a JobSystem and waits for
+ * all of them.
+ * @ingroup System
+ *
+ * run() must be called from a single thread. The destructor waits for
+ * pending functions.
+ */
+class TaskGroup {
+public:
+  TaskGroup(JobSystem &jobs = JobSystem::global()) : mJobs(jobs) {}
+
+  ~TaskGroup() { wait(); }
+
+  /// Queue a function to run on the job system
+  void run(std::function<void()> function);
+
+  /// Run pending functions until all functions in the group have finished
+  void wait();
+
+private:
+  JobSystem &mJobs;
+  std::atomic<int> mPending{0};
+  std::deque<std::function<void()>> mFunctions;
+};
+
+// Implementation ______________________________________________________________
+
+template <class F>
+void JobSystem::parallelFor(size_t begin, size_t end, const F &f,
+                            size_t grainSize) {
+  if (end <= begin) {
+    return;
+  }
+  const size_t count = end - begin;
+  const size_t numThreads = mWorkers.size() + 1;
+  if (grainSize == 0) {
+    grainSize = std::max<size_t>(1, count / (numThreads * 4));
+  }
+  if (mWorkers.empty() || count <= grainSize) {
+    for (size_t i = begin; i < end; ++i) {
+      f(i);
+    }
+    return;
+  }
+
+  auto function = [](void *context, size_t b, size_t e) {
+    const F &fn = *static_cast<const F *>(context);
+    for (size_t i = b; i < e; ++i) {
+      fn(i);
+    }
+  };
+
+  // Jobs are queued in small batches from the stack
+  const size_t numJobs = (count + grainSize - 1) / grainSize;
+  std::atomic<int> pending{int(numJobs)};
+  const size_t batchSize = 32;
+  Job batch[batchSize];
+  size_t numBatched = 0;
+  for (size_t b = begin; b < end; b += grainSize) {
+    batch[numBatched++] = Job{function, const_cast<F *>(&f), b,
+                              std::min(b + grainSize, end), &pending};
+    if (numBatched == batchSize) {
+      submit(batch, numBatched);
+      numBatched = 0;
+    }
+  }
+  submit(batch, numBatched);
+  wait(pending);
+}
+
+} // namespace al
+
+#endif // AL_JOBSYSTEM_H
@@ -44,20 +44,223 @@
         Graham Wakefield, 2010, grrrwaaa@gmail.com
 */
 
-#include <cstring>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 #include <inttypes.h>
 #include <vector>
 
-//#include "allocore/system/pstdint.h"
-
 namespace al {
 
+inline uint32_t next_power_of_two(uint32_t v) {
+  --v;
+  v |= v >> 1;
+  v |= v >> 2;
+  v |= v >> 4;
+  v |= v >> 8;
+  v |= v >> 16;
+  return v + 1;
+}
+
+/** Lock free single-producer-single-consumer ring buffer of elements of type T.
+ *
+ * One thread may only write (push(), writeRegions(), commitWrite()) and one
+ * thread may only read (pop(), peek(), readRegions(), commitRead(), clear()).
+ * The read and write indices are atomic and kept on separate cache lines
+ * together with a cached copy of the other thread's index, so that the two
+ * threads only touch each other's cache line when the buffer looks full or
+ * empty.
+ *
+ * Besides copying in and out, the buffer can be accessed in place: request
+ * a region with writeRegions() or readRegions(), fill or consume it and then
+ * publish it with commitWrite() or commitRead(). A region is split in two
+ * when it crosses the end of the buffer.
+ *
+ * @code
+SPSCRingBuffer<float> ring(4096);
+// Producer (e.g. audio thread)
+auto region = ring.writeRegions(io.framesPerBuffer());
+std::copy(io.outBuffer(0), io.outBuffer(0) + region.firstSize, region.first);
+std::copy(io.outBuffer(0) + region.firstSize,
+          io.outBuffer(0) + region.size(), region.second);
+ring.commitWrite(region.size());
+// Consumer (e.g. graphics thread)
+float block[512];
+size_t count = ring.pop(block, 512);
+ * @endcode
+ *
+ * @ingroup allocore
+ */
+template <typename T> class SPSCRingBuffer {
+public:
+  /// Contiguous memory for in-place access, split in two at the buffer end.
+  struct Region {
+    T *first{nullptr};
+    size_t firstSize{0};
+    T *second{nullptr};
+    size_t secondSize{0};
+
+    size_t size() const { return firstSize + secondSize; }
+    T &operator[](size_t i) {
+      return i < firstSize ? first[i] : second[i - firstSize];
+    }
+  };
+
+  /** Allocate ring buffer for size elements.
+      Actual size rounded up to next power of 2. */
+  SPSCRingBuffer(size_t size = 256)
+      : mSize(size_t(next_power_of_two(uint32_t(size)))), mWrap(mSize - 1),
+        mData(mSize) {}
+
+  /// Number of elements the buffer can hold
+  size_t capacity() const { return mSize; }
+
+  /// The number of elements available for writing.
+  size_t writeSpace() const {
+    return mSize - (mWriter.index.load(std::memory_order_acquire) -
+                    mReader.index.load(std::memory_order_acquire));
+  }
+
+  /// The number of elements available for reading.
+  size_t readSpace() const {
+    return mWriter.index.load(std::memory_order_acquire) -
+           mReader.index.load(std::memory_order_acquire);
+  }
+
+  /// Write single element. Returns false if the buffer is full.
+  bool push(const T &value) {
+    const size_t w = mWriter.index.load(std::memory_order_relaxed);
+    if (w - mWriter.other == mSize) {
+      mWriter.other = mReader.index.load(std::memory_order_acquire);
+      if (w - mWriter.other == mSize) {
+        return false;
+      }
+    }
+    mData[w & mWrap] = value;
+    mWriter.index.store(w + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Write up to count elements from src. Returns elements written.
+  size_t push(const T *src, size_t count) {
+    Region region = writeRegions(count);
+    std::copy(src, src + region.firstSize, region.first);
+    std::copy(src + region.firstSize, src + region.size(), region.second);
+    commitWrite(region.size());
+    return region.size();
+  }
+
+  /// Read single element. Returns false if the buffer is empty.
+  bool pop(T &value) {
+    const size_t r = mReader.index.load(std::memory_order_relaxed);
+    if (r == mReader.other) {
+      mReader.other = mWriter.index.load(std::memory_order_acquire);
+      if (r == mReader.other) {
+        return false;
+      }
+    }
+    value = mData[r & mWrap];
+    mReader.index.store(r + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Read up to count elements into dst. Returns elements read.
+  size_t pop(T *dst, size_t count) {
+    size_t read = peek(dst, count);
+    commitRead(read);
+    return read;
+  }
+
+  /// Copy up to count elements into dst without consuming them.
+  size_t peek(T *dst, size_t count) {
+    Region region = readRegions(count);
+    std::copy(region.first, region.first + region.firstSize, dst);
+    std::copy(region.second, region.second + region.secondSize,
+              dst + region.firstSize);
+    return region.size();
+  }
+
+  /** Get writable memory for up to count elements.
+      Nothing is visible to the reader until commitWrite() is called. */
+  Region writeRegions(size_t count) {
+    const size_t w = mWriter.index.load(std::memory_order_relaxed);
+    if (mSize - (w - mWriter.other) < count) {
+      mWriter.other = mReader.index.load(std::memory_order_acquire);
+    }
+    count = std::min(count, mSize - (w - mWriter.other));
+    return makeRegion(w, count);
+  }
+
+  /// Publish count elements previously obtained through writeRegions()
+  void commitWrite(size_t count) {
+    const size_t w = mWriter.index.load(std::memory_order_relaxed);
+    mWriter.index.store(w + count, std::memory_order_release);
+  }
+
+  /** Get readable memory for up to count elements.
+      Elements are not released to the writer until commitRead() is called. */
+  Region readRegions(size_t count) {
+    const size_t r = mReader.index.load(std::memory_order_relaxed);
+    if (mReader.other - r < count) {
+      mReader.other = mWriter.index.load(std::memory_order_acquire);
+    }
+    count = std::min(count, mReader.other - r);
+    return makeRegion(r, count);
+  }
+
+  /// Release count elements previously obtained through readRegions()
+  void commitRead(size_t count) {
+    const size_t r = mReader.index.load(std::memory_order_relaxed);
+    mReader.index.store(r + count, std::memory_order_release);
+  }
+
+  /// Discard all data available for reading. Must be called from the reader.
+  void clear() {
+    mReader.other = mWriter.index.load(std::memory_order_acquire);
+    mReader.index.store(mReader.other, std::memory_order_release);
+  }
+
+private:
+  static constexpr size_t kCacheLineSize = 64;
+
+  // Index owned by one thread and that thread's cached copy of the other
+  // thread's index. Padding on both sides keeps them off any cache line
+  // written by the other thread, without requiring over-aligned allocation.
+  struct Cursor {
+    char paddingBefore[kCacheLineSize];
+    std::atomic<size_t> index{0};
+    size_t other{0};
+    char paddingAfter[kCacheLineSize];
+  };
+
+  Region makeRegion(size_t start, size_t count) {
+    Region region;
+    const size_t offset = start & mWrap;
+    region.first = mData.data() + offset;
+    region.firstSize = std::min(count, mSize - offset);
+    region.second = mData.data();
+    region.secondSize = count - region.firstSize;
+    return region;
+  }
+
+  const size_t mSize;
+  const size_t mWrap;
+  std::vector<T> mData;
+  Cursor mWriter;
+  Cursor mReader;
+};
+
 /** Lock free single-reader-single-writer ring buffer.
  * Can be used to stream data safely between two threads, one being
  * a reader, one a writer. There is no locking in this ring buffer,
  * so it is ideal to pass data to and from a high priority thread
  * like an audio thread.
+ *
+ * This is a byte oriented interface to SPSCRingBuffer. As before, one byte
+ * of the rounded size is kept free, so a buffer of size 256 holds at most
+ * 255 bytes. Prefer SPSCRingBuffer for new code, as it avoids casting, uses
+ * its full capacity and allows in-place access.
  */
 
 /// @ingroup allocore
@@ -65,139 +268,44 @@ class SingleRWRingBuffer {
 public:
   /** Allocate ringbuffer.
       Actual size rounded up to next power of 2. */
-  SingleRWRingBuffer(size_t sz = 256);
-
-  ~SingleRWRingBuffer();
+  SingleRWRingBuffer(size_t sz = 256) : mBuffer(sz) {}
 
   /** The number of bytes available for writing.
    */
-  size_t writeSpace() const;
+  size_t writeSpace() const {
+    size_t space = mBuffer.writeSpace();
+    return space > 0 ? space - 1 : 0;
+  }
 
   /** The number of bytes available for reading.
    */
-  size_t readSpace() const;
+  size_t readSpace() const { return mBuffer.readSpace(); }
 
   /** Copy sz bytes from src into the ringbuffer.
       Returns bytes actually copied.
       */
-  size_t write(const char *src, size_t sz);
+  size_t write(const char *src, size_t sz) {
+    return mBuffer.push(src, std::min(sz, writeSpace()));
+  }
 
   /** Read sz bytes of data from the ring buffer and advance the read pointer.
               Returns bytes actually copied
       */
-  size_t read(char *dst, size_t sz);
+  size_t read(char *dst, size_t sz) { return mBuffer.pop(dst, sz); }
 
   /** Read data without advancing the read pointer
       Returns bytes actually copied
       */
-  size_t peek(char *dst, size_t sz);
+  size_t peek(char *dst, size_t sz) { return mBuffer.peek(dst, sz); }
 
   /** Clear any data in the ringbuffer
    */
-  void clear() { mRead = mWrite; }
+  void clear() { mBuffer.clear(); }
 
 protected:
-  size_t mSize{0}, mWrap{0};
-  size_t mRead{0}, mWrite{0};
-  std::vector<char> mData;
+  SPSCRingBuffer<char> mBuffer;
 };
 
-inline uint32_t next_power_of_two(uint32_t v) {
-  --v;
-  v |= v >> 1;
-  v |= v >> 2;
-  v |= v >> 4;
-  v |= v >> 8;
-  v |= v >> 16;
-  return v + 1;
-}
-
-inline SingleRWRingBuffer ::SingleRWRingBuffer(size_t sz)
-    : mSize(size_t(next_power_of_two(uint32_t(sz)))), mWrap(mSize - 1),
-      mRead(0), mWrite(0) {
-  mData.resize(mSize);
-}
-
-inline SingleRWRingBuffer ::~SingleRWRingBuffer() {}
-
-inline size_t SingleRWRingBuffer ::writeSpace() const {
-  const size_t r = mRead;
-  const size_t w = mWrite;
-  if (r == w)
-    return mWrap;
-  return ((mSize + (r - w)) & mWrap) - 1;
-}
-
-inline size_t SingleRWRingBuffer ::readSpace() const {
-  const size_t r = mRead;
-  const size_t w = mWrite;
-  return (mSize + (w - r)) & mWrap;
-}
-
-inline size_t SingleRWRingBuffer ::write(const char *src, size_t sz) {
-  size_t space = writeSpace();
-  sz = sz > space ? space : sz;
-  if (sz == 0)
-    return 0;
-
-  size_t w = mWrite;
-  size_t end = w + sz;
-
-  if (end < mSize) {
-    memcpy(mData.data() + w, src, sz);
-  } else {
-    size_t split = mSize - w;
-    end &= mWrap;
-    memcpy(mData.data() + w, src, split);
-    memcpy(mData.data(), src + split, end);
-  }
-
-  mWrite = end;
-  return sz;
-}
-
-inline size_t SingleRWRingBuffer ::read(char *dst, size_t sz) {
-  size_t space = readSpace();
-  sz = sz > space ? space : sz;
-  if (sz == 0)
-    return 0;
-
-  size_t r = mRead;
-  size_t end = r + sz;
-
-  if (end < mSize) {
-    memcpy(dst, mData.data() + r, sz);
-  } else {
-    size_t split = mSize - r;
-    end &= mWrap;
-    memcpy(dst, mData.data() + r, split);
-    memcpy(dst + split, mData.data(), end);
-  }
-
-  mRead = end;
-  return sz;
-}
-
-inline size_t SingleRWRingBuffer ::peek(char *dst, size_t sz) {
-  size_t space = readSpace();
-  sz = sz > space ? space : sz;
-  if (sz == 0)
-    return 0;
-
-  size_t r = mRead;
-  size_t end = r + sz;
-
-  if (end < mSize) {
-    memcpy(dst, mData.data() + r, sz);
-  } else {
-    size_t split = mSize - r;
-    end &= mWrap;
-    memcpy(dst, mData.data() + r, split);
-    memcpy(dst + split, mData.data(), end);
-  }
-  return sz;
-}
-
 } // namespace al
 
 #endif /* include guard */
@@ -75,6 +75,7 @@ enum class TimeMasterMode {
 };
 
 class Parameter;
+class ParameterAutomation;
 
 /**
  * @brief The ParameterMeta class defines the base interface for Parameter
@@ -102,7 +103,7 @@ public:
    * The parameter needs to be registered to a ParameterServer to listen to
    * OSC values on this address
    */
-  std::string getFullAddress() { return mFullAddress; }
+  const std::string &getFullAddress() const { return mFullAddress; }
 
   /**
    * @brief getName returns the name of the parameter
@@ -664,7 +665,24 @@ public:
     }
   }
 
+  /**
+   * @brief Send values set from now on to a ParameterAutomation
+   *
+   * This is called by ParameterAutomation when it is attached to the
+   * parameter. Pass nullptr to stop. Returns once no other thread is still
+   * sending a value to the previous automation, so it can be destroyed.
+   */
+  void setAutomation(ParameterAutomation *automation);
+
+  ParameterAutomation *automation() const {
+    return mAutomation.load(std::memory_order_acquire);
+  }
+
 private:
+  void sendToAutomation(float value);
+
+  std::atomic<ParameterAutomation *> mAutomation{nullptr};
+  std::atomic<int> mAutomationSenders{0}; // set() calls using mAutomation
 };
 
 /// ParamaterInt
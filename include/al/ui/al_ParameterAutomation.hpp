@@ -0,0 +1,229 @@
+#ifndef INCLUDE_AL_PARAMETERAUTOMATION_HPP
+#define INCLUDE_AL_PARAMETERAUTOMATION_HPP
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2022. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+   File description:
+   Timestamped, sample accurate parameter changes for the audio thread
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "al/system/al_Time.hpp"
+
+namespace al {
+
+class Parameter;
+
+/**
+ * @brief The ParameterAutomation class delivers control changes to the audio
+ * thread as per sample values.
+ * @ingroup UI
+ *
+ * Reading Parameter::get() from the audio callback only sees changes at block
+ * boundaries. A ParameterAutomation attached to a Parameter receives every
+ * value passed to set() or setNoCalls() as an event stamped with the sample
+ * frame at which it should take effect. The audio thread calls process() once
+ * per block, which consumes the events through a lock-free queue and returns
+ * one value per frame, ramping linearly to each new value over the smoothing
+ * time.
+ *
+ * Values set from control threads are placed one block after the audio clock
+ * at the time of the call, so the spacing between changes is kept inside
+ * the block instead of being quantized to block boundaries. Events can also
+ * be scheduled at an explicit frame with schedule().
+ *
+ * Any number of threads may call set() and schedule(). Only the audio thread
+ * may call process().
+ *
+ * @code
+ * Parameter gain{"gain", "", 0.5};
+ * ParameterAutomation gainAutomation{gain};
+ *
+ * void onSound(AudioIOData &io) override {
+ *   const float *g = gainAutomation.process(io.framesPerBuffer());
+ *   while (io()) {
+ *     io.out(0) = io.in(0) * g[io.frame()];
+ *   }
+ * }
+ * @endcode
+ */
+class ParameterAutomation {
+public:
+  struct Stats {
+    uint64_t events{0};  ///< Events applied by process()
+    uint64_t late{0};    ///< Events that arrived after their frame
+    uint64_t dropped{0}; ///< Events lost because the queue was full
+  };
+
+  /**
+   * @param sampleRate frames per second of the audio clock
+   * @param maxBlockSize largest block passed to process()
+   * @param smoothing default ramp time in seconds for new values
+   * @param queueSize events that can be pending, rounded up to a power of two
+   */
+  ParameterAutomation(float initialValue = 0.0f, double sampleRate = 44100.0,
+                      unsigned int maxBlockSize = 512,
+                      float smoothing = 0.005f, size_t queueSize = 1024);
+
+  /**
+   * @brief Automate a parameter
+   *
+   * Values set on the parameter are sent to this object until it is
+   * destroyed or detach() is called. Both wait for set() calls in progress
+   * on other threads, so the parameter may be set while this is destroyed.
+   */
+  ParameterAutomation(Parameter &param, double sampleRate = 44100.0,
+                      unsigned int maxBlockSize = 512,
+                      float smoothing = 0.005f, size_t queueSize = 1024);
+
+  ~ParameterAutomation();
+
+  ParameterAutomation(const ParameterAutomation &) = delete;
+  ParameterAutomation &operator=(const ParameterAutomation &) = delete;
+
+  /// Stop receiving values from the parameter
+  void detach();
+
+  /**
+   * @brief Set the audio configuration
+   *
+   * Must not be called while process() is running.
+   */
+  void configure(double sampleRate, unsigned int maxBlockSize);
+
+  double sampleRate() const { return mSampleRate; }
+  unsigned int maxBlockSize() const { return mMaxBlockSize; }
+
+  /// Ramp time in seconds used by set() and by schedule() when none is given
+  void smoothing(float seconds) { mSmoothing = seconds; }
+  float smoothing() const { return mSmoothing; }
+
+  /**
+   * @brief Frames between the audio clock and the frame given to set()
+   *
+   * Defaults to the size of the last processed block, which is the smallest
+   * latency that keeps changes in the right place within the block.
+   * Set to 0 to go back to the default.
+   */
+  void latency(unsigned int frames) { mLatency = frames; }
+
+  /**
+   * @brief Set a new value from a control thread
+   * @return false if the queue was full and the value was dropped
+   *
+   * The value is timestamped with frameAt(al_steady_time()).
+   */
+  bool set(float value);
+
+  /**
+   * @brief Schedule a value at a frame of the audio clock
+   * @param value target value
+   * @param frame audio frame at which the ramp to value starts
+   * @param rampTime ramp duration in seconds. If < 0 the smoothing time is
+   * used.
+   * @return false if the queue was full and the value was dropped
+   */
+  bool schedule(float value, uint64_t frame, float rampTime = -1.0f);
+
+  /**
+   * @brief Frame at which a value set at a given steady clock time is applied
+   *
+   * Maps al_steady_time() to the audio clock using the time process() last
+   * started a block, plus the latency.
+   */
+  uint64_t frameAt(al_sec time) const;
+
+  /**
+   * @brief Consume events and compute a block of values
+   * @param numFrames frames in the block, at most maxBlockSize()
+   * @return numFrames values, valid until the next call
+   *
+   * Call from the audio thread at the start of each block. Does not lock or
+   * allocate.
+   */
+  const float *process(unsigned int numFrames);
+
+  /// First frame of the last block passed to process()
+  uint64_t frame() const { return mFrame.load(std::memory_order_acquire); }
+
+  /// Value at the end of the last processed block. Read from the audio thread.
+  float value() const { return mValue; }
+
+  Stats stats() const;
+
+private:
+  struct Event {
+    uint64_t frame;
+    float value;
+    float rampTime;
+  };
+  struct EventQueue;
+
+  void applyEvent(const Event &event);
+
+  Parameter *mParameter{nullptr};
+  std::unique_ptr<EventQueue> mQueue;
+
+  double mSampleRate;
+  unsigned int mMaxBlockSize;
+  std::atomic<float> mSmoothing;
+  std::atomic<unsigned int> mLatency{0};
+
+  // Audio thread state
+  std::vector<float> mBuffer;
+  std::vector<Event> mPending; // sorted by frame, capacity fixed
+  float mValue;
+  float mIncrement{0.0f};
+  float mTarget;
+  uint64_t mRampFrames{0};
+
+  // Audio clock published for control threads, read with a sequence lock
+  std::atomic<uint64_t> mClockSequence{0};
+  std::atomic<uint64_t> mFrame{0};
+  std::atomic<al_sec> mBlockTime{0.0};
+  std::atomic<unsigned int> mBlockSize{0};
+
+  std::atomic<uint64_t> mEventsDropped{0};
+  std::atomic<uint64_t> mStatsEvents{0};
+  std::atomic<uint64_t> mStatsLate{0};
+};
+
+} // namespace al
+
+#endif
@@ -42,8 +42,12 @@
         Andrés Cabrera mantaraya36@gmail.com
 */
 
-#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "al/protocol/al_OSC.hpp"
 #include "al/ui/al_Parameter.hpp"
@@ -89,35 +93,11 @@ public:
    * @brief addListener enables notifiying via OSC that a preset has changed
    * @param IPaddress The IP address of the listener
    * @param oscPort The network port so send the value changes on
+   *
+   * The address is resolved once here. A listener is only registered once,
+   * even if given by different names, e.g. localhost and 127.0.0.1.
    */
-  virtual void addListener(std::string IPaddress, uint16_t oscPort) {
-
-    auto newListenerSocket = new osc::Send;
-
-    if (newListenerSocket->open(oscPort, IPaddress.c_str())) {
-      mListenerLock.lock();
-      for (const auto &sender : mOSCSenders) {
-        if (sender->address() == IPaddress && sender->port() == oscPort) {
-          // FIXME check for addresses that are different but map to the same
-          // address, e.g. 127.0.0.1 and localhost
-
-          std::cout << "Listener already registered: " << IPaddress << ":"
-                    << oscPort << std::endl;
-          mListenerLock.unlock();
-          delete newListenerSocket;
-        }
-      }
-
-      mOSCSenders.push_back(newListenerSocket);
-      mListenerLock.unlock();
-      std::cout << "Registered listener " << IPaddress << ":" << oscPort
-                << std::endl;
-    } else {
-      delete newListenerSocket;
-      std::cerr << "ERROR: Could not register listener " << IPaddress << ":"
-                << oscPort << std::endl;
-    }
-  }
+  virtual void addListener(std::string IPaddress, uint16_t oscPort);
 
   /**
    * @brief Notify the listeners of value changes
@@ -130,6 +110,11 @@ public:
    * register to be notified when the data changes to only do notifications
    * then.
    *
+   * Notifications are queued without locking and sent by a separate thread,
+   * so the calling thread never waits on name resolution or the network.
+   * Notifications queued while the sender thread is busy are sent to each
+   * listener together in OSC bundles. Use flush() to wait until they have
+   * been sent.
    */
   void notifyListeners(std::string OSCaddress, float value,
                        ValueSource *src = nullptr);
@@ -151,7 +136,11 @@ public:
   void notifyListeners(std::string OSCaddress, ParameterMeta *param,
                        ValueSource *src);
 
+  /// Wait until all queued notifications have been sent
+  void flush();
+
   void send(osc::Packet &p) {
+    flush(); // Keep order with queued notifications
     mListenerLock.lock();
     for (osc::Send *sender : mOSCSenders) {
       sender->send(p);
@@ -168,8 +157,18 @@ public:
   }
 
 protected:
+  // Send message to all listeners except the source of the change
+  template <class... Args>
+  void notifyAll(const std::string &OSCaddress, ValueSource *src,
+                 const Args &...args);
+
   std::mutex mListenerLock;
   std::vector<osc::Send *> mOSCSenders;
+  // IP address of each sender, resolved in addListener()
+  std::vector<std::string> mListenerIps;
+  // Encoded notifications too large for the queue, sent from the caller's
+  // thread. Guarded by mListenerLock.
+  std::vector<char> mNotifyBuffer = std::vector<char>(1024);
   std::vector<std::pair<std::string, int>> mConnectedNodes;
 
   class HandshakeHandler : public osc::PacketHandler {
@@ -185,6 +184,23 @@ protected:
   std::mutex mNodeLock;
 
 private:
+  void wakeSender();
+  void senderLoop();
+  // Send a batch of queued notifications. Returns number sent.
+  size_t sendQueued();
+
+  // Bounded multiple producer queue of encoded notifications
+  struct NotifyQueue;
+  std::unique_ptr<NotifyQueue> mNotifyQueue;
+  std::atomic<size_t> mNumListeners{0};
+
+  std::thread mSenderThread;
+  std::atomic<bool> mSenderRunning{false};
+  std::atomic<bool> mSenderWaiting{false};
+  std::mutex mSenderLock;
+  std::condition_variable mSenderWake;
+  std::condition_variable mSenderFlushed;
+  uint64_t mNotificationsSent{0}; // Guarded by mSenderLock
 };
 
 /**
@@ -323,6 +339,11 @@ public:
 
   virtual void onMessage(osc::Message &m) override;
 
+  /// Set plain parameters without copying the message. Falls back to
+  /// onMessage() for bundles, registered listeners and consumers, and
+  /// addresses not handled here.
+  virtual bool onMessageView(osc::MessageView &m) override;
+
   uint16_t serverPort() { return mServer->port(); }
 
   void verbose(bool verbose = true) { mVerbose = verbose; }
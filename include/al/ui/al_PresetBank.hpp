@@ -0,0 +1,201 @@
+#ifndef AL_PRESETBANK_H
+#define AL_PRESETBANK_H
+
+/*	Allolib --
+   Multimedia / virtual environment application class library
+
+   Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology,
+   UCSB. Copyright (C) 2012-2018. The Regents of the University of California.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   Neither the name of the University of California nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+   OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+   WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+   OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+   ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   File description:
+   In-memory cache of preset files for a preset directory
+*/
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "al/system/al_Time.hpp"
+#include "al/system/al_Watcher.hpp"
+#include "al/types/al_VariantValue.hpp"
+
+namespace al {
+
+/**
+ * @brief The PresetBank class keeps the contents of a preset directory in
+ * memory.
+ * @ingroup UI
+ *
+ * All ".preset" files in the directory are parsed in parallel by load(), so
+ * that recalling a preset does not need to touch the disk. Calls to store()
+ * update the memory copy immediately and write the file on a background
+ * thread. The writer thread is started by the first store() and the polling
+ * thread by load(), so an unused bank costs no threads.
+ *
+ * Files changed on disk by other programs are detected by polling their
+ * modification time. Changes are dispatched through Watcher::notify() with
+ * the full path to the preset file as resource name and "modified" as event
+ * name, so you can also call Watcher::notify() yourself to force a reload.
+ *
+ * @code
+PresetBank bank;
+bank.load("presets");
+PresetBank::ParameterStates values;
+if (bank.get("preset1", values)) {
+  // use values
+}
+ * @endcode
+ */
+class PresetBank : public Watcher {
+public:
+  typedef std::map<std::string, std::vector<VariantValue>> ParameterStates;
+
+  PresetBank(bool verbose = false);
+  ~PresetBank();
+
+  /**
+   * @brief Load all preset files in directory into memory
+   * @param directory path to the preset directory
+   *
+   * Any previously loaded presets are discarded. Pending writes are flushed
+   * before loading.
+   */
+  void load(std::string directory);
+
+  /// Directory currently loaded
+  std::string directory();
+
+  /**
+   * @brief get preset values from memory
+   * @param name the preset name (without ".preset" extension)
+   * @param values the values are copied here if found
+   * @return true if the preset exists
+   *
+   * If the preset is not in memory, an attempt is made to read it from disk
+   * and it is added to the bank if it exists. Names not found on disk are
+   * remembered and not looked up again until they are stored, reported as
+   * created by the poller or the directory is reloaded.
+   */
+  bool get(const std::string &name, ParameterStates &values);
+
+  /// Returns true if the preset is in memory or its file exists on disk
+  bool contains(const std::string &name);
+
+  /**
+   * @brief store preset in memory and queue writing to disk
+   * @param name the preset name (without ".preset" extension)
+   * @param values preset values
+   */
+  void store(const std::string &name, const ParameterStates &values);
+
+  /// Reread preset file from disk, removing it from bank and unwatching it if
+  /// it no longer exists.
+  void reload(const std::string &name);
+
+  /// Names of the presets currently in memory
+  std::vector<std::string> names();
+
+  /// Block until all queued writes have been performed
+  void flush();
+
+  /**
+   * @brief Set interval at which modification times are checked
+   * @param seconds polling period. Set to 0 to disable polling.
+   */
+  void setPollInterval(al_sec seconds);
+
+  void setVerbose(bool isVerbose = true) { mVerbose = isVerbose; }
+
+  void onEvent(std::string resourcename, std::string eventname) override;
+
+  /// Full path to the file for preset name in this bank
+  std::string presetPath(const std::string &name);
+
+  /**
+   * @brief Parse a preset text file
+   * @param fileName full path to file
+   * @param values parsed values are inserted here
+   * @param verbose print diagnostic messages
+   * @return false if the file could not be opened.
+   */
+  static bool readPresetFile(const std::string &fileName,
+                             ParameterStates &values, bool verbose = false);
+
+  /**
+   * @brief Write preset text file
+   * @param fileName full path to file
+   * @param presetName name to write in preset header
+   * @param values values to write
+   * @param verbose print diagnostic messages
+   * @return true if no errors.
+   */
+  static bool writePresetFile(const std::string &fileName,
+                              const std::string &presetName,
+                              const ParameterStates &values,
+                              bool verbose = false);
+
+private:
+  struct Entry {
+    ParameterStates values;
+    al_sec modified{0};
+    int pendingWrites{0};
+  };
+
+  void writerFunction();
+  void pollFunction();
+
+  bool mVerbose{false};
+  std::string mDirectory;
+
+  std::mutex mEntriesLock;
+  std::map<std::string, Entry> mEntries;
+  std::set<std::string> mMissing; // Names known not to exist on disk
+
+  std::mutex mWriteLock;
+  std::condition_variable mWriteCondition;
+  std::deque<std::pair<std::string, ParameterStates>> mWriteQueue;
+  size_t mWritesInFlight{0};
+  bool mRunning{true};
+  std::unique_ptr<std::thread> mWriterThread;
+
+  std::condition_variable mPollCondition;
+  al_sec mPollInterval{1.0};
+  std::unique_ptr<std::thread> mPollThread;
+};
+
+} // namespace al
+
+#endif // AL_PRESETBANK_H
@@ -55,6 +55,7 @@
 #include "al/system/al_Time.hpp"
 #include "al/ui/al_Parameter.hpp"
 #include "al/ui/al_ParameterServer.hpp"
+#include "al/ui/al_PresetBank.hpp"
 
 namespace al {
 
@@ -369,12 +370,32 @@ public:
   bool savePresetValues(const ParameterStates &values, std::string presetName,
                         bool overwrite = true);
 
+  /**
+   * @brief Serve preset recall from memory
+   * @param use if false, presets are read from disk on every recall
+   *
+   * When enabled, all presets in the current path are loaded into a
+   * PresetBank. Recalling and interpolating presets then reads from memory,
+   * storing presets updates memory and writes files in a background thread,
+   * and presets modified on disk by other programs are reloaded
+   * automatically. Presets stored with overwrite set to false are given a
+   * unique name against both the bank and the files on disk.
+   */
+  void usePresetBank(bool use = true);
+
+  /// Returns the preset bank or nullptr if usePresetBank() has not been set
+  PresetBank *presetBank() { return mPresetBank.get(); }
+
   void setTimeMaster(TimeMasterMode masterMode);
 
   void startCpuThread();
   void stopCpuThread();
 
 private:
+  // savePresetValues() without locking mFileLock. Caller must hold the lock.
+  bool writePresetValues(const ParameterStates &values, std::string presetName,
+                         bool overwrite);
+
   //  std::vector<float> getParameterValue(ParameterMeta *p);
   //  void setParametersInBundle(ParameterBundle *bundle, std::string
   //  bundlePrefix,
@@ -424,6 +445,8 @@ private:
   std::vector<std::function<void(std::string)>> mPresetsMapCbs;
 
   std::map<int, std::string> mPresetsMap;
+
+  std::unique_ptr<PresetBank> mPresetBank;
 };
 
 } // namespace al
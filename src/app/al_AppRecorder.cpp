@@ -8,12 +8,51 @@
 #include <condition_variable>
 #include <thread>
 
+namespace {
+
+std::string ffmpegProgram() {
+#ifdef AL_WINDOWS
+  // Note: path must be DOS style for std::system
+  return "c:\\Program Files\\ffmpeg\\bin\\ffmpeg";
+#else
+#if defined(AL_OSX)
+  return "/usr/local/bin/ffmpeg";
+#else
+  return "ffmpeg";
+#endif
+#endif
+}
+
+// Video encoding options shared by all capture formats
+std::string ffmpegVideoArgs() {
+  std::string args = " -pix_fmt yuv420p";
+  // for compatibility with outdated media players
+  // args += " -crf 20 -preset slower";
+
+  // video compression amount in [0,51] inversely related to quality
+  int videoCompress = 20;
+  args += " -crf " + std::to_string(videoCompress);
+
+  int videoEncodeSpeed = 2;
+
+  static const std::string speedStrings[] = {
+      "placebo", "veryslow", "slower",   "slow",      "medium",
+      "fast",    "faster",   "veryfast", "superfast", "ultrafast"};
+  args += " -preset " + speedStrings[videoEncodeSpeed];
+  return args;
+}
+
+} // namespace
+
 void al::AppRecorder::startRecordingOffline(double totalTime) {
   if (!mAudioDomain || !mWindowDomain) {
     std::cerr << "ERROR starting AppRecorder::startRecordingOffline"
               << std::endl;
     std::cerr << "Call AppRecorder::connectApp() before calling." << std::endl;
+    return;
   }
+  // A previous recording may still be joining its assets
+  waitForEncoding();
   mAudioDomain->stop();
   auto &audioIO = mAudioDomain->audioIO();
   audioIO.zeroOut();
@@ -32,6 +71,7 @@ void al::AppRecorder::startRecordingOffline(double totalTime) {
   if (!Dir::make(outPath)) {
     std::cerr << "Error creating directory: " << outPath << std::endl;
   }
+  bool recordAudio = false;
 #ifdef AL_LIBSNDFILE
   gam::SoundFile sf(outPath + "audio.wav");
   sf.channels(audioIO.channelsOut());
@@ -39,6 +79,8 @@ void al::AppRecorder::startRecordingOffline(double totalTime) {
   if (!sf.openWrite()) {
     std::cerr << "Error opening file for write: " << outPath + "audio.wav"
               << std::endl;
+  } else {
+    recordAudio = true;
   }
 #else
   std::cout << "Warning: libsndfile not available. Not recording audio"
@@ -50,6 +92,61 @@ void al::AppRecorder::startRecordingOffline(double totalTime) {
   for (unsigned int i = 0; i < audioIO.channelsOut(); i++) {
     outbuf[i] = audioIO.outBuffer(i);
   }
+
+  // Prepare frame encoder. Rows are read bottom to top from OpenGL.
+  const int width = mWindowDomain->window().fbWidth();
+  const int height = mWindowDomain->window().fbHeight();
+  const std::string fps = std::to_string(mGraphicsDomain->fps());
+  const std::string rawInputArgs = " -f rawvideo -pix_fmt rgb24 -s " +
+                                   std::to_string(width) + "x" +
+                                   std::to_string(height) + " -framerate " +
+                                   fps;
+  // Without audio the piped encoder writes the final movie
+  const std::string pipedVideo =
+      outPath + (recordAudio ? "video.mp4" : "movie.mp4");
+  std::string destination;
+  switch (mFormat) {
+  case FrameEncoder::Format::PNG:
+    destination = outPath + "out";
+    break;
+  case FrameEncoder::Format::RAW:
+    destination = outPath + "frames.raw";
+    break;
+  case FrameEncoder::Format::PIPE:
+    destination = "\"" + ffmpegProgram() + "\" -y" + rawInputArgs + " -i -" +
+                  ffmpegVideoArgs() + " " + pipedVideo;
+    break;
+  }
+  mEncoder.flipVertically(true);
+  if (!mEncoder.open(mFormat, destination, width, height, 3,
+                     mEncoderThreads)) {
+    std::cerr << "Error opening frame encoder. Not recording video"
+              << std::endl;
+  }
+
+  // Frames are read into one of two pixel buffer objects while the other
+  // one, holding the previous frame, is copied to the encoder. This avoids
+  // stalling on the transfer of the frame just rendered.
+  GLuint pbos[2];
+  glGenBuffers(2, pbos);
+  for (auto pbo : pbos) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, mEncoder.frameBytes(), nullptr,
+                 GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  auto encodeFrame = [&](GLuint pbo) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    auto *pixels = (const unsigned char *)glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, mEncoder.frameBytes(), GL_MAP_READ_BIT);
+    if (pixels) {
+      // Waits for a free buffer if the encoder is behind
+      mEncoder.write(pixels);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+  };
+
   // Prepare audio thread
   float audioRunning = true;
   std::condition_variable audioSignal;
@@ -74,7 +171,6 @@ void al::AppRecorder::startRecordingOffline(double totalTime) {
 
   // Run recorder
   mRunning = true;
-  int imageCounter = 0;
   while (time < totalTime && mRunning) {
     frameCount++;
     time = frameCount / mGraphicsDomain->fps();
@@ -89,21 +185,21 @@ void al::AppRecorder::startRecordingOffline(double totalTime) {
       audioSignal.notify_one();
     }
     mWindowDomain->tick();
-    // Now capture the active framebuffer to file
-    std::vector<unsigned char> mPixels;
-
-    mPixels.resize(mWindowDomain->window().width() *
-                   mWindowDomain->window().height() * 3);
-    unsigned char *pixs = &mPixels[0];
-    glReadPixels(1, 1, mWindowDomain->window().width(),
-                 mWindowDomain->window().height(), GL_RGB, GL_UNSIGNED_BYTE,
-                 pixs);
-    std::string imagePath =
-        outPath + "out" + std::to_string(imageCounter++) + ".png";
-
-    Image::saveImage(imagePath, pixs, mWindowDomain->window().width(),
-                     mWindowDomain->window().height(), true);
+    // Start the transfer of the active framebuffer and encode the previous
+    // frame
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[frameCount % 2]);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    if (frameCount > 1) {
+      encodeFrame(pbos[(frameCount + 1) % 2]);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
   }
+  if (frameCount > 0) {
+    encodeFrame(pbos[frameCount % 2]);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+  glDeleteBuffers(2, pbos);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
 
   // cleanup audio thread
   {
@@ -118,54 +214,55 @@ void al::AppRecorder::startRecordingOffline(double totalTime) {
   free(interleavedBuf);
   free(outbuf);
 
+  // Write remaining frames
+  mEncoder.close();
+  auto metrics = mEncoder.metrics();
+  std::cout << "Recorded " << metrics.framesWritten << " frames at "
+            << metrics.framesPerSecond() << " fps. Waited "
+            << metrics.stallTime << " s for the encoder." << std::endl;
+
   // Put domains back to normal
   mGraphicsDomain->removeSubDomain(recordingDomain);
   mAudioDomain->start();
 
-  // Now try to call ffmpeg to join assets
-  std::cout << "Calling ffmpeg on " + outPath << std::endl;
-  std::string prog;
-#ifdef AL_WINDOWS
-  // Note: path must be DOS style for std::system
-  prog = "c:\\Program Files\\ffmpeg\\bin\\ffmpeg";
-#else
-#if defined(AL_OSX)
-  prog = "/usr/local/bin/ffmpeg";
-#else
-  prog = "ffmpeg";
-#endif
-#endif
-
+  // Now join assets with ffmpeg
   std::string args;
-  args += " -r " + std::to_string(mGraphicsDomain->fps());
-  args += " -framerate " + std::to_string(mGraphicsDomain->fps());
-  args += " -i " + outPath + "/out%d.png";
-
-#ifdef AL_LIBSNDFILE
-  args += " -i " + outPath + "audio.wav -c:a aac -b:a 192k";
-#endif
-  args += " -pix_fmt yuv420p";
-  // for compatibility with outdated media players
-  // args += " -crf 20 -preset slower";
-
-  // video compression amount in [0,51] inversely related to quality
-  int videoCompress = 20;
-  args += " -crf " + std::to_string(videoCompress);
-
-  int videoEncodeSpeed = 2;
-
-  static const std::string speedStrings[] = {
-      "placebo", "veryslow", "slower",   "slow",      "medium",
-      "fast",    "faster",   "veryfast", "superfast", "ultrafast"};
-  args += " -preset " + speedStrings[videoEncodeSpeed];
+  switch (mFormat) {
+  case FrameEncoder::Format::PNG:
+    args += " -r " + fps;
+    args += " -framerate " + fps;
+    args += " -i " + outPath + "out%d.png";
+    break;
+  case FrameEncoder::Format::RAW:
+    args += rawInputArgs;
+    args += " -i " + outPath + "frames.raw";
+    break;
+  case FrameEncoder::Format::PIPE:
+    if (!recordAudio) {
+      std::cout << "Done recording " + pipedVideo << std::endl;
+      return;
+    }
+    args += " -i " + pipedVideo;
+    break;
+  }
+  if (recordAudio) {
+    args += " -i " + outPath + "audio.wav -c:a aac -b:a 192k";
+  }
+  if (mFormat == FrameEncoder::Format::PIPE) {
+    // Already encoded
+    args += " -c:v copy";
+  } else {
+    args += ffmpegVideoArgs();
+  }
   args += " " + outPath + "movie.mp4";
 
-  std::string cmd = "\"" + prog + "\"" + args;
-  // printf("%s\n", cmd.c_str());
-
-  // TODO: thread this; std::system blocks until the command finishes
-  std::system(cmd.c_str());
-  std::cout << cmd << std::endl;
-
-  std::cout << "Done calling ffmpeg on " + outPath << std::endl;
+  // Run in the background, as encoding can take longer than recording.
+  // -nostdin keeps ffmpeg from reading the terminal.
+  std::string cmd = "\"" + ffmpegProgram() + "\" -nostdin" + args;
+  std::cout << "Calling ffmpeg on " + outPath << std::endl;
+  mFfmpegThread = std::thread([cmd, outPath]() {
+    std::cout << cmd << std::endl;
+    std::system(cmd.c_str());
+    std::cout << "Done calling ffmpeg on " + outPath << std::endl;
+  });
 }
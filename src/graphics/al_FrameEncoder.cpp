@@ -0,0 +1,222 @@
+#include "al/graphics/al_FrameEncoder.hpp"
+
+#include "al/system/al_Time.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "al_stb_image.hpp"
+
+#ifdef AL_WINDOWS
+#define popen _popen
+#define pclose _pclose
+#else
+#include <signal.h>
+#endif
+
+using namespace al;
+
+bool FrameEncoder::open(Format format, const std::string &destination,
+                        int width, int height, int components,
+                        unsigned int numWorkers, unsigned int numBuffers) {
+  close();
+  if (width <= 0 || height <= 0 || components < 1 || components > 4) {
+    std::cerr << "FrameEncoder: invalid frame size " << width << "x" << height
+              << "x" << components << std::endl;
+    return false;
+  }
+  mFormat = format;
+  mDestination = destination;
+  mWidth = width;
+  mHeight = height;
+  mComponents = components;
+
+  if (format == Format::RAW) {
+    mFile = fopen(destination.c_str(), "wb");
+  } else if (format == Format::PIPE) {
+#ifdef AL_WINDOWS
+    mFile = popen(destination.c_str(), "wb");
+#else
+    mFile = popen(destination.c_str(), "w");
+#endif
+  }
+  if (format != Format::PNG && !mFile) {
+    std::cerr << "FrameEncoder: error opening " << destination << std::endl;
+    return false;
+  }
+
+  // Raw frames must stay in order, so only PNG uses more than one worker
+  if (format != Format::PNG || numWorkers == 0) {
+    numWorkers = 1;
+  }
+  if (numBuffers == 0) {
+    numBuffers = numWorkers * 2 + 1;
+  }
+  mPool.clear();
+  mFree.clear();
+  for (unsigned int i = 0; i < numBuffers; i++) {
+    mPool.emplace_back(new Frame);
+    mPool.back()->pixels.resize(frameBytes());
+    mFree.push_back(mPool.back().get());
+  }
+  mQueue.assign(numBuffers, nullptr);
+  mQueueHead = 0;
+  mQueueCount = 0;
+  mNextIndex = 0;
+  mStop = false;
+  mMetrics = Metrics();
+  mOpenTime = al_steady_time();
+  mOpen = true;
+  if (format == Format::PNG) {
+    // stb's flip flag is global, so it is set here once instead of by every
+    // worker for every frame
+    al_stbSetFlipVertically(mFlip);
+  }
+  for (unsigned int i = 0; i < numWorkers; i++) {
+    mWorkers.emplace_back(&FrameEncoder::workerFunction, this);
+  }
+  return true;
+}
+
+bool FrameEncoder::close() {
+  if (!mOpen) {
+    return true;
+  }
+  {
+    std::unique_lock<std::mutex> lk(mLock);
+    mStop = true;
+  }
+  mFrameQueued.notify_all();
+  for (auto &worker : mWorkers) {
+    worker.join();
+  }
+  mWorkers.clear();
+
+  bool ok = true;
+  if (mFormat == Format::RAW) {
+    ok = fclose(mFile) == 0;
+  } else if (mFormat == Format::PIPE) {
+    int status = pclose(mFile);
+    if (status != 0) {
+      std::cerr << "FrameEncoder: " << mDestination << " returned " << status
+                << std::endl;
+      ok = false;
+    }
+  }
+  mFile = nullptr;
+
+  std::unique_lock<std::mutex> lk(mLock);
+  mMetrics.elapsed = al_steady_time() - mOpenTime;
+  mOpen = false;
+  // Frames still held by the caller stay valid until the next open()
+  return ok && mMetrics.errors == 0;
+}
+
+FrameEncoder::Frame *FrameEncoder::acquire() {
+  std::unique_lock<std::mutex> lk(mLock);
+  if (!mOpen) {
+    return nullptr;
+  }
+  if (mFree.empty()) {
+    double start = al_steady_time();
+    mFrameFreed.wait(lk, [this]() { return !mFree.empty(); });
+    mMetrics.stallTime += al_steady_time() - start;
+  }
+  Frame *frame = mFree.back();
+  mFree.pop_back();
+  return frame;
+}
+
+void FrameEncoder::submit(Frame *frame) {
+  {
+    std::unique_lock<std::mutex> lk(mLock);
+    frame->index = mNextIndex++;
+    mQueue[(mQueueHead + mQueueCount) % mQueue.size()] = frame;
+    mQueueCount++;
+    mMetrics.framesSubmitted++;
+  }
+  mFrameQueued.notify_one();
+}
+
+void FrameEncoder::write(const unsigned char *pixels) {
+  Frame *frame = acquire();
+  if (frame) {
+    std::memcpy(frame->pixels.data(), pixels, frameBytes());
+    submit(frame);
+  }
+}
+
+FrameEncoder::Metrics FrameEncoder::metrics() const {
+  std::unique_lock<std::mutex> lk(mLock);
+  Metrics m = mMetrics;
+  if (mOpen) {
+    m.elapsed = al_steady_time() - mOpenTime;
+  }
+  return m;
+}
+
+bool FrameEncoder::writeFrame(Frame &frame) {
+  if (mFormat == Format::PNG) {
+    // Flip flag was set by open()
+    std::string fileName =
+        mDestination + std::to_string(frame.index) + ".png";
+    return !al_stbWriteImage(fileName.c_str(), frame.pixels.data(), mWidth,
+                             mHeight, mComponents);
+  }
+  const size_t rowBytes = size_t(mWidth) * mComponents;
+  if (!mFlip) {
+    return fwrite(frame.pixels.data(), rowBytes, mHeight, mFile) ==
+           size_t(mHeight);
+  }
+  for (int row = mHeight - 1; row >= 0; row--) {
+    if (fwrite(frame.pixels.data() + row * rowBytes, rowBytes, 1, mFile) !=
+        1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void FrameEncoder::workerFunction() {
+#ifndef AL_WINDOWS
+  if (mFormat == Format::PIPE) {
+    // Report a closed pipe as a write error instead of terminating
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+  }
+#endif
+  std::unique_lock<std::mutex> lk(mLock);
+  while (true) {
+    mFrameQueued.wait(lk, [this]() { return mStop || mQueueCount > 0; });
+    if (mQueueCount == 0) {
+      // Stopped and all frames written
+      break;
+    }
+    Frame *frame = mQueue[mQueueHead];
+    mQueueHead = (mQueueHead + 1) % mQueue.size();
+    mQueueCount--;
+    lk.unlock();
+
+    double start = al_steady_time();
+    bool ok = writeFrame(*frame);
+    double encodeTime = al_steady_time() - start;
+
+    lk.lock();
+    mMetrics.encodeTime += encodeTime;
+    if (ok) {
+      mMetrics.framesWritten++;
+      mMetrics.bytesEncoded += frameBytes();
+    } else {
+      if (mMetrics.errors == 0) {
+        std::cerr << "FrameEncoder: error writing frame " << frame->index
+                  << std::endl;
+      }
+      mMetrics.errors++;
+    }
+    mFree.push_back(frame);
+    mFrameFreed.notify_one();
+  }
+}
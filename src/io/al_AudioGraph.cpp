@@ -0,0 +1,621 @@
+#include "al/io/al_AudioGraph.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+#if defined(AL_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(AL_OSX)
+#include <dispatch/dispatch.h>
+#include <pthread.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#include <cerrno>
+#endif
+
+using namespace al;
+
+struct AudioGraph::Node {
+  AudioCallback *callback{nullptr};
+  ProcessFunction function;
+  std::vector<int> inputs;
+  unsigned int numOutputs{0};
+  bool isInput{false};
+  unsigned int firstChannel{0}; // Host channel of input nodes
+  bool isOutput{false};
+
+  // Processing nodes that read this node's outputs, each listed once
+  std::vector<size_t> successors;
+  int numDependencies{0};
+  std::atomic<int> remaining{0};
+
+  // Set by allocateBuffers()
+  std::unique_ptr<NodeIO> io;
+  float *output{nullptr};
+  float *gather{nullptr}; // Inputs copied together when there are several
+  bool readsHost{false};  // Input read in place from the host channels
+  bool pinned{false};     // Output buffer is never reused
+};
+
+// AudioIOData whose buffers point into the graph's memory
+class AudioGraph::NodeIO : public AudioIOData {
+public:
+  NodeIO(unsigned int framesPerBuffer, double framesPerSecond)
+      : mTemp(framesPerBuffer) {
+    mFramesPerBuffer = framesPerBuffer;
+    mFramesPerSecond = framesPerSecond;
+    mBufT = mTemp.data();
+  }
+
+  ~NodeIO() {
+    // Not owned
+    mBufI = mBufO = mBufB = mBufT = nullptr;
+  }
+
+  void buffers(const float *in, unsigned int numIn, float *out,
+               unsigned int numOut) {
+    mBufI = const_cast<float *>(in);
+    mNumI = numIn;
+    mBufO = out;
+    mNumO = numOut;
+  }
+
+  void inputBuffer(const float *in) { mBufI = const_cast<float *>(in); }
+
+private:
+  std::vector<float> mTemp;
+};
+
+// Bounded multi-producer multi-consumer queue of node indices. Each cell
+// carries a sequence number telling whether it is ready to be written or
+// read, so push and pop only use atomic operations on the cells and the two
+// positions.
+class AudioGraph::NodeQueue {
+public:
+  explicit NodeQueue(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mCells.reset(new Cell[size]);
+    mMask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+      mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool push(size_t value) {
+    size_t pos = mTail.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &mCells[pos & mMask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+      if (diff == 0) {
+        if (mTail.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // Full
+      } else {
+        pos = mTail.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = value;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(size_t &value) {
+    size_t pos = mHead.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &mCells[pos & mMask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(sequence) - intptr_t(pos + 1);
+      if (diff == 0) {
+        if (mHead.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // Empty
+      } else {
+        pos = mHead.load(std::memory_order_relaxed);
+      }
+    }
+    value = cell->value;
+    cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    size_t value;
+  };
+
+  std::unique_ptr<Cell[]> mCells;
+  size_t mMask{0};
+  std::atomic<size_t> mTail{0};
+  std::atomic<size_t> mHead{0};
+};
+
+// Counting semaphore. post() never blocks, so it can be called from the
+// audio thread.
+class AudioGraph::Semaphore {
+public:
+#if defined(AL_WINDOWS)
+  Semaphore() { mHandle = CreateSemaphore(nullptr, 0, LONG_MAX, nullptr); }
+  ~Semaphore() { CloseHandle(mHandle); }
+  void post() { ReleaseSemaphore(mHandle, 1, nullptr); }
+  void wait() { WaitForSingleObject(mHandle, INFINITE); }
+
+private:
+  HANDLE mHandle;
+#elif defined(AL_OSX)
+  Semaphore() { mSemaphore = dispatch_semaphore_create(0); }
+  ~Semaphore() { dispatch_release(mSemaphore); }
+  void post() { dispatch_semaphore_signal(mSemaphore); }
+  void wait() { dispatch_semaphore_wait(mSemaphore, DISPATCH_TIME_FOREVER); }
+
+private:
+  dispatch_semaphore_t mSemaphore;
+#else
+  Semaphore() { sem_init(&mSemaphore, 0, 0); }
+  ~Semaphore() { sem_destroy(&mSemaphore); }
+  void post() { sem_post(&mSemaphore); }
+  void wait() {
+    while (sem_wait(&mSemaphore) != 0 && errno == EINTR) {
+    }
+  }
+
+private:
+  sem_t mSemaphore;
+#endif
+};
+
+AudioGraph::AudioGraph(unsigned int numWorkers, int workerPriority)
+    : mNumWorkers(numWorkers), mWorkerPriority(workerPriority),
+      mWake(new Semaphore), mQueue(new NodeQueue(1)) {}
+
+AudioGraph::~AudioGraph() { stopWorkers(); }
+
+void AudioGraph::startWorkers() {
+  mStop.store(false, std::memory_order_relaxed);
+  bool prioritySet = true;
+  for (unsigned int i = 0; i < mNumWorkers; i++) {
+    mWorkers.emplace_back(&AudioGraph::workerFunction, this);
+    if (mWorkerPriority <= 0) {
+      continue;
+    }
+#ifdef AL_WINDOWS
+    prioritySet &=
+        SetThreadPriority((HANDLE)mWorkers.back().native_handle(),
+                          THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    sched_param param;
+    param.sched_priority = std::min(mWorkerPriority, 99);
+    prioritySet &= pthread_setschedparam(mWorkers.back().native_handle(),
+                                         SCHED_FIFO, &param) == 0;
+#endif
+  }
+  if (!prioritySet) {
+    std::cerr << "AudioGraph: could not set real-time priority for workers. "
+                 "Using normal priority."
+              << std::endl;
+  }
+}
+
+void AudioGraph::stopWorkers() {
+  if (mWorkers.empty()) {
+    return;
+  }
+  mStop.store(true, std::memory_order_release);
+  for (size_t i = 0; i < mWorkers.size(); i++) {
+    mWake->post();
+  }
+  for (auto &worker : mWorkers) {
+    worker.join();
+  }
+  mWorkers.clear();
+}
+
+void AudioGraph::workerFunction() {
+  while (true) {
+    mWake->wait();
+    if (mStop.load(std::memory_order_acquire)) {
+      break;
+    }
+    size_t index;
+    while (mQueue->pop(index)) {
+      runNode(index);
+    }
+  }
+}
+
+int AudioGraph::input(unsigned int firstChannel, unsigned int numChannels) {
+  std::unique_ptr<Node> node(new Node);
+  node->isInput = true;
+  node->firstChannel = firstChannel;
+  node->numOutputs = numChannels;
+  return addNode(std::move(node), {});
+}
+
+int AudioGraph::addNode(AudioCallback &callback, const std::vector<int> &inputs,
+                        unsigned int numOutputs) {
+  std::unique_ptr<Node> node(new Node);
+  node->callback = &callback;
+  node->numOutputs = numOutputs;
+  return addNode(std::move(node), inputs);
+}
+
+int AudioGraph::addNode(ProcessFunction function,
+                        const std::vector<int> &inputs,
+                        unsigned int numOutputs) {
+  std::unique_ptr<Node> node(new Node);
+  node->function = function;
+  node->numOutputs = numOutputs;
+  return addNode(std::move(node), inputs);
+}
+
+int AudioGraph::addNode(std::unique_ptr<Node> node,
+                        const std::vector<int> &inputs) {
+  const size_t index = mNodes.size();
+  for (int input : inputs) {
+    if (input < 0 || size_t(input) >= index) {
+      std::cerr << "AudioGraph: input " << input
+                << " is not a node of the graph" << std::endl;
+      return -1;
+    }
+  }
+  node->inputs = inputs;
+  for (int input : inputs) {
+    Node &inputNode = *mNodes[input];
+    if (std::find(inputNode.successors.begin(), inputNode.successors.end(),
+                  index) != inputNode.successors.end()) {
+      continue;
+    }
+    inputNode.successors.push_back(index);
+    if (!inputNode.isInput) {
+      node->numDependencies++;
+    }
+  }
+  if (!node->isInput) {
+    mNumProcessingNodes++;
+    if (node->numDependencies == 0) {
+      mRoots.push_back(index);
+    }
+  }
+  mNodes.push_back(std::move(node));
+  mPrepared = false;
+  return int(index);
+}
+
+bool AudioGraph::output(int node, unsigned int firstChannel) {
+  if (node < 0 || size_t(node) >= mNodes.size()) {
+    std::cerr << "AudioGraph: " << node << " is not a node of the graph"
+              << std::endl;
+    return false;
+  }
+  if (mNodes[node]->isInput) {
+    std::cerr << "AudioGraph: graph inputs can not be outputs" << std::endl;
+    return false;
+  }
+  mNodes[node]->isOutput = true;
+  mOutputs.push_back({node, firstChannel});
+  mPrepared = false;
+  return true;
+}
+
+void AudioGraph::clear() {
+  mNodes.clear();
+  mOutputs.clear();
+  mRoots.clear();
+  mNumProcessingNodes = 0;
+  mPrepared = false;
+}
+
+size_t AudioGraph::totalChannels() const {
+  size_t channels = 0;
+  for (auto &node : mNodes) {
+    if (node->isInput) {
+      continue;
+    }
+    channels += node->numOutputs;
+    if (node->inputs.size() > 1) {
+      for (int input : node->inputs) {
+        channels += mNodes[input]->numOutputs;
+      }
+    }
+  }
+  return channels;
+}
+
+void AudioGraph::prepare(const AudioIOData &io) {
+  // Workers are idle between blocks, but are stopped so none can be reading
+  // the queue while it is replaced
+  stopWorkers();
+  mFramesPerBuffer = (unsigned int)io.framesPerBuffer();
+  mFramesPerSecond = io.framesPerSecond();
+  mHostChannels = io.channelsOut();
+  allocateBuffers();
+  // Every node is queued at most once per block
+  mQueue.reset(new NodeQueue(std::max(mNodes.size(), size_t(1))));
+  mPrepared = true;
+  mWarned = false;
+  startWorkers();
+}
+
+void AudioGraph::allocateBuffers() {
+  const size_t numNodes = mNodes.size();
+
+  // upstream[a][b] is true if node b runs before node a
+  std::vector<std::vector<bool>> upstream(numNodes,
+                                          std::vector<bool>(numNodes));
+  for (size_t a = 0; a < numNodes; a++) {
+    for (int input : mNodes[a]->inputs) {
+      upstream[a][input] = true;
+      for (size_t b = 0; b < size_t(input); b++) {
+        if (upstream[input][b]) {
+          upstream[a][b] = true;
+        }
+      }
+    }
+  }
+
+  // A slot is a range of channels holding the output or gathered inputs of
+  // one node at a time
+  struct Slot {
+    unsigned int channels;
+    size_t occupant;
+    bool gather;
+    size_t offset;
+  };
+  std::vector<Slot> slots;
+
+  // Whether node a may overwrite the slot. Everything that reads the
+  // current contents must run before a.
+  auto isFree = [&](const Slot &slot, size_t a) -> bool {
+    const Node &occupant = *mNodes[slot.occupant];
+    if (slot.gather) {
+      return slot.occupant != a && upstream[a][slot.occupant];
+    }
+    if (occupant.isOutput || occupant.pinned) {
+      return false;
+    }
+    if (occupant.successors.empty()) {
+      return upstream[a][slot.occupant];
+    }
+    for (size_t reader : occupant.successors) {
+      if (reader == a || !upstream[a][reader]) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  // Smallest free slot that fits, or a new one
+  auto allocate = [&](size_t a, unsigned int channels, bool gather) {
+    size_t best = slots.size();
+    for (size_t s = 0; s < slots.size(); s++) {
+      if (slots[s].channels >= channels && isFree(slots[s], a) &&
+          (best == slots.size() || slots[s].channels < slots[best].channels)) {
+        best = s;
+      }
+    }
+    if (best == slots.size()) {
+      slots.push_back({channels, a, gather, 0});
+    } else {
+      slots[best].occupant = a;
+      slots[best].gather = gather;
+    }
+    return best;
+  };
+
+  const size_t none = SIZE_MAX;
+  std::vector<size_t> outputSlot(numNodes, none);
+  std::vector<size_t> gatherSlot(numNodes, none);
+  for (size_t a = 0; a < numNodes; a++) {
+    Node &node = *mNodes[a];
+    node.pinned = false;
+    if (node.isInput) {
+      if (node.firstChannel + node.numOutputs > mHostChannels) {
+        std::cerr << "AudioGraph: input channels " << node.firstChannel
+                  << " to " << node.firstChannel + node.numOutputs - 1
+                  << " are not available. Using silence." << std::endl;
+        node.pinned = true;
+        outputSlot[a] = allocate(a, node.numOutputs, false);
+      }
+      continue;
+    }
+    if (node.inputs.size() > 1) {
+      unsigned int channels = 0;
+      for (int input : node.inputs) {
+        channels += mNodes[input]->numOutputs;
+      }
+      gatherSlot[a] = allocate(a, channels, true);
+    }
+    if (node.numOutputs > 0) {
+      outputSlot[a] = allocate(a, node.numOutputs, false);
+    }
+  }
+
+  mBufferChannels = 0;
+  for (auto &slot : slots) {
+    slot.offset = mBufferChannels;
+    mBufferChannels += slot.channels;
+  }
+  mBuffer.assign(mBufferChannels * mFramesPerBuffer, 0.0f);
+
+  auto slotBuffer = [&](size_t s) {
+    return s == none ? nullptr
+                     : mBuffer.data() + slots[s].offset * mFramesPerBuffer;
+  };
+  for (size_t a = 0; a < numNodes; a++) {
+    Node &node = *mNodes[a];
+    node.output = slotBuffer(outputSlot[a]);
+    node.gather = slotBuffer(gatherSlot[a]);
+  }
+  for (size_t a = 0; a < numNodes; a++) {
+    Node &node = *mNodes[a];
+    node.io.reset();
+    if (node.isInput) {
+      continue;
+    }
+    node.io.reset(new NodeIO(mFramesPerBuffer, mFramesPerSecond));
+    node.readsHost = false;
+    const float *in = nullptr;
+    unsigned int numIn = 0;
+    if (node.inputs.size() == 1) {
+      const Node &inputNode = *mNodes[node.inputs[0]];
+      // Host channels are set for each block in onAudioCB()
+      node.readsHost = inputNode.isInput && !inputNode.pinned;
+      in = inputNode.output;
+      numIn = inputNode.numOutputs;
+    } else if (node.inputs.size() > 1) {
+      in = node.gather;
+      for (int input : node.inputs) {
+        numIn += mNodes[input]->numOutputs;
+      }
+    }
+    node.io->buffers(in, numIn, node.output, node.numOutputs);
+  }
+}
+
+void AudioGraph::runNode(size_t index) {
+  const size_t frameBytes = mFramesPerBuffer * sizeof(float);
+  size_t current = index;
+  while (true) {
+    Node &node = *mNodes[current];
+    if (node.gather) {
+      float *dst = node.gather;
+      for (int input : node.inputs) {
+        const Node &inputNode = *mNodes[input];
+        memcpy(dst, inputNode.output, inputNode.numOutputs * frameBytes);
+        dst += inputNode.numOutputs * mFramesPerBuffer;
+      }
+    }
+    if (node.numOutputs > 0) {
+      memset(node.output, 0, node.numOutputs * frameBytes);
+    }
+    node.io->frame(0);
+    if (node.callback) {
+      node.callback->onAudioCB(*node.io);
+    } else {
+      node.function(*node.io);
+    }
+
+    // Queue the nodes that are now ready, but keep the first one on this
+    // thread, so a chain runs without going through the queues
+    size_t next = SIZE_MAX;
+    for (size_t successor : node.successors) {
+      if (mNodes[successor]->remaining.fetch_sub(
+              1, std::memory_order_acq_rel) == 1) {
+        if (next == SIZE_MAX) {
+          next = successor;
+        } else {
+          bool queued = mQueue->push(successor);
+          assert(queued);
+          (void)queued;
+          if (!mWorkers.empty()) {
+            mWake->post();
+          }
+        }
+      }
+    }
+    mPending.fetch_sub(1, std::memory_order_release);
+    if (next == SIZE_MAX) {
+      break;
+    }
+    current = next;
+  }
+}
+
+void AudioGraph::onAudioCB(AudioIOData &io) {
+  if (!mPrepared || io.framesPerBuffer() != mFramesPerBuffer ||
+      io.channelsOut() != mHostChannels) {
+    // Preparing here would allocate on the audio thread
+    if (!mWarned) {
+      mWarned = true;
+      std::cerr << "AudioGraph: not prepared for this block. Call prepare() "
+                   "before audio starts."
+                << std::endl;
+    }
+    return;
+  }
+  const size_t numNodes = mNodes.size();
+  if (mHostChannels > 0) {
+    for (size_t a = 0; a < numNodes; a++) {
+      Node &node = *mNodes[a];
+      if (node.isInput && !node.pinned) {
+        node.output = io.outBuffer(node.firstChannel);
+      }
+    }
+  }
+  for (size_t a = 0; a < numNodes; a++) {
+    Node &node = *mNodes[a];
+    if (node.readsHost) {
+      node.io->inputBuffer(mNodes[node.inputs[0]]->output);
+    }
+    node.remaining.store(node.numDependencies, std::memory_order_relaxed);
+  }
+
+  if (mNumProcessingNodes > 0) {
+    mPending.store(int(mNumProcessingNodes), std::memory_order_relaxed);
+    for (size_t root : mRoots) {
+      bool queued = mQueue->push(root);
+      assert(queued);
+      (void)queued;
+    }
+    // This thread takes a root too
+    const size_t wakeups =
+        std::min(mRoots.size() - 1, size_t(mWorkers.size()));
+    for (size_t i = 0; i < wakeups; i++) {
+      mWake->post();
+    }
+    // Run ready nodes until all are done. Nodes running on workers are
+    // waited for by yielding, as sleeping could oversleep the deadline.
+    while (mPending.load(std::memory_order_acquire) > 0) {
+      size_t index;
+      if (mQueue->pop(index)) {
+        runNode(index);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // Node outputs replace the host channels, summed where they overlap
+  const unsigned int fpb = mFramesPerBuffer;
+  for (size_t o = 0; o < mOutputs.size(); o++) {
+    const Node &node = *mNodes[mOutputs[o].first];
+    for (unsigned int c = 0; c < node.numOutputs; c++) {
+      const unsigned int channel = mOutputs[o].second + c;
+      if (channel >= mHostChannels) {
+        break;
+      }
+      bool written = false;
+      for (size_t p = 0; p < o && !written; p++) {
+        const unsigned int first = mOutputs[p].second;
+        written = channel >= first &&
+                  channel < first + mNodes[mOutputs[p].first]->numOutputs;
+      }
+      const float *src = node.output + c * fpb;
+      float *dst = io.outBuffer(channel);
+      if (written) {
+        for (unsigned int i = 0; i < fpb; i++) {
+          dst[i] += src[i];
+        }
+      } else {
+        memcpy(dst, src, fpb * sizeof(float));
+      }
+    }
+  }
+}
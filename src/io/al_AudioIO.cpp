@@ -11,10 +11,16 @@
 #include <iostream>
 #include <string>
 
+#include "al/math/al_Tile.hpp"
+
 #ifdef AL_AUDIO_RTAUDIO
 #include "RtAudio.h"
 #endif
 
+#ifdef AL_AUDIO_DUMMY_THREAD
+#include "al/io/al_HeadlessAudio.hpp"
+#endif
+
 #ifdef AL_AUDIO_PORTAUDIO
 #include "portaudio.h"
 #endif
@@ -27,9 +33,15 @@ static void warn(const char *msg, const char *src) {
 
 #ifdef AL_AUDIO_DUMMY
 
+// The dummy backend doesn't call the audio callback. When built with
+// ALLOLIB_DUMMY_AUDIO_THREAD it runs the callback at the audio rate from its
+// own thread instead, as if a device were requesting blocks.
 struct AudioBackendData {
   int numOutChans, numInChans;
   std::string streamName;
+#ifdef AL_AUDIO_DUMMY_THREAD
+  std::unique_ptr<HeadlessAudio> driver;
+#endif
 };
 
 AudioBackend::AudioBackend() {
@@ -82,7 +94,14 @@ void AudioBackend::setOutDeviceChans(int num) {
   static_cast<AudioBackendData *>(mBackendData.get())->numOutChans = num;
 }
 
-double AudioBackend::time() { return 0.0; }
+double AudioBackend::time() {
+#ifdef AL_AUDIO_DUMMY_THREAD
+  AudioBackendData *data = static_cast<AudioBackendData *>(mBackendData.get());
+  return data->driver ? data->driver->time() : 0.0;
+#else
+  return 0.0;
+#endif
+}
 
 bool AudioBackend::open(int framesPerSecond, unsigned int framesPerBuffer,
                         void *userdata) {
@@ -91,22 +110,46 @@ bool AudioBackend::open(int framesPerSecond, unsigned int framesPerBuffer,
 }
 
 bool AudioBackend::close() {
+  stop();
   mOpen = false;
   return true;
 }
 
 bool AudioBackend::start(int framesPerSecond, int framesPerBuffer,
                          void *userdata) {
+#ifdef AL_AUDIO_DUMMY_THREAD
+  AudioBackendData *data = static_cast<AudioBackendData *>(mBackendData.get());
+  if (mRunning) {
+    return true;
+  }
+  data->driver =
+      std::make_unique<HeadlessAudio>(*static_cast<AudioIO *>(userdata));
+  mRunning = data->driver->start();
+#else
   mRunning = true;
-  return true;
+#endif
+  return mRunning;
 }
 
 bool AudioBackend::stop() {
+#ifdef AL_AUDIO_DUMMY_THREAD
+  AudioBackendData *data = static_cast<AudioBackendData *>(mBackendData.get());
+  if (data->driver) {
+    data->driver->stop();
+  }
+#endif
   mRunning = false;
   return true;
 }
 
-double AudioBackend::cpu() { return 0.0; }
+double AudioBackend::cpu() {
+#ifdef AL_AUDIO_DUMMY_THREAD
+  AudioBackendData *data = static_cast<AudioBackendData *>(mBackendData.get());
+  return data->driver ? data->driver->cpu() : 0.0;
+#else
+  return 0.0;
+#endif
+}
 
 AudioDevice AudioBackend::defaultInput() { return AudioDevice(0); }
 
@@ -424,6 +467,8 @@ static int paCallback(const void *input, void *output, unsigned long frameCount,
                       const PaStreamCallbackTimeInfo *timeInfo,
                       PaStreamCallbackFlags statusFlags, void *userData) {
   AudioIO &io = *(AudioIO *)userData;
+  AudioProfiler::Block profile(io.profiler(),
+                               frameCount / io.framesPerSecond());
 
   assert(frameCount == (unsigned)io.framesPerBuffer());
   const float **inBuffers = (const float **)input;
@@ -437,50 +482,10 @@ static int paCallback(const void *input, void *output, unsigned long frameCount,
 
   io.processAudio(); // call callback
 
-  // apply smoothly-ramped gain to all output channels
-  if (io.usingGain()) {
-    float dgain = (io.mGain - io.mGainPrev) / frameCount;
-
-    for (int j = 0; j < io.channelsOutDevice(); ++j) {
-      float *out = io.outBuffer(j);
-      float gain = io.mGainPrev;
-
-      for (unsigned i = 0; i < frameCount; ++i) {
-        out[i] *= gain;
-        gain += dgain;
-      }
-    }
-
-    io.mGainPrev = io.mGain;
-  }
-
-  // kill pesky nans so we don't hurt anyone's ears
-  if (io.zeroNANs()) {
-    for (unsigned i = 0; i < unsigned(frameCount * io.channelsOutDevice());
-         ++i) {
-      float &s = (&io.out(0, 0))[i];
-      // if(isnan(s)) s = 0.f;
-      if (s != s)
-        s = 0.f; // portable isnan; only nans do not equal themselves
-    }
-  }
-
-  if (io.clipOut()) {
-    for (unsigned i = 0; i < unsigned(frameCount * io.channelsOutDevice());
-         ++i) {
-      float &s = (&io.out(0, 0))[i];
-      if (s < -1.f)
-        s = -1.f;
-      else if (s > 1.f)
-        s = 1.f;
-    }
-  }
-
-  float **outBuffers = (float **)output;
-  for (int i = 0; i < io.channelsOutDevice(); i++) {
-    memcpy(outBuffers[i], const_cast<float *>(&io.out(i, 0)),
-           frameCount * sizeof(float));
-  }
+  AudioProfiler::Scope outputScope(AudioProfiler::OUTPUT);
+  // Gain ramp, NaN removal and clipping in one pass over the output buffers,
+  // then copied to the device
+  io.finalizeOutput((float **)output);
 
   return 0;
 }
@@ -615,6 +620,11 @@ bool AudioBackend::open(int framesPerSecond, unsigned int framesPerBuffer,
   auto *ip = data->iParams.nChannels > 0 ? &data->iParams : nullptr;
   auto *op = data->oParams.nChannels > 0 ? &data->oParams : nullptr;
   try {
+    if (static_cast<AudioIO *>(userdata)->directOutput()) {
+      data->options.flags |= RTAUDIO_NONINTERLEAVED;
+    } else {
+      data->options.flags &= ~RTAUDIO_NONINTERLEAVED;
+    }
     data->audio.openStream(op, ip, RTAUDIO_FLOAT32, framesPerSecond,
                            &deviceBufferSize, rtaudioCallback, userdata,
                            &data->options);
@@ -698,70 +708,48 @@ static int rtaudioCallback(void *output, void *input, unsigned int frameCount,
   }
 
   AudioIO &io = *(AudioIO *)userData;
+  AudioProfiler::Block profile(io.profiler(),
+                               frameCount / io.framesPerSecond());
 
   assert(frameCount == (unsigned)io.framesPerBuffer());
 
+  // Direct output opens the stream non-interleaved, so device buffers have
+  // the layout of the AudioIOData buffers
+  const bool planar = io.directOutput();
   if (input != NULL) {
     const float *inBuffers = (const float *)input;
     float *hwInBuffer = const_cast<float *>(io.inBuffer(0));
-    for (unsigned int frame = 0; frame < io.framesPerBuffer(); frame++) {
-      for (int i = 0; i < io.channelsInDevice(); i++) {
-        hwInBuffer[i * frameCount + frame] = *inBuffers++;
+    if (planar) {
+      memcpy(hwInBuffer, inBuffers,
+             frameCount * io.channelsInDevice() * sizeof(float));
+    } else {
+      for (unsigned int frame = 0; frame < frameCount; frame++) {
+        for (int i = 0; i < io.channelsInDevice(); i++) {
+          hwInBuffer[i * frameCount + frame] = *inBuffers++;
+        }
       }
     }
   }
 
+  // Render into device memory unless there are virtual output channels
+  float *outBuffer = (float *)output;
+  const bool direct =
+      planar && outBuffer && int(io.channelsOut()) == io.channelsOutDevice();
+  if (direct) {
+    io.deviceOutBuffer(outBuffer);
+  }
+
   if (io.autoZeroOut())
     io.zeroOut();
 
   io.processAudio(); // call callback
 
-  // apply smoothly-ramped gain to all output channels
-  if (io.usingGain()) {
-    float dgain = (io.mGain - io.mGainPrev) / frameCount;
-
-    for (int j = 0; j < io.channelsOutDevice(); ++j) {
-      float *out = io.outBuffer(j);
-      float gain = io.mGainPrev;
-
-      for (unsigned i = 0; i < frameCount; ++i) {
-        out[i] *= gain;
-        gain += dgain;
-      }
-    }
-
-    io.mGainPrev = io.mGain;
-  }
-
-  // kill pesky nans so we don't hurt anyone's ears
-  if (io.zeroNANs()) {
-    for (unsigned i = 0; i < unsigned(frameCount * io.channelsOutDevice());
-         ++i) {
-      float &s = (&io.out(0, 0))[i];
-      // if(isnan(s)) s = 0.f;
-      if (s != s)
-        s = 0.f; // portable isnan; only nans do not equal themselves
-    }
-  }
-
-  if (io.clipOut()) {
-    for (unsigned i = 0; i < unsigned(frameCount * io.channelsOutDevice());
-         ++i) {
-      float &s = (&io.out(0, 0))[i];
-      if (s < -1.f)
-        s = -1.f;
-      else if (s > 1.f)
-        s = 1.f;
-    }
-  }
-
-  float *outBuffers = (float *)output;
-
-  float *finalOutBuffer = const_cast<float *>(io.outBuffer(0));
-  for (unsigned int frame = 0; frame < io.framesPerBuffer(); frame++) {
-    for (int i = 0; i < io.channelsOutDevice(); i++) {
-      *outBuffers++ = finalOutBuffer[i * frameCount + frame];
-    }
+  AudioProfiler::Scope outputScope(AudioProfiler::OUTPUT);
+  // Gain ramp, NaN removal and clipping in one pass over the output buffers,
+  // then copied to the device
+  io.finalizeOutput(outBuffer, !planar);
+  if (direct) {
+    io.deviceOutBuffer(nullptr);
   }
 
   return 0;
@@ -1231,9 +1219,12 @@ void AudioIO::print() const {
 // void AudioIO::processAudio(){ frame(0); if(callback) callback(*this); }
 void AudioIO::processAudio() {
   frame(0);
-  if (callback)
+  if (callback) {
+    AudioProfiler::Scope scope(AudioProfiler::IO_CALLBACK);
     callback(*this);
+  }
 
+  AudioProfiler::Scope scope(AudioProfiler::AUDIO_CALLBACKS);
   std::vector<AudioCallback *>::iterator iter = mAudioCallbacks.begin();
   while (iter != mAudioCallbacks.end()) {
     frame(0);
@@ -1258,4 +1249,155 @@ double AudioIO::time(int frame) const {
   return (double)frame / framesPerSecond() + time();
 }
 
+void AudioIO::directOutput(bool v) {
+  if (isOpen()) {
+    warn("direct output cannot be set with the stream open", "AudioIO");
+    return;
+  }
+  mDirectOutput = v;
+}
+
+AudioOutputPass AudioIO::outputPass() const {
+  AudioOutputPass pass;
+  pass.gainStart = mGainPrev;
+  pass.gainEnd = mGain;
+  pass.zeroNANs = mZeroNANs;
+  pass.clip = mClipOut;
+  return pass;
+}
+
+void AudioIO::finalizeOutput(float *const *buffers) {
+  const AudioOutputPass pass = outputPass();
+  const unsigned int numFrames = framesPerBuffer();
+  for (int i = 0; i < channelsOutDevice(); ++i) {
+    float *out = outBuffer(i);
+    pass.process(out, out, numFrames);
+    if (buffers[i] != out) {
+      std::memcpy(buffers[i], out, numFrames * sizeof(float));
+    }
+  }
+  mGainPrev = mGain;
+}
+
+void AudioIO::finalizeOutput(float *buffer, bool interleaved) {
+  const AudioOutputPass pass = outputPass();
+  const unsigned int numFrames = framesPerBuffer();
+  for (int i = 0; i < channelsOutDevice(); ++i) {
+    float *out = outBuffer(i);
+    pass.process(out, out, numFrames);
+    if (!interleaved && buffer + i * numFrames != out) {
+      std::memcpy(buffer + i * numFrames, out, numFrames * sizeof(float));
+    }
+  }
+  if (interleaved) {
+    AudioOutputPass copy;
+    copy.zeroNANs = false;
+    copy.clip = false;
+    copy.processInterleaved(outBuffer(0), buffer, channelsOutDevice(),
+                            numFrames);
+  }
+  mGainPrev = mGain;
+}
+
+void AudioIO::deviceOutBuffer(float *buffer) {
+  if (buffer) {
+    if (!mInternalOutBuffer) {
+      mInternalOutBuffer = mBufO;
+    }
+    mBufO = buffer;
+  } else if (mInternalOutBuffer) {
+    mBufO = mInternalOutBuffer;
+    mInternalOutBuffer = nullptr;
+  }
+}
+
+// AudioOutputPass -------------------------------------
+
+namespace {
+
+template <bool Gain, bool ZeroNANs, bool Clip>
+inline float finalizeSample(float s, float gain) {
+  if (Gain) {
+    s *= gain;
+  }
+  if (ZeroNANs) {
+    s = s != s ? 0.f : s; // only NaNs do not equal themselves
+  }
+  if (Clip) {
+    s = s < -1.f ? -1.f : (s > 1.f ? 1.f : s);
+  }
+  return s;
+}
+
+template <bool Gain, bool ZeroNANs, bool Clip>
+void finalizeChannel(const float *src, float *dst, unsigned int numFrames,
+                     float gain, float dgain, unsigned int stride) {
+  tiledWrite(
+      dst, numFrames,
+      [src, gain, dgain](unsigned int i) {
+        return finalizeSample<Gain, ZeroNANs, Clip>(src[i],
+                                                    gain + dgain * float(i));
+      },
+      stride);
+}
+
+template <bool Gain, bool ZeroNANs, bool Clip>
+void finalizeInterleaved(const float *src, float *dst, int numChannels,
+                         unsigned int numFrames, float gain, float dgain) {
+  for (int c = 0; c < numChannels; ++c) {
+    finalizeChannel<Gain, ZeroNANs, Clip>(src + c * numFrames, dst + c,
+                                          numFrames, gain, dgain,
+                                          unsigned(numChannels));
+  }
+}
+
+typedef void (*ChannelFunction)(const float *, float *, unsigned int, float,
+                                float, unsigned int);
+typedef void (*InterleavedFunction)(const float *, float *, int, unsigned int,
+                                    float, float);
+
+// Indexed by gain | zeroNANs << 1 | clip << 2
+const ChannelFunction channelFunctions[8] = {
+    finalizeChannel<false, false, false>, finalizeChannel<true, false, false>,
+    finalizeChannel<false, true, false>,  finalizeChannel<true, true, false>,
+    finalizeChannel<false, false, true>,  finalizeChannel<true, false, true>,
+    finalizeChannel<false, true, true>,   finalizeChannel<true, true, true>};
+
+const InterleavedFunction interleavedFunctions[8] = {
+    finalizeInterleaved<false, false, false>,
+    finalizeInterleaved<true, false, false>,
+    finalizeInterleaved<false, true, false>,
+    finalizeInterleaved<true, true, false>,
+    finalizeInterleaved<false, false, true>,
+    finalizeInterleaved<true, false, true>,
+    finalizeInterleaved<false, true, true>,
+    finalizeInterleaved<true, true, true>};
+
+int passIndex(const AudioOutputPass &pass) {
+  const bool gain = pass.gainStart != 1.f || pass.gainEnd != 1.f;
+  return int(gain) | int(pass.zeroNANs) << 1 | int(pass.clip) << 2;
+}
+
+} // namespace
+
+void AudioOutputPass::process(const float *src, float *dst,
+                              unsigned int numFrames) const {
+  if (numFrames == 0) {
+    return;
+  }
+  const float dgain = (gainEnd - gainStart) / numFrames;
+  channelFunctions[passIndex(*this)](src, dst, numFrames, gainStart, dgain, 1);
+}
+
+void AudioOutputPass::processInterleaved(const float *src, float *dst,
+                                         int numChannels,
+                                         unsigned int numFrames) const {
+  if (numFrames == 0) {
+    return;
+  }
+  const float dgain = (gainEnd - gainStart) / numFrames;
+  interleavedFunctions[passIndex(*this)](src, dst, numChannels, numFrames,
+                                         gainStart, dgain);
+}
+
 } // namespace al
@@ -0,0 +1,176 @@
+#include "al/io/al_AudioProfiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "al/protocol/al_OSC.hpp"
+#include "al/ui/al_ParameterServer.hpp"
+
+using namespace al;
+
+namespace {
+thread_local AudioProfiler *tlsCurrentProfiler = nullptr;
+} // namespace
+
+AudioProfiler::AudioProfiler(size_t historySize)
+    : mRecords(std::max(historySize, size_t(1))),
+      mHistory(std::max(historySize, size_t(1))) {
+  const char *names[NUM_BUILTIN_STAGES] = {
+      "callback", "audioCallbacks", "voices", "spatializer", "postProcessing",
+      "output"};
+  for (int i = 0; i < NUM_BUILTIN_STAGES; i++) {
+    mNames[i] = names[i];
+  }
+  std::fill(mStageTimes, mStageTimes + kMaxStages, 0.0);
+}
+
+int AudioProfiler::addStage(const std::string &name) {
+  if (mNumStages == kMaxStages) {
+    std::cout << "AudioProfiler: Can't add more than " << kMaxStages
+              << " stages" << std::endl;
+    return -1;
+  }
+  mNames[mNumStages] = name;
+  return mNumStages++;
+}
+
+AudioProfiler *AudioProfiler::current() { return tlsCurrentProfiler; }
+
+void AudioProfiler::beginBlock(double blockPeriod) {
+  mPrevious = tlsCurrentProfiler;
+  tlsCurrentProfiler = this;
+  mBlockPeriod = blockPeriod;
+  std::fill(mStageTimes, mStageTimes + mNumStages, 0.0);
+  mBlockStart = std::chrono::steady_clock::now();
+}
+
+void AudioProfiler::endBlock() {
+  Record record;
+  record.total = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - mBlockStart)
+                     .count();
+  record.period = mBlockPeriod;
+  std::copy(mStageTimes, mStageTimes + kMaxStages, record.stages);
+  tlsCurrentProfiler = mPrevious;
+
+  mBlocks.fetch_add(1, std::memory_order_relaxed);
+  if (record.total > record.period) {
+    mDeadlineMisses.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (!mRecords.push(record)) {
+    mDropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void AudioProfiler::readRecords() {
+  Record record;
+  while (mRecords.pop(record)) {
+    mHistory[mHistoryWrite] = record;
+    mHistoryWrite = (mHistoryWrite + 1) % mHistory.size();
+    mHistoryCount = std::min(mHistoryCount + 1, mHistory.size());
+  }
+}
+
+AudioProfiler::Stats AudioProfiler::computeStats(int stage) {
+  Stats stats;
+  readRecords();
+  if (mHistoryCount == 0) {
+    return stats;
+  }
+  mScratch.resize(mHistoryCount);
+  double sum = 0;
+  for (size_t i = 0; i < mHistoryCount; i++) {
+    const Record &record = mHistory[i];
+    mScratch[i] = stage < 0 ? record.total : record.stages[stage];
+    sum += mScratch[i];
+  }
+  auto percentile = [&](double p) {
+    auto nth = mScratch.begin() + size_t(p * (mHistoryCount - 1) + 0.5);
+    std::nth_element(mScratch.begin(), nth, mScratch.end());
+    return *nth;
+  };
+  stats.count = mHistoryCount;
+  stats.mean = sum / mHistoryCount;
+  stats.p50 = percentile(0.5);
+  stats.p90 = percentile(0.9);
+  stats.p99 = percentile(0.99);
+  stats.max = *std::max_element(mScratch.begin(), mScratch.end());
+  return stats;
+}
+
+AudioProfiler::Stats AudioProfiler::blockStats() { return computeStats(-1); }
+
+AudioProfiler::Stats AudioProfiler::stageStats(int stage) {
+  if (stage < 0 || stage >= mNumStages) {
+    return Stats();
+  }
+  return computeStats(stage);
+}
+
+double AudioProfiler::load() {
+  readRecords();
+  double time = 0, period = 0;
+  for (size_t i = 0; i < mHistoryCount; i++) {
+    time += mHistory[i].total;
+    period += mHistory[i].period;
+  }
+  return period > 0 ? time / period : 0.0;
+}
+
+void AudioProfiler::reset() {
+  readRecords();
+  mHistoryWrite = 0;
+  mHistoryCount = 0;
+  mBlocks = 0;
+  mDeadlineMisses = 0;
+  mDropped = 0;
+}
+
+void AudioProfiler::print(std::ostream &stream) {
+  auto printStats = [&](const std::string &name, const Stats &s) {
+    char line[128];
+    snprintf(line, sizeof(line),
+             "%-16s mean %7.3f  p50 %7.3f  p90 %7.3f  p99 %7.3f  max %7.3f",
+             name.c_str(), s.mean * 1000, s.p50 * 1000, s.p90 * 1000,
+             s.p99 * 1000, s.max * 1000);
+    stream << line << std::endl;
+  };
+  stream << "Audio profile (ms) over " << blockStats().count << " blocks"
+         << std::endl;
+  printStats("block", blockStats());
+  for (int i = 0; i < mNumStages; i++) {
+    printStats(mNames[i], stageStats(i));
+  }
+  stream << "Load: " << load() << "  Deadline misses: " << deadlineMisses()
+         << "/" << blocks() << std::endl;
+}
+
+void AudioProfiler::addMessages(osc::Packet &packet,
+                                const std::string &prefix) {
+  auto addStats = [&](const std::string &name, const Stats &s) {
+    packet.addMessage(prefix + "/" + name, float(s.mean * 1000),
+                      float(s.p50 * 1000), float(s.p90 * 1000),
+                      float(s.p99 * 1000), float(s.max * 1000));
+  };
+  packet.beginBundle();
+  addStats("block", blockStats());
+  for (int i = 0; i < mNumStages; i++) {
+    addStats(mNames[i], stageStats(i));
+  }
+  packet.addMessage(prefix + "/load", float(load()));
+  packet.addMessage(prefix + "/deadlineMisses", int(deadlineMisses()));
+  packet.addMessage(prefix + "/blocks", int(blocks()));
+  packet.endBundle();
+}
+
+void AudioProfiler::publish(osc::Send &sender, const std::string &prefix) {
+  osc::Packet packet(4096);
+  addMessages(packet, prefix);
+  sender.send(packet);
+}
+
+void AudioProfiler::publish(OSCNotifier &notifier, const std::string &prefix) {
+  osc::Packet packet(4096);
+  addMessages(packet, prefix);
+  notifier.send(packet);
+}
@@ -0,0 +1,136 @@
+#include "al/io/al_HeadlessAudio.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+using namespace al;
+
+HeadlessAudio::HeadlessAudio(AudioIO &io, Clock clock)
+    : mIO(io), mClock(clock) {}
+
+HeadlessAudio::~HeadlessAudio() { stop(); }
+
+double HeadlessAudio::time() const {
+  return double(mFramesProcessed) / mIO.framesPerSecond();
+}
+
+bool HeadlessAudio::prepare() {
+  if (mRunning || mThread.joinable()) {
+    std::cerr << "HeadlessAudio: already running" << std::endl;
+    return false;
+  }
+  mFramesProcessed = 0;
+  mDeadlineMisses = 0;
+  mCpu = 0.0;
+  if (!mRecordPath.empty()) {
+    if (!mWriter.open(mRecordPath.c_str(), uint32_t(mIO.framesPerSecond()),
+                      uint16_t(mIO.channelsOut()))) {
+      return false;
+    }
+    mInterleaved.resize(mIO.channelsOut() * mIO.framesPerBuffer());
+  }
+  return true;
+}
+
+bool HeadlessAudio::start(uint64_t numFrames) {
+  if (!prepare()) {
+    return false;
+  }
+  mRunning = true;
+  mThread = std::thread(&HeadlessAudio::run, this, numFrames);
+  return true;
+}
+
+void HeadlessAudio::stop() {
+  mRunning = false;
+  finish();
+}
+
+void HeadlessAudio::wait() { finish(); }
+
+void HeadlessAudio::finish() {
+  if (mThread.joinable()) {
+    mThread.join();
+  }
+  mWriter.close();
+}
+
+bool HeadlessAudio::render(uint64_t numFrames) {
+  if (!prepare()) {
+    return false;
+  }
+  mRunning = true;
+  run(numFrames);
+  mWriter.close();
+  return true;
+}
+
+void HeadlessAudio::run(uint64_t numFrames) {
+  using clock = std::chrono::steady_clock;
+  const uint64_t framesPerBuffer = mIO.framesPerBuffer();
+  const auto blockDuration = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(framesPerBuffer / mIO.framesPerSecond()));
+  auto deadline = clock::now();
+
+  while (mRunning && (numFrames == 0 || mFramesProcessed < numFrames)) {
+    auto begin = clock::now();
+    processBlock();
+    auto end = clock::now();
+    mCpu = std::chrono::duration<double>(end - begin).count() /
+           std::chrono::duration<double>(blockDuration).count();
+
+    // The last block is only counted and written up to numFrames
+    uint64_t frames = framesPerBuffer;
+    if (numFrames > 0) {
+      frames = std::min(frames, numFrames - mFramesProcessed);
+    }
+    if (mWriter.isOpen()) {
+      const int channels = mIO.channelsOut();
+      for (int c = 0; c < channels; c++) {
+        const float *out = mIO.outBuffer(c);
+        for (uint64_t i = 0; i < frames; i++) {
+          mInterleaved[i * channels + c] = out[i];
+        }
+      }
+      mWriter.write(mInterleaved.data(), frames);
+    }
+    mFramesProcessed += frames;
+
+    if (mClock == Clock::REALTIME) {
+      deadline += blockDuration;
+      auto now = clock::now();
+      if (end > deadline) {
+        // A device would have underrun. Start counting again from now
+        // instead of rushing to catch up.
+        mDeadlineMisses++;
+        deadline = now;
+      } else {
+        std::this_thread::sleep_until(deadline);
+      }
+    }
+  }
+  mRunning = false;
+}
+
+void HeadlessAudio::processBlock() {
+  AudioIO &io = mIO;
+  const unsigned int frameCount = io.framesPerBuffer();
+  const int channels = io.channelsOut();
+  AudioProfiler::Block profile(io.profiler(),
+                               frameCount / io.framesPerSecond());
+
+  if (io.autoZeroOut()) {
+    io.zeroOut();
+  }
+
+  io.processAudio();
+
+  AudioProfiler::Scope outputScope(AudioProfiler::OUTPUT);
+  // All channels count as device channels, finalized in place
+  const AudioOutputPass pass = io.outputPass();
+  for (int j = 0; j < channels; ++j) {
+    pass.process(io.outBuffer(j), io.outBuffer(j), frameCount);
+  }
+  io.mGainPrev = io.mGain;
+}
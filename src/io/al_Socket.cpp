@@ -68,6 +68,7 @@ public:
   bool listen() { return false; }
   bool accept(Socket::Impl *newSock) { return false; }
   bool opened() const { return false; }
+  intptr_t handle() const { return -1; }
   int recv(char *buffer, int maxlen, char *from) { return 0; }
   int send(const char *buffer, int len) { return 0; }
 };
@@ -514,6 +515,10 @@ public:
 
   bool opened() const { return INVALID_SOCKET != mSocketHandle; }
 
+  intptr_t handle() const {
+    return opened() ? intptr_t(mSocketHandle) : intptr_t(-1);
+  }
+
   size_t recv(char *buffer, size_t maxlen, char *from) {
     return ::recv(mSocketHandle, buffer, maxlen, 0);
   }
@@ -587,6 +592,8 @@ const std::string &Socket::address() const { return mImpl->address(); }
 
 bool Socket::opened() const { return mImpl->opened(); }
 
+intptr_t Socket::handle() const { return mImpl->handle(); }
+
 uint16_t Socket::port() const { return mImpl->port(); }
 
 al_sec Socket::timeout() const { return mImpl->timeout(); }
@@ -40,8 +40,8 @@ void from_bytes(const uint8_t *bytes, uint16_t &dest) {
 }
 
 void from_bytes(const uint8_t *bytes, uint32_t &dest) {
-  dest = (uint16_t(bytes[3]) << 8 * 3) | (uint16_t(bytes[4]) << 8 * 2) |
-         (uint16_t(bytes[1]) << 8 * 1) | (uint16_t(bytes[0]) << 8 * 0);
+  dest = (uint32_t(bytes[3]) << 8 * 3) | (uint32_t(bytes[2]) << 8 * 2) |
+         (uint32_t(bytes[1]) << 8 * 1) | (uint32_t(bytes[0]) << 8 * 0);
 }
 
 } // namespace Convert
@@ -57,6 +57,134 @@ void CommandConnection::stop() {
   mState = BarrierState::NONE;
 }
 
+namespace {
+// Size prefix of each command
+const size_t kCommandHeaderSize = 4;
+// Seconds a client waits for the server to acknowledge the handshake
+const double kHandshakeTimeout = 5.0;
+// Largest buffer of the receive threads used without the event loop
+const size_t kMaxReceiveBufferSize = 64 * 1024 * 1024;
+
+// Header and command are put together to go out in one send, so commands
+// sent concurrently from other threads can't come in between. Small
+// commands use localFrame, larger ones heapFrame.
+uint8_t *frameCommand(const void *data, size_t size, uint8_t *localFrame,
+                      size_t localSize, std::vector<uint8_t> &heapFrame) {
+  if (size > UINT32_MAX) {
+    std::cerr << "ERROR: command too large to send" << std::endl;
+    return nullptr;
+  }
+  uint8_t *frame = localFrame;
+  if (kCommandHeaderSize + size > localSize) {
+    heapFrame.resize(kCommandHeaderSize + size);
+    frame = heapFrame.data();
+  }
+  auto header = Convert::to_bytes(uint32_t(size));
+  memcpy(frame, header.data(), kCommandHeaderSize);
+  memcpy(frame + kCommandHeaderSize, data, size);
+  return frame;
+}
+} // namespace
+
+size_t CommandConnection::dispatchMessages(uint8_t *data, size_t size,
+                                           Socket &src) {
+  size_t consumed = 0;
+  while (size - consumed >= kCommandHeaderSize) {
+    uint32_t commandSize = 0;
+    Convert::from_bytes(data + consumed, commandSize);
+    if (size - consumed - kCommandHeaderSize < commandSize) {
+      break; // Wait for the rest of the command
+    }
+    uint8_t *command = data + consumed + kCommandHeaderSize;
+    consumed += kCommandHeaderSize + commandSize;
+    if (commandSize == 0) {
+      continue;
+    }
+    if (command[0] == PING) {
+      uint8_t pong[1] = {PONG};
+      if (!sendCommand(src, pong, 1)) {
+        std::cerr << "ERROR: could not send pong" << std::endl;
+      }
+      continue;
+    } else if (command[0] == PONG) {
+      if (mVerbose) {
+        std::cout << "Got pong for " << src.address() << ":" << src.port()
+                  << std::endl;
+      }
+      continue;
+    }
+
+    Message message(command, commandSize);
+    if (mVerbose) {
+      std::cout << "Received message from " << src.address() << ":"
+                << src.port() << std::endl;
+    }
+    if (!processIncomingMessage(message, &src)) {
+      std::cerr << __FILE__ << " : unable to process message("
+                << (int)command[0] << ") from " << src.address() << ":"
+                << src.port() << std::endl;
+    }
+  }
+  return consumed;
+}
+
+bool CommandConnection::receiveMessages(Socket &src,
+                                        std::vector<uint8_t> &buffer,
+                                        size_t &bufferSize) {
+  if (bufferSize == buffer.size()) {
+    if (buffer.size() >= kMaxReceiveBufferSize) {
+      std::cerr << "ERROR: input buffer overrun from " << src.address() << ":"
+                << src.port() << std::endl;
+      return false;
+    }
+    buffer.resize(std::max(buffer.size() * 2, size_t(16384)));
+  }
+  size_t bytes =
+      src.recv((char *)buffer.data() + bufferSize, buffer.size() - bufferSize);
+  if (bytes == 0 || bytes == SIZE_MAX) {
+    return true; // Timed out or nothing to read
+  }
+  bufferSize += bytes;
+  size_t consumed = dispatchMessages(buffer.data(), bufferSize, src);
+  bufferSize -= consumed;
+  memmove(buffer.data(), buffer.data() + consumed, bufferSize);
+  return true;
+}
+
+bool CommandConnection::sendCommand(Socket &dst, const void *data,
+                                    size_t size) {
+  uint8_t localFrame[256];
+  std::vector<uint8_t> heapFrame;
+  const uint8_t *frame =
+      frameCommand(data, size, localFrame, sizeof(localFrame), heapFrame);
+  return frame && sendBytes(dst, frame, kCommandHeaderSize + size);
+}
+
+bool CommandConnection::sendBytes(Socket &dst, const void *data,
+                                  size_t size) {
+  if (mLoop) {
+    return mLoop->send(&dst, data, size);
+  }
+  return dst.send((const char *)data, size) == size;
+}
+
+bool CommandConnection::startLoop() {
+  if (!mLoop) {
+    mLoop = std::make_shared<CommandLoop>();
+    mPrivateLoop = true;
+  }
+  // Shared loops are started by their owner
+  return !mPrivateLoop || mLoop->start();
+}
+
+void CommandConnection::stopLoop() {
+  if (mPrivateLoop) {
+    mLoop->stop();
+    mLoop = nullptr;
+    mPrivateLoop = false;
+  }
+}
+
 /// =====================================
 ///
 std::vector<float> CommandServer::ping(double timeoutSecs) {
@@ -70,10 +198,8 @@ std::vector<float> CommandServer::ping(double timeoutSecs) {
                 << std::endl;
     }
     //    auto startTime = al_steady_time();
-    unsigned char message[2] = {0, 0};
-
-    message[0] = PING;
-    listener->send((const char *)message, 2);
+    unsigned char message[1] = {PING};
+    sendCommand(*listener, message, 1);
   }
 
   return pingTimes;
@@ -113,6 +239,47 @@ bool CommandServer::start(uint16_t serverPort, const char *serverAddr) {
     return false;
   }
 
+  if (CommandLoop::available()) {
+    if (!startLoop()) {
+      std::cerr << "[+Server] ERROR starting event loop" << std::endl;
+      return false;
+    }
+    mRunning = true;
+    bool listening = mLoop->listen(
+        mSocket, [this](std::shared_ptr<Socket> client) {
+          if (mVerbose) {
+            std::cout << "[+Server] Got Connection Request "
+                      << client->address() << ":" << client->port()
+                      << std::endl;
+          }
+          auto handshakeDone = std::make_shared<bool>(false);
+          mLoop->add(
+              client,
+              [this, client, handshakeDone](Socket &socket, uint8_t *data,
+                                            size_t size) -> size_t {
+                size_t consumed = 0;
+                if (!*handshakeDone) {
+                  consumed = acceptHandshake(client, data, size);
+                  if (consumed == 0 || !mRunning) {
+                    return consumed;
+                  }
+                  *handshakeDone = true;
+                }
+                return consumed + dispatchMessages(data + consumed,
+                                                   size - consumed, socket);
+              },
+              [this](Socket &socket) { removeConnection(&socket); });
+        });
+    if (!listening) {
+      stopLoop();
+      mRunning = false;
+      return false;
+    }
+    mState = CommandConnection::SERVER;
+    return true;
+  }
+
+  // Thread per connection where the event loop is not available
   mRunning = true;
   mBootstrapServerThread = std::make_unique<std::thread>([&]() {
     // Receive data
@@ -169,50 +336,12 @@ bool CommandServer::start(uint16_t serverPort, const char *serverAddr) {
 
             mConnectionThreads.emplace_back(std::make_unique<std::thread>(
                 [&](std::shared_ptr<Socket> client) {
-                  uint8_t commandMessage[8192];
+                  std::vector<uint8_t> buffer;
                   size_t bufferSize = 0;
                   while (mRunning) {
-                    size_t bytes = client->recv(
-                        (char *)(commandMessage + bufferSize), 16384);
-
-                    while (bytes > 0 && bytes < 16385) {
-                      Message message(commandMessage, bytes);
-                      if (mVerbose) {
-                        std::cout << "[+Server] Received message from "
-                                  << client->address() << ":" << client->port()
-                                  << std::endl;
-                      }
-                      if (!processIncomingMessage(message, client.get())) {
-                        std::cerr << __FILE__
-                                  << " : Server unable to process message("
-                                  << (int)commandMessage[0] << ") from client "
-                                  << client->address() << ":" << client->port()
-                                  << std::endl;
-                      } else {
-                        if (message.remainingBytes() > 0) {
-                          memcpy(commandMessage, message.data(),
-                                 message.remainingBytes());
-                          bufferSize = message.remainingBytes();
-                        } else {
-                          bufferSize = 0;
-                        }
-                      }
-                      bytes =
-                          client->recv((char *)(commandMessage + bufferSize),
-                                       16384 - bufferSize);
-                      if (bufferSize >= 16384 && bytes == 0) {
-                        std::cerr << "[+Server] ERROR: Network buffer overrun. "
-                                     "Flushing "
-                                     "buffers "
-                                  << bytes << std::endl;
-                        bufferSize = 0;
-                      }
-                    }
-                    if (bytes != SIZE_MAX && bytes != 0) {
-                      std::cerr
-                          << __FILE__
-                          << " : Unexpected command size. Flushing buffer."
-                          << bytes << std::endl;
+                    if (!receiveMessages(*client, buffer, bufferSize)) {
+                      client->close();
+                      break;
                     }
                   }
 
@@ -241,9 +370,76 @@ bool CommandServer::start(uint16_t serverPort, const char *serverAddr) {
   return true;
 }
 
+size_t CommandServer::acceptHandshake(std::shared_ptr<Socket> client,
+                                     uint8_t *data, size_t size) {
+  if (data[0] != HANDSHAKE) {
+    std::cerr << __FILE__ << ": Server unable to recognize message "
+              << (int)data[0] << std::endl;
+    mLoop->remove(client.get());
+    client->close();
+    return size;
+  }
+  if (size < 5) {
+    return 0;
+  }
+  uint16_t version = 0;
+  uint16_t revision = 0;
+  Convert::from_bytes(data + 1, version);
+  Convert::from_bytes(data + 3, revision);
+  if (mVerbose) {
+    std::cout << "[+Server] Handshake for " << client->address() << ":"
+              << client->port() << std::endl;
+    std::cout << "[+Server] Client reports protocol version " << version
+              << " revision " << revision << std::endl;
+  }
+
+  uint8_t ack[5];
+  ack[0] = HANDSHAKE_ACK;
+  memcpy(ack + 1, &mVersion, sizeof(uint16_t));
+  memcpy(ack + 1 + sizeof(uint16_t), &mRevision, sizeof(uint16_t));
+  if (!sendBytes(*client, ack, 5)) {
+    std::cerr << "[+Server] ERROR sending handshake ack" << std::endl;
+  }
+  {
+    std::unique_lock<std::mutex> lk(mConnectionsLock);
+    mServerConnections.emplace_back(client);
+    mConnectionVersions.emplace_back(
+        std::pair<uint16_t, uint16_t>{version, revision});
+  }
+  onConnection(client.get());
+  return 5;
+}
+
+void CommandServer::removeConnection(Socket *client) {
+  std::unique_lock<std::mutex> lk(mConnectionsLock);
+  for (size_t i = 0; i < mServerConnections.size(); i++) {
+    if (mServerConnections[i].get() == client) {
+      if (mVerbose) {
+        std::cout << "[+Server] Client disconnected " << client->address()
+                  << ":" << client->port() << std::endl;
+      }
+      mServerConnections.erase(mServerConnections.begin() + i);
+      mConnectionVersions.erase(mConnectionVersions.begin() + i);
+      return;
+    }
+  }
+}
+
 void CommandServer::stop() {
 
   mRunning = false;
+  if (mLoop) {
+    mLoop->remove(&mSocket);
+    std::vector<std::shared_ptr<Socket>> connections;
+    {
+      std::unique_lock<std::mutex> lk(mConnectionsLock);
+      connections = mServerConnections;
+    }
+    for (auto &connection : connections) {
+      mLoop->remove(connection.get());
+    }
+    stopLoop();
+  }
   mSocket.close();
   if (mBootstrapServerThread) {
     mBootstrapServerThread->join();
@@ -311,7 +507,7 @@ bool CommandServer::sendMessage(uint8_t *message, size_t length,
           std::cout << "Sending message to " << connection->address() << ":"
                     << connection->port() << std::endl;
         }
-        ret &= connection->send((const char *)message, length) == length;
+        ret &= sendCommand(*connection, message, length);
       }
     }
 
@@ -320,7 +516,7 @@ bool CommandServer::sendMessage(uint8_t *message, size_t length,
       std::cout << "Sending message to " << dst->address() << ":" << dst->port()
                 << std::endl;
     }
-    ret = dst->send((const char *)message, length) == length;
+    ret = sendCommand(*dst, message, length);
   }
   return ret;
 }
@@ -332,57 +528,72 @@ bool CommandClient::start(uint16_t serverPort, const char *serverAddr) {
     std::cerr << "[Client] Error opening bootstrap socket" << std::endl;
     return false;
   }
+  if (CommandLoop::available()) {
+    if (!mSocket.connect()) {
+      std::cerr << "[Client] Error connecting bootstrap socket" << std::endl;
+      return false;
+    }
+    // Handshake before the socket is made non-blocking
+    if (!handshake()) {
+      mSocket.close();
+      return false;
+    }
+    mState = CommandConnection::CLIENT;
+    mRunning = true;
+    onConnection(&mSocket);
+
+    if (!startLoop()) {
+      std::cerr << "[Client] ERROR starting event loop" << std::endl;
+      return false;
+    }
+    // mSocket is not owned by the loop
+    std::shared_ptr<Socket> socket(&mSocket, [](Socket *) {});
+    return mLoop->add(
+        socket,
+        [this](Socket &src, uint8_t *data, size_t size) {
+          mBusy.store(true);
+          size_t consumed = dispatchMessages(data, size, src);
+          mBusy.store(false);
+          return consumed;
+        },
+        [this](Socket & /*src*/) {
+          if (mVerbose) {
+            std::cout << "[Client] Connection closed by server" << std::endl;
+          }
+          mRunning = false;
+        });
+  }
+
+  // Receive on a thread where the event loop is not available
   std::condition_variable cv;
   std::mutex mutex;
+  bool started = false;
+  bool connected = false;
   std::unique_lock<std::mutex> lk(mutex);
   mConnectionThreads.push_back(std::make_unique<std::thread>([&]() {
     // For a client connection, mSocket is connected to a server socket on
     // the other end.
-
-    if (!mSocket.connect()) {
+    bool ok = mSocket.connect();
+    if (!ok) {
       std::cerr << "[Client] Error connecting bootstrap socket" << std::endl;
-      return;
+    } else {
+      ok = handshake();
     }
-
-    mState = CommandConnection::CLIENT;
-    mRunning = true;
-    unsigned char message[8] = {0, 0, 0, 0, 0, 0, 0, 0};
-    message[0] = HANDSHAKE;
-    //    auto b = Convert::to_bytes(mSocket.port());
-
-    memcpy(message + 1, &mVersion, sizeof(uint16_t));
-    memcpy(message + 1 + sizeof(uint16_t), &mRevision, sizeof(uint16_t));
-
-    // TODO provide functionality to validat connection versions
-    auto bytesSent = mSocket.send((const char *)message, 5);
-    if (bytesSent != 5) {
-      std::cerr << "[Client] ERROR sending handshake" << std::endl;
-    }
-    size_t bytesRecv = mSocket.recv((char *)message, 5);
-    if (bytesRecv == 5 && message[0] == HANDSHAKE_ACK) {
-      uint16_t version = 0;
-      uint16_t revision = 0;
-      if (bytesRecv >= 4) {
-        Convert::from_bytes((const uint8_t *)&message[1], version);
-        Convert::from_bytes((const uint8_t *)&message[3], revision);
-      }
-      if (mVerbose) {
-        std::cout << "[Client] Got handshake ack from " << mSocket.address()
-                  << ":" << mSocket.port() << std::endl;
-        std::cout << "[Client] Server reports protocol version " << version
-                  << " revision " << revision << std::endl;
-      }
+    if (ok) {
+      mState = CommandConnection::CLIENT;
       mRunning = true;
-    } else {
-      return;
+      onConnection(&mSocket);
     }
-
-    onConnection(&mSocket);
     {
       std::unique_lock<std::mutex> lk(mutex);
+      started = true;
+      connected = ok;
       cv.notify_one();
     }
-    uint8_t commandMessage[16384];
+    if (!ok) {
+      return;
+    }
+    std::vector<uint8_t> buffer;
     size_t bufferSize = 0;
     while (mRunning) {
       if (!mSocket.opened()) {
@@ -390,45 +601,11 @@ bool CommandClient::start(uint16_t serverPort, const char *serverAddr) {
         mRunning = false;
         continue;
       }
-
-      size_t bytes = mSocket.recv((char *)(commandMessage + bufferSize),
-                                  16384 - bufferSize);
-
-      if (bufferSize >= 16384 && bytes == 0) {
-        std::cerr << "[Client] ERROR: Network buffer overrun. Flushing buffers "
-                  << bytes << std::endl;
-        bufferSize = 0;
-      }
       mBusy.store(true); // FIXME This helps, but we should add timeout to recv,
                          // and mark as not busy when there is no incoming data
-      if (bytes > 0 && bytes < 16385) {
-        bufferSize += bytes;
-        if (commandMessage[0] == PING) {
-          clientHandlePing(mSocket);
-        } else {
-          Message message(commandMessage, bytes);
-          if (mVerbose) {
-            std::cout << "[Client] Received message from " << mSocket.address()
-                      << ":" << mSocket.port() << std::endl;
-          }
-          if (!processIncomingMessage(message, &mSocket)) {
-            std::cerr << __FILE__ << " : Client unable to process message("
-                      << (int)commandMessage[0] << ") from "
-                      << mSocket.address() << ":" << mSocket.port()
-                      << std::endl;
-
-          } else {
-            if (message.remainingBytes() > 0) {
-              memcpy(commandMessage, message.data(), message.remainingBytes());
-              bufferSize = message.remainingBytes();
-            } else {
-              bufferSize = 0;
-            }
-          }
-        }
-      } else if (bytes != SIZE_MAX && bytes != 0) {
-        std::cerr << "[Client] ERROR: Network buffer overrun. " << bytes
-                  << std::endl;
+      if (!receiveMessages(mSocket, buffer, bufferSize)) {
+        mSocket.close();
+        mRunning = false;
       }
       mBusy.store(false);
     }
@@ -438,7 +615,51 @@ bool CommandClient::start(uint16_t serverPort, const char *serverAddr) {
     }
   }));
 
-  cv.wait(lk);
+  cv.wait(lk, [&]() { return started; });
+  return connected;
+}
+
+bool CommandClient::handshake() {
+  uint8_t message[5];
+  message[0] = HANDSHAKE;
+  memcpy(message + 1, &mVersion, sizeof(uint16_t));
+  memcpy(message + 1 + sizeof(uint16_t), &mRevision, sizeof(uint16_t));
+  if (mSocket.send((const char *)message, 5) != 5) {
+    std::cerr << "[Client] ERROR sending handshake" << std::endl;
+    return false;
+  }
+  // Each receive waits at most until the deadline, so a server that does not
+  // answer makes start() fail instead of hang
+  const al_sec socketTimeout = mSocket.timeout();
+  const double deadline = al_steady_time() + kHandshakeTimeout;
+  size_t bytesRecv = 0;
+  while (bytesRecv < 5) {
+    const double remaining = deadline - al_steady_time();
+    if (remaining <= 0) {
+      break;
+    }
+    mSocket.timeout(remaining);
+    size_t bytes = mSocket.recv((char *)message + bytesRecv, 5 - bytesRecv);
+    if (bytes == 0 || bytes == SIZE_MAX) {
+      break;
+    }
+    bytesRecv += bytes;
+  }
+  mSocket.timeout(socketTimeout);
+  if (bytesRecv != 5 || message[0] != HANDSHAKE_ACK) {
+    std::cerr << "[Client] ERROR: no handshake ack from server" << std::endl;
+    return false;
+  }
+  if (mVerbose) {
+    uint16_t version = 0;
+    uint16_t revision = 0;
+    Convert::from_bytes(message + 1, version);
+    Convert::from_bytes(message + 3, revision);
+    std::cout << "[Client] Got handshake ack from " << mSocket.address() << ":"
+              << mSocket.port() << std::endl;
+    std::cout << "[Client] Server reports protocol version " << version
+              << " revision " << revision << std::endl;
+  }
   return true;
 }
 
@@ -446,15 +667,22 @@ void CommandClient::clientHandlePing(Socket &client) {
   if (mVerbose) {
     std::cout << "Client got ping request" << std::endl;
   }
-  char buffer[2] = {0, 0};
-  buffer[0] = PONG;
+  uint8_t buffer[1] = {PONG};
   //  std::cout << "sending pong" << std::endl;
-  int bytesSent = client.send((const char *)buffer, 2);
-  if (bytesSent != 2) {
+  if (!sendCommand(client, buffer, 1)) {
     std::cerr << "ERROR: sent bytes mismatch for pong" << std::endl;
   }
 }
 
+void CommandClient::stop() {
+  mRunning = false;
+  if (mLoop) {
+    mLoop->remove(&mSocket);
+    stopLoop();
+  }
+  CommandConnection::stop();
+}
+
 bool CommandClient::sendMessage(uint8_t *message, size_t length, Socket *dst,
                                 al::ValueSource *src) {
   bool ret = true;
@@ -469,7 +697,7 @@ bool CommandClient::sendMessage(uint8_t *message, size_t length, Socket *dst,
         std::cout << "Sending message to " << mSocket.address() << ":"
                   << mSocket.port() << std::endl;
       }
-      ret = mSocket.send((const char *)message, length) == length;
+      ret = sendCommand(mSocket, message, length);
     }
   } else {
     if (mSocket.address() != dst->address() || mSocket.port() != dst->port()) {
@@ -477,7 +705,13 @@ bool CommandClient::sendMessage(uint8_t *message, size_t length, Socket *dst,
         std::cout << "Sending message to " << dst->address() << ":"
                   << dst->port() << std::endl;
       }
-      ret = dst->send((const char *)message, length) == length;
+      // dst is not on the event loop
+      uint8_t localFrame[256];
+      std::vector<uint8_t> heapFrame;
+      const uint8_t *frame = frameCommand(message, length, localFrame,
+                                          sizeof(localFrame), heapFrame);
+      const size_t frameSize = kCommandHeaderSize + length;
+      ret = frame && dst->send((const char *)frame, frameSize) == frameSize;
     }
   }
   return ret;
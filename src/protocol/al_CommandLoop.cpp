@@ -0,0 +1,561 @@
+#include "al/protocol/al_CommandLoop.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifndef AL_WINDOWS
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef AL_LINUX
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+#endif
+
+using namespace al;
+
+struct CommandLoop::Connection {
+  std::shared_ptr<Socket> socket;
+  int fd{-1};
+  bool listening{false};
+  AcceptCallback onAccept;
+  DataCallback onData;
+  CloseCallback onClose;
+  std::atomic<bool> removed{false};
+
+  // Only touched by the loop
+  std::vector<uint8_t> input;
+  size_t inputSize{0};
+
+  std::mutex writeLock; // Guards the members below
+  std::vector<uint8_t> output;
+  size_t outputStart{0};
+  bool watchingWritable{false};
+  bool closed{false};
+};
+
+#ifdef AL_WINDOWS
+
+struct CommandLoop::PollState {};
+
+CommandLoop::CommandLoop(size_t maxBufferSize)
+    : mMaxBufferSize(maxBufferSize) {}
+CommandLoop::~CommandLoop() {}
+bool CommandLoop::available() { return false; }
+bool CommandLoop::listen(Socket & /*socket*/, AcceptCallback /*onAccept*/) {
+  std::cerr << "CommandLoop: not available on Windows" << std::endl;
+  return false;
+}
+bool CommandLoop::add(std::shared_ptr<Socket> /*socket*/,
+                      DataCallback /*onData*/, CloseCallback /*onClose*/) {
+  std::cerr << "CommandLoop: not available on Windows" << std::endl;
+  return false;
+}
+void CommandLoop::remove(Socket * /*socket*/) {}
+bool CommandLoop::send(Socket * /*socket*/, const void * /*data*/,
+                       size_t /*size*/) {
+  return false;
+}
+size_t CommandLoop::queuedBytes(Socket * /*socket*/) { return 0; }
+size_t CommandLoop::numConnections() { return 0; }
+bool CommandLoop::start() { return false; }
+void CommandLoop::stop() {}
+int CommandLoop::poll(double /*timeout*/) { return 0; }
+
+#else
+
+namespace {
+const size_t kInitialBufferSize = 4096;
+// Reads from one connection before moving on to the next ready one, so a
+// busy connection does not starve the others
+const int kMaxReadsPerWakeup = 4;
+
+#ifdef MSG_NOSIGNAL
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+bool wouldBlock() {
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+} // namespace
+
+#ifdef AL_LINUX
+struct CommandLoop::PollState {};
+#else
+struct CommandLoop::PollState {
+  std::vector<pollfd> fds; // wake pipe first, then one per connection
+  std::vector<std::shared_ptr<Connection>> connections;
+};
+#endif
+
+CommandLoop::CommandLoop(size_t maxBufferSize)
+    : mMaxBufferSize(std::max(maxBufferSize, kInitialBufferSize)),
+      mPollState(new PollState) {
+  if (pipe(mWakeFd) != 0) {
+    std::cerr << "CommandLoop: could not create wake up pipe" << std::endl;
+  } else {
+    fcntl(mWakeFd[0], F_SETFL, fcntl(mWakeFd[0], F_GETFL) | O_NONBLOCK);
+  }
+#ifdef AL_LINUX
+  mPollFd = epoll_create1(EPOLL_CLOEXEC);
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.ptr = nullptr; // wake pipe
+  epoll_ctl(mPollFd, EPOLL_CTL_ADD, mWakeFd[0], &event);
+#endif
+}
+
+CommandLoop::~CommandLoop() {
+  stop();
+  if (mPollFd >= 0) {
+    ::close(mPollFd);
+  }
+  for (int fd : mWakeFd) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+bool CommandLoop::available() { return true; }
+
+bool CommandLoop::listen(Socket &socket, AcceptCallback onAccept) {
+  auto connection = std::make_shared<Connection>();
+  // Not owned
+  connection->socket = std::shared_ptr<Socket>(&socket, [](Socket *) {});
+  connection->listening = true;
+  connection->onAccept = onAccept;
+  return addConnection(connection);
+}
+
+bool CommandLoop::add(std::shared_ptr<Socket> socket, DataCallback onData,
+                      CloseCallback onClose) {
+  auto connection = std::make_shared<Connection>();
+  connection->socket = socket;
+  connection->onData = onData;
+  connection->onClose = onClose;
+  return addConnection(connection);
+}
+
+bool CommandLoop::addConnection(std::shared_ptr<Connection> connection) {
+  connection->fd = int(connection->socket->handle());
+  if (connection->fd < 0) {
+    std::cerr << "CommandLoop: socket is not open" << std::endl;
+    return false;
+  }
+  fcntl(connection->fd, F_SETFL,
+        fcntl(connection->fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+  int noSigPipe = 1;
+  setsockopt(connection->fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe,
+             sizeof(noSigPipe));
+#endif
+
+  std::unique_lock<std::mutex> lk(mLock);
+  if (mConnections.find(connection->socket.get()) != mConnections.end()) {
+    std::cerr << "CommandLoop: socket already added" << std::endl;
+    return false;
+  }
+  mConnections[connection->socket.get()] = connection;
+#ifdef AL_LINUX
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.ptr = connection.get();
+  if (epoll_ctl(mPollFd, EPOLL_CTL_ADD, connection->fd, &event) != 0) {
+    std::cerr << "CommandLoop: could not watch socket: " << strerror(errno)
+              << std::endl;
+    mConnections.erase(connection->socket.get());
+    return false;
+  }
+#else
+  wake(); // Wait on the new socket too
+#endif
+  return true;
+}
+
+void CommandLoop::remove(Socket *socket) {
+  // Callbacks are not running once dispatch is held
+  std::unique_lock<std::mutex> dispatch(mDispatchLock, std::defer_lock);
+  if (mLoopThread.load() != std::this_thread::get_id()) {
+    dispatch.lock();
+  }
+  std::unique_lock<std::mutex> lk(mLock);
+  auto it = mConnections.find(socket);
+  if (it == mConnections.end()) {
+    return;
+  }
+  it->second->removed = true;
+#ifdef AL_LINUX
+  epoll_ctl(mPollFd, EPOLL_CTL_DEL, it->second->fd, nullptr);
+#else
+  wake();
+#endif
+  mRemoved.push_back(it->second);
+  mConnections.erase(it);
+}
+
+bool CommandLoop::send(Socket *socket, const void *data, size_t size) {
+  std::shared_ptr<Connection> connection;
+  {
+    std::unique_lock<std::mutex> lk(mLock);
+    auto it = mConnections.find(socket);
+    if (it == mConnections.end() || it->second->listening) {
+      return false;
+    }
+    connection = it->second;
+  }
+  std::unique_lock<std::mutex> lk(connection->writeLock);
+  if (connection->closed) {
+    return false;
+  }
+  const size_t queued = connection->output.size() - connection->outputStart;
+  if (queued + size > mMaxBufferSize) {
+    std::cerr << "CommandLoop: send queue full for " << socket->address()
+              << ":" << socket->port() << std::endl;
+    return false;
+  }
+  size_t written = 0;
+  if (queued == 0) {
+    ssize_t bytes = ::send(connection->fd, data, size, kSendFlags);
+    if (bytes < 0) {
+      if (!wouldBlock()) {
+        return false;
+      }
+      bytes = 0;
+    }
+    written = size_t(bytes);
+  }
+  if (written < size) {
+    const uint8_t *remaining = static_cast<const uint8_t *>(data) + written;
+    connection->output.insert(connection->output.end(), remaining,
+                              remaining + (size - written));
+    watchWritable(*connection, true);
+  }
+  lk.unlock();
+
+  std::unique_lock<std::mutex> statsLock(mStatsLock);
+  mStats.bytesSent += written;
+  if (written < size) {
+    mStats.sendsQueued++;
+  }
+  return true;
+}
+
+size_t CommandLoop::queuedBytes(Socket *socket) {
+  std::shared_ptr<Connection> connection;
+  {
+    std::unique_lock<std::mutex> lk(mLock);
+    auto it = mConnections.find(socket);
+    if (it == mConnections.end()) {
+      return 0;
+    }
+    connection = it->second;
+  }
+  std::unique_lock<std::mutex> lk(connection->writeLock);
+  return connection->output.size() - connection->outputStart;
+}
+
+size_t CommandLoop::numConnections() {
+  std::unique_lock<std::mutex> lk(mLock);
+  size_t count = 0;
+  for (auto &connection : mConnections) {
+    if (!connection.second->listening) {
+      count++;
+    }
+  }
+  return count;
+}
+
+bool CommandLoop::start() {
+  if (running()) {
+    return true;
+  }
+  mRunning = true;
+  mThread = std::thread(&CommandLoop::loop, this);
+  return true;
+}
+
+void CommandLoop::stop() {
+  if (!running()) {
+    return;
+  }
+  mRunning = false;
+  wake();
+  mThread.join();
+  mLoopThread = std::thread::id();
+}
+
+void CommandLoop::wake() {
+  char c = 0;
+  if (write(mWakeFd[1], &c, 1) != 1) {
+    std::cerr << "CommandLoop: could not wake loop thread" << std::endl;
+  }
+}
+
+void CommandLoop::loop() {
+  while (mRunning) {
+    poll(-1);
+  }
+}
+
+int CommandLoop::poll(double timeout) {
+  mLoopThread = std::this_thread::get_id();
+  {
+    // Events for these were handled by the previous poll()
+    std::unique_lock<std::mutex> lk(mLock);
+    mRemoved.clear();
+  }
+  int timeoutMs = timeout < 0 ? -1 : int(timeout * 1000.0);
+  int numReady = 0;
+#ifdef AL_LINUX
+  const int kMaxEvents = 64;
+  epoll_event events[kMaxEvents];
+  int numEvents = epoll_wait(mPollFd, events, kMaxEvents, timeoutMs);
+  std::unique_lock<std::mutex> dispatch(mDispatchLock);
+  for (int i = 0; i < numEvents; i++) {
+    auto *connection = static_cast<Connection *>(events[i].data.ptr);
+    if (!connection) {
+      char buffer[16];
+      while (read(mWakeFd[0], buffer, sizeof(buffer)) > 0) {
+      }
+      continue;
+    }
+    const uint32_t flags = events[i].events;
+    handleEvents(*connection, flags & EPOLLIN, flags & EPOLLOUT,
+                 flags & (EPOLLERR | EPOLLHUP));
+    numReady++;
+  }
+#else
+  auto &fds = mPollState->fds;
+  auto &polled = mPollState->connections;
+  fds.assign(1, pollfd{mWakeFd[0], POLLIN, 0});
+  {
+    std::unique_lock<std::mutex> lk(mLock);
+    polled.clear();
+    for (auto &connection : mConnections) {
+      std::unique_lock<std::mutex> writeLock(connection.second->writeLock);
+      short events = POLLIN;
+      if (connection.second->watchingWritable) {
+        events |= POLLOUT;
+      }
+      fds.push_back(pollfd{connection.second->fd, events, 0});
+      polled.push_back(connection.second);
+    }
+  }
+  int numEvents = ::poll(fds.data(), fds.size(), timeoutMs);
+  std::unique_lock<std::mutex> dispatch(mDispatchLock);
+  if (numEvents > 0) {
+    if (fds[0].revents & POLLIN) {
+      char buffer[16];
+      while (read(mWakeFd[0], buffer, sizeof(buffer)) > 0) {
+      }
+    }
+    for (size_t i = 1; i < fds.size(); i++) {
+      if (fds[i].revents) {
+        handleEvents(*polled[i - 1], fds[i].revents & POLLIN,
+                     fds[i].revents & POLLOUT,
+                     fds[i].revents & (POLLERR | POLLHUP | POLLNVAL));
+        numReady++;
+      }
+    }
+  }
+  polled.clear();
+#endif
+  if (numEvents > 0) {
+    std::unique_lock<std::mutex> lk(mStatsLock);
+    mStats.wakeups++;
+  }
+  return numReady;
+}
+
+void CommandLoop::handleEvents(Connection &connection, bool readable,
+                               bool writable, bool error) {
+  if (connection.removed) {
+    return; // Removed after the events were collected
+  }
+  if (connection.listening) {
+    acceptConnections(connection);
+    return;
+  }
+  if (writable) {
+    writeQueued(connection);
+  }
+  if (readable || error) {
+    // Errors and hang ups are detected by recv()
+    readConnection(connection);
+  }
+}
+
+void CommandLoop::acceptConnections(Connection &connection) {
+  uint64_t accepted = 0;
+  while (true) {
+    auto socket = std::make_shared<Socket>();
+    if (!connection.socket->accept(*socket)) {
+      break;
+    }
+    accepted++;
+    connection.onAccept(socket);
+  }
+  std::unique_lock<std::mutex> lk(mStatsLock);
+  mStats.accepted += accepted;
+}
+
+void CommandLoop::readConnection(Connection &connection) {
+  bool closing = false;
+  bool overrun = false;
+  size_t received = 0;
+  size_t unconsumed = 0; // Bytes received since onData() was last called
+  for (int i = 0; i < kMaxReadsPerWakeup; i++) {
+    auto &input = connection.input;
+    if (input.size() - connection.inputSize < kInitialBufferSize) {
+      if (input.size() < mMaxBufferSize) {
+        input.resize(std::min(std::max(input.size() * 2, kInitialBufferSize),
+                              mMaxBufferSize));
+      } else if (unconsumed > 0) {
+        // Let the handler take complete commands before reading more
+        consumeInput(connection);
+        unconsumed = 0;
+        if (connection.removed) {
+          break;
+        }
+      }
+      if (connection.inputSize == input.size()) {
+        // Dropping bytes would split a command, so the stream can't be
+        // framed anymore
+        std::cerr << "CommandLoop: input buffer overrun from "
+                  << connection.socket->address() << ". Closing connection."
+                  << std::endl;
+        closing = overrun = true;
+        break;
+      }
+    }
+    ssize_t bytes = ::recv(connection.fd, input.data() + connection.inputSize,
+                           input.size() - connection.inputSize, 0);
+    if (bytes > 0) {
+      connection.inputSize += size_t(bytes);
+      received += size_t(bytes);
+      unconsumed += size_t(bytes);
+      continue;
+    }
+    closing = bytes == 0 || !wouldBlock();
+    break;
+  }
+
+  if (received > 0) {
+    std::unique_lock<std::mutex> lk(mStatsLock);
+    mStats.bytesReceived += received;
+  }
+  if (unconsumed > 0 && !overrun && !connection.removed) {
+    consumeInput(connection);
+  }
+  if (closing && !connection.removed) {
+    closeConnection(connection);
+  }
+}
+
+void CommandLoop::consumeInput(Connection &connection) {
+  size_t consumed = connection.onData(
+      *connection.socket, connection.input.data(), connection.inputSize);
+  consumed = std::min(consumed, connection.inputSize);
+  if (consumed > 0) {
+    memmove(connection.input.data(), connection.input.data() + consumed,
+            connection.inputSize - consumed);
+    connection.inputSize -= consumed;
+  }
+}
+
+void CommandLoop::writeQueued(Connection &connection) {
+  std::unique_lock<std::mutex> lk(connection.writeLock);
+  auto &output = connection.output;
+  size_t written = 0;
+  bool failed = false;
+  while (connection.outputStart < output.size()) {
+    ssize_t bytes =
+        ::send(connection.fd, output.data() + connection.outputStart,
+               output.size() - connection.outputStart, kSendFlags);
+    if (bytes < 0) {
+      failed = !wouldBlock();
+      break;
+    }
+    connection.outputStart += size_t(bytes);
+    written += size_t(bytes);
+  }
+  if (connection.outputStart == output.size()) {
+    output.clear();
+    connection.outputStart = 0;
+    watchWritable(connection, false);
+  } else if (connection.outputStart > output.size() / 2) {
+    output.erase(output.begin(), output.begin() + connection.outputStart);
+    connection.outputStart = 0;
+  }
+  lk.unlock();
+
+  {
+    std::unique_lock<std::mutex> statsLock(mStatsLock);
+    mStats.bytesSent += written;
+  }
+  if (failed) {
+    closeConnection(connection);
+  }
+}
+
+void CommandLoop::watchWritable(Connection &connection, bool watch) {
+  // Called with connection.writeLock held
+  if (connection.watchingWritable == watch) {
+    return;
+  }
+  connection.watchingWritable = watch;
+#ifdef AL_LINUX
+  epoll_event event{};
+  event.events = watch ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  event.data.ptr = &connection;
+  epoll_ctl(mPollFd, EPOLL_CTL_MOD, connection.fd, &event);
+#else
+  if (watch) {
+    wake();
+  }
+#endif
+}
+
+void CommandLoop::closeConnection(Connection &connection) {
+  {
+    std::unique_lock<std::mutex> lk(connection.writeLock);
+    if (connection.closed) {
+      return;
+    }
+    connection.closed = true;
+  }
+  {
+    std::unique_lock<std::mutex> lk(mLock);
+    auto it = mConnections.find(connection.socket.get());
+    if (it != mConnections.end()) {
+      connection.removed = true;
+#ifdef AL_LINUX
+      epoll_ctl(mPollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+#endif
+      mRemoved.push_back(it->second);
+      mConnections.erase(it);
+    }
+  }
+  connection.socket->close();
+  {
+    std::unique_lock<std::mutex> lk(mStatsLock);
+    mStats.closed++;
+  }
+  if (connection.onClose) {
+    connection.onClose(*connection.socket);
+  }
+}
+
+#endif
+
+CommandLoop::Stats CommandLoop::stats() const {
+  std::unique_lock<std::mutex> lk(mStatsLock);
+  return mStats;
+}
@@ -5,6 +5,7 @@
 #include <stdio.h> // printf
 #include <string.h>
 
+#include <algorithm>
 #include <iostream>
 
 #include "al/system/al_Printing.hpp"
@@ -198,9 +199,11 @@ Message::Message(const char *message, int size, const TimeTag &timeTag,
          resetStream();)
   if (senderAddr != nullptr) {
     strncpy(mSenderAddr, senderAddr, 32);
+    mSenderAddr[31] = '\0';
   } else {
     mSenderAddr[0] = '\0';
   }
+  mSenderPort = senderPort;
 }
 
 Message::~Message() { OSCTRY("~Message()", delete mImpl;) }
@@ -292,6 +295,471 @@ Message &Message::operator>>(Blob &v) {
   return *this;
 }
 
+namespace {
+
+uint32_t readUInt32(const char *p) {
+  const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+  return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) |
+         (uint32_t(u[2]) << 8) | uint32_t(u[3]);
+}
+
+uint64_t readUInt64(const char *p) {
+  return (uint64_t(readUInt32(p)) << 32) | readUInt32(p + 4);
+}
+
+void writeUInt32(char *p, uint32_t v) {
+  p[0] = char(v >> 24);
+  p[1] = char(v >> 16);
+  p[2] = char(v >> 8);
+  p[3] = char(v);
+}
+
+void writeUInt64(char *p, uint64_t v) {
+  writeUInt32(p, uint32_t(v >> 32));
+  writeUInt32(p + 4, uint32_t(v));
+}
+
+size_t padded(size_t n) { return (n + 3) & ~size_t(3); }
+
+// Size of the padded OSC-string at p, 0 if it does not end before end
+size_t stringSize(const char *p, const char *end) {
+  const char *s = p;
+  while (s < end && *s) {
+    ++s;
+  }
+  if (s == end) {
+    return 0;
+  }
+  size_t n = padded(s - p + 1);
+  return n <= size_t(end - p) ? n : 0;
+}
+
+} // namespace
+
+bool detail::bundleHeader(const char *data, size_t size, TimeTag &timeTag) {
+  if (size < 16 || (size & 3) || memcmp(data, "#bundle", 8) != 0) {
+    return false;
+  }
+  timeTag = readUInt64(data + 8);
+  return true;
+}
+
+bool detail::bundleElement(const char *&data, const char *end,
+                           const char *&element, size_t &elementSize) {
+  if (end - data < 4) {
+    return false;
+  }
+  elementSize = readUInt32(data);
+  element = data + 4;
+  if ((elementSize & 3) || elementSize > size_t(end - element)) {
+    return false;
+  }
+  data = element + elementSize;
+  return true;
+}
+
+// MessageView -----------------------------------------------------------------
+
+bool MessageView::parse(const char *message, size_t size,
+                        const TimeTag &timeTag) {
+  *this = MessageView();
+  if (size < 4 || (size & 3) || message[0] == '#') {
+    return false;
+  }
+  const char *end = message + size;
+  size_t addressSize = stringSize(message, end);
+  if (addressSize == 0) {
+    return false;
+  }
+  const char *typeTags = message + addressSize;
+  const char *arguments = typeTags;
+  const char *tags = "";
+  if (typeTags < end && *typeTags == ',') {
+    // Messages without type tags are read as having no arguments
+    size_t tagsSize = stringSize(typeTags, end);
+    if (tagsSize == 0) {
+      return false;
+    }
+    tags = typeTags + 1;
+    arguments = typeTags + tagsSize;
+  }
+
+  // Check that all arguments are in range, so extraction does not have to
+  const char *arg = arguments;
+  size_t count = 0;
+  for (; tags[count]; ++count) {
+    size_t argSize = 0;
+    switch (tags[count]) {
+    case 'i':
+    case 'f':
+    case 'c':
+    case 'r':
+    case 'm':
+      argSize = 4;
+      break;
+    case 'h':
+    case 'd':
+    case 't':
+      argSize = 8;
+      break;
+    case 's':
+    case 'S':
+      argSize = stringSize(arg, end);
+      if (argSize == 0) {
+        return false;
+      }
+      break;
+    case 'b':
+      if (end - arg < 4) {
+        return false;
+      }
+      argSize = 4 + padded(readUInt32(arg));
+      break;
+    case 'T':
+    case 'F':
+    case 'N':
+    case 'I':
+    case '[':
+    case ']':
+      break;
+    default:
+      return false;
+    }
+    if (argSize > size_t(end - arg)) {
+      return false;
+    }
+    arg += argSize;
+  }
+
+  mData = message;
+  mSize = size;
+  mAddress = message;
+  mAddressSize = strlen(message);
+  mTypeTags = tags;
+  mArgumentCount = count;
+  mArguments = arguments;
+  mTimeTag = timeTag;
+  resetStream();
+  return true;
+}
+
+bool MessageView::addressIs(const char *address) const {
+  return strcmp(mAddress, address) == 0;
+}
+
+MessageView &MessageView::resetStream() {
+  mArgument = 0;
+  mNext = mArguments;
+  mGood = true;
+  return *this;
+}
+
+MessageView &MessageView::operator>>(int &v) {
+  if (nextType() == 'i') {
+    v = int32_t(readUInt32(mNext));
+    mNext += 4;
+    mArgument++;
+  } else {
+    mGood = false;
+  }
+  return *this;
+}
+
+MessageView &MessageView::operator>>(int64_t &v) {
+  if (nextType() == 'h') {
+    v = int64_t(readUInt64(mNext));
+    mNext += 8;
+    mArgument++;
+  } else {
+    mGood = false;
+  }
+  return *this;
+}
+
+MessageView &MessageView::operator>>(float &v) {
+  if (nextType() == 'f') {
+    uint32_t bits = readUInt32(mNext);
+    memcpy(&v, &bits, 4);
+    mNext += 4;
+    mArgument++;
+  } else {
+    mGood = false;
+  }
+  return *this;
+}
+
+MessageView &MessageView::operator>>(double &v) {
+  if (nextType() == 'd') {
+    uint64_t bits = readUInt64(mNext);
+    memcpy(&v, &bits, 8);
+    mNext += 8;
+    mArgument++;
+  } else {
+    mGood = false;
+  }
+  return *this;
+}
+
+MessageView &MessageView::operator>>(char &v) {
+  if (nextType() == 'c') {
+    v = char(readUInt32(mNext));
+    mNext += 4;
+    mArgument++;
+  } else {
+    mGood = false;
+  }
+  return *this;
+}
+
+MessageView &MessageView::operator>>(const char *&v) {
+  char t = nextType();
+  if (t == 's' || t == 'S') {
+    v = mNext;
+    mNext += padded(strlen(mNext) + 1);
+    mArgument++;
+  } else {
+    mGood = false;
+  }
+  return *this;
+}
+
+MessageView &MessageView::operator>>(std::string &v) {
+  const char *s = nullptr;
+  *this >> s;
+  if (s) {
+    v = s;
+  }
+  return *this;
+}
+
+MessageView &MessageView::operator>>(Blob &v) {
+  if (nextType() == 'b') {
+    v.size = readUInt32(mNext);
+    v.data = mNext + 4;
+    mNext += 4 + padded(v.size);
+    mArgument++;
+  } else {
+    mGood = false;
+  }
+  return *this;
+}
+
+// PacketWriter ----------------------------------------------------------------
+
+PacketWriter &PacketWriter::buffer(char *buffer, size_t capacity) {
+  mBuffer = buffer;
+  mCapacity = capacity;
+  return clear();
+}
+
+PacketWriter &PacketWriter::clear() {
+  mSize = 0;
+  mOverflow = false;
+  mBundleDepth = 0;
+  mInMessage = false;
+  mNumTypeTags = 0;
+  return *this;
+}
+
+char *PacketWriter::reserve(size_t n) {
+  if (mOverflow || mSize + n + mNumTypeTags > mCapacity) {
+    mOverflow = true;
+    return nullptr;
+  }
+  char *p = mBuffer + mSize;
+  mSize += n;
+  return p;
+}
+
+char *PacketWriter::reserveArgument(char t, size_t n) {
+  if (!mInMessage) {
+    mOverflow = true;
+    return nullptr;
+  }
+  // One more byte for the type tag
+  if (mOverflow || mSize + n + mNumTypeTags + 1 > mCapacity) {
+    mOverflow = true;
+    return nullptr;
+  }
+  mNumTypeTags++;
+  mBuffer[mCapacity - mNumTypeTags] = t;
+  char *p = mBuffer + mSize;
+  mSize += n;
+  return p;
+}
+
+PacketWriter &PacketWriter::beginBundle(TimeTag timeTag) {
+  if (mBundleDepth == kMaxBundleDepth) {
+    mOverflow = true;
+    return *this;
+  }
+  size_t sizePosition = 0;
+  if (mBundleDepth > 0 && reserve(4)) {
+    sizePosition = mSize - 4;
+  }
+  mBundleSizes[mBundleDepth++] = sizePosition;
+  if (char *p = reserve(16)) {
+    memcpy(p, "#bundle", 8);
+    writeUInt64(p + 8, timeTag);
+  }
+  return *this;
+}
+
+PacketWriter &PacketWriter::endBundle() {
+  if (mBundleDepth == 0) {
+    return *this;
+  }
+  size_t sizePosition = mBundleSizes[--mBundleDepth];
+  if (mBundleDepth > 0 && !mOverflow) {
+    writeUInt32(mBuffer + sizePosition, uint32_t(mSize - sizePosition - 4));
+  }
+  return *this;
+}
+
+PacketWriter &PacketWriter::addPacket(const char *data, size_t size) {
+  if (mInMessage || (size & 3)) {
+    mOverflow = true;
+    return *this;
+  }
+  if (mBundleDepth > 0) {
+    if (char *p = reserve(4)) {
+      writeUInt32(p, uint32_t(size));
+    }
+  }
+  if (char *p = reserve(size)) {
+    memcpy(p, data, size);
+  }
+  return *this;
+}
+
+PacketWriter &PacketWriter::beginMessage(const char *addressPattern) {
+  mInMessage = true;
+  mNumTypeTags = 0;
+  mMessageSize = 0;
+  if (mBundleDepth > 0 && reserve(4)) {
+    mMessageSize = mSize - 4;
+  }
+  size_t length = strlen(addressPattern);
+  size_t n = padded(length + 1);
+  if (char *p = reserve(n)) {
+    memcpy(p, addressPattern, length);
+    memset(p + length, 0, n - length);
+  }
+  mTypeTagsStart = mSize;
+  return *this;
+}
+
+PacketWriter &PacketWriter::endMessage() {
+  if (!mInMessage) {
+    return *this;
+  }
+  mInMessage = false;
+  // Comma, tags and terminator, padded
+  size_t tagsSize = padded(mNumTypeTags + 2);
+  if (!mOverflow && mSize + tagsSize > mCapacity) {
+    mOverflow = true;
+  }
+  if (!mOverflow) {
+    char *tags = mBuffer + mTypeTagsStart;
+    const size_t argumentsSize = mSize - mTypeTagsStart;
+    const size_t n = mNumTypeTags;
+    if (mSize + tagsSize + n <= mCapacity) {
+      // Moving the arguments does not reach the collected tags
+      memmove(tags + tagsSize, tags, argumentsSize);
+      for (size_t i = 0; i < n; i++) {
+        tags[i + 1] = mBuffer[mCapacity - 1 - i];
+      }
+    } else {
+      // Nearly full buffer. Bring the tags next to the arguments and rotate
+      // them in front, then make room for the comma and padding.
+      std::reverse(mBuffer + mCapacity - n, mBuffer + mCapacity);
+      memmove(mBuffer + mSize, mBuffer + mCapacity - n, n);
+      std::rotate(tags, tags + argumentsSize, tags + argumentsSize + n);
+      memmove(tags + tagsSize, tags + n, argumentsSize);
+      memmove(tags + 1, tags, n);
+    }
+    tags[0] = ',';
+    memset(tags + n + 1, 0, tagsSize - n - 1);
+    mSize += tagsSize;
+    if (mBundleDepth > 0) {
+      writeUInt32(mBuffer + mMessageSize, uint32_t(mSize - mMessageSize - 4));
+    }
+  }
+  mNumTypeTags = 0;
+  return *this;
+}
+
+PacketWriter &PacketWriter::operator<<(int v) {
+  if (char *p = reserveArgument('i', 4)) {
+    writeUInt32(p, uint32_t(v));
+  }
+  return *this;
+}
+
+PacketWriter &PacketWriter::operator<<(unsigned v) {
+  return (*this) << int(v);
+}
+
+PacketWriter &PacketWriter::operator<<(int64_t v) {
+  if (char *p = reserveArgument('h', 8)) {
+    writeUInt64(p, uint64_t(v));
+  }
+  return *this;
+}
+
+PacketWriter &PacketWriter::operator<<(uint64_t v) {
+  return (*this) << int64_t(v);
+}
+
+PacketWriter &PacketWriter::operator<<(float v) {
+  if (char *p = reserveArgument('f', 4)) {
+    uint32_t bits;
+    memcpy(&bits, &v, 4);
+    writeUInt32(p, bits);
+  }
+  return *this;
+}
+
+PacketWriter &PacketWriter::operator<<(double v) {
+  if (char *p = reserveArgument('d', 8)) {
+    uint64_t bits;
+    memcpy(&bits, &v, 8);
+    writeUInt64(p, bits);
+  }
+  return *this;
+}
+
+PacketWriter &PacketWriter::operator<<(char v) {
+  if (char *p = reserveArgument('c', 4)) {
+    writeUInt32(p, uint32_t(int32_t(v)));
+  }
+  return *this;
+}
+
+PacketWriter &PacketWriter::operator<<(const char *v) {
+  size_t length = strlen(v);
+  size_t n = padded(length + 1);
+  if (char *p = reserveArgument('s', n)) {
+    memcpy(p, v, length);
+    memset(p + length, 0, n - length);
+  }
+  return *this;
+}
+
+PacketWriter &PacketWriter::operator<<(const std::string &v) {
+  return (*this) << v.c_str();
+}
+
+PacketWriter &PacketWriter::operator<<(const Blob &v) {
+  size_t n = padded(v.size);
+  if (char *p = reserveArgument('b', 4 + n)) {
+    writeUInt32(p, uint32_t(v.size));
+    memcpy(p + 4, v.data, v.size);
+    memset(p + 4 + v.size, 0, n - v.size);
+  }
+  return *this;
+}
+
 class Send::SocketSender {
 public:
   UdpTransmitSocket transmitSocket;
@@ -340,6 +808,12 @@ size_t Send::send(const Packet &p) {
   return r;
 }
 
+size_t Send::sendRaw(const char *data, size_t size) {
+  size_t r = 0;
+  OSCTRY("Send::send", r = socketSender->send(data, size);)
+  return r;
+}
+
 static void *recvThreadFunc(void *user) {
   Recv *r = static_cast<Recv *>(user);
   r->loop();
@@ -428,13 +902,47 @@ void Recv::stop() {
 
 void Recv::parse(const char *packet, int size, const char *senderAddr,
                  uint16_t senderPort) {
+  if (size_t(size) > mBuffer.size()) {
+    mBuffer.resize(size);
+  }
   std::memcpy(&mBuffer[0], packet, size);
-  auto messages = parse(&mBuffer[0], size, 1, senderAddr, senderPort);
-  for (auto *handler : mHandlers) {
-    for (auto m : messages) {
-      handler->onMessage(*m);
+  dispatch(&mBuffer[0], size, senderAddr, senderPort);
+}
+
+void Recv::dispatch(const char *packet, size_t size, const char *senderAddr,
+                    uint16_t senderPort) {
+  detail::dispatchPacket(mHandlers.data(), mHandlers.size(), packet, size,
+                         senderAddr, senderPort);
+}
+
+bool detail::dispatchPacket(PacketHandler *const *handlers,
+                            size_t numHandlers, const char *packet,
+                            size_t size, const char *senderAddr,
+                            uint16_t senderPort) {
+  bool valid = Recv::forEachMessage(packet, size, [&](MessageView &view) {
+    view.sender(senderAddr, senderPort);
+    // Only built for handlers that do not take the view
+    std::unique_ptr<Message> message;
+    for (size_t i = 0; i < numHandlers; i++) {
+      view.resetStream();
+      if (handlers[i]->onMessageView(view)) {
+        continue;
+      }
+      if (!message) {
+        message = std::make_unique<Message>(view.data(), int(view.size()),
+                                            view.timeTag(), senderAddr,
+                                            senderPort);
+      } else {
+        message->resetStream();
+      }
+      handlers[i]->onMessage(*message);
     }
+  });
+  if (!valid) {
+    AL_WARN("OSC error: malformed packet from %s:%i",
+            senderAddr ? senderAddr : "", senderPort);
   }
+  return valid;
 }
 
 void Recv::loop() { socketReceiver->loop(); }
@@ -0,0 +1,334 @@
+#include "al/protocol/al_OSCRecvGroup.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#ifndef AL_WINDOWS
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef AL_LINUX
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+#endif
+
+using namespace al;
+using namespace al::osc;
+
+struct RecvGroup::Port {
+  int fd{-1};
+  uint16_t port{0};
+  std::vector<PacketHandler *> handlers;
+};
+
+#ifdef AL_WINDOWS
+
+struct RecvGroup::Batch {};
+
+RecvGroup::RecvGroup(unsigned int batchSize, unsigned int maxPacketSize)
+    : mBatchSize(batchSize), mMaxPacketSize(maxPacketSize) {}
+
+RecvGroup::~RecvGroup() {}
+
+bool RecvGroup::open(uint16_t port, PacketHandler & /*handler*/,
+                     const char * /*address*/) {
+  std::cerr << "RecvGroup: not available on Windows. Use osc::Recv for port "
+            << port << std::endl;
+  return false;
+}
+
+void RecvGroup::close() {}
+bool RecvGroup::start() { return false; }
+void RecvGroup::stop() {}
+int RecvGroup::poll(double /*timeout*/) { return 0; }
+void RecvGroup::receiveLoop() {}
+int RecvGroup::receive(Port & /*port*/) { return 0; }
+
+#else
+
+namespace {
+// Batches read from one socket before moving on to the next ready one, so a
+// flooded port does not starve the others
+const int kMaxBatchesPerWakeup = 4;
+} // namespace
+
+#ifdef AL_LINUX
+struct RecvGroup::Batch {
+  std::vector<mmsghdr> messages;
+  std::vector<iovec> iovecs;
+  std::vector<sockaddr_in> addresses;
+};
+#else
+struct RecvGroup::Batch {
+  std::vector<pollfd> fds; // wake pipe first, then one per port
+  sockaddr_in address;
+};
+#endif
+
+RecvGroup::RecvGroup(unsigned int batchSize, unsigned int maxPacketSize)
+    : mBatchSize(batchSize > 0 ? batchSize : 1),
+      mMaxPacketSize(maxPacketSize), mBatch(new Batch) {
+  mArena.resize(size_t(mBatchSize) * mMaxPacketSize);
+  if (pipe(mWakeFd) != 0) {
+    std::cerr << "RecvGroup: could not create wake up pipe" << std::endl;
+  } else {
+    fcntl(mWakeFd[0], F_SETFL, fcntl(mWakeFd[0], F_GETFL) | O_NONBLOCK);
+  }
+#ifdef AL_LINUX
+  mBatch->messages.resize(mBatchSize);
+  mBatch->iovecs.resize(mBatchSize);
+  mBatch->addresses.resize(mBatchSize);
+  for (unsigned int i = 0; i < mBatchSize; i++) {
+    mBatch->iovecs[i].iov_base = &mArena[size_t(i) * mMaxPacketSize];
+    mBatch->iovecs[i].iov_len = mMaxPacketSize;
+    msghdr &header = mBatch->messages[i].msg_hdr;
+    memset(&header, 0, sizeof(header));
+    header.msg_name = &mBatch->addresses[i];
+    header.msg_iov = &mBatch->iovecs[i];
+    header.msg_iovlen = 1;
+  }
+  mPollFd = epoll_create1(EPOLL_CLOEXEC);
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.ptr = nullptr; // wake pipe
+  epoll_ctl(mPollFd, EPOLL_CTL_ADD, mWakeFd[0], &event);
+#else
+  mBatch->fds.push_back(pollfd{mWakeFd[0], POLLIN, 0});
+#endif
+}
+
+RecvGroup::~RecvGroup() {
+  close();
+  if (mPollFd >= 0) {
+    ::close(mPollFd);
+  }
+  for (int fd : mWakeFd) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+bool RecvGroup::open(uint16_t port, PacketHandler &handler,
+                     const char *address) {
+  if (running()) {
+    std::cerr << "RecvGroup: stop before opening port " << port << std::endl;
+    return false;
+  }
+  for (auto &p : mPorts) {
+    if (p->port == port) {
+      p->handlers.push_back(&handler);
+      return true;
+    }
+  }
+
+  sockaddr_in bindAddress{};
+  bindAddress.sin_family = AF_INET;
+  bindAddress.sin_port = htons(port);
+  if (*address == '\0') {
+    bindAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+  } else {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *result = nullptr;
+    if (getaddrinfo(address, nullptr, &hints, &result) != 0 || !result) {
+      std::cerr << "RecvGroup: could not resolve " << address << std::endl;
+      return false;
+    }
+    bindAddress.sin_addr =
+        reinterpret_cast<sockaddr_in *>(result->ai_addr)->sin_addr;
+    freeaddrinfo(result);
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&bindAddress),
+                     sizeof(bindAddress)) != 0) {
+    std::cerr << "RecvGroup: could not open " << address << ":" << port
+              << std::endl;
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  std::unique_ptr<Port> newPort(new Port);
+  newPort->fd = fd;
+  newPort->port = port;
+  newPort->handlers.push_back(&handler);
+#ifdef AL_LINUX
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.ptr = newPort.get();
+  epoll_ctl(mPollFd, EPOLL_CTL_ADD, fd, &event);
+#else
+  mBatch->fds.push_back(pollfd{fd, POLLIN, 0});
+#endif
+  mPorts.push_back(std::move(newPort));
+  return true;
+}
+
+void RecvGroup::close() {
+  stop();
+  for (auto &port : mPorts) {
+    // Closing also removes the socket from the epoll set
+    ::close(port->fd);
+  }
+  mPorts.clear();
+#ifndef AL_LINUX
+  mBatch->fds.resize(1);
+#endif
+}
+
+bool RecvGroup::start() {
+  if (running()) {
+    return true;
+  }
+  mRunning = true;
+  mThread = std::thread(&RecvGroup::receiveLoop, this);
+  return true;
+}
+
+void RecvGroup::stop() {
+  if (!running()) {
+    return;
+  }
+  mRunning = false;
+  char c = 0;
+  if (write(mWakeFd[1], &c, 1) != 1) {
+    std::cerr << "RecvGroup: could not wake receiving thread" << std::endl;
+  }
+  mThread.join();
+}
+
+void RecvGroup::receiveLoop() {
+  while (mRunning) {
+    poll(-1);
+  }
+}
+
+int RecvGroup::poll(double timeout) {
+  int timeoutMs = timeout < 0 ? -1 : int(timeout * 1000.0);
+  int numPackets = 0;
+#ifdef AL_LINUX
+  const int kMaxEvents = 32;
+  epoll_event events[kMaxEvents];
+  int numEvents = epoll_wait(mPollFd, events, kMaxEvents, timeoutMs);
+  for (int i = 0; i < numEvents; i++) {
+    if (events[i].data.ptr) {
+      numPackets += receive(*static_cast<Port *>(events[i].data.ptr));
+    } else {
+      char buffer[16];
+      while (read(mWakeFd[0], buffer, sizeof(buffer)) > 0) {
+      }
+    }
+  }
+#else
+  auto &fds = mBatch->fds;
+  int numEvents = ::poll(fds.data(), fds.size(), timeoutMs);
+  if (numEvents > 0) {
+    if (fds[0].revents & POLLIN) {
+      char buffer[16];
+      while (read(mWakeFd[0], buffer, sizeof(buffer)) > 0) {
+      }
+    }
+    for (size_t i = 1; i < fds.size(); i++) {
+      if (fds[i].revents & POLLIN) {
+        numPackets += receive(*mPorts[i - 1]);
+      }
+    }
+  }
+#endif
+  if (numEvents > 0) {
+    std::unique_lock<std::mutex> lk(mStatsLock);
+    mStats.wakeups++;
+  }
+  return numPackets;
+}
+
+int RecvGroup::receive(Port &port) {
+  uint64_t bytes = 0;
+  uint64_t malformed = 0;
+  uint64_t calls = 0;
+  int numPackets = 0;
+  char senderAddr[INET_ADDRSTRLEN];
+
+  auto handle = [&](const char *data, size_t size, const sockaddr_in &from) {
+    inet_ntop(AF_INET, &from.sin_addr, senderAddr, sizeof(senderAddr));
+    if (!detail::dispatchPacket(port.handlers.data(), port.handlers.size(),
+                                data, size, senderAddr,
+                                ntohs(from.sin_port))) {
+      malformed++;
+    }
+    bytes += size;
+  };
+
+  for (int batch = 0; batch < kMaxBatchesPerWakeup; batch++) {
+#ifdef AL_LINUX
+    for (unsigned int i = 0; i < mBatchSize; i++) {
+      mBatch->messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+    int n = recvmmsg(port.fd, mBatch->messages.data(), mBatchSize,
+                     MSG_DONTWAIT, nullptr);
+    calls++;
+    if (n <= 0) {
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      const mmsghdr &message = mBatch->messages[i];
+      if (message.msg_hdr.msg_flags & MSG_TRUNC) {
+        malformed++;
+        continue;
+      }
+      handle(&mArena[size_t(i) * mMaxPacketSize], message.msg_len,
+             mBatch->addresses[i]);
+    }
+    numPackets += n;
+    if (unsigned(n) < mBatchSize) {
+      break;
+    }
+#else
+    unsigned int n = 0;
+    for (; n < mBatchSize; n++) {
+      socklen_t addressSize = sizeof(sockaddr_in);
+      ssize_t size = recvfrom(
+          port.fd, mArena.data(), mMaxPacketSize, MSG_DONTWAIT,
+          reinterpret_cast<sockaddr *>(&mBatch->address), &addressSize);
+      calls++;
+      if (size < 0) {
+        break;
+      }
+      if (size_t(size) == mMaxPacketSize) {
+        // Possibly truncated
+        malformed++;
+        continue;
+      }
+      handle(mArena.data(), size_t(size), mBatch->address);
+    }
+    numPackets += int(n);
+    if (n < mBatchSize) {
+      break;
+    }
+#endif
+  }
+
+  std::unique_lock<std::mutex> lk(mStatsLock);
+  mStats.packets += numPackets;
+  mStats.bytes += bytes;
+  mStats.malformed += malformed;
+  mStats.receiveCalls += calls;
+  return numPackets;
+}
+
+#endif
+
+RecvGroup::Stats RecvGroup::stats() const {
+  std::unique_lock<std::mutex> lk(mStatsLock);
+  return mStats;
+}
@@ -1,72 +1,50 @@
 #include "al/scene/al_DynamicScene.hpp"
 
 #include "al/graphics/al_Shapes.hpp"
+#include "al/math/al_Frustum.hpp"
 #include "al/scene/al_PositionedVoice.hpp"
 
 #include <algorithm>
+#include <cstring>
 
 using namespace std;
 using namespace al;
 
-ThreadPool::ThreadPool(unsigned int n) : busy() {
-  for (unsigned int i = 0; i < n; ++i) {
-    workers.emplace_back(std::bind(&ThreadPool::thread_proc, this));
-  }
-}
-
-ThreadPool::~ThreadPool() { stopThreads(); }
-
-void ThreadPool::thread_proc() {
-  while (!stop) {
-    std::unique_lock<std::mutex> latch(queue_mutex);
-    cv_task.wait(latch, [this]() { return stop || !tasks.empty(); });
-    if (!tasks.empty()) {
-      // got work. set busy.
-      ++busy;
-
-      // pull from queue
-      auto f = tasks.front();
-      tasks.pop_front();
-
-      // release lock. run async
-      latch.unlock();
-
-      // run function outside context
-      f.first(f.second);
-
-      latch.lock();
-      --busy;
-      cv_finished.notify_one();
+namespace {
+// Stable LSD radix sort on 8 bit digits. Keys are non-negative floats, whose
+// bit patterns sort in the same order as their values.
+template <class T>
+void radixSortDescending(std::vector<T> &items, std::vector<T> &buffer) {
+  buffer.resize(items.size());
+  for (int shift = 0; shift < 32; shift += 8) {
+    size_t counts[256] = {0};
+    for (auto &item : items) {
+      counts[(item.key >> shift) & 0xFF]++;
     }
+    if (items.empty() ||
+        counts[(items[0].key >> shift) & 0xFF] == items.size()) {
+      continue; // All keys share this digit
+    }
+    size_t offset = 0;
+    for (int digit = 255; digit >= 0; digit--) {
+      size_t count = counts[digit];
+      counts[digit] = offset;
+      offset += count;
+    }
+    for (auto &item : items) {
+      buffer[counts[(item.key >> shift) & 0xFF]++] = item;
+    }
+    items.swap(buffer);
   }
 }
-
-// waits until the queue is empty.
-
-void ThreadPool::waitForProcessingDone() {
-  std::unique_lock<std::mutex> lock(queue_mutex);
-  cv_finished.wait(lock, [this]() { return tasks.empty() && (busy == 0); });
-}
-
-void ThreadPool::stopThreads() {
-  // set stop-condition
-  std::unique_lock<std::mutex> latch(queue_mutex);
-  stop = true;
-  cv_task.notify_all();
-  latch.unlock();
-  // all threads terminate, then we're done.
-  for (auto &t : workers)
-    t.join();
-}
-
-// ------------------------------------------------
+} // namespace
 
 DynamicScene::DynamicScene(int threadPoolSize, TimeMasterMode masterMode)
     : PolySynth(masterMode) {
   Speakers sl = StereoSpeakerLayout(); // Stereo by default
   setSpatializer<StereoPanner>(sl);
   if (threadPoolSize > 0) {
-    mWorkerThreads = std::make_unique<ThreadPool>(threadPoolSize);
+    mWorkerThreads = std::make_unique<JobSystem>(threadPoolSize);
   }
   for (int i = 0; i < threadPoolSize; i++) {
     mAudioThreads.push_back(
@@ -93,10 +71,7 @@ DynamicScene::DynamicScene(int threadPoolSize, TimeMasterMode masterMode)
 
 DynamicScene::~DynamicScene() {
   stopAudioThreads();
-
-  if (mWorkerThreads) {
-    mWorkerThreads->waitForProcessingDone();
-  }
+  mWorkerThreads = nullptr;
   cleanup();
 }
 
@@ -117,6 +92,14 @@ void DynamicScene::prepare(AudioIOData &io) {
     threadio.channelsOut(mVoiceMaxOutputChannels);
     threadio.channelsBus(mVoiceBusChannels);
   }
+  // Room for every reserved voice on each thread
+  size_t numVoices = 16;
+  for (auto &pool : mVoicePools) {
+    numVoices += pool->size;
+  }
+  for (auto &tmap : mThreadMap) {
+    tmap.second.reserve(numVoices);
+  }
   m_internalAudioConfigured = true;
 }
 
@@ -136,36 +119,48 @@ void DynamicScene::render(Graphics &g) {
     processVoiceTurnOff();
   }
   std::unique_lock<std::mutex> lk(mGraphicsLock);
-  std::vector<PositionedVoice *> voices;
-  voices.reserve(128);
-  auto voice = mActiveVoices;
+  Frustumd frustum;
+  if (mCullDrawing) {
+    // Frustum in the space the voices are drawn in
+    frustum.fromMatrix(g.projMatrix() * g.viewMatrix() * g.modelMatrix());
+  }
+  auto viewPos = mListenerPose.pos();
+  mDrawVoices.clear();
+  auto *voice = mActiveVoices;
   while (voice) {
-    voices.push_back((PositionedVoice *)voice);
+    if (voice->active()) {
+      auto *posVoice = dynamic_cast<PositionedVoice *>(voice);
+      float distSqr = 0.0f;
+      if (posVoice) {
+        auto pos = posVoice->pose().pos();
+        float radius = posVoice->boundingRadius();
+        if (mCullDrawing && radius >= 0.0f &&
+            frustum.testSphere(pos, radius * std::abs(posVoice->size())) ==
+                Frustumd::OUTSIDE) {
+          voice = voice->next;
+          continue;
+        }
+        distSqr = float((pos - viewPos).magSqr());
+      }
+      uint32_t key;
+      std::memcpy(&key, &distSqr, sizeof(key));
+      mDrawVoices.push_back({key, voice, posVoice});
+    }
     voice = voice->next;
   }
   if (mSortDrawingByDistance) {
-    // FIXME this is crashing in some undetermined cases.
-    // For now a working but inefficient way of sorting
-    auto viewPos = mListenerPose.pos();
-    std::sort(voices.begin(), voices.end(),
-              [&](PositionedVoice *a, PositionedVoice *b) -> bool {
-                auto distA = (a->pose().pos() - viewPos).mag();
-                auto distB = (b->pose().pos() - viewPos).mag();
-                return distA >= distB;
-              });
+    // Furthest first
+    radixSortDescending(mDrawVoices, mDrawSortBuffer);
   }
-  for (auto voice : voices) {
+  for (auto &item : mDrawVoices) {
     // TODO implement offset?
-    if (voice->active()) {
-      g.pushMatrix();
-      if (dynamic_cast<PositionedVoice *>(voice)) {
-        PositionedVoice *posVoice = static_cast<PositionedVoice *>(voice);
-        posVoice->preProcess(g);
-        posVoice->applyTransformations(g);
-      }
-      voice->onProcess(g);
-      g.popMatrix();
+    g.pushMatrix();
+    if (item.positionedVoice) {
+      item.positionedVoice->preProcess(g);
+      item.positionedVoice->applyTransformations(g);
     }
+    item.voice->onProcess(g);
+    g.popMatrix();
   }
   if (mMasterMode == TimeMasterMode::TIME_MASTER_GRAPHICS) {
     processInactiveVoices();
@@ -179,6 +174,12 @@ void DynamicScene::render(AudioIOData &io) {
   assert(mSpatializer && "ERROR: call setSpatializer before starting audio");
   io.frame(0);
   mSpatializer->prepare(io);
+  // Spatializers that rotate their whole mix get the listener orientation
+  // once per block instead of rotated source positions
+  const bool rotateSources = !mSpatializer->rotatesSoundfield();
+  if (!rotateSources) {
+    mSpatializer->listenerOrientation(mListenerPose.quat());
+  }
   if (mMasterMode == TimeMasterMode::TIME_MASTER_AUDIO) {
     processVoices();
     // Turn off voices
@@ -200,36 +201,54 @@ void DynamicScene::render(AudioIOData &io) {
           if (endOffsetFrames > 0 && endOffsetFrames <= fpb) {
             voice->triggerOff(endOffsetFrames);
           }
-          internalAudioIO.zeroOut();
-          internalAudioIO.zeroBus();
-          internalAudioIO.frame(offset);
-          voice->onProcess(internalAudioIO);
           Vec3d listeningDir;
-          vector<Vec3f> posOffsets;
+          const vector<Vec3f> *posOffsets = nullptr;
+          bool attenuate = false;
+          float atten = 1.0f;
           if (dynamic_cast<PositionedVoice *>(voice)) {
             PositionedVoice *posVoice = static_cast<PositionedVoice *>(voice);
             Vec3d direction = posVoice->pose().vec() - mListenerPose.vec();
 
             // Rotate vector according to listener-rotation
-            Quatd srcRot = mListenerPose.quat();
-            listeningDir = srcRot.rotate(direction);
-            posOffsets = posVoice->audioOutOffsets();
-            assert(posOffsets.size() == 0 ||
-                   posOffsets.size() == posVoice->numOutChannels());
+            if (rotateSources) {
+              Quatd srcRot = mListenerPose.quat();
+              listeningDir = srcRot.rotate(direction);
+            } else {
+              listeningDir = direction;
+            }
+            posOffsets = &posVoice->audioOutOffsets();
+            assert(posOffsets->size() == 0 ||
+                   posOffsets->size() == posVoice->numOutChannels());
             if (posVoice->useDistanceAttenuation()) {
-              float distance = listeningDir.mag();
-              float atten = mDistAtten.attenuation(distance);
-              internalAudioIO.frame(0);
-              float *buf = internalAudioIO.outBuffer(0);
-
-              while (internalAudioIO()) {
-                *buf = *buf * atten;
-                buf++;
-              }
+              attenuate = true;
+              atten = mDistAtten.attenuation(listeningDir.mag());
             }
           } else {
             listeningDir = mListenerPose;
           }
+          if (!beginVoiceBlock(voice, attenuate &&
+                                          atten < mAudibilityThreshold)) {
+            voice = voice->next;
+            continue;
+          }
+          internalAudioIO.zeroOut();
+          internalAudioIO.zeroBus();
+          internalAudioIO.frame(offset);
+          {
+            AudioProfiler::Scope voiceScope(AudioProfiler::VOICES);
+            voice->onProcess(internalAudioIO);
+          }
+          endVoiceBlock(voice, internalAudioIO, offset);
+          AudioProfiler::Scope spatializerScope(AudioProfiler::SPATIALIZER);
+          if (attenuate) {
+            internalAudioIO.frame(0);
+            float *buf = internalAudioIO.outBuffer(0);
+
+            while (internalAudioIO()) {
+              *buf = *buf * atten;
+              buf++;
+            }
+          }
           if (mBusRoutingCallback) {
             // First call callback to route signals to internal buses
             internalAudioIO.frame(offset);
@@ -249,11 +268,11 @@ void DynamicScene::render(AudioIOData &io) {
             internalAudioIO.frame(offset);
             Pose offsetPose = listeningDir;
             // FIXME rotate according to listener orientation
-            if (posOffsets.size() > 0) {
+            if (posOffsets && posOffsets->size() > 0) {
               // Is there need to rotate the position according to the quat()?
               // It would only really be useful if the source has a direction
               // dependent dispersion model...
-              offsetPose.vec() += posOffsets[i];
+              offsetPose.vec() += (*posOffsets)[i];
             }
             Vec3f adjustedPos = offsetPose.vec();
             mSpatializer->renderBuffer(io, adjustedPos,
@@ -272,7 +291,7 @@ void DynamicScene::render(AudioIOData &io) {
     while (voice) {
       if (voice->active()) {
         mThreadMap[counter++].push_back(voice->id());
-        if (counter > mThreadMap.size()) {
+        if (counter >= mThreadMap.size()) {
           counter = 0;
         }
       }
@@ -283,13 +302,19 @@ void DynamicScene::render(AudioIOData &io) {
     std::unique_lock<std::mutex> lk(mThreadTriggerLock);
     mAudioThreadDone.wait(lk, [this]() { return mAudioBusy == 0; });
   }
-  mSpatializer->finalize(io);
+  {
+    AudioProfiler::Scope spatializerScope(AudioProfiler::SPATIALIZER);
+    mSpatializer->finalize(io);
+  }
   processGain(io);
 
   // Run post processing callbacks
-  for (auto cb : mPostProcessing) {
-    io.frame(0);
-    cb->onAudioCB(io);
+  {
+    AudioProfiler::Scope postScope(AudioProfiler::POST_PROCESSING);
+    for (auto cb : mPostProcessing) {
+      io.frame(0);
+      cb->onAudioCB(io);
+    }
   }
   if (mMasterMode == TimeMasterMode::TIME_MASTER_AUDIO) {
     processInactiveVoices();
@@ -312,16 +337,17 @@ void DynamicScene::update(double dt) {
       voice = voice->next;
     }
   } else { // Using worker threads
-
+    mUpdateVoices.clear();
     auto *voice = mActiveVoices;
     while (voice) {
       if (voice->active()) {
-        UpdateThreadFuncData data{voice, dt};
-        mWorkerThreads->enqueue(DynamicScene::updateThreadFunc, data);
+        mUpdateVoices.push_back(voice);
       }
       voice = voice->next;
     }
-    mWorkerThreads->waitForProcessingDone();
+    mWorkerThreads->parallelFor(0, mUpdateVoices.size(), [&](size_t i) {
+      mUpdateVoices[i]->update(dt);
+    });
   }
   // Update
   if (mMasterMode == TimeMasterMode::TIME_MASTER_UPDATE) {
@@ -363,6 +389,8 @@ void DynamicScene::sortDrawingByDistance(bool sort) {
   mSortDrawingByDistance = sort;
 }
 
+void DynamicScene::cullDrawing(bool cull) { mCullDrawing = cull; }
+
 void DynamicScene::stopAudioThreads() {
     mSynthRunning = false;
     mThreadTrigger.notify_all();
@@ -372,14 +400,6 @@ void DynamicScene::stopAudioThreads() {
     mAudioThreads.clear();
 }
 
-void DynamicScene::updateThreadFunc(UpdateThreadFuncData data) {
-    //        UpdateThreadFuncData *data = (UpdateThreadFuncData *) ud;
-    //        std::cout << "eq " << data.voice << "  " << data.dt << std::endl;
-  SynthVoice *voice = data.voice;
-  double &dt = data.dt;
-  voice->update(dt);
-}
-
 void DynamicScene::audioThreadFunc(DynamicScene *scene, int id) {
   while (scene->mSynthRunning) {
     std::unique_lock<std::mutex> lk(scene->mThreadTriggerLock);
@@ -403,38 +423,52 @@ void DynamicScene::audioThreadFunc(DynamicScene *scene, int id) {
           if (endOffsetFrames > 0 && endOffsetFrames <= fpb) {
             voice->triggerOff(endOffsetFrames);
           }
-          internalAudioIO.zeroOut();
-          internalAudioIO.zeroBus();
-          internalAudioIO.frame(offset);
-          voice->onProcess(internalAudioIO);
           Vec3d listeningDir;
-          vector<Vec3f> posOffsets;
+          const vector<Vec3f> *posOffsets = nullptr;
+          bool attenuate = false;
+          float atten = 1.0f;
           if (dynamic_cast<PositionedVoice *>(voice)) {
             PositionedVoice *posVoice = static_cast<PositionedVoice *>(voice);
             Vec3d direction =
                 posVoice->pose().vec() - scene->mListenerPose.vec();
 
             // Rotate vector according to listener-rotation
-            Quatd srcRot = scene->mListenerPose.quat();
-            listeningDir = srcRot.rotate(direction);
-            posOffsets = posVoice->audioOutOffsets();
-            assert(posOffsets.size() == 0 ||
-                   posOffsets.size() == posVoice->numOutChannels());
+            if (!scene->mSpatializer->rotatesSoundfield()) {
+              Quatd srcRot = scene->mListenerPose.quat();
+              listeningDir = srcRot.rotate(direction);
+            } else {
+              listeningDir = direction;
+            }
+            posOffsets = &posVoice->audioOutOffsets();
+            assert(posOffsets->size() == 0 ||
+                   posOffsets->size() == posVoice->numOutChannels());
             if (posVoice->useDistanceAttenuation()) {
-              float distance = scene->mListenerPose.vec().mag();
-              float atten = scene->mDistAtten.attenuation(distance);
-              internalAudioIO.frame(0);
-              float *buf = internalAudioIO.outBuffer(0);
-
-              while (internalAudioIO()) {
-                *buf = *buf * atten;
-                buf++;
-              }
+              attenuate = true;
+              atten = scene->mDistAtten.attenuation(direction.mag());
             }
           } else {
             listeningDir = scene->mListenerPose;
             // FIXME what should we do here if voice not a PositionedVoice?
           }
+          if (!scene->beginVoiceBlock(
+                  voice, attenuate && atten < scene->mAudibilityThreshold)) {
+            voice = voice->next;
+            continue;
+          }
+          internalAudioIO.zeroOut();
+          internalAudioIO.zeroBus();
+          internalAudioIO.frame(offset);
+          voice->onProcess(internalAudioIO);
+          scene->endVoiceBlock(voice, internalAudioIO, offset);
+          if (attenuate) {
+            internalAudioIO.frame(0);
+            float *buf = internalAudioIO.outBuffer(0);
+
+            while (internalAudioIO()) {
+              *buf = *buf * atten;
+              buf++;
+            }
+          }
           scene->mSpatializerLock.lock();
           if (scene->mBusRoutingCallback) {
             // First call callback to route signals to internal buses
@@ -454,8 +488,8 @@ void DynamicScene::audioThreadFunc(DynamicScene *scene, int id) {
             io.frame(offset);
             internalAudioIO.frame(offset);
             Pose offsetPose = scene->mListenerPose;
-            if (posOffsets.size() > 0) {
-              offsetPose.vec() += posOffsets[i];
+            if (posOffsets && posOffsets->size() > 0) {
+              offsetPose.vec() += (*posOffsets)[i];
             }
             Vec3f adjustedPos = offsetPose.vec();
             scene->mSpatializer->renderBuffer(
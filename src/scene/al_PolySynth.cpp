@@ -1,9 +1,14 @@
 #include "al/scene/al_PolySynth.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 
 #include <memory>
 
+#include "al/math/al_Tile.hpp"
+
 using namespace al;
 
 int al::asciiToIndex(int asciiKey, int offset) {
@@ -227,6 +232,9 @@ int PolySynth::triggerOn(SynthVoice *voice, int offsetFrames, int id,
   }
   if (allCallbacksOk) {
     voice->triggerOn(offsetFrames);
+    if (!mVoicePools.empty()) {
+      markTriggered(voice);
+    }
     {
       std::unique_lock<std::mutex> lk(mVoiceToInsertLock);
       voice->next = mVoicesToInsert;
@@ -257,6 +265,11 @@ void PolySynth::allNotesOff() { mAllNotesOff = true; }
 SynthVoice *PolySynth::getVoice(std::string name, bool forceAlloc) {
   std::unique_lock<std::mutex> lk(
       mFreeVoiceLock); // Only one getVoice() call at a time
+  if (!mVoicePools.empty()) {
+    if (auto *pool = findPool(name)) {
+      return takePooledVoice(*pool);
+    }
+  }
   SynthVoice *freeVoice = mFreeVoices;
   SynthVoice *previousVoice = nullptr;
   while (freeVoice) {
@@ -298,6 +311,7 @@ SynthVoice *PolySynth::getFreeVoice() {
   SynthVoice *freeVoice = mFreeVoices;
   if (freeVoice) {
     mFreeVoices = freeVoice->next;
+    acquirePooledVoice(freeVoice);
   }
   return freeVoice;
 }
@@ -315,61 +329,81 @@ void PolySynth::render(AudioIOData &io) {
   // Render active voices
   auto *voice = mActiveVoices;
   int fpb = io.framesPerBuffer();
-  while (voice) {
-    if (voice->active()) {
-      int offset = voice->getStartOffsetFrames(fpb);
-      if (offset < fpb) {
-        int endOffsetFrames = voice->getEndOffsetFrames(fpb);
-        if (endOffsetFrames > 0 && endOffsetFrames <= fpb) {
-          voice->triggerOff(endOffsetFrames);
-        }
-        if (m_useInternalAudioIO) {
-          internalAudioIO.zeroOut();
-          internalAudioIO.zeroBus();
-          internalAudioIO.frame(offset);
-          voice->onProcess(internalAudioIO);
-
-          if (mBusRoutingCallback) {
-            // First call callback to route signals to internal buses
-            internalAudioIO.frame(offset);
-            Pose p;
-            (*mBusRoutingCallback)(internalAudioIO, p);
+  {
+    AudioProfiler::Scope voicesScope(AudioProfiler::VOICES);
+    while (voice) {
+      if (voice->active()) {
+        int offset = voice->getStartOffsetFrames(fpb);
+        if (offset < fpb) {
+          int endOffsetFrames = voice->getEndOffsetFrames(fpb);
+          if (endOffsetFrames > 0 && endOffsetFrames <= fpb) {
+            voice->triggerOff(endOffsetFrames);
           }
-          // Then gather all the internal buses into the master AudioIO
-          // buses
-          io.frame(offset);
-          internalAudioIO.frame(offset);
-          while (io() && internalAudioIO()) {
-            for (int i = 0; i < mVoiceMaxOutputChannels; i++) {
-              if (mChannelMap.size() > i) {
-                io.out(mChannelMap[i]) += internalAudioIO.out(i);
-              } else {
-                io.out(i) += internalAudioIO.out(i);
-              }
-            }
-            for (int i = 0; i < mVoiceBusChannels; i++) {
-              io.bus(i) += internalAudioIO.bus(i);
+          if (!beginVoiceBlock(voice)) {
+            voice = voice->next;
+            continue;
+          }
+          if (m_useInternalAudioIO) {
+            internalAudioIO.zeroOut();
+            internalAudioIO.zeroBus();
+            internalAudioIO.frame(offset);
+            voice->onProcess(internalAudioIO);
+            endVoiceBlock(voice, internalAudioIO, offset);
+
+            if (mBusRoutingCallback) {
+              // First call callback to route signals to internal buses
+              internalAudioIO.frame(offset);
+              Pose p;
+              (*mBusRoutingCallback)(internalAudioIO, p);
             }
+            // Then gather all the internal buses into the master AudioIO
+            // buses
+            mixVoiceOutput(io, offset);
+          } else {
+            io.frame(offset);
+            voice->onProcess(io);
           }
         }
-      } else {
-        io.frame(offset);
-        voice->onProcess(io);
       }
+      voice = voice->next;
     }
-    voice = voice->next;
   }
   processGain(io);
   // Run post processing callbacks
-  for (auto cb : mPostProcessing) {
-    io.frame(0);
-    cb->onAudioCB(io);
+  {
+    AudioProfiler::Scope postScope(AudioProfiler::POST_PROCESSING);
+    for (auto cb : mPostProcessing) {
+      io.frame(0);
+      cb->onAudioCB(io);
+    }
   }
   if (mMasterMode == TimeMasterMode::TIME_MASTER_AUDIO) {
     processInactiveVoices();
   }
 }
 
+void PolySynth::mixVoiceOutput(AudioIOData &io, int offset) {
+  const int numFrames =
+      int(std::min(io.framesPerBuffer(), internalAudioIO.framesPerBuffer())) -
+      offset;
+  if (numFrames <= 0) {
+    return;
+  }
+  const size_t numChannels = io.channelsOut();
+  for (int i = 0; i < mVoiceMaxOutputChannels; i++) {
+    const size_t channel = size_t(i) < mChannelMap.size() ? mChannelMap[i] : i;
+    if (channel < numChannels) {
+      tiledAdd(io.outBuffer(int(channel)) + offset,
+               internalAudioIO.outBuffer(i) + offset, numFrames);
+    }
+  }
+  const int numBuses = std::min(int(io.channelsBus()), int(mVoiceBusChannels));
+  for (int i = 0; i < numBuses; i++) {
+    tiledAdd(io.busBuffer(i) + offset, internalAudioIO.busBuffer(i) + offset,
+             numFrames);
+  }
+}
+
 void PolySynth::render(Graphics &g) {
   if (mMasterMode == TimeMasterMode::TIME_MASTER_GRAPHICS) {
     processVoices();
@@ -438,6 +472,7 @@ void PolySynth::insertFreeVoice(SynthVoice *voice) {
   std::unique_lock<std::mutex> lk(mFreeVoiceLock);
   voice->next = mFreeVoices;
   mFreeVoices = voice;
+  releasePooledVoice(voice);
 }
 
 bool PolySynth::popFreeVoice(SynthVoice *voice) {
@@ -453,6 +488,7 @@ bool PolySynth::popFreeVoice(SynthVoice *voice) {
         mFreeVoices = lastVoice->next;
         voice->next = nullptr;
       }
+      acquirePooledVoice(voice);
       return true;
     }
     lastVoice = lastVoice->next;
@@ -589,11 +625,288 @@ SynthVoice *PolySynth::allocateVoice(std::string name) {
 
 void PolySynth::setVoiceMaxOutputChannels(uint16_t channels) {
   mVoiceMaxOutputChannels = channels;
+  mChannelMap.resize(channels);
   for (size_t i = 0; i < channels; i++) {
     mChannelMap[i] = i;
   }
 }
 
+bool PolySynth::reserveVoices(std::string name, int capacity,
+                              VoiceStealing stealing, int spareVoices) {
+  auto creator = mPoolCreators.find(name);
+  if (creator == mPoolCreators.end()) {
+    std::cerr << "ERROR: can't reserve voices of type " << name
+              << ". Voice not registered." << std::endl;
+    return false;
+  }
+  if (capacity <= 0) {
+    std::cerr << "ERROR: voice pool capacity must be positive" << std::endl;
+    return false;
+  }
+  if (spareVoices < 0) {
+    spareVoices = stealing == VoiceStealing::NONE ? 0 : capacity / 4 + 1;
+  }
+  return addVoicePool(creator->second(capacity + spareVoices), name, capacity,
+                      stealing);
+}
+
+int PolySynth::voicesInUse(std::string name) {
+  auto *pool = findPool(name);
+  return pool ? pool->inUse.load() : -1;
+}
+
+void PolySynth::initializeVoice(SynthVoice *voice) {
+  voice->next = nullptr;
+  if (mDefaultUserData) {
+    voice->userData(mDefaultUserData);
+  }
+  voice->init();
+  for (auto allocCb : mAllocationCallbacks) {
+    allocCb.first(voice, allocCb.second);
+  }
+}
+
+bool PolySynth::addVoicePool(std::unique_ptr<VoicePool> pool, std::string name,
+                             int capacity, VoiceStealing stealing) {
+  if (findPool(pool->type) || findPool(name)) {
+    std::cerr << "ERROR: voices of type " << name << " already reserved"
+              << std::endl;
+    return false;
+  }
+  pool->name = name;
+  pool->capacity = capacity;
+  pool->stealing = stealing;
+  pool->slots.reset(new VoicePool::Slot[pool->size]);
+  for (size_t i = 0; i < pool->size; i++) {
+    initializeVoice(pool->voice(int(i)));
+  }
+  {
+    std::unique_lock<std::mutex> lk(mFreeVoiceLock);
+    // Link in reverse so the voices are handed out in memory order
+    for (size_t i = pool->size; i > 0; i--) {
+      auto *voice = pool->voice(int(i - 1));
+      voice->next = mFreeVoices;
+      mFreeVoices = voice;
+    }
+    mMeasurePeaks |= stealing == VoiceStealing::QUIETEST;
+    mVoicePools.push_back(std::move(pool));
+  }
+  disableAllocation(name);
+  return true;
+}
+
+PolySynth::VoicePool *PolySynth::findPool(const SynthVoice *voice) {
+  for (auto &pool : mVoicePools) {
+    if (pool->index(voice) >= 0) {
+      return pool.get();
+    }
+  }
+  return nullptr;
+}
+
+PolySynth::VoicePool *PolySynth::findPool(const std::type_index &type) {
+  for (auto &pool : mVoicePools) {
+    if (pool->type == type) {
+      return pool.get();
+    }
+  }
+  return nullptr;
+}
+
+PolySynth::VoicePool *PolySynth::findPool(const std::string &name) {
+  for (auto &pool : mVoicePools) {
+    if (pool->name == name) {
+      return pool.get();
+    }
+  }
+  return nullptr;
+}
+
+SynthVoice *PolySynth::takePooledVoice(VoicePool &pool) {
+  SynthVoice *freeVoice = mFreeVoices;
+  SynthVoice *previousVoice = nullptr;
+  while (freeVoice && pool.index(freeVoice) < 0) {
+    previousVoice = freeVoice;
+    freeVoice = freeVoice->next;
+  }
+  if (!freeVoice) {
+    if (mVerbose) {
+      std::cout << "No free voice of type " << pool.name << std::endl;
+    }
+    return nullptr;
+  }
+  if (pool.inUse.load() >= pool.capacity && !stealVoice(pool)) {
+    if (mVerbose) {
+      std::cout << "All " << pool.capacity << " voices of type " << pool.name
+                << " in use" << std::endl;
+    }
+    return nullptr;
+  }
+  if (previousVoice) {
+    previousVoice->next = freeVoice->next;
+  } else {
+    mFreeVoices = freeVoice->next;
+  }
+  freeVoice->next = nullptr;
+  acquirePooledVoice(freeVoice);
+  return freeVoice;
+}
+
+bool PolySynth::stealVoice(VoicePool &pool) {
+  if (pool.stealing == VoiceStealing::NONE) {
+    return false;
+  }
+  int victim = -1;
+  uint64_t oldest = UINT64_MAX;
+  float quietest = FLT_MAX;
+  for (size_t i = 0; i < pool.size; i++) {
+    auto &slot = pool.slots[i];
+    uint64_t triggered = slot.triggered.load();
+    // Voices taken but not triggered yet are still being set up
+    if (!slot.inUse.load() || slot.steal.load() || triggered == 0) {
+      continue;
+    }
+    if (pool.stealing == VoiceStealing::QUIETEST) {
+      float peak = slot.peak.load(std::memory_order_relaxed);
+      if (peak > quietest || (peak == quietest && triggered > oldest)) {
+        continue;
+      }
+      quietest = peak;
+    } else if (triggered > oldest) {
+      continue;
+    }
+    oldest = triggered;
+    victim = int(i);
+  }
+  if (victim < 0) {
+    return false;
+  }
+  if (mVerbose) {
+    std::cout << "Stealing voice " << pool.voice(victim)->id() << std::endl;
+  }
+  pool.slots[victim].steal = true;
+  mStealRequests.fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+void PolySynth::acquirePooledVoice(SynthVoice *voice) {
+  if (auto *pool = findPool(voice)) {
+    if (!pool->slots[pool->index(voice)].inUse.exchange(true)) {
+      pool->inUse++;
+    }
+  }
+}
+
+void PolySynth::releaseVoiceSlot(SynthVoice *voice) {
+  if (auto *pool = findPool(voice)) {
+    auto &slot = pool->slots[pool->index(voice)];
+    if (slot.steal.exchange(false)) {
+      mStealRequests--;
+    }
+    slot.triggered = 0;
+    if (slot.inUse.exchange(false)) {
+      pool->inUse--;
+    }
+  }
+}
+
+void PolySynth::stopStolenVoices() {
+  for (auto &pool : mVoicePools) {
+    for (size_t i = 0; i < pool->size; i++) {
+      // The request is cleared when the voice returns to the pool. The
+      // voice is faded out in its next block, as stopping it at once clicks.
+      if (pool->slots[i].steal.load(std::memory_order_acquire)) {
+        pool->voice(int(i))->mStolen = true;
+      }
+    }
+  }
+}
+
+void PolySynth::markTriggered(SynthVoice *voice) {
+  if (auto *pool = findPool(voice)) {
+    auto &slot = pool->slots[pool->index(voice)];
+    // Not a candidate for QUIETEST until it has rendered a block
+    slot.peak.store(FLT_MAX, std::memory_order_relaxed);
+    slot.triggered = ++pool->triggerCount;
+  }
+}
+
+bool PolySynth::beginVoiceBlock(SynthVoice *voice, bool inaudible) {
+  voice->mCulled = inaudible;
+  if (voice->mStolen &&
+      (inaudible || voice->mSilent || !m_useInternalAudioIO)) {
+    // Nothing to fade out, or no output of its own to fade
+    voice->free();
+    return false;
+  }
+  if (!inaudible && !voice->mSilent) {
+    return true;
+  }
+  if (voice->mReleased) {
+    // The rest of the release would not be heard
+    voice->free();
+    return false;
+  }
+  if (inaudible || ++voice->mSkippedBlocks < voice->mSilenceBlocks) {
+    return false;
+  }
+  // Process this block to check if the voice is audible again
+  voice->mSkippedBlocks = 0;
+  return true;
+}
+
+void PolySynth::endVoiceBlock(SynthVoice *voice, AudioIOData &io, int offset) {
+  if (voice->mStolen) {
+    // Linear fade to silence at the end of the block
+    const int fpb = int(io.framesPerBuffer());
+    const float step = 1.0f / float(std::max(fpb - offset, 1));
+    for (unsigned int c = 0; c < io.channelsOut() + io.channelsBus(); c++) {
+      float *buffer = c < io.channelsOut()
+                          ? io.outBuffer(c)
+                          : io.busBuffer(c - io.channelsOut());
+      for (int i = offset; i < fpb; i++) {
+        buffer[i] *= 1.0f - float(i - offset + 1) * step;
+      }
+    }
+    voice->free();
+    return;
+  }
+  const bool detectSilence = voice->mSilenceThreshold > 0.0f;
+  if (!detectSilence && !mMeasurePeaks) {
+    return;
+  }
+  // Buses count too, a voice may only feed effects on them
+  float peak = 0.0f;
+  const int fpb = int(io.framesPerBuffer());
+  for (unsigned int c = 0; c < io.channelsOut() + io.channelsBus(); c++) {
+    const float *buffer = c < io.channelsOut()
+                              ? io.outBuffer(c)
+                              : io.busBuffer(c - io.channelsOut());
+    for (int i = offset; i < fpb; i++) {
+      peak = std::max(peak, std::abs(buffer[i]));
+    }
+  }
+  if (mMeasurePeaks) {
+    auto *pool = findPool(voice);
+    if (pool && pool->stealing == VoiceStealing::QUIETEST) {
+      pool->slots[pool->index(voice)].peak.store(peak,
+                                                 std::memory_order_relaxed);
+    }
+  }
+  if (detectSilence) {
+    if (peak >= voice->mSilenceThreshold) {
+      voice->mSilentBlocks = 0;
+      voice->mSilent = false;
+    } else if (++voice->mSilentBlocks >= voice->mSilenceBlocks) {
+      if (voice->mReleased) {
+        voice->free();
+      } else {
+        voice->mSilent = true;
+      }
+    }
+  }
+}
+
 void PolySynth::setBusRoutingCallback(PolySynth::BusRoutingCallback cb) {
   mBusRoutingCallback = std::make_shared<BusRoutingCallback>(cb);
 }
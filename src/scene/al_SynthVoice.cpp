@@ -267,6 +267,12 @@ std::vector<VariantValue> SynthVoice::getTriggerParams() {
 void SynthVoice::triggerOn(int offsetFrames) {
   mOnOffsetFrames = offsetFrames;
   mActive = true;
+  mReleased = false;
+  mSilentBlocks = 0;
+  mSkippedBlocks = 0;
+  mSilent = false;
+  mCulled = false;
+  mStolen = false;
   onTriggerOn();
 }
 
@@ -274,6 +280,7 @@ void SynthVoice::triggerOff(int offsetFrames) {
   mOffOffsetFrames =
       offsetFrames; // TODO implement offset frames for trigger off.
   // Currently ignoring and turning off at start of buffer
+  mReleased = true;
   onTriggerOff();
 }
 
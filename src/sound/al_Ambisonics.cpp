@@ -2,6 +2,8 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 #ifdef USE_GAMMA
 #include "scl.h"
 #define COS gam::scl::cosT8
@@ -58,12 +60,31 @@ void AmbiBase::dim(int dim) {
 void AmbiBase::order(int o) {
   if (o != mOrder) {
     mOrder = o;
+    if (mOrder > 3 && mConvention == FUMA) {
+      std::cout << "AmbiBase::order() Warning. FuMa is only defined up to "
+                   "third order. Using ACN/SN3D."
+                << std::endl;
+      mConvention = ACN_SN3D;
+    }
     mChannels = orderToChannels(mDim, mOrder);
     resize(mWeights, channels());
     onChannelsChange();
   }
 }
 
+void AmbiBase::convention(Convention c) {
+  if (c == FUMA && mOrder > 3) {
+    std::cout << "AmbiBase::convention() Warning. FuMa is only defined up to "
+                 "third order. Using ACN/SN3D."
+              << std::endl;
+    c = ACN_SN3D;
+  }
+  if (c != mConvention) {
+    mConvention = c;
+    onChannelsChange();
+  }
+}
+
 int AmbiBase::channelsToUniformOrder(int channels) {
   // M = floor(sqrt(N) - 1)
   return (int)(sqrt((double)channels) - 1);
@@ -165,6 +186,84 @@ void AmbiBase::encodeWeightsFuMa16(float *ws, float az, float el) {
   encodeWeightsFuMa16(ws, x, y, z);
 }
 
+void AmbiBase::encodeWeightsACN(float *ws, int dim, int order, float x,
+                                float y, float z) {
+  *ws = 1.f; // W, SN3D normalized
+
+  // (x + iy)^m = cos^m(E) e^(imA) provides the azimuthal terms multiplied by
+  // the cos^m(E) factor of the associated Legendre function
+  double cm = 1.0;
+  double sm = 0.0;
+
+  if (dim == 2) {
+    // Circular harmonics, ACN ordered: W, then sin(mA), cos(mA) for each m
+    for (int m = 1; m <= order; ++m) {
+      double c = cm * x - sm * y;
+      sm = cm * y + sm * x;
+      cm = c;
+      ws[2 * m - 1] = float(sm);
+      ws[2 * m] = float(cm);
+    }
+    return;
+  }
+
+  // P_l^m(z) = cos^m(E) Q_l^m(z) with the Condon-Shortley phase omitted.
+  // For each m, Q is computed upwards in l with the three-term recurrence
+  //   Q_m^m     = (2m - 1)!!
+  //   Q_m+1^m   = (2m + 1) z Q_m^m
+  //   Q_l^m     = ((2l - 1) z Q_l-1^m - (l + m - 1) Q_l-2^m) / (l - m)
+  // and the SN3D factor sqrt((2 - d_m0) (l - m)! / (l + m)!) is updated
+  // alongside it.
+  double qmm = 1.0;   // Q_m^m
+  double ratio = 1.0; // (l - m)! / (l + m)! at l = m
+  for (int m = 0; m <= order; ++m) {
+    if (m > 0) {
+      double c = cm * x - sm * y;
+      sm = cm * y + sm * x;
+      cm = c;
+      qmm *= (2 * m - 1);
+      ratio /= double(2 * m) * (2 * m - 1);
+    }
+    double lRatio = ratio;
+    double q2 = 0.0;
+    double q1 = qmm;
+    for (int l = m; l <= order; ++l) {
+      double q;
+      if (l == m) {
+        q = qmm;
+      } else {
+        q = ((2 * l - 1) * z * q1 - (l + m - 1) * q2) / (l - m);
+        lRatio *= double(l - m) / (l + m);
+        q2 = q1;
+        q1 = q;
+      }
+      double n = std::sqrt((m == 0 ? 1.0 : 2.0) * lRatio) * q;
+      ws[l * l + l + m] = float(n * cm);
+      if (m > 0) {
+        ws[l * l + l - m] = float(n * sm);
+      }
+    }
+  }
+}
+
+void AmbiBase::encodeWeightsACN(float *ws, int dim, int order, float az,
+                                float el) {
+  float cosel = std::cos(el);
+  float x = std::cos(az) * cosel;
+  float y = std::sin(az) * cosel;
+  float z = dim >= 3 ? std::sin(el) : 0;
+  encodeWeightsACN(ws, dim, order, x, y, z);
+}
+
+void AmbiBase::encodeWeights(float *ws, Convention convention, int dim,
+                             int order, float x, float y, float z) {
+  if (convention == ACN_SN3D) {
+    encodeWeightsACN(ws, dim, order, x, y, z);
+  } else {
+    encodeWeightsFuMa(ws, dim, order, x, y, z);
+  }
+}
+
 // AmbiDecode
 
 float AmbiDecode::flavorWeights[4][5][5] = {
@@ -202,7 +301,8 @@ float AmbiDecode::flavorWeights[4][5][5] = {
     }};
 
 AmbiDecode::AmbiDecode(int dim, int order, int numSpeakers, int flav)
-    : AmbiBase(dim, order), mNumSpeakers(0), mDecodeMatrix(nullptr) {
+    : AmbiBase(dim, order), mNumSpeakers(0), mFlavor(1),
+      mDecodeMatrix(nullptr) {
   resizeArrays(channels(), numSpeakers);
   flavor(flav);
 }
@@ -212,49 +312,136 @@ AmbiDecode::~AmbiDecode() {
   // delete[] mSpeakers; // listener now owns speakers and will delete them
 }
 
-void AmbiDecode::decode(float *dec, const float *ambi, int numDecFrames) const {
-  // iterate speakers
-  for (int s = 0; s < numSpeakers(); ++s) {
-    // skip zero-amp speakers:
-    if (mSpeakers[s].gain != 0.) {
-      float *out = dec + mSpeakers[s].deviceChannel * numDecFrames;
+namespace {
+
+// Block sizes for the decode matrix multiply. Accumulators for 4 speakers by
+// 8 frames fit in the vector registers, and a tile of 64 frames of the
+// Ambisonic block (64 channels at 7th order) stays in L1 cache while all
+// speakers are decoded from it.
+const int kDecodeFrameTile = 64;
+const int kDecodeSpeakers = 4;
+const int kDecodeFrames = 8;
+
+// out[s] += sum_c gains[s][c] * ambi[c] for all active speakers. gains are
+// packed as [speaker / 4][channel][speaker % 4] and padded with zero gains.
+template <class AmbiRow, class OutRow>
+void decodeTiled(const float *gains, const std::vector<int> &outputs,
+                 int numChannels, int numFrames, AmbiRow ambiRow,
+                 OutRow outRow) {
+  const int numSpeakers = int(outputs.size());
+
+  for (int f0 = 0; f0 < numFrames; f0 += kDecodeFrameTile) {
+    const int f1 = std::min(f0 + kDecodeFrameTile, numFrames);
+    for (int s0 = 0; s0 < numSpeakers; s0 += kDecodeSpeakers) {
+      const int ns = std::min(kDecodeSpeakers, numSpeakers - s0);
+      const float *g = gains + s0 * numChannels;
+      float *out[kDecodeSpeakers];
+      for (int s = 0; s < ns; ++s) {
+        out[s] = outRow(outputs[s0 + s]);
+      }
 
-      // iterate ambi channels
-      for (int c = 0; c < channels(); ++c) {
-        const float *in = ambi + c * numDecFrames;
-        float w = decodeWeight(s, c);
-        for (int i = 0; i < numDecFrames; ++i)
-          out[i] += in[i] * w;
+      int f = f0;
+      for (; f + kDecodeFrames <= f1; f += kDecodeFrames) {
+        float acc[kDecodeSpeakers][kDecodeFrames] = {};
+        for (int c = 0; c < numChannels; ++c) {
+          const float *in = ambiRow(c) + f;
+          const float *w = g + c * kDecodeSpeakers;
+          for (int s = 0; s < kDecodeSpeakers; ++s) {
+            for (int i = 0; i < kDecodeFrames; ++i) {
+              acc[s][i] += w[s] * in[i];
+            }
+          }
+        }
+        for (int s = 0; s < ns; ++s) {
+          for (int i = 0; i < kDecodeFrames; ++i) {
+            out[s][f + i] += acc[s][i];
+          }
+        }
+      }
+
+      // Frames left over when the block is not a multiple of kDecodeFrames
+      for (; f < f1; ++f) {
+        float acc[kDecodeSpeakers] = {};
+        for (int c = 0; c < numChannels; ++c) {
+          const float in = ambiRow(c)[f];
+          const float *w = g + c * kDecodeSpeakers;
+          for (int s = 0; s < kDecodeSpeakers; ++s) {
+            acc[s] += w[s] * in;
+          }
+        }
+        for (int s = 0; s < ns; ++s) {
+          out[s][f] += acc[s];
+        }
       }
     }
   }
 }
 
-void AmbiDecode::decode(float **dec, const float **ambi,
-                        int numDecFrames) const {
-  // iterate speakers
-  for (int s = 0; s < numSpeakers(); ++s) {
-    // skip zero-amp speakers:
-    if (mSpeakers[s].gain != 0.) {
-      float *out = dec[mSpeakers[s].deviceChannel];
-
-      // iterate ambi channels
-      for (int c = 0; c < channels(); ++c) {
-        const float *in = ambi[c];
-        float w = decodeWeight(s, c);
-        for (int i = 0; i < numDecFrames; ++i)
-          out[i] += in[i] * w;
+// Per order decoder weights for orders and conventions not covered by the
+// flavorWeights table
+void computeOrderWeights(std::vector<float> &w, int flavor, int dim,
+                         int order) {
+  for (int l = 0; l <= order; ++l) {
+    double g = 1.0;
+    if (flavor == 2) {
+      // in phase
+      for (int k = 1; k <= l; ++k) {
+        g *= dim == 2 ? double(order - k + 1) / (order + k)
+                      : double(order - k + 1) / (order + k + 1);
+      }
+    } else if (flavor != 0) {
+      // max-rE
+      if (dim == 2) {
+        g = std::cos(l * M_PI / (2 * order + 2));
+      } else {
+        // Legendre polynomial P_l at the rE of the decoder
+        double x = std::cos(137.9 * M_PI / 180.0 / (order + 1.51));
+        double p0 = 1.0;
+        double p1 = x;
+        g = l == 0 ? p0 : p1;
+        for (int k = 2; k <= l; ++k) {
+          g = ((2 * k - 1) * x * p1 - (k - 1) * p0) / k;
+          p0 = p1;
+          p1 = g;
+        }
       }
     }
+    w[l] = float(g);
+  }
+}
+
+} // namespace
+
+void AmbiDecode::decode(float *dec, const float *ambi, int numDecFrames) const {
+  if (mDecodeGainsDirty) {
+    updateDecodeGains();
+  }
+  if (mDecodeOutputs.empty()) {
+    return;
+  }
+  decodeTiled(
+      mDecodeGains.data(), mDecodeOutputs, channels(), numDecFrames,
+      [&](int c) { return ambi + c * numDecFrames; },
+      [&](int deviceChannel) { return dec + deviceChannel * numDecFrames; });
+}
+
+void AmbiDecode::decode(float **dec, const float **ambi,
+                        int numDecFrames) const {
+  if (mDecodeGainsDirty) {
+    updateDecodeGains();
+  }
+  if (mDecodeOutputs.empty()) {
+    return;
   }
+  decodeTiled(
+      mDecodeGains.data(), mDecodeOutputs, channels(), numDecFrames,
+      [&](int c) { return ambi[c]; },
+      [&](int deviceChannel) { return dec[deviceChannel]; });
 }
 
 void AmbiDecode::flavor(int type) {
   if (type < 4) {
     mFlavor = type;
-    const int No = sizeof(mWOrder) / sizeof(mWOrder[0]);
-    for (int i = 0; i < No; ++i)
-      mWOrder[i] = flavorWeights[flavor()][i][order()];
     updateChanWeights();
   }
 }
@@ -271,16 +458,18 @@ void AmbiDecode::setSpeakerRadians(int index, int deviceChannel, float az,
     return;
   }
 
-  mSpeakers[index].azimuth = az;
-  mSpeakers[index].elevation = el;
+  // Speaker stores angles in degrees
+  if (mClockwiseAzimuth) {
+    az = -az;
+  }
+  mSpeakers[index].azimuth = az * float(180.0 / M_PI);
+  mSpeakers[index].elevation = el * float(180.0 / M_PI);
   mSpeakers[index].deviceChannel = deviceChannel;
   mSpeakers[index].gain = amp;
 
-  // update encoding weights
-  encodeWeightsFuMa(mDecodeMatrix + index * channels(), mDim, mOrder, az, el);
-  for (int i = 0; i < channels(); i++) {
-    mDecodeMatrix[index * channels() + i] *= amp;
-  }
+  computeSpeakerRow(index);
+  // Packed once on the next decode() rather than for every speaker set
+  mDecodeGainsDirty = true;
 }
 
 void AmbiDecode::setSpeaker(int index, int deviceChannel, float az, float el,
@@ -289,89 +478,102 @@ void AmbiDecode::setSpeaker(int index, int deviceChannel, float az, float el,
                     el *float(0.01745329252), amp);
 }
 
-void AmbiDecode::setSpeakers(Speakers *spkrs) {
-  //	mSpeakers.resize(spkrs->size());
-  //	for (unsigned i = 0; i < mSpeakers.size(); i++) {
-  //		Speaker &spkr = spkrs->at(i);
-  //		setSpeaker(i, spkr.deviceChannel, spkr.azimuth, spkr.elevation,
-  // spkr.gain);
-  //	}
-  setSpeakers(*spkrs);
+void AmbiDecode::setSpeakers(Speakers *spkrs) { setSpeakers(*spkrs); }
+
+void AmbiDecode::clockwiseAzimuth(bool enable) {
+  if (enable != mClockwiseAzimuth) {
+    mClockwiseAzimuth = enable;
+    resizeArrays(channels(), mNumSpeakers);
+  }
 }
 
 void AmbiDecode::setSpeakers(Speakers &spkrs) {
   mSpeakers = spkrs;
+  // recomputes the decode matrix from the new speakers
   resizeArrays(channels(), mSpeakers.size());
+}
+
+void AmbiDecode::computeSpeakerRow(int index) {
+  const Speaker &spkr = mSpeakers[index];
+  float *row = mDecodeMatrix + index * channels();
+  // Ambisonic azimuth is anti-clockwise
+  float az = Speaker::toRad(spkr.azimuth);
+  if (mClockwiseAzimuth) {
+    az = -az;
+  }
+  float el = Speaker::toRad(spkr.elevation);
+
   // update encoding weights
-  for (int i = 0; i < mSpeakers.size(); i++) {
-    for (int index = 0; index < channels(); index++) {
-      encodeWeightsFuMa(mDecodeMatrix + index * channels(), mDim, mOrder,
-                        mSpeakers[i].azimuth, mSpeakers[i].elevation);
-      for (int i = 0; i < channels(); i++) {
-        mDecodeMatrix[index * channels() + i] *= mSpeakers[i].gain;
-      }
-    }
+  if (mConvention == ACN_SN3D) {
+    encodeWeightsACN(row, mDim, mOrder, az, el);
+  } else {
+    encodeWeightsFuMa(row, mDim, mOrder, az, el);
+  }
+  for (int i = 0; i < channels(); i++) {
+    row[i] *= spkr.gain;
   }
 }
 
 void AmbiDecode::updateChanWeights() {
-  float *wc = mWeights;
-  *wc++ = mWOrder[0];
-
-  if (mOrder > 0) {
-    *wc++ = mWOrder[1]; // X
-    *wc++ = mWOrder[1]; // Y
-    if (mOrder > 1) {
-      *wc++ = mWOrder[2]; // U
-      *wc++ = mWOrder[2]; // V
-      if (mOrder > 2) {
-        *wc++ = mWOrder[3]; // P
-        *wc++ = mWOrder[3]; // Q
-      }
+  mWOrder.resize(mOrder + 1);
+  if (mConvention == FUMA && mOrder < 5) {
+    for (int l = 0; l <= mOrder; ++l) {
+      mWOrder[l] = flavorWeights[mFlavor][l][mOrder];
     }
+  } else {
+    computeOrderWeights(mWOrder, mFlavor, mDim, mOrder);
+  }
 
-    if (3 == mDim) {
-      *wc++ = mWOrder[1]; // Z
-      if (mOrder > 1) {
-        *wc++ = mWOrder[2]; // S
-        *wc++ = mWOrder[2]; // T
-        *wc++ = mWOrder[2]; // R
-        if (mOrder > 2) {
-          *wc++ = mWOrder[3]; // N
-          *wc++ = mWOrder[3]; // O
-          *wc++ = mWOrder[3]; // L
-          *wc++ = mWOrder[3]; // M
-          *wc = mWOrder[3];   // K
-        }
-      }
-    }
+  for (int c = 0; c < channels(); ++c) {
+    int degree = channelDegree(mConvention, mDim, mOrder, c);
+    mWeights[c] = degree >= 0 ? mWOrder[degree] : 0.f;
   }
+  updateDecodeGains();
 }
 
-void AmbiDecode::resizeArrays(int numChannels, int numSpeakers) {
-  int oldSize = channels() * mNumSpeakers;
-  int newSize = numChannels * numSpeakers;
-
-  if (oldSize != newSize) {
-    resize(mDecodeMatrix, newSize);
-    // resize(mFrame, newSize);
-
-    // resize number of speakers (?)
-    if (numSpeakers != mNumSpeakers) {
-      mNumSpeakers = numSpeakers;
-
-      // resize(mSpeakers, numSpeakers);
+void AmbiDecode::updateDecodeGains() const {
+  mDecodeGainsDirty = false;
+  mDecodeOutputs.clear();
+  for (int s = 0; s < mNumSpeakers; ++s) {
+    // skip zero-amp speakers:
+    if (mSpeakers[s].gain != 0.) {
+      mDecodeOutputs.push_back(s);
     }
+  }
 
-    //		// recompute decode matrix weights
-    //		for(int i=0; i<numSpeakers; i++){
-    //			setSpeaker(i, azimuths()[i], elevations()[i]);
-    //		}
-
-    updateChanWeights();
+  // Pack in groups of kDecodeSpeakers for decodeTiled()
+  int numActive = int(mDecodeOutputs.size());
+  int numPadded = (numActive + kDecodeSpeakers - 1) / kDecodeSpeakers *
+                  kDecodeSpeakers;
+  mDecodeGains.assign(numPadded * channels(), 0.f);
+  for (int a = 0; a < numActive; ++a) {
+    int s = mDecodeOutputs[a];
+    float *group = mDecodeGains.data() + (a - a % kDecodeSpeakers) * channels();
+    for (int c = 0; c < channels(); ++c) {
+      group[c * kDecodeSpeakers + a % kDecodeSpeakers] = decodeWeight(s, c);
+    }
+    mDecodeOutputs[a] = mSpeakers[s].deviceChannel;
   }
+}
 
+void AmbiDecode::resizeArrays(int numChannels, int numSpeakers) {
+  // Always reallocate: the number of channels may have changed while the
+  // matrix size stayed the same.
   mChannels = numChannels;
+  mNumSpeakers = numSpeakers;
+  resize(mDecodeMatrix, numChannels * numSpeakers);
+  mSpeakers.resize(numSpeakers);
+  // Reserve for all speakers so that updateDecodeGains() doesn't allocate
+  // when called from decode()
+  mDecodeGains.reserve((numSpeakers + kDecodeSpeakers - 1) / kDecodeSpeakers *
+                       kDecodeSpeakers * numChannels);
+  mDecodeOutputs.reserve(numSpeakers);
+
+  // recompute decode matrix weights
+  for (int i = 0; i < numSpeakers; i++) {
+    computeSpeakerRow(i);
+  }
+  updateChanWeights();
 }
 
 void AmbiDecode::onChannelsChange() { resizeArrays(channels(), mNumSpeakers); }
@@ -398,6 +600,250 @@ void AmbiDecode::print(std::ostream &stream) const {
   stream << std::endl;
 }
 
+// ---- AmbiRotate
+
+namespace {
+
+// P of the Ivanic-Ruedenberg recurrence. r1 is the first degree rotation
+// indexed [i + 1][j + 1], prev the rotation of degree l - 1.
+double rotationP(int i, int l, int a, int b, const double *r1,
+                 const double *prev) {
+  const int n = 2 * l - 1;
+  auto R1 = [&](int x, int y) { return r1[(x + 1) * 3 + y + 1]; };
+  auto Rp = [&](int x, int y) { return prev[(x + l - 1) * n + y + l - 1]; };
+  if (b == l) {
+    return R1(i, 1) * Rp(a, l - 1) - R1(i, -1) * Rp(a, -l + 1);
+  } else if (b == -l) {
+    return R1(i, 1) * Rp(a, -l + 1) + R1(i, -1) * Rp(a, l - 1);
+  }
+  return R1(i, 0) * Rp(a, b);
+}
+
+} // namespace
+
+AmbiRotate::AmbiRotate(int dim, int order) : AmbiBase(dim, order) {
+  onChannelsChange();
+}
+
+void AmbiRotate::onChannelsChange() {
+  // Gain of each channel relative to the ACN/SN3D harmonic with the same
+  // degree and index, measured at two directions where the harmonics are
+  // far from zero
+  const float dirs[2][3] = {{0.5234f, -0.3213f, 0.7891f},
+                            {-0.2711f, 0.8134f, 0.5146f}};
+  std::vector<float> conv(channels());
+  std::vector<float> acn(orderToChannels(3, mOrder));
+  std::vector<float> reference(channels(), 0.f);
+  mScales.assign(channels(), 1.f);
+  for (const auto &d : dirs) {
+    Vec3f dir = Vec3f(d[0], d[1], d[2]).normalize();
+    encodeWeights(conv.data(), mConvention, mDim, mOrder, dir.x, dir.y, dir.z);
+    encodeWeightsACN(acn.data(), 3, mOrder, dir.x, dir.y, dir.z);
+    for (int c = 0; c < channels(); ++c) {
+      int l = channelDegree(mConvention, mDim, mOrder, c);
+      int m = channelIndex(mConvention, mDim, mOrder, c);
+      float a = acn[l * l + l + m];
+      if (std::abs(a) > std::abs(reference[c])) {
+        reference[c] = a;
+        mScales[c] = conv[c] / a;
+      }
+    }
+  }
+
+  // Group channels by degree, ordered by index, with identity rotations
+  mDegrees.clear();
+  mDegrees.resize(mOrder + 1);
+  for (int l = 0; l <= mOrder; ++l) {
+    Degree &degree = mDegrees[l];
+    for (int m = -l; m <= l; ++m) {
+      for (int c = 0; c < channels(); ++c) {
+        if (channelDegree(mConvention, mDim, mOrder, c) == l &&
+            channelIndex(mConvention, mDim, mOrder, c) == m) {
+          degree.channels.push_back(c);
+        }
+      }
+    }
+    const int n = int(degree.channels.size());
+    degree.matrix.assign(n * n, 0.f);
+    for (int i = 0; i < n; ++i) {
+      degree.matrix[i * n + i] = 1.f;
+    }
+  }
+
+  const int maxSize = (2 * mOrder + 1) * (2 * mOrder + 1);
+  mRotation.assign(maxSize, 0.0);
+  mPrevRotation.assign(maxSize, 0.0);
+}
+
+void AmbiRotate::matrix(const double *r) {
+  if (mDim == 2) {
+    // Only the rotation about the vertical axis. Channels of each degree
+    // are ordered (sin, cos), and a rotation by yaw adds l * yaw to the
+    // phase of both.
+    double yaw = std::atan2(r[3], r[0]);
+    for (int l = 1; l <= mOrder; ++l) {
+      double c = std::cos(l * yaw);
+      double s = std::sin(l * yaw);
+      const double rotation[4] = {c, s, -s, c};
+      Degree &degree = mDegrees[l];
+      for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 2; ++j) {
+          degree.matrix[i * 2 + j] =
+              float(rotation[i * 2 + j] * mScales[degree.channels[i]] /
+                    mScales[degree.channels[j]]);
+        }
+      }
+    }
+    return;
+  }
+
+  // First degree harmonics are (y, z, x) for m = -1, 0, 1
+  const int axis[3] = {1, 2, 0};
+  double r1[9];
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      r1[i * 3 + j] = r[axis[i] * 3 + axis[j]];
+    }
+  }
+
+  // Scratch buffers are sized in onChannelsChange(), so this doesn't
+  // allocate when called every block
+  std::copy(r1, r1 + 9, mRotation.begin());
+  for (int l = 1; l <= mOrder; ++l) {
+    const int n = 2 * l + 1;
+    if (l > 1) {
+      mPrevRotation.swap(mRotation);
+      const double *prev = mPrevRotation.data();
+      double *rotation = mRotation.data();
+      for (int m = -l; m <= l; ++m) {
+        const int am = std::abs(m);
+        const double d = m == 0 ? 1.0 : 0.0;
+        for (int k = -l; k <= l; ++k) {
+          const double denom = std::abs(k) < l ? double(l + k) * (l - k)
+                                               : double(2 * l) * (2 * l - 1);
+          double u = std::sqrt((l + m) * (l - m) / denom);
+          double v = 0.5 * std::sqrt((1 + d) * (l + am - 1) * (l + am) / denom) *
+                     (1 - 2 * d);
+          double w = -0.5 * std::sqrt((l - am - 1) * (l - am) / denom) * (1 - d);
+
+          double value = 0;
+          if (u != 0) {
+            value += u * rotationP(0, l, m, k, r1, prev);
+          }
+          if (v != 0) {
+            double V;
+            if (m == 0) {
+              V = rotationP(1, l, 1, k, r1, prev) +
+                  rotationP(-1, l, -1, k, r1, prev);
+            } else if (m > 0) {
+              double d1 = m == 1 ? 1.0 : 0.0;
+              V = rotationP(1, l, m - 1, k, r1, prev) * std::sqrt(1 + d1) -
+                  rotationP(-1, l, -m + 1, k, r1, prev) * (1 - d1);
+            } else {
+              double d1 = m == -1 ? 1.0 : 0.0;
+              V = rotationP(1, l, m + 1, k, r1, prev) * (1 - d1) +
+                  rotationP(-1, l, -m - 1, k, r1, prev) * std::sqrt(1 + d1);
+            }
+            value += v * V;
+          }
+          if (w != 0) {
+            double W;
+            if (m > 0) {
+              W = rotationP(1, l, m + 1, k, r1, prev) +
+                  rotationP(-1, l, -m - 1, k, r1, prev);
+            } else {
+              W = rotationP(1, l, m - 1, k, r1, prev) -
+                  rotationP(-1, l, -m + 1, k, r1, prev);
+            }
+            value += w * W;
+          }
+          rotation[(m + l) * n + k + l] = value;
+        }
+      }
+    }
+
+    // Convert to the channel normalization of the convention
+    Degree &degree = mDegrees[l];
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        degree.matrix[i * n + j] =
+            float(mRotation[i * n + j] * mScales[degree.channels[i]] /
+                  mScales[degree.channels[j]]);
+      }
+    }
+  }
+}
+
+void AmbiRotate::rotation(const Quatd &q) {
+  double r[9];
+  for (int j = 0; j < 3; ++j) {
+    Vec3d axis(0, 0, 0);
+    axis[j] = 1;
+    Vec3d column = q.rotate(axis);
+    for (int i = 0; i < 3; ++i) {
+      r[i * 3 + j] = column[i];
+    }
+  }
+  matrix(r);
+}
+
+float AmbiRotate::rotationWeight(int outChannel, int inChannel) const {
+  int l = channelDegree(mConvention, mDim, mOrder, outChannel);
+  if (l < 0 || l != channelDegree(mConvention, mDim, mOrder, inChannel)) {
+    return 0.f;
+  }
+  const Degree &degree = mDegrees[l];
+  const int n = int(degree.channels.size());
+  int i = int(std::find(degree.channels.begin(), degree.channels.end(),
+                        outChannel) -
+              degree.channels.begin());
+  int j = int(std::find(degree.channels.begin(), degree.channels.end(),
+                        inChannel) -
+              degree.channels.begin());
+  return degree.matrix[i * n + j];
+}
+
+void AmbiRotate::numFrames(int numFrames) {
+  size_t size = size_t(orderToChannels(mDim, mOrder)) * numFrames;
+  if (mBuffer.size() < size) {
+    mBuffer.resize(size);
+  }
+}
+
+void AmbiRotate::rotate(float *ambiChans, int numFrames) {
+  // Sized by numFrames() outside the audio callback
+  assert(mBuffer.size() >= size_t(channels()) * numFrames);
+  if (mBuffer.size() < size_t(channels()) * numFrames) {
+    return;
+  }
+  // Degree 0 is invariant under rotation
+  for (int l = 1; l <= mOrder; ++l) {
+    const Degree &degree = mDegrees[l];
+    const int n = int(degree.channels.size());
+    for (int j = 0; j < n; ++j) {
+      memcpy(mBuffer.data() + j * numFrames,
+             ambiChans + degree.channels[j] * numFrames,
+             numFrames * sizeof(float));
+    }
+    for (int i = 0; i < n; ++i) {
+      float *out = ambiChans + degree.channels[i] * numFrames;
+      const float *row = degree.matrix.data() + i * n;
+      const float w0 = row[0];
+      const float *in = mBuffer.data();
+      for (int k = 0; k < numFrames; ++k) {
+        out[k] = w0 * in[k];
+      }
+      for (int j = 1; j < n; ++j) {
+        const float w = row[j];
+        in = mBuffer.data() + j * numFrames;
+        for (int k = 0; k < numFrames; ++k) {
+          out[k] += w * in[k];
+        }
+      }
+    }
+  }
+}
+
 // ---- AmbiEncode
 void AmbiEncode::print(std::ostream &stream) {
   stream << "Encode weights:" << std::endl;
@@ -411,12 +857,12 @@ void AmbiEncode::print(std::ostream &stream) {
 // Ambisonics Spatializer -----------------
 
 AmbisonicsSpatializer::AmbisonicsSpatializer()
-    : Spatializer({}), mDecoder(3, 1, 8, 1), mEncoder(3, 1) {}
+    : Spatializer({}), mDecoder(3, 1, 8, 1), mEncoder(3, 1), mRotate(3, 1) {}
 
 AmbisonicsSpatializer::AmbisonicsSpatializer(const Speakers &sl, int dim, int order,
                                              int flavor)
     : Spatializer(sl), mDecoder(dim, order, sl.size(), flavor),
-      mEncoder(dim, order){};
+      mEncoder(dim, order), mRotate(dim, order){};
 
 void AmbisonicsSpatializer::zeroAmbi() {
   assert(mAmbiDomainChannels.size() != 0 &&
@@ -431,24 +877,52 @@ void AmbisonicsSpatializer::configure(int dim, int order, int flavor) {
 
   mEncoder.dim(dim);
   mEncoder.order(order);
+
+  mRotate.dim(dim);
+  mRotate.order(order);
+  mRotationIdentity = true;
 }
 
-void AmbisonicsSpatializer::compile() {
-  mDecoder.setSpeakers(&mSpeakers);
+void AmbisonicsSpatializer::sceneCoordinates(bool enable) {
+  mSceneCoordinates = enable;
+  mDecoder.clockwiseAzimuth(enable);
+}
+
+void AmbisonicsSpatializer::convention(AmbiBase::Convention c) {
+  mDecoder.convention(c);
+  mEncoder.convention(c);
+  mRotate.convention(c);
+  mRotationIdentity = true;
+}
 
-  size_t numSpeakers = mSpeakers.size();
-  for (size_t i = 0; i < numSpeakers; i++) {
-    mDecoder.setSpeakerRadians(i, mSpeakers[i].deviceChannel,
-                               mSpeakers[i].azimuth, mSpeakers[i].elevation,
-                               mSpeakers[i].gain);
+void AmbisonicsSpatializer::listenerOrientation(const Quatd &orientation) {
+  mRotationIdentity = std::abs(orientation.w) >= 1.0 - 1e-9;
+  if (mRotationIdentity) {
+    return;
+  }
+  // Rotation matrix in Ambisonic coordinates: columns are the rotated axes.
+  // ambi (x, y, z) = graphics (-z, -x, y)
+  double r[9];
+  for (int j = 0; j < 3; ++j) {
+    Vec3d axis(0, 0, 0);
+    axis[j] = 1;
+    Vec3d column =
+        orientation.rotate(Vec3d(-axis.y, axis.z, -axis.x)); // to graphics
+    r[j] = -column.z;
+    r[3 + j] = -column.x;
+    r[6 + j] = column.y;
   }
+  mRotate.matrix(r);
 }
 
+void AmbisonicsSpatializer::compile() { mDecoder.setSpeakers(mSpeakers); }
+
 void AmbisonicsSpatializer::numFrames(unsigned int v) {
   mNumFrames = v;
   if (mAmbiDomainChannels.size() != (unsigned long)(mDecoder.channels() * v)) {
     mAmbiDomainChannels.resize(mDecoder.channels() * v);
   }
+  mRotate.numFrames(v);
 }
 
 void AmbisonicsSpatializer::numSpeakers(int num) { mDecoder.numSpeakers(num); }
@@ -466,6 +940,22 @@ void AmbisonicsSpatializer::prepare(AudioIOData &io) {
   zeroAmbi();
 }
 
+void AmbisonicsSpatializer::encoderDirection(const Vec3f &pos) {
+  if (!mSceneCoordinates) {
+    mEncoder.direction(pos);
+    return;
+  }
+  // pos is in graphics coordinates relative to the listener
+  Vec3f direction(-pos.z, -pos.x, pos.y);
+  float mag = direction.mag();
+  if (mag > 1e-6f) {
+    direction /= mag;
+  } else {
+    direction = Vec3f(1, 0, 0);
+  }
+  mEncoder.direction(direction);
+}
+
 void AmbisonicsSpatializer::renderBuffer(AudioIOData &io, const Vec3f &pos,
                                          const float *samples,
                                          const unsigned int &numFrames) {
@@ -489,7 +979,7 @@ void AmbisonicsSpatializer::renderBuffer(AudioIOData &io, const Vec3f &pos,
   //  Quatd srcRot = listeningPose.quat();
   //  direction = srcRot.rotate(direction);
   //  direction = Vec3d(-direction.z, -direction.x, direction.y).normalize();
-  mEncoder.direction(pos);
+  encoderDirection(pos);
   //	for(int i = 0; i < numFrames; i++){
   ////		// cheaper:
   ////		Vec3d direction =
@@ -538,7 +1028,7 @@ void AmbisonicsSpatializer::renderSample(AudioIOData &io, const Vec3f &pos,
   // mEncoder.direction(-rf, -rr, ru);
   //    mEncoder.direction(-direction[2], -direction[0], direction[1]);
   //  direction = Vec3d(-direction.z, -direction.x, direction.y).normalize();
-  mEncoder.direction(pos);
+  encoderDirection(pos);
   mEncoder.encode(ambiChans(), io.framesPerBuffer(), frameIndex, sample);
 }
 
@@ -548,6 +1038,10 @@ void AmbisonicsSpatializer::finalize(AudioIOData &io) {
   float *outs = &io.out(0, 0); // io.outBuffer();
   int numFrames = io.framesPerBuffer();
 
+  if (rotatesSoundfield() && !mRotationIdentity) {
+    mRotate.rotate(ambiChans(), mNumFrames);
+  }
+
   mDecoder.decode(outs, ambiChans(), numFrames);
 }
 
@@ -0,0 +1,314 @@
+#include "al/sound/al_BassManagement.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "al/sound/al_Crossover.hpp"
+
+using namespace al;
+
+BassManagement::BassManagement(float crossoverFrequency, double sampleRate)
+    : mFrequency(crossoverFrequency), mSampleRate(sampleRate) {
+  updateCoefficients();
+  mLows.resize(512);
+}
+
+void BassManagement::setSpeakers(const Speakers& speakers,
+                                 const std::vector<int>& subwooferChannels) {
+  mSpeakers.clear();
+  mSpeakerChannels.clear();
+  mSubwooferChannels.clear();
+  for (auto& speaker : speakers) {
+    if (std::find(subwooferChannels.begin(), subwooferChannels.end(),
+                  int(speaker.deviceChannel)) != subwooferChannels.end()) {
+      continue;  // Subwoofers in the layout are not split
+    }
+    mSpeakers.push_back(speaker);
+    mSpeakerChannels.emplace_back();
+    mSpeakerChannels.back().deviceChannel = int(speaker.deviceChannel);
+  }
+  for (int deviceChannel : subwooferChannels) {
+    mSubwooferChannels.emplace_back();
+    mSubwooferChannels.back().deviceChannel = deviceChannel;
+  }
+  if (mSubwooferChannels.empty()) {
+    std::cerr << "BassManagement: no subwoofers, lows will be dropped"
+              << std::endl;
+  }
+
+  size_t numLanes =
+      (mSpeakerChannels.size() + kLanes - 1) / kLanes * size_t(kLanes);
+  mZ0.assign(numLanes, 0.f);
+  mZ1.assign(numLanes, 0.f);
+  mZ2.assign(numLanes, 0.f);
+  allocateDelays();
+}
+
+void BassManagement::crossoverFrequency(float frequency) {
+  mFrequency = frequency;
+  updateCoefficients();
+}
+
+void BassManagement::sampleRate(double rate) {
+  if (rate != mSampleRate) {
+    mSampleRate = rate;
+    updateCoefficients();
+    allocateDelays();
+  }
+}
+
+void BassManagement::prepare(const AudioIOData& io) {
+  sampleRate(io.framesPerSecond());
+  mLows.resize(std::max(io.framesPerBuffer(), uint64_t(1)));
+}
+
+void BassManagement::maxDelay(float seconds) {
+  mMaxDelay = std::max(seconds, 0.f);
+  allocateDelays();
+}
+
+void BassManagement::delay(int deviceChannel, float seconds) {
+  Channel* channel = findChannel(deviceChannel);
+  if (!channel) {
+    std::cerr << "BassManagement: channel " << deviceChannel
+              << " is not a speaker or subwoofer" << std::endl;
+    return;
+  }
+  int frames = int(std::lround(seconds * mSampleRate));
+  int maxFrames = int(channel->delayLine.size()) - 1;
+  if (frames > maxFrames) {
+    std::cerr << "BassManagement: delay of " << seconds
+              << " s is longer than maxDelay()" << std::endl;
+  }
+  channel->delayTime = seconds;
+  channel->delay = std::max(0, std::min(frames, maxFrames));
+}
+
+float BassManagement::delay(int deviceChannel) const {
+  const Channel* channel = findChannel(deviceChannel);
+  return channel ? float(channel->delay / mSampleRate) : 0.f;
+}
+
+void BassManagement::gain(int deviceChannel, float gain) {
+  Channel* channel = findChannel(deviceChannel);
+  if (!channel) {
+    std::cerr << "BassManagement: channel " << deviceChannel
+              << " is not a speaker or subwoofer" << std::endl;
+    return;
+  }
+  channel->gain = gain;
+}
+
+float BassManagement::gain(int deviceChannel) const {
+  const Channel* channel = findChannel(deviceChannel);
+  return channel ? channel->gain : 0.f;
+}
+
+void BassManagement::compensateDistances(float speedOfSound) {
+  float maxRadius = 0.f;
+  for (auto& speaker : mSpeakers) {
+    maxRadius = std::max(maxRadius, speaker.radius);
+  }
+  if (maxRadius <= 0.f) {
+    return;
+  }
+  float longest = 0.f;
+  for (auto& speaker : mSpeakers) {
+    longest = std::max(longest, (maxRadius - speaker.radius) / speedOfSound);
+  }
+  if (longest > mMaxDelay) {
+    maxDelay(longest);
+  }
+  for (auto& speaker : mSpeakers) {
+    delay(speaker.deviceChannel, (maxRadius - speaker.radius) / speedOfSound);
+    gain(speaker.deviceChannel, speaker.radius / maxRadius);
+  }
+}
+
+void BassManagement::reset() {
+  std::fill(mZ0.begin(), mZ0.end(), 0.f);
+  std::fill(mZ1.begin(), mZ1.end(), 0.f);
+  std::fill(mZ2.begin(), mZ2.end(), 0.f);
+  for (auto* channels : {&mSpeakerChannels, &mSubwooferChannels}) {
+    for (auto& channel : *channels) {
+      std::fill(channel.delayLine.begin(), channel.delayLine.end(), 0.f);
+    }
+  }
+}
+
+void BassManagement::onAudioCB(AudioIOData& io) {
+  const int numFrames = int(io.framesPerBuffer());
+  const int maxFrames = int(mLows.size());
+  for (int offset = 0; offset < numFrames; offset += maxFrames) {
+    process(io, offset, std::min(maxFrames, numFrames - offset));
+  }
+}
+
+void BassManagement::process(AudioIOData& io, int offset, int numFrames) {
+  const int numChannels = int(io.channelsOut());
+  std::fill(mLows.begin(), mLows.begin() + numFrames, 0.f);
+
+  // Split speakers a group of lanes at a time. Frames are transposed into a
+  // tile so the filters run across lanes. The offset keeping state out of
+  // denormals is far below Crossover's, which would add a DC offset once the
+  // lows of many speakers are summed.
+  static const float denormOffset = 1e-18f;
+  const float c0 = mC0;
+  const float c1 = mC1;
+  const int numSpeakers = int(mSpeakerChannels.size());
+  for (int g = 0; g < numSpeakers; g += kLanes) {
+    float* buffers[kLanes];
+    float z0[kLanes], z1[kLanes], z2[kLanes];
+    for (int l = 0; l < kLanes; l++) {
+      const int index = g + l;
+      buffers[l] = nullptr;
+      if (index < numSpeakers &&
+          mSpeakerChannels[index].deviceChannel < numChannels) {
+        buffers[l] =
+            io.outBuffer(mSpeakerChannels[index].deviceChannel) + offset;
+      }
+      z0[l] = mZ0[index];
+      z1[l] = mZ1[index];
+      z2[l] = mZ2[index];
+    }
+
+    for (int i = 0; i < numFrames; i += kTile) {
+      const int n = std::min(kTile, numFrames - i);
+      float x[kTile][kLanes];
+      float lo[kTile][kLanes];
+      for (int l = 0; l < kLanes; l++) {
+        for (int j = 0; j < n; j++) {
+          x[j][l] = buffers[l] ? buffers[l][i + j] : 0.f;
+        }
+      }
+      // Crossover<float>::next() for every lane
+      for (int j = 0; j < n; j++) {
+        for (int l = 0; l < kLanes; l++) {
+          const float in = x[j][l];
+          const float v0 = in - c0 * z0[l];
+          const float x0 = z0[l] + c0 * v0;
+          const float v1 = c1 * (in - z1[l]);
+          const float x1 = v1 + z1[l];
+          const float v2 = c1 * (x1 - z2[l]);
+          const float x2 = v2 + z2[l];
+          z0[l] = v0 + denormOffset;
+          z1[l] = v1 + x1 + denormOffset;
+          z2[l] = v2 + x2 + denormOffset;
+          lo[j][l] = x2;
+          x[j][l] = x0 - x2;
+        }
+      }
+      for (int j = 0; j < n; j++) {
+        float sum = 0.f;
+        for (int l = 0; l < kLanes; l++) {
+          sum += lo[j][l];
+        }
+        mLows[i + j] += sum;
+      }
+      for (int l = 0; l < kLanes; l++) {
+        if (buffers[l]) {
+          for (int j = 0; j < n; j++) {
+            buffers[l][i + j] = x[j][l];
+          }
+        }
+      }
+    }
+
+    for (int l = 0; l < kLanes; l++) {
+      mZ0[g + l] = z0[l];
+      mZ1[g + l] = z1[l];
+      mZ2[g + l] = z2[l];
+    }
+  }
+
+  if (!mSubwooferChannels.empty()) {
+    const float share = 1.f / mSubwooferChannels.size();
+    for (auto& sub : mSubwooferChannels) {
+      if (sub.deviceChannel < numChannels) {
+        float* out = io.outBuffer(sub.deviceChannel) + offset;
+        for (int i = 0; i < numFrames; i++) {
+          out[i] += mLows[i] * share;
+        }
+      }
+    }
+  }
+
+  for (auto* channels : {&mSpeakerChannels, &mSubwooferChannels}) {
+    for (auto& channel : *channels) {
+      if (channel.deviceChannel < numChannels) {
+        applyDelayAndGain(channel,
+                          io.outBuffer(channel.deviceChannel) + offset,
+                          numFrames);
+      }
+    }
+  }
+}
+
+BassManagement::Channel* BassManagement::findChannel(int deviceChannel) {
+  for (auto* channels : {&mSpeakerChannels, &mSubwooferChannels}) {
+    for (auto& channel : *channels) {
+      if (channel.deviceChannel == deviceChannel) {
+        return &channel;
+      }
+    }
+  }
+  return nullptr;
+}
+
+const BassManagement::Channel* BassManagement::findChannel(
+    int deviceChannel) const {
+  return const_cast<BassManagement*>(this)->findChannel(deviceChannel);
+}
+
+void BassManagement::updateCoefficients() {
+  Crossover<float>::coefficients(mFrequency, float(mSampleRate), mC0, mC1);
+}
+
+void BassManagement::allocateDelays() {
+  // Power of two sizes so indices wrap with a mask
+  size_t size = 1;
+  while (size < size_t(std::ceil(mMaxDelay * mSampleRate)) + 1) {
+    size *= 2;
+  }
+  for (auto* channels : {&mSpeakerChannels, &mSubwooferChannels}) {
+    for (auto& channel : *channels) {
+      channel.delayLine.assign(size, 0.f);
+      channel.writeIndex = 0;
+      // Keep the delay time when the sample rate changes
+      int frames = int(std::lround(channel.delayTime * mSampleRate));
+      channel.delay = std::max(0, std::min(frames, int(size) - 1));
+    }
+  }
+}
+
+void BassManagement::applyDelayAndGain(Channel& channel, float* buffer,
+                                       int numFrames) {
+  const float gain = channel.gain;
+  if (channel.delay == 0) {
+    if (gain != 1.f) {
+      for (int i = 0; i < numFrames; i++) {
+        buffer[i] *= gain;
+      }
+    }
+    return;
+  }
+  // Copy in and out of the ring in at most two contiguous pieces each
+  float* line = channel.delayLine.data();
+  const size_t size = channel.delayLine.size();
+  const size_t mask = size - 1;
+  size_t write = channel.writeIndex;
+  size_t done = 0;
+  while (done < size_t(numFrames)) {
+    size_t n = std::min(size_t(numFrames) - done, size - write);
+    size_t read = (write - size_t(channel.delay)) & mask;
+    n = std::min(n, size - read);
+    std::copy(buffer + done, buffer + done + n, line + write);
+    for (size_t i = 0; i < n; i++) {
+      buffer[done + i] = line[read + i] * gain;
+    }
+    write = (write + n) & mask;
+    done += n;
+  }
+  channel.writeIndex = write;
+}
@@ -23,6 +23,11 @@ BiQuad::BiQuad(BIQUADTYPE _type, double _sampleRate)
 BiQuad::~BiQuad() {}
 
 void BiQuad::set(double freq, double bandwidth, double dbGain) {
+  design(mBD, mType, mSampleRate, freq, bandwidth, dbGain);
+}
+
+void BiQuad::design(BiquadData &bd, BIQUADTYPE type, double sampleRate,
+                    double freq, double bandwidth, double dbGain) {
   // TODO all the way to fs/2, range
   if (freq > 20000)
     freq = 20000;
@@ -34,13 +39,13 @@ void BiQuad::set(double freq, double bandwidth, double dbGain) {
 
   // setup variables
   A = pow(10, dbGain / 40);
-  omega = 2 * M_PI * freq / (1 * mSampleRate); // 1X or 2X oversampled
+  omega = 2 * M_PI * freq / (1 * sampleRate); // 1X or 2X oversampled
   sn = sin(omega);
   cs = cos(omega);
   alpha = sn * sinh(M_LN2 / 2 * bandwidth * omega / sn);
   beta = sqrt(A + A);
 
-  switch (mType) {
+  switch (type) {
   case BIQUAD_LPF:
     b0 = (1 - cs) / 2;
     b1 = 1 - cs;
@@ -101,11 +106,11 @@ void BiQuad::set(double freq, double bandwidth, double dbGain) {
     return;
   }
 
-  mBD.a0 = b0 / a0;
-  mBD.a1 = b1 / a0;
-  mBD.a2 = b2 / a0;
-  mBD.a3 = a1 / a0;
-  mBD.a4 = a2 / a0;
+  bd.a0 = b0 / a0;
+  bd.a1 = b1 / a0;
+  bd.a2 = b2 / a0;
+  bd.a3 = a1 / a0;
+  bd.a4 = a2 / a0;
 }
 
 void BiQuad::processBuffer(float *buffer, int count) {
@@ -3,11 +3,22 @@
 #include <cstdint>
 #include <cstring>
 #include "al/io/al_AudioIOData.hpp"
+#include "al/math/al_Tile.hpp"
 
+#include <algorithm>
 #include <cinttypes>
+#include <cmath>
+#include <iostream>
 
 using namespace al;
 
+namespace {
+
+// Frames mixed at a time. A tile of every bus stays in L1 cache.
+const int kMixFrames = 64;
+
+} // namespace
+
 void DownMixer::layoutToStereo(const Speakers &sl, AudioIOData &io) {
   uint32_t leftChannel = 0;
   uint32_t rightChannel = 1;
@@ -33,13 +44,7 @@ void DownMixer::layoutToStereo(const Speakers &sl, AudioIOData &io) {
       mRoutingMap[spkr.deviceChannel].push_back({rightChannel, r});
     }
   }
-  if (mBusStartNumber == -1) {
-
-    mBusStartNumber = io.channelsBus();
-    io.channelsBus(io.channelsBus() + 2);
-  } else {
-    // TODO check if we have enough buses
-  }
+  compile(io, 2);
 }
 
 void DownMixer::set5_1toStereo(AudioIOData &io) {
@@ -57,44 +62,148 @@ void DownMixer::set5_1toStereo(AudioIOData &io) {
   mRoutingMap[3] = {{leftChannel, sixDbDown}};
   mRoutingMap[4] = {{rightChannel, sixDbDown}};
   mRoutingMap[5] = {{leftChannel, sixDbDown}, {rightChannel, sixDbDown}};
+  compile(io, 2);
+}
+
+void DownMixer::layoutToLayout(const Speakers &from, const Speakers &to,
+                               AudioIOData &io) {
+  mRoutingMap.clear();
+  if (to.empty()) {
+    std::cerr << "DownMixer: target layout has no speakers" << std::endl;
+    compile(io, 0);
+    return;
+  }
+  std::vector<Vec3d> targets;
+  for (const auto &spkr : to) {
+    targets.push_back(spkr.vec().normalized());
+  }
+  std::vector<float> gains(to.size());
+  for (const auto &spkr : from) {
+    const Vec3d source = spkr.vec().normalized();
+    float power = 0.0f;
+    size_t closest = 0;
+    for (size_t i = 0; i < targets.size(); i++) {
+      double cosine = source.dot(targets[i]);
+      gains[i] = cosine > 1e-6 ? float(cosine) : 0.0f;
+      power += gains[i] * gains[i];
+      if (cosine > source.dot(targets[closest])) {
+        closest = i;
+      }
+    }
+    if (power == 0.0f) {
+      mRoutingMap[spkr.deviceChannel] = {{uint32_t(closest), 1.0f}};
+      continue;
+    }
+    const float normalization = 1.0f / std::sqrt(power);
+    for (size_t i = 0; i < targets.size(); i++) {
+      if (gains[i] > 0.0f) {
+        mRoutingMap[spkr.deviceChannel].push_back(
+            {uint32_t(i), gains[i] * normalization});
+      }
+    }
+  }
+  compile(io, uint32_t(to.size()));
+}
+
+void DownMixer::setMatrix(const std::vector<std::vector<float>> &gains,
+                          AudioIOData &io) {
+  mRoutingMap.clear();
+  for (size_t output = 0; output < gains.size(); output++) {
+    for (size_t input = 0; input < gains[output].size(); input++) {
+      if (gains[output][input] != 0.0f) {
+        mRoutingMap[uint32_t(input)].push_back(
+            {uint32_t(output), gains[output][input]});
+      }
+    }
+  }
+  compile(io, uint32_t(gains.size()));
+}
+
+void DownMixer::compile(AudioIOData &io, uint32_t numOutputs) {
   if (mBusStartNumber == -1) {
     mBusStartNumber = io.channelsBus();
-    io.channelsBus(io.channelsBus() + 2);
-  } else {
-    // TODO check if we have enough buses
+    io.channelsBus(io.channelsBus() + int(numOutputs));
+    mNumBuses = int(numOutputs);
+  } else if (int(numOutputs) > mNumBuses) {
+    if (mBusStartNumber + mNumBuses == int(io.channelsBus())) {
+      // Our buses are the last ones, so they can grow
+      io.channelsBus(mBusStartNumber + int(numOutputs));
+      mNumBuses = int(numOutputs);
+    } else {
+      std::cerr << "DownMixer: buses were added after the downmix buses. "
+                   "Only mixing to "
+                << mNumBuses << " of " << numOutputs << " outputs."
+                << std::endl;
+      numOutputs = uint32_t(mNumBuses);
+    }
   }
+
+  // Transpose the input to output map into rows per output
+  std::vector<std::vector<Route>> rows(numOutputs);
+  for (const auto &mapEntry : mRoutingMap) {
+    for (const auto &routing : mapEntry.second) {
+      if (routing.first < numOutputs) {
+        rows[routing.first].push_back({mapEntry.first, routing.second});
+      }
+    }
+  }
+  mRoutes.clear();
+  mRowStart.assign(1, 0);
+  for (const auto &row : rows) {
+    // mRoutingMap is ordered by input, so rows read the inputs in order
+    mRoutes.insert(mRoutes.end(), row.begin(), row.end());
+    mRowStart.push_back(uint32_t(mRoutes.size()));
+  }
+  mScratch.assign(size_t(numOutputs) * kMixFrames, 0.0f);
 }
 
 void DownMixer::setStereoOutput() { setOutputs({0, 1}); }
 
 void DownMixer::setOutputs(std::vector<uint32_t> outs) { mOuts = outs; }
 
-void DownMixer::downMixToBus(AudioIOData &io) {
-  // Zero bus buffers
-  for (int i = mBusStartNumber; i < io.channelsBus(); i++) {
-    memset(io.busBuffer(i), 0, io.framesPerBuffer() * sizeof(float));
-  }
-  io.frame(0);
-  while (io()) {
-    for (const auto &mapEntry : mRoutingMap) {
-      for (const auto &routing : mapEntry.second) {
-        io.bus(routing.first) += io.out(mapEntry.first) * routing.second;
+void DownMixer::mix(AudioIOData &io, bool toOuts) {
+  const int numFrames = io.framesPerBuffer();
+  const uint32_t numInputs = uint32_t(io.channelsOut());
+  const uint32_t outputs = numOutputs();
+
+  for (int f0 = 0; f0 < numFrames; f0 += kMixFrames) {
+    const int tileFrames = std::min(kMixFrames, numFrames - f0);
+    // All buses are accumulated before any is written, as outputs may be
+    // inputs of other buses
+    for (uint32_t o = 0; o < outputs; o++) {
+      float acc[kMixFrames] = {};
+      for (uint32_t r = mRowStart[o]; r < mRowStart[o + 1]; r++) {
+        const Route &route = mRoutes[r];
+        if (route.input >= numInputs) {
+          continue;
+        }
+        const float *in = io.outBuffer(int(route.input)) + f0;
+        tiledAddScaled(acc, in, route.gain, unsigned(tileFrames));
+      }
+      memcpy(&mScratch[size_t(o) * kMixFrames], acc,
+             tileFrames * sizeof(float));
+    }
+    for (uint32_t o = 0; o < outputs; o++) {
+      const float *acc = &mScratch[size_t(o) * kMixFrames];
+      memcpy(io.busBuffer(mBusStartNumber + int(o)) + f0, acc,
+             tileFrames * sizeof(float));
+      if (toOuts && o < mOuts.size() && mOuts[o] != UINT32_MAX) {
+        memcpy(io.outBuffer(int(mOuts[o])) + f0, acc,
+               tileFrames * sizeof(float));
       }
     }
   }
 }
 
+void DownMixer::downMixToBus(AudioIOData &io) { mix(io, false); }
+
 void DownMixer::copyBusToOuts(AudioIOData &io) {
-  int offset = io.channelsBus() - mOuts.size();
-  for (size_t i = 0; i < mOuts.size(); i++) {
+  for (size_t i = 0; i < mOuts.size() && int(i) < mNumBuses; i++) {
     if (mOuts[i] != UINT32_MAX) {
-      memcpy(io.outBuffer(mOuts[i]), io.busBuffer(offset + i),
+      memcpy(io.outBuffer(mOuts[i]), io.busBuffer(mBusStartNumber + int(i)),
              io.framesPerBuffer() * sizeof(float));
     }
   }
 }
 
-void DownMixer::downMix(AudioIOData &io) {
-  downMixToBus(io);
-  copyBusToOuts(io);
-}
+void DownMixer::downMix(AudioIOData &io) { mix(io, true); }
@@ -162,3 +162,39 @@ uint64_t SoundFileStreaming::getFrames(uint64_t numFrames, float* buffer) {
       drwav_read_pcm_frames_f32((drwav*)mImpl, numFrames, buffer);
   return framesRead;
 }
+
+SoundFileWriter::~SoundFileWriter() { close(); }
+
+bool SoundFileWriter::open(const char* path, uint32_t sampleRate,
+                           uint16_t numChannels) {
+  close();
+  drwav_data_format format;
+  format.container = drwav_container_riff;
+  format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+  format.channels = numChannels;
+  format.sampleRate = sampleRate;
+  format.bitsPerSample = 32;
+  drwav* wav = new drwav;
+  if (!drwav_init_file_write(wav, path, &format)) {
+    std::cerr << "ERROR opening file for writing: " << path << std::endl;
+    delete wav;
+    return false;
+  }
+  mImpl = wav;
+  return true;
+}
+
+void SoundFileWriter::close() {
+  if (mImpl) {
+    drwav_uninit((drwav*)mImpl);
+    delete (drwav*)mImpl;
+    mImpl = nullptr;
+  }
+}
+
+uint64_t SoundFileWriter::write(const float* buffer, uint64_t numFrames) {
+  if (!mImpl) {
+    return 0;
+  }
+  return drwav_write_pcm_frames((drwav*)mImpl, numFrames, buffer);
+}
@@ -1,8 +1,12 @@
 #include "al/sound/al_SpeakerAdjustment.hpp"
 
+#include <algorithm>
 #include <cfloat>
+#include <cmath>
 #include <iostream>
 
+#include "al/math/al_Tile.hpp"
+
 using namespace al;
 
 void SpeakerDistanceGainAdjustment::configure(Speakers layout, double expon) {
@@ -31,16 +35,87 @@ void SpeakerDistanceGainAdjustment::configure(Speakers layout, double expon) {
 }
 
 void SpeakerDistanceGainAdjustment::processGains(AudioIOData& io) {
-  if (io.channelsOut() == 60) {
-    size_t counter = 0;
-    for (auto speaker : mLayout) {
-      float* ioBus = io.outBuffer(speaker.deviceChannel);
-      int samples = io.framesPerBuffer();
-      float gain = mGains[counter++];
-      while (samples-- > 0) {
-        *ioBus = *ioBus * gain;
-        ioBus++;
-      }
+  const int samples = io.framesPerBuffer();
+  for (size_t i = 0; i < mLayout.size() && i < mGains.size(); i++) {
+    if (mLayout[i].deviceChannel >= io.channelsOut()) {
+      continue;
+    }
+    float* ioBus = io.outBuffer(mLayout[i].deviceChannel);
+    const float gain = mGains[i];
+    for (int n = 0; n < samples; n++) {
+      ioBus[n] *= gain;
+    }
+  }
+}
+
+void SpeakerDistanceTimeAdjustment::configure(Speakers layout,
+                                              double framesPerSecond,
+                                              uint64_t framesPerBuffer,
+                                              float speedOfSound) {
+  mLayout = layout;
+  float max_distance = 0.0;
+  for (auto speaker : layout) {
+    max_distance = std::max(max_distance, speaker.radius);
+  }
+  mDelays.clear();
+  mLines.clear();
+  mLines.resize(layout.size());
+  for (size_t i = 0; i < layout.size(); i++) {
+    float delay = float((max_distance - layout[i].radius) / speedOfSound *
+                        framesPerSecond);
+    mDelays.push_back(delay);
+    DelayLine& line = mLines[i];
+    line.frames = (unsigned int)std::floor(delay);
+    line.fraction = delay - line.frames;
+    // One more frame of history for the interpolation
+    line.history = line.frames + (line.fraction > 0.f ? 1 : 0);
+    line.buffer.assign(line.history + std::max(framesPerBuffer, uint64_t(1)),
+                       0.f);
+  }
+}
+
+void SpeakerDistanceTimeAdjustment::processDelays(AudioIOData& io) {
+  const unsigned int samples = io.framesPerBuffer();
+  for (size_t i = 0; i < mLayout.size() && i < mLines.size(); i++) {
+    DelayLine& line = mLines[i];
+    if (line.history == 0 || mLayout[i].deviceChannel >= io.channelsOut()) {
+      continue;
+    }
+    float* ioBus = io.outBuffer(mLayout[i].deviceChannel);
+    // Blocks longer than configured are processed in parts, the delay line
+    // is never resized here
+    const unsigned int maxChunk = line.buffer.size() - line.history;
+    for (unsigned int offset = 0; offset < samples; offset += maxChunk) {
+      processLine(line, ioBus + offset, std::min(maxChunk, samples - offset));
     }
   }
 }
+
+void SpeakerDistanceTimeAdjustment::processLine(DelayLine& line, float* ioBus,
+                                                unsigned int samples) {
+  float* buffer = line.buffer.data();
+  std::copy(ioBus, ioBus + samples, buffer + line.history);
+
+  // Output frame n is input frame n - frames, interpolated toward the
+  // frame before it
+  const float* current = buffer + line.history - line.frames;
+  const float* previous = current - 1;
+  const float a = 1.f - line.fraction;
+  const float b = line.fraction;
+  if (b == 0.f) {
+    std::copy(current, current + samples, ioBus);
+  } else {
+    tiledWrite(ioBus, samples, [current, previous, a, b](unsigned int n) {
+      return a * current[n] + b * previous[n];
+    });
+  }
+
+  // Keep the end of this block as history for the next
+  std::copy(buffer + samples, buffer + samples + line.history, buffer);
+}
+
+void SpeakerDistanceTimeAdjustment::reset() {
+  for (auto& line : mLines) {
+    std::fill(line.buffer.begin(), line.buffer.end(), 0.f);
+  }
+}
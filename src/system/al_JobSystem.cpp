@@ -0,0 +1,203 @@
+#include "al/system/al_JobSystem.hpp"
+
+using namespace al;
+
+namespace {
+// Worker index of the current thread, -1 for threads outside the job system
+thread_local const JobSystem *tlsJobSystem = nullptr;
+thread_local int tlsWorkerIndex = -1;
+} // namespace
+
+bool JobSystem::WorkQueue::push(const Job &job) {
+  if (count == kQueueCapacity) {
+    return false;
+  }
+  jobs[(head + count) % kQueueCapacity] = job;
+  count++;
+  return true;
+}
+
+bool JobSystem::WorkQueue::popBack(Job &job) {
+  if (count == 0) {
+    return false;
+  }
+  count--;
+  job = jobs[(head + count) % kQueueCapacity];
+  return true;
+}
+
+bool JobSystem::WorkQueue::popFront(Job &job) {
+  if (count == 0) {
+    return false;
+  }
+  job = jobs[head];
+  head = (head + 1) % kQueueCapacity;
+  count--;
+  return true;
+}
+
+JobSystem::JobSystem(unsigned int numWorkers) {
+  mNumQueues = numWorkers + 1;
+  mQueues.reset(new WorkQueue[mNumQueues]);
+  for (unsigned int i = 0; i < numWorkers; i++) {
+    mWorkers.emplace_back(&JobSystem::workerFunction, this, i);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::unique_lock<std::mutex> lk(mSleepLock);
+    mStop = true;
+  }
+  mSleepCondition.notify_all();
+  for (auto &worker : mWorkers) {
+    worker.join();
+  }
+}
+
+JobSystem &JobSystem::global() {
+  static JobSystem jobSystem;
+  return jobSystem;
+}
+
+unsigned int JobSystem::defaultWorkerCount() {
+  unsigned int hardwareThreads = std::thread::hardware_concurrency();
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+int JobSystem::currentIndex() const {
+  return tlsJobSystem == this ? tlsWorkerIndex : -1;
+}
+
+void JobSystem::submit(const Job *jobs, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  if (mWorkers.empty()) {
+    // No one else will run them
+    for (size_t i = 0; i < count; i++) {
+      run(jobs[i]);
+    }
+    return;
+  }
+
+  // Workers push to their own queue, other threads to the shared queue.
+  // Workers steal from both.
+  int index = currentIndex();
+  WorkQueue &queue = mQueues[index >= 0 ? index : mNumQueues - 1];
+  size_t queued = 0;
+  {
+    std::unique_lock<std::mutex> lk(queue.lock);
+    while (queued < count && queue.push(jobs[queued])) {
+      queued++;
+    }
+  }
+  if (queued > 0) {
+    mQueued.fetch_add(int(queued), std::memory_order_release);
+
+    // Taking the lock orders the wake up after a worker's check of mQueued
+    { std::unique_lock<std::mutex> lk(mSleepLock); }
+    if (queued == 1) {
+      mSleepCondition.notify_one();
+    } else {
+      mSleepCondition.notify_all();
+    }
+  }
+  // The queue is full. Run the rest here instead of growing it.
+  for (size_t i = queued; i < count; i++) {
+    run(jobs[i]);
+  }
+}
+
+bool JobSystem::findJob(int index, Job &job) {
+  if (mQueued.load(std::memory_order_acquire) <= 0) {
+    return false;
+  }
+  if (index >= 0) {
+    WorkQueue &queue = mQueues[index];
+    std::unique_lock<std::mutex> lk(queue.lock);
+    if (queue.popBack(job)) {
+      mQueued.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  // Steal, starting after our own queue or from the shared queue
+  unsigned int start = index >= 0 ? index + 1 : mNumQueues - 1;
+  for (unsigned int i = 0; i < mNumQueues; i++) {
+    unsigned int victim = (start + i) % mNumQueues;
+    if (int(victim) == index) {
+      continue;
+    }
+    WorkQueue &queue = mQueues[victim];
+    std::unique_lock<std::mutex> lk(queue.lock);
+    if (queue.popFront(job)) {
+      mQueued.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::run(const Job &job) {
+  job.function(job.context, job.begin, job.end);
+  if (job.pending->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // Wake threads sleeping in wait(). Taking the lock orders this after
+    // their check of pending.
+    { std::unique_lock<std::mutex> lk(mSleepLock); }
+    mSleepCondition.notify_all();
+  }
+}
+
+void JobSystem::wait(std::atomic<int> &pending) {
+  int index = currentIndex();
+  Job job;
+  while (pending.load(std::memory_order_acquire) > 0) {
+    if (findJob(index, job)) {
+      run(job);
+      continue;
+    }
+    // The remaining jobs are running on other threads. Sleep until they
+    // finish or new jobs are queued.
+    std::unique_lock<std::mutex> lk(mSleepLock);
+    mSleepCondition.wait(lk, [&]() {
+      return pending.load(std::memory_order_acquire) <= 0 ||
+             mQueued.load(std::memory_order_acquire) > 0;
+    });
+  }
+}
+
+void JobSystem::workerFunction(unsigned int index) {
+  tlsJobSystem = this;
+  tlsWorkerIndex = int(index);
+  Job job;
+  while (true) {
+    if (findJob(int(index), job)) {
+      run(job);
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(mSleepLock);
+    mSleepCondition.wait(lk, [this]() {
+      return mStop || mQueued.load(std::memory_order_acquire) > 0;
+    });
+    if (mStop) {
+      break;
+    }
+  }
+}
+
+// TaskGroup -------------------------------------
+
+void TaskGroup::run(std::function<void()> function) {
+  mFunctions.push_back(std::move(function));
+  mPending.fetch_add(1, std::memory_order_relaxed);
+  JobSystem::Job job{[](void *context, size_t, size_t) {
+                       (*static_cast<std::function<void()> *>(context))();
+                     },
+                     &mFunctions.back(), 0, 0, &mPending};
+  mJobs.submit(&job, 1);
+}
+
+void TaskGroup::wait() {
+  mJobs.wait(mPending);
+  mFunctions.clear();
+}
@@ -1,7 +1,9 @@
-#include "al/core/system/al_Watcher.hpp"
+#include "al/system/al_Watcher.hpp"
 
 #include <map>
+#include <mutex>
 #include <set>
+#include <vector>
 
 using namespace al;
 
@@ -10,28 +12,44 @@ typedef std::map<std::string, Watchers> WatchersMap;
 
 /// singleton notification center:
 static WatchersMap gWatchers;
+// Watchers may be notified from a different thread than the one that
+// registered them (e.g. file polling threads), so registry access is locked.
+static std::mutex gWatchersLock;
 
 void Watcher::watch(std::string name) {
+  std::lock_guard<std::mutex> lk(gWatchersLock);
   Watchers& w = gWatchers[name];
   w.insert(this);
 }
 
 void Watcher::unwatch(std::string name) {
-  Watchers& w = gWatchers[name];
-  w.erase(this);
+  std::lock_guard<std::mutex> lk(gWatchersLock);
+  auto it = gWatchers.find(name);
+  if (it != gWatchers.end()) {
+    it->second.erase(this);
+  }
 }
 
 void Watcher::unwatch() {
+  std::lock_guard<std::mutex> lk(gWatchersLock);
   for (WatchersMap::iterator it = gWatchers.begin(); it != gWatchers.end();
        it++) {
-    unwatch(it->first);
+    it->second.erase(this);
   }
 }
 
 void Watcher::notify(std::string name, std::string event) {
-  Watchers& w = gWatchers[name];
-  for (Watchers::iterator it = w.begin(); it != w.end(); it++) {
-    Watcher* rw = *it;
+  // Copy the list so handlers can watch()/unwatch() from onEvent()
+  std::vector<Watcher*> w;
+  {
+    std::lock_guard<std::mutex> lk(gWatchersLock);
+    auto it = gWatchers.find(name);
+    if (it == gWatchers.end()) {
+      return;
+    }
+    w.assign(it->second.begin(), it->second.end());
+  }
+  for (Watcher* rw : w) {
     rw->onEvent(name, event);
   }
 }
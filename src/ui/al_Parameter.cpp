@@ -7,8 +7,10 @@
 #include <iostream>
 #include <regex>
 #include <sstream>
+#include <thread>
 
 #include "al/io/al_File.hpp"
+#include "al/ui/al_ParameterAutomation.hpp"
 
 using namespace al;
 
@@ -51,6 +53,7 @@ void Parameter::setNoCalls(float value, void *blockReceiver) {
 
   mValue = value;
   mChanged = true;
+  sendToAutomation(value);
 }
 
 void Parameter::set(float value, ValueSource *src) {
@@ -64,6 +67,25 @@ void Parameter::set(float value, ValueSource *src) {
 
   runChangeCallbacksSynchronous(value, src);
   mValue = value;
+  sendToAutomation(value);
+}
+
+void Parameter::setAutomation(ParameterAutomation *automation) {
+  mAutomation.store(automation);
+  // Wait for set() calls that loaded the previous automation
+  while (mAutomationSenders.load() != 0) {
+    std::this_thread::yield();
+  }
+}
+
+void Parameter::sendToAutomation(float value) {
+  // Counted before loading the pointer, so setAutomation() either sees this
+  // call or this call sees the new pointer
+  mAutomationSenders.fetch_add(1);
+  if (auto *automation = mAutomation.load()) {
+    automation->set(value);
+  }
+  mAutomationSenders.fetch_sub(1);
 }
 
 // ParameterInt
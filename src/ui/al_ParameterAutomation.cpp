@@ -0,0 +1,237 @@
+#include "al/ui/al_ParameterAutomation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "al/ui/al_Parameter.hpp"
+
+using namespace al;
+
+// Bounded multiple producer queue by D. Vyukov. The sequence number of a slot
+// tells producers and the audio thread who owns it.
+struct ParameterAutomation::EventQueue {
+  struct Slot {
+    std::atomic<size_t> sequence;
+    Event event;
+  };
+
+  EventQueue(size_t size) {
+    capacity = 2;
+    while (capacity < size) {
+      capacity <<= 1;
+    }
+    slots.reset(new Slot[capacity]);
+    for (size_t i = 0; i < capacity; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool push(const Event &event) {
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      Slot &slot = slots[position & (capacity - 1)];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      intptr_t difference = intptr_t(sequence) - intptr_t(position);
+      if (difference == 0) {
+        if (enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                  std::memory_order_relaxed)) {
+          slot.event = event;
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Only called from the audio thread
+  bool pop(Event &event) {
+    Slot &slot = slots[dequeuePosition & (capacity - 1)];
+    size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (intptr_t(sequence) - intptr_t(dequeuePosition + 1) < 0) {
+      return false;
+    }
+    event = slot.event;
+    slot.sequence.store(dequeuePosition + capacity, std::memory_order_release);
+    dequeuePosition++;
+    return true;
+  }
+
+  size_t capacity;
+  std::unique_ptr<Slot[]> slots;
+  std::atomic<size_t> enqueuePosition{0};
+  size_t dequeuePosition{0};
+};
+
+ParameterAutomation::ParameterAutomation(float initialValue, double sampleRate,
+                                         unsigned int maxBlockSize,
+                                         float smoothing, size_t queueSize)
+    : mQueue(new EventQueue(queueSize)), mSmoothing(smoothing),
+      mValue(initialValue), mTarget(initialValue) {
+  mPending.reserve(mQueue->capacity);
+  configure(sampleRate, maxBlockSize);
+}
+
+ParameterAutomation::ParameterAutomation(Parameter &param, double sampleRate,
+                                         unsigned int maxBlockSize,
+                                         float smoothing, size_t queueSize)
+    : ParameterAutomation(param.get(), sampleRate, maxBlockSize, smoothing,
+                          queueSize) {
+  if (param.automation()) {
+    std::cerr << "ParameterAutomation: replacing automation for "
+              << param.getFullAddress() << std::endl;
+  }
+  mParameter = &param;
+  param.setAutomation(this);
+}
+
+ParameterAutomation::~ParameterAutomation() { detach(); }
+
+void ParameterAutomation::detach() {
+  if (mParameter && mParameter->automation() == this) {
+    mParameter->setAutomation(nullptr);
+  }
+  mParameter = nullptr;
+}
+
+void ParameterAutomation::configure(double sampleRate,
+                                    unsigned int maxBlockSize) {
+  mSampleRate = sampleRate;
+  mMaxBlockSize = maxBlockSize;
+  mBuffer.resize(maxBlockSize);
+}
+
+bool ParameterAutomation::set(float value) {
+  return schedule(value, frameAt(al_steady_time()));
+}
+
+bool ParameterAutomation::schedule(float value, uint64_t frame,
+                                   float rampTime) {
+  if (rampTime < 0.0f) {
+    rampTime = mSmoothing.load(std::memory_order_relaxed);
+  }
+  if (!mQueue->push(Event{frame, value, rampTime})) {
+    mEventsDropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+uint64_t ParameterAutomation::frameAt(al_sec time) const {
+  uint64_t frame;
+  al_sec blockTime;
+  unsigned int blockSize;
+  uint64_t sequence;
+  do {
+    sequence = mClockSequence.load(std::memory_order_acquire);
+    frame = mFrame.load(std::memory_order_relaxed);
+    blockTime = mBlockTime.load(std::memory_order_relaxed);
+    blockSize = mBlockSize.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((sequence & 1) ||
+           sequence != mClockSequence.load(std::memory_order_relaxed));
+
+  if (blockSize == 0) {
+    // Audio has not started, apply at the first block
+    return frame;
+  }
+  // If the audio thread is late or stopped, keep the event within a block
+  double offset = std::max(0.0, (time - blockTime) * mSampleRate);
+  offset = std::min(offset, double(blockSize));
+  unsigned int latency = mLatency.load(std::memory_order_relaxed);
+  return frame + uint64_t(offset + 0.5) + (latency > 0 ? latency : blockSize);
+}
+
+void ParameterAutomation::applyEvent(const Event &event) {
+  uint64_t rampFrames = uint64_t(std::lround(event.rampTime * mSampleRate));
+  if (rampFrames == 0) {
+    mValue = mTarget = event.value;
+    mRampFrames = 0;
+  } else {
+    mTarget = event.value;
+    mIncrement = (mTarget - mValue) / float(rampFrames);
+    mRampFrames = rampFrames;
+  }
+}
+
+const float *ParameterAutomation::process(unsigned int numFrames) {
+  numFrames = std::min(numFrames, mMaxBlockSize);
+  const uint64_t start = mFrame.load(std::memory_order_relaxed) +
+                         mBlockSize.load(std::memory_order_relaxed);
+
+  // Publish the clock for frameAt()
+  const uint64_t sequence = mClockSequence.load(std::memory_order_relaxed);
+  mClockSequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  mFrame.store(start, std::memory_order_relaxed);
+  mBlockTime.store(al_steady_time(), std::memory_order_relaxed);
+  mBlockSize.store(numFrames, std::memory_order_relaxed);
+  mClockSequence.store(sequence + 2, std::memory_order_release);
+
+  // Move new events into the pending list, which is kept sorted by frame.
+  // Events with the same frame keep their order.
+  Event event;
+  while (mPending.size() < mPending.capacity() && mQueue->pop(event)) {
+    auto position =
+        std::upper_bound(mPending.begin(), mPending.end(), event,
+                         [](const Event &a, const Event &b) {
+                           return a.frame < b.frame;
+                         });
+    mPending.insert(position, event);
+  }
+
+  uint64_t applied = 0;
+  uint64_t late = 0;
+  unsigned int i = 0;
+  while (i < numFrames) {
+    while (applied < mPending.size() && mPending[applied].frame <= start + i) {
+      if (mPending[applied].frame < start) {
+        late++;
+      }
+      applyEvent(mPending[applied]);
+      applied++;
+    }
+    unsigned int end = numFrames;
+    if (applied < mPending.size() && mPending[applied].frame < start + end) {
+      end = unsigned(mPending[applied].frame - start);
+    }
+    while (i < end) {
+      if (mRampFrames > 0) {
+        unsigned int steps =
+            unsigned(std::min<uint64_t>(mRampFrames, end - i));
+        for (unsigned int n = 0; n < steps; n++) {
+          mValue += mIncrement;
+          mBuffer[i++] = mValue;
+        }
+        mRampFrames -= steps;
+        if (mRampFrames == 0) {
+          mValue = mTarget;
+          mBuffer[i - 1] = mValue;
+        }
+      } else {
+        std::fill(mBuffer.begin() + i, mBuffer.begin() + end, mValue);
+        i = end;
+      }
+    }
+  }
+  if (applied > 0) {
+    mPending.erase(mPending.begin(), mPending.begin() + applied);
+    mStatsEvents.fetch_add(applied, std::memory_order_relaxed);
+    if (late > 0) {
+      mStatsLate.fetch_add(late, std::memory_order_relaxed);
+    }
+  }
+  return mBuffer.data();
+}
+
+ParameterAutomation::Stats ParameterAutomation::stats() const {
+  Stats stats;
+  stats.events = mStatsEvents.load(std::memory_order_relaxed);
+  stats.late = mStatsLate.load(std::memory_order_relaxed);
+  stats.dropped = mEventsDropped.load(std::memory_order_relaxed);
+  return stats;
+}
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cstring>
 
 constexpr int handshakeServerPort = 16987;
@@ -14,145 +15,344 @@ using namespace al;
 
 // OSCNotifier implementation -------------------------------------------------
 
+namespace {
+// Whether a change that came from srcIp:srcPort is sent to the listener at
+// ip:port. Changes are not echoed back to where they came from.
+bool acceptsSource(const char *srcIp, uint16_t srcPort, const std::string &ip,
+                   uint16_t port) {
+  return ip != srcIp && (srcPort == 0 || srcPort != port);
+}
+} // namespace
+
+struct OSCNotifier::NotifyQueue {
+  static const size_t kCapacity = 256; // Must be a power of two
+  static const size_t kMaxMessageSize = 512;
+  // Notifications sent per batch, so new listeners are not held off
+  static const size_t kMaxBatch = 64;
+  // Bundles are kept within one Ethernet frame
+  static const size_t kMaxBundleSize = 1472;
+
+  // One encoded message. The sequence number tells producers and the
+  // sender thread who owns the slot (bounded queue by D. Vyukov).
+  struct Slot {
+    std::atomic<size_t> sequence;
+    uint32_t size{0}; // 0 if the message did not fit
+    uint16_t sourcePort{0};
+    bool hasSource{false};
+    char sourceIp[64];
+    char data[kMaxMessageSize];
+  };
+
+  // Messages for one listener, collected into a bundle when there are more
+  // than one. Only used by the sender thread.
+  struct ListenerBatch {
+    std::vector<char> buffer = std::vector<char>(kMaxBundleSize);
+    osc::PacketWriter writer;
+    const Slot *first{nullptr};
+    size_t count{0};
+
+    void add(const Slot &slot, osc::Send &sender) {
+      if (count == 0) {
+        first = &slot;
+      } else {
+        if (count == 1) {
+          writer.buffer(buffer.data(), buffer.size());
+          writer.beginBundle();
+          writer.addPacket(first->data, first->size);
+        }
+        if (writer.size() + 4 + slot.size > writer.capacity()) {
+          writer.endBundle();
+          sender.send(writer);
+          writer.clear();
+          writer.beginBundle();
+        }
+        writer.addPacket(slot.data, slot.size);
+      }
+      count++;
+    }
+
+    void finish(osc::Send &sender) {
+      if (count == 1) {
+        sender.sendRaw(first->data, first->size);
+      } else if (count > 1) {
+        writer.endBundle();
+        sender.send(writer);
+      }
+      count = 0;
+    }
+  };
+
+  NotifyQueue() {
+    for (size_t i = 0; i < kCapacity; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Get a free slot to write to, or nullptr if the queue is full
+  Slot *claim(size_t &position) {
+    position = enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      Slot &slot = slots[position & (kCapacity - 1)];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      intptr_t difference = intptr_t(sequence) - intptr_t(position);
+      if (difference == 0) {
+        if (enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                  std::memory_order_relaxed)) {
+          return &slot;
+        }
+      } else if (difference < 0) {
+        return nullptr;
+      } else {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Make a claimed slot visible to the sender thread
+  void commit(Slot *slot, size_t position) {
+    slot->sequence.store(position + 1, std::memory_order_release);
+  }
+
+  // Committed slot offset places from the front, or nullptr
+  const Slot *peek(size_t offset) const {
+    size_t position = dequeuePosition + offset;
+    const Slot &slot = slots[position & (kCapacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+      return nullptr;
+    }
+    return &slot;
+  }
+
+  // Return count slots from the front to the producers
+  void release(size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      size_t position = dequeuePosition + i;
+      slots[position & (kCapacity - 1)].sequence.store(
+          position + kCapacity, std::memory_order_release);
+    }
+    dequeuePosition += count;
+  }
+
+  Slot slots[kCapacity];
+  std::atomic<size_t> enqueuePosition{0};
+  char padding[64]; // Keep producers and the sender off the same cache line
+  size_t dequeuePosition{0};
+  std::vector<ListenerBatch> batches;
+};
+
 OSCNotifier::OSCNotifier() { mHandshakeHandler.notifier = this; }
 
 OSCNotifier::~OSCNotifier() {
+  if (mSenderThread.joinable()) {
+    {
+      std::unique_lock<std::mutex> lk(mSenderLock);
+      mSenderRunning = false;
+      mSenderWake.notify_one();
+    }
+    // Sends what is still queued before stopping
+    mSenderThread.join();
+  }
   for (osc::Send *sender : mOSCSenders) {
     delete sender;
   }
 }
 
-void OSCNotifier::notifyListeners(std::string OSCaddress, float value,
-                                  ValueSource *src) {
-  mListenerLock.lock();
-  for (osc::Send *sender : mOSCSenders) {
-    auto ip = Socket::nameToIp(sender->address());
-
-    if (!src || (src->port == 0 && src->ipAddr != ip) ||
-        (src->port != sender->port() && src->ipAddr != ip)) {
-      sender->send(OSCaddress, value);
+void OSCNotifier::addListener(std::string IPaddress, uint16_t oscPort) {
+  std::string ip = Socket::nameToIp(IPaddress);
+  std::unique_lock<std::mutex> lk(mListenerLock);
+  for (size_t i = 0; i < mOSCSenders.size(); i++) {
+    if (mListenerIps[i] == ip && mOSCSenders[i]->port() == oscPort) {
+      std::cout << "Listener already registered: " << IPaddress << ":"
+                << oscPort << std::endl;
+      return;
     }
-    //		std::cout << "Notifying " << sender->address() << ":" <<
-    // sender->port() << " -- " << OSCaddress << std::endl;
   }
-  mListenerLock.unlock();
+
+  auto newListenerSocket = new osc::Send;
+  if (!newListenerSocket->open(oscPort, IPaddress.c_str())) {
+    delete newListenerSocket;
+    std::cerr << "ERROR: Could not register listener " << IPaddress << ":"
+              << oscPort << std::endl;
+    return;
+  }
+  mOSCSenders.push_back(newListenerSocket);
+  mListenerIps.push_back(ip);
+  if (!mNotifyQueue) {
+    mNotifyQueue = std::make_unique<NotifyQueue>();
+    mSenderRunning = true;
+    mSenderThread = std::thread(&OSCNotifier::senderLoop, this);
+  }
+  // Publishes the queue to notifying threads
+  mNumListeners.store(mOSCSenders.size(), std::memory_order_release);
+  std::cout << "Registered listener " << IPaddress << ":" << oscPort
+            << std::endl;
 }
 
-void OSCNotifier::notifyListeners(std::string OSCaddress, int value,
-                                  ValueSource *src) {
-  mListenerLock.lock();
-  for (osc::Send *sender : mOSCSenders) {
-    auto ip = Socket::nameToIp(sender->address());
+void OSCNotifier::flush() {
+  if (mNumListeners.load(std::memory_order_acquire) == 0 ||
+      std::this_thread::get_id() == mSenderThread.get_id()) {
+    return;
+  }
+  const uint64_t queued =
+      mNotifyQueue->enqueuePosition.load(std::memory_order_acquire);
+  std::unique_lock<std::mutex> lk(mSenderLock);
+  mSenderFlushed.wait(lk, [&]() { return mNotificationsSent >= queued; });
+}
+
+template <class... Args>
+void OSCNotifier::notifyAll(const std::string &OSCaddress, ValueSource *src,
+                            const Args &...args) {
+  if (mNumListeners.load(std::memory_order_acquire) == 0) {
+    return;
+  }
+  NotifyQueue &queue = *mNotifyQueue;
+  size_t position;
+  NotifyQueue::Slot *slot;
+  while (!(slot = queue.claim(position))) {
+    // Full. Wait for the sender thread to make room.
+    wakeSender();
+    std::this_thread::yield();
+  }
+  osc::PacketWriter writer(slot->data, sizeof(slot->data));
+  writer.addMessage(OSCaddress, args...);
+  const bool tooLarge = writer.overflow();
+  slot->size = tooLarge ? 0 : uint32_t(writer.size());
+  slot->hasSource = src != nullptr;
+  if (src) {
+    strncpy(slot->sourceIp, src->ipAddr.c_str(), sizeof(slot->sourceIp) - 1);
+    slot->sourceIp[sizeof(slot->sourceIp) - 1] = '\0';
+    slot->sourcePort = src->port;
+  }
+  queue.commit(slot, position);
+  wakeSender();
+  if (!tooLarge) {
+    return;
+  }
 
-    if (!src || (src->port == 0 && src->ipAddr != ip) ||
-        (src->port != sender->port() && src->ipAddr != ip)) {
-      sender->send(OSCaddress, value);
+  // Send large messages from this thread after the ones queued before them
+  flush();
+  std::unique_lock<std::mutex> lk(mListenerLock);
+  writer.buffer(mNotifyBuffer.data(), mNotifyBuffer.size());
+  writer.addMessage(OSCaddress, args...);
+  while (writer.overflow()) {
+    mNotifyBuffer.resize(mNotifyBuffer.size() * 2);
+    writer.buffer(mNotifyBuffer.data(), mNotifyBuffer.size());
+    writer.addMessage(OSCaddress, args...);
+  }
+  for (size_t i = 0; i < mOSCSenders.size(); i++) {
+    if (src && !acceptsSource(src->ipAddr.c_str(), src->port, mListenerIps[i],
+                              mOSCSenders[i]->port())) {
+      continue;
     }
-    //        std::cout << "Notifying " << sender->address() << ":" <<
-    //        sender->port() << " -- " << OSCaddress << std::endl;
+    mOSCSenders[i]->send(writer);
   }
-  mListenerLock.unlock();
 }
 
-void OSCNotifier::notifyListeners(std::string OSCaddress, std::string value,
-                                  ValueSource *src) {
-  mListenerLock.lock();
-  for (osc::Send *sender : mOSCSenders) {
-    auto ip = Socket::nameToIp(sender->address());
+void OSCNotifier::wakeSender() {
+  // Pairs with the fence in senderLoop(), so either the sender sees the new
+  // notification or this sees the sender waiting
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (mSenderWaiting.load(std::memory_order_relaxed)) {
+    std::unique_lock<std::mutex> lk(mSenderLock);
+    mSenderWake.notify_one();
+  }
+}
 
-    if (!src || (src->port == 0 && src->ipAddr != ip) ||
-        (src->port != sender->port() && src->ipAddr != ip)) {
-      sender->send(OSCaddress, value);
+void OSCNotifier::senderLoop() {
+  while (true) {
+    size_t sent = sendQueued();
+    if (sent > 0) {
+      std::unique_lock<std::mutex> lk(mSenderLock);
+      mNotificationsSent += sent;
+      mSenderFlushed.notify_all();
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(mSenderLock);
+    if (!mSenderRunning) {
+      break;
     }
-    //    std::cout << "Notifying " << sender->address() << ":" <<
-    //    sender->port()
-    //              << " -- " << OSCaddress << std::endl;
+    mSenderWaiting = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!mNotifyQueue->peek(0)) {
+      mSenderWake.wait_for(lk, std::chrono::milliseconds(100));
+    }
+    mSenderWaiting = false;
   }
-  mListenerLock.unlock();
 }
 
-void OSCNotifier::notifyListeners(std::string OSCaddress, Vec3f value,
-                                  ValueSource *src) {
-  mListenerLock.lock();
-  for (osc::Send *sender : mOSCSenders) {
-    auto ip = Socket::nameToIp(sender->address());
-
-    if (!src || (src->port == 0 && src->ipAddr != ip) ||
-        (src->port != sender->port() && src->ipAddr != ip)) {
-      sender->send(OSCaddress, value[0], value[1], value[2]);
+size_t OSCNotifier::sendQueued() {
+  NotifyQueue &queue = *mNotifyQueue;
+  std::unique_lock<std::mutex> lk(mListenerLock);
+  queue.batches.resize(mOSCSenders.size());
+  size_t count = 0;
+  while (count < NotifyQueue::kMaxBatch) {
+    const NotifyQueue::Slot *slot = queue.peek(count);
+    if (!slot) {
+      break;
+    }
+    count++;
+    if (slot->size == 0) {
+      continue; // Sent by the notifying thread
+    }
+    for (size_t i = 0; i < mOSCSenders.size(); i++) {
+      if (slot->hasSource &&
+          !acceptsSource(slot->sourceIp, slot->sourcePort, mListenerIps[i],
+                         mOSCSenders[i]->port())) {
+        continue;
+      }
+      queue.batches[i].add(*slot, *mOSCSenders[i]);
     }
-    //		std::cout << "Notifying " << sender->address() << ":" <<
-    // sender->port() << " -- " << OSCaddress << std::endl;
   }
-  mListenerLock.unlock();
+  for (size_t i = 0; i < mOSCSenders.size(); i++) {
+    queue.batches[i].finish(*mOSCSenders[i]);
+  }
+  lk.unlock();
+  // Slots are only reused once their messages have been sent
+  queue.release(count);
+  return count;
 }
 
-void OSCNotifier::notifyListeners(std::string OSCaddress, Vec4f value,
+void OSCNotifier::notifyListeners(std::string OSCaddress, float value,
                                   ValueSource *src) {
-  mListenerLock.lock();
-  for (osc::Send *sender : mOSCSenders) {
-    auto ip = Socket::nameToIp(sender->address());
+  notifyAll(OSCaddress, src, value);
+}
 
-    if (!src || (src->port == 0 && src->ipAddr != ip) ||
-        (src->port != sender->port() && src->ipAddr != ip)) {
-      sender->send(OSCaddress, value[0], value[1], value[2], value[3]);
-    }
-    //		std::cout << "Notifying " << sender->address() << ":" <<
-    // sender->port() << " -- " << OSCaddress << std::endl;
-  }
-  mListenerLock.unlock();
+void OSCNotifier::notifyListeners(std::string OSCaddress, int value,
+                                  ValueSource *src) {
+  notifyAll(OSCaddress, src, value);
 }
 
-void OSCNotifier::notifyListeners(std::string OSCaddress, Vec5f value,
+void OSCNotifier::notifyListeners(std::string OSCaddress, std::string value,
                                   ValueSource *src) {
-  mListenerLock.lock();
-  for (osc::Send *sender : mOSCSenders) {
-    auto ip = Socket::nameToIp(sender->address());
+  notifyAll(OSCaddress, src, value);
+}
 
-    if (!src || (src->port == 0 && src->ipAddr != ip) ||
-        (src->port != sender->port() && src->ipAddr != ip)) {
-      sender->send(OSCaddress, value[0], value[1], value[2], value[3],
-                   value[4]);
-    }
-    //		std::cout << "Notifying " << sender->address() << ":" <<
-    // sender->port() << " -- " << OSCaddress << std::endl;
-  }
-  mListenerLock.unlock();
+void OSCNotifier::notifyListeners(std::string OSCaddress, Vec3f value,
+                                  ValueSource *src) {
+  notifyAll(OSCaddress, src, value[0], value[1], value[2]);
 }
 
-void OSCNotifier::notifyListeners(std::string OSCaddress, Pose value,
+void OSCNotifier::notifyListeners(std::string OSCaddress, Vec4f value,
                                   ValueSource *src) {
-  mListenerLock.lock();
-  for (osc::Send *sender : mOSCSenders) {
-    auto ip = Socket::nameToIp(sender->address());
+  notifyAll(OSCaddress, src, value[0], value[1], value[2], value[3]);
+}
 
-    if (!src || (src->port == 0 && src->ipAddr != ip) ||
-        (src->port != sender->port() && src->ipAddr != ip)) {
-      sender->send(OSCaddress, (float)value.pos()[0], (float)value.pos()[1],
-                   (float)value.pos()[2], (float)value.quat().w,
-                   (float)value.quat().x, (float)value.quat().y,
-                   (float)value.quat().z);
-    }
-    //		std::cout << "Notifying " << sender->address() << ":" <<
-    // sender->port() << " -- " << OSCaddress << std::endl;
-  }
-  mListenerLock.unlock();
+void OSCNotifier::notifyListeners(std::string OSCaddress, Vec5f value,
+                                  ValueSource *src) {
+  notifyAll(OSCaddress, src, value[0], value[1], value[2], value[3], value[4]);
 }
 
-void OSCNotifier::notifyListeners(std::string OSCaddress, Color value,
+void OSCNotifier::notifyListeners(std::string OSCaddress, Pose value,
                                   ValueSource *src) {
-  mListenerLock.lock();
-  for (osc::Send *sender : mOSCSenders) {
-    auto ip = Socket::nameToIp(sender->address());
+  notifyAll(OSCaddress, src, (float)value.pos()[0], (float)value.pos()[1],
+            (float)value.pos()[2], (float)value.quat().w,
+            (float)value.quat().x, (float)value.quat().y,
+            (float)value.quat().z);
+}
 
-    if (!src || (src->port == 0 && src->ipAddr != ip) ||
-        (src->port != sender->port() && src->ipAddr != ip)) {
-      sender->send(OSCaddress, float(value.r), float(value.g), float(value.b));
-    }
-    //		std::cout << "Notifying " << sender->address() << ":" <<
-    // sender->port() << " -- " << OSCaddress << std::endl;
-  }
-  mListenerLock.unlock();
+void OSCNotifier::notifyListeners(std::string OSCaddress, Color value,
+                                  ValueSource *src) {
+  notifyAll(OSCaddress, src, float(value.r), float(value.g), float(value.b));
 }
 
 void OSCNotifier::notifyListeners(std::string OSCaddress, ParameterMeta *param,
@@ -401,6 +601,106 @@ void ParameterServer::onMessage(osc::Message &m) {
   mParameterLock.unlock();
 }
 
+// Set param from m if the address and type tags match. Only the types that
+// can be read without allocating are handled.
+static bool setParameterValueFromView(ParameterMeta *param,
+                                      osc::MessageView &m) {
+  if (!m.addressIs(param->getFullAddress().c_str())) {
+    return false;
+  }
+  const char *tags = m.typeTags();
+  const std::type_info &type = typeid(*param);
+  ValueSource s{m.senderAddress(), m.senderPort()};
+  if (type == typeid(Parameter) || type == typeid(ParameterBool)) {
+    if (strcmp(tags, "f") == 0) {
+      float val;
+      m >> val;
+      static_cast<Parameter *>(param)->set(val, &s);
+      return true;
+    }
+  } else if (type == typeid(ParameterInt)) {
+    if (strcmp(tags, "i") == 0) {
+      int32_t val;
+      m >> val;
+      static_cast<ParameterInt *>(param)->set(val, &s);
+      return true;
+    }
+  } else if (type == typeid(ParameterMenu)) {
+    if (strcmp(tags, "i") == 0) {
+      int val;
+      m >> val;
+      static_cast<ParameterMenu *>(param)->set(val, &s);
+      return true;
+    }
+  } else if (type == typeid(ParameterChoice)) {
+    if (strcmp(tags, "i") == 0) {
+      int val;
+      m >> val;
+      static_cast<ParameterChoice *>(param)->set(val, &s);
+      return true;
+    }
+  } else if (type == typeid(ParameterVec3)) {
+    if (strcmp(tags, "fff") == 0) {
+      float x, y, z;
+      m >> x >> y >> z;
+      static_cast<ParameterVec3 *>(param)->set(Vec3f(x, y, z), &s);
+      return true;
+    }
+  } else if (type == typeid(ParameterVec4)) {
+    if (strcmp(tags, "ffff") == 0) {
+      float a, b, c, d;
+      m >> a >> b >> c >> d;
+      static_cast<ParameterVec4 *>(param)->set(Vec4f(a, b, c, d), &s);
+      return true;
+    }
+  } else if (type == typeid(ParameterColor)) {
+    if (strcmp(tags, "ffff") == 0) {
+      float a, b, c, d;
+      m >> a >> b >> c >> d;
+      static_cast<ParameterColor *>(param)->set(Color(a, b, c, d), &s);
+      return true;
+    }
+  } else if (type == typeid(ParameterPose)) {
+    if (strcmp(tags, "fffffff") == 0) {
+      float x, y, z, w, qx, qy, qz;
+      m >> x >> y >> z >> w >> qx >> qy >> qz;
+      static_cast<ParameterPose *>(param)->set(
+          Pose(Vec3d(x, y, z), Quatd(w, qx, qy, qz)), &s);
+      return true;
+    }
+  } else if (type == typeid(Trigger)) {
+    if (tags[0] == '\0') {
+      static_cast<Trigger *>(param)->trigger();
+      return true;
+    } else if (strcmp(tags, "f") == 0) {
+      float val;
+      m >> val;
+      if (val == 1.0) {
+        static_cast<Trigger *>(param)->trigger();
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParameterServer::onMessageView(osc::MessageView &m) {
+  std::unique_lock<std::mutex> lk(mParameterLock);
+  // These take an osc::Message, so leave the message to onMessage()
+  if (mVerbose || !mParameterBundles.empty() || !mPacketHandlers.empty() ||
+      !mMessageConsumers.empty()) {
+    return false;
+  }
+  bool handled = false;
+  for (ParameterMeta *param : mParameters) {
+    if (setParameterValueFromView(param, m)) {
+      m.resetStream();
+      handled = true;
+    }
+  }
+  return handled;
+}
+
 void ParameterServer::print(std::ostream &stream) {
   std::unique_lock<std::mutex> lk(mServerLock);
   if (!mServer) {
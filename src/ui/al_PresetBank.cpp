@@ -0,0 +1,423 @@
+#include "al/ui/al_PresetBank.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+
+#include "al/io/al_File.hpp"
+
+using namespace al;
+
+PresetBank::PresetBank(bool verbose) : mVerbose(verbose) {}
+
+PresetBank::~PresetBank() {
+  flush();
+  {
+    std::lock_guard<std::mutex> lk(mWriteLock);
+    mRunning = false;
+  }
+  mWriteCondition.notify_all();
+  mPollCondition.notify_all();
+  if (mWriterThread) {
+    mWriterThread->join();
+  }
+  if (mPollThread) {
+    mPollThread->join();
+  }
+  unwatch();
+}
+
+void PresetBank::load(std::string directory) {
+  flush();
+  unwatch();
+  if (directory.size() > 0) {
+    directory = File::conformDirectory(directory);
+  }
+
+  FileList presetFiles = filterInDir(directory, [](const FilePath &f) {
+    return al::checkExtension(f, ".preset");
+  });
+
+  std::vector<std::string> names;
+  for (int i = 0; i < presetFiles.count(); i++) {
+    const std::string &name = presetFiles[i].file();
+    names.push_back(name.substr(0, name.size() - 7)); // exclude extension
+  }
+
+  // Parse files in parallel. Each task fills its own map to avoid locking.
+  size_t numTasks = std::max(1u, std::thread::hardware_concurrency());
+  numTasks = std::min(numTasks, names.size());
+  std::vector<std::future<std::map<std::string, Entry>>> tasks;
+  for (size_t task = 0; task < numTasks; task++) {
+    tasks.push_back(std::async(std::launch::async, [&, task]() {
+      std::map<std::string, Entry> entries;
+      for (size_t i = task; i < names.size(); i += numTasks) {
+        std::string path = directory + names[i] + ".preset";
+        Entry &entry = entries[names[i]];
+        entry.modified = File::modified(path);
+        readPresetFile(path, entry.values, mVerbose);
+      }
+      return entries;
+    }));
+  }
+
+  std::map<std::string, Entry> entries;
+  for (auto &task : tasks) {
+    auto taskEntries = task.get();
+    entries.insert(taskEntries.begin(), taskEntries.end());
+  }
+  {
+    std::lock_guard<std::mutex> lk(mEntriesLock);
+    mDirectory = directory;
+    mEntries = std::move(entries);
+    mMissing.clear();
+  }
+  for (const auto &name : names) {
+    watch(directory + name + ".preset");
+  }
+  {
+    std::lock_guard<std::mutex> lk(mWriteLock);
+    if (!mPollThread && mPollInterval > 0) {
+      mPollThread =
+          std::make_unique<std::thread>(&PresetBank::pollFunction, this);
+    }
+  }
+  if (mVerbose) {
+    std::cout << "PresetBank loaded " << names.size() << " presets from "
+              << directory << std::endl;
+  }
+}
+
+std::string PresetBank::directory() {
+  std::lock_guard<std::mutex> lk(mEntriesLock);
+  return mDirectory;
+}
+
+bool PresetBank::get(const std::string &name, ParameterStates &values) {
+  {
+    std::lock_guard<std::mutex> lk(mEntriesLock);
+    auto entry = mEntries.find(name);
+    if (entry != mEntries.end()) {
+      values = entry->second.values;
+      return true;
+    }
+    if (mMissing.find(name) != mMissing.end()) {
+      return false;
+    }
+  }
+  // Not in memory, it might have been created after load()
+  reload(name);
+  std::lock_guard<std::mutex> lk(mEntriesLock);
+  auto entry = mEntries.find(name);
+  if (entry != mEntries.end()) {
+    values = entry->second.values;
+    return true;
+  }
+  // Don't go to disk again until the poller reports the file as created
+  mMissing.insert(name);
+  return false;
+}
+
+bool PresetBank::contains(const std::string &name) {
+  {
+    std::lock_guard<std::mutex> lk(mEntriesLock);
+    if (mEntries.find(name) != mEntries.end()) {
+      return true;
+    }
+  }
+  return File::exists(presetPath(name));
+}
+
+void PresetBank::store(const std::string &name, const ParameterStates &values) {
+  bool isNew = false;
+  {
+    std::lock_guard<std::mutex> lk(mEntriesLock);
+    Entry &entry = mEntries[name];
+    isNew = entry.pendingWrites == 0 && entry.modified == 0;
+    entry.values = values;
+    entry.pendingWrites++;
+    mMissing.erase(name);
+  }
+  if (isNew) {
+    watch(presetPath(name));
+  }
+  {
+    std::lock_guard<std::mutex> lk(mWriteLock);
+    if (!mWriterThread) {
+      mWriterThread =
+          std::make_unique<std::thread>(&PresetBank::writerFunction, this);
+    }
+    mWriteQueue.push_back({name, values});
+  }
+  mWriteCondition.notify_all();
+}
+
+void PresetBank::reload(const std::string &name) {
+  std::string path = presetPath(name);
+  Entry entry;
+  entry.modified = File::modified(path);
+  bool exists = readPresetFile(path, entry.values, mVerbose);
+  bool isNew;
+  {
+    std::lock_guard<std::mutex> lk(mEntriesLock);
+    auto current = mEntries.find(name);
+    if (current != mEntries.end() && current->second.pendingWrites > 0) {
+      // Memory copy is newer than disk, it will be written soon.
+      return;
+    }
+    isNew = current == mEntries.end();
+    if (exists) {
+      mEntries[name] = std::move(entry);
+      mMissing.erase(name);
+    } else if (!isNew) {
+      mEntries.erase(current);
+    }
+  }
+  if (exists && isNew) {
+    watch(path);
+  } else if (!exists && !isNew) {
+    unwatch(path);
+  }
+}
+
+std::vector<std::string> PresetBank::names() {
+  std::vector<std::string> presetNames;
+  std::lock_guard<std::mutex> lk(mEntriesLock);
+  for (const auto &entry : mEntries) {
+    presetNames.push_back(entry.first);
+  }
+  return presetNames;
+}
+
+void PresetBank::flush() {
+  std::unique_lock<std::mutex> lk(mWriteLock);
+  mWriteCondition.wait(
+      lk, [this]() { return mWriteQueue.empty() && mWritesInFlight == 0; });
+}
+
+void PresetBank::setPollInterval(al_sec seconds) {
+  {
+    std::lock_guard<std::mutex> lk(mWriteLock);
+    mPollInterval = seconds;
+    if (!mPollThread && seconds > 0 && directory().size() > 0) {
+      mPollThread =
+          std::make_unique<std::thread>(&PresetBank::pollFunction, this);
+    }
+  }
+  mPollCondition.notify_all();
+}
+
+void PresetBank::onEvent(std::string resourcename, std::string eventname) {
+  std::string dir = directory();
+  if (resourcename.size() <= dir.size() + 7 ||
+      resourcename.compare(0, dir.size(), dir) != 0) {
+    return;
+  }
+  std::string name =
+      resourcename.substr(dir.size(), resourcename.size() - dir.size() - 7);
+  if (mVerbose) {
+    std::cout << "PresetBank: preset " << name << " " << eventname << std::endl;
+  }
+  reload(name);
+}
+
+std::string PresetBank::presetPath(const std::string &name) {
+  return directory() + name + ".preset";
+}
+
+bool PresetBank::readPresetFile(const std::string &fileName,
+                                ParameterStates &values, bool verbose) {
+  std::string line;
+  std::ifstream f(fileName);
+  if (!f.is_open()) {
+    if (verbose) {
+      std::cout << "Error while opening preset file: " << fileName
+                << std::endl;
+    }
+    return false;
+  }
+  while (getline(f, line)) {
+    if (line.substr(0, 2) == "::") {
+      if (verbose) {
+        std::cout << "Found preset : " << line << std::endl;
+      }
+      while (getline(f, line)) {
+        if (line.size() < 2) {
+          continue;
+        }
+        if (line.substr(0, 2) == "::") {
+          if (verbose) {
+            std::cout << "End preset." << std::endl;
+          }
+          break;
+        }
+        std::stringstream ss(line);
+        std::string address, type;
+        std::vector<VariantValue> fields;
+        std::getline(ss, address, ' ');
+        std::getline(ss, type, ' ');
+        std::string value;
+        auto currentType = type.begin();
+        // FIXME parse strings correctly to allow spaces in strings
+        while (std::getline(ss, value, ' ')) {
+          if (currentType == type.end()) {
+            std::cerr << "ERROR: Inconsistent type tags. Ingnoring extra values"
+                      << std::endl;
+            break;
+          }
+          if (*currentType == 'f') {
+            fields.push_back(std::stof(value));
+          } else if (*currentType == 's') {
+            fields.push_back(value);
+          } else if (*currentType == 'i') {
+            fields.push_back(std::stoi(value));
+          }
+          ++currentType;
+        }
+
+        if (address.size() > 0 && address[0] != '#' && type.size() > 0) {
+          values[address] = fields;
+        }
+      }
+    }
+  }
+  if (f.bad()) {
+    if (verbose) {
+      std::cout << "Error while reading preset file: " << fileName
+                << std::endl;
+    }
+  }
+  f.close();
+  return true;
+}
+
+bool PresetBank::writePresetFile(const std::string &fileName,
+                                 const std::string &presetName,
+                                 const ParameterStates &values, bool verbose) {
+  bool ok = true;
+  std::ofstream f(fileName);
+  if (!f.is_open()) {
+    if (verbose) {
+      std::cout << "Error while opening preset file for write: " << fileName
+                << std::endl;
+    }
+    return false;
+  }
+  f << "::" + presetName << std::endl;
+  for (const auto &value : values) {
+    std::string types, valueString;
+    for (auto &value2 : value.second) {
+      if (value2.type() == VariantType::VARIANT_FLOAT) {
+        types += "f";
+        valueString += std::to_string(value2.get<float>()) + " ";
+      } else if (value2.type() == VariantType::VARIANT_STRING) {
+        types += "s";
+        valueString += value2.get<std::string>() + " ";
+      } else if (value2.type() == VariantType::VARIANT_INT32) {
+        types += "i";
+        valueString += std::to_string(value2.get<int32_t>()) + " ";
+      }
+    }
+    // TODO chop last blank space
+    std::string line = value.first + " " + types + " " + valueString;
+    f << line << std::endl;
+  }
+  f << "::" << std::endl;
+  if (f.bad()) {
+    if (verbose) {
+      std::cout << "Error while writing preset file: " << fileName << std::endl;
+    }
+    ok = false;
+  }
+  f.close();
+  return ok;
+}
+
+void PresetBank::writerFunction() {
+  std::unique_lock<std::mutex> lk(mWriteLock);
+  while (mRunning || !mWriteQueue.empty()) {
+    mWriteCondition.wait(
+        lk, [this]() { return !mRunning || !mWriteQueue.empty(); });
+    while (!mWriteQueue.empty()) {
+      auto item = std::move(mWriteQueue.front());
+      mWriteQueue.pop_front();
+      mWritesInFlight++;
+      lk.unlock();
+
+      std::string path = presetPath(item.first);
+      writePresetFile(path, item.first, item.second, mVerbose);
+      {
+        std::lock_guard<std::mutex> entriesLock(mEntriesLock);
+        auto entry = mEntries.find(item.first);
+        if (entry != mEntries.end()) {
+          entry->second.pendingWrites--;
+          // Don't report our own write as an external modification
+          entry->second.modified = File::modified(path);
+        }
+      }
+
+      lk.lock();
+      mWritesInFlight--;
+    }
+    mWriteCondition.notify_all();
+  }
+}
+
+void PresetBank::pollFunction() {
+  std::unique_lock<std::mutex> lk(mWriteLock);
+  while (mRunning) {
+    if (mPollInterval > 0) {
+      mPollCondition.wait_for(lk,
+                              std::chrono::duration<double>(mPollInterval));
+    } else {
+      mPollCondition.wait(lk);
+    }
+    if (!mRunning || mPollInterval <= 0) {
+      continue;
+    }
+    lk.unlock();
+
+    std::string dir = directory();
+    std::vector<std::pair<std::string, al_sec>> known;
+    {
+      std::lock_guard<std::mutex> entriesLock(mEntriesLock);
+      for (const auto &entry : mEntries) {
+        if (entry.second.pendingWrites == 0) {
+          known.push_back({entry.first, entry.second.modified});
+        }
+      }
+    }
+    for (const auto &entry : known) {
+      std::string path = dir + entry.first + ".preset";
+      al_sec modified = File::modified(path);
+      if (modified == 0) {
+        Watcher::notify(path, "deleted");
+      } else if (modified != entry.second) {
+        Watcher::notify(path, "modified");
+      }
+    }
+    if (dir.size() > 0) {
+      FileList presetFiles = filterInDir(dir, [](const FilePath &f) {
+        return al::checkExtension(f, ".preset");
+      });
+      for (int i = 0; i < presetFiles.count(); i++) {
+        const std::string &file = presetFiles[i].file();
+        std::string name = file.substr(0, file.size() - 7);
+        bool isKnown;
+        {
+          std::lock_guard<std::mutex> entriesLock(mEntriesLock);
+          isKnown = mEntries.find(name) != mEntries.end();
+        }
+        if (!isKnown) {
+          watch(dir + file);
+          Watcher::notify(dir + file, "created");
+        }
+      }
+    }
+
+    lk.lock();
+  }
+}
@@ -51,6 +51,10 @@ void PresetHandler::setSubDirectory(std::string directory) {
   }
   setCurrentPresetMap();
   mSubDir = directory;
+  std::lock_guard<std::mutex> lk(mFileLock);
+  if (mPresetBank) {
+    mPresetBank->load(getCurrentPath());
+  }
 }
 
 void PresetHandler::registerPresetCallback(
@@ -203,7 +207,7 @@ void PresetHandler::storePreset(int index, std::string name, bool overwrite) {
     }
   }
 
-  savePresetValues(values, name, overwrite);
+  writePresetValues(values, name, overwrite);
   mPresetsMap[index] = name;
   storeCurrentPresetMap();
   mCurrentPresetName = name;
@@ -631,6 +635,10 @@ void PresetHandler::setRootPath(std::string path) {
     mRootDir = path;
   }
   setCurrentPresetMap();
+  std::lock_guard<std::mutex> lk(mFileLock);
+  if (mPresetBank) {
+    mPresetBank->load(getCurrentPath());
+  }
 }
 
 std::string al::PresetHandler::getRootPath() {
@@ -1198,83 +1206,43 @@ PresetHandler::getBundleStates(ParameterBundle *bundle, std::string id) {
 PresetHandler::ParameterStates
 PresetHandler::loadPresetValues(std::string name) {
   ParameterStates preset;
-  std::lock_guard<std::mutex> lock(mFileLock); // Protect loading and saving
-  std::lock_guard<std::mutex> lock2(mSkipParametersLock); // Protect skip list
-  std::string path = getCurrentPath();
-  if (path.back() != '/') {
-    path += "/";
-  }
-  std::string line;
-  std::ifstream f(path + name + ".preset");
-  if (!f.is_open()) {
-    if (mVerbose) {
-      std::cout << "Error while opening preset file: "
-                << path + name + ".preset" << std::endl;
-    }
-  }
-  while (getline(f, line)) {
-    if (line.substr(0, 2) == "::") {
-      if (mVerbose) {
-        std::cout << "Found preset : " << line << std::endl;
-      }
-      while (getline(f, line)) {
-        if (line.size() < 2) {
-          continue;
-        }
-        if (line.substr(0, 2) == "::") {
-          if (mVerbose) {
-            std::cout << "End preset." << std::endl;
-          }
-          break;
-        }
-        std::stringstream ss(line);
-        std::string address, type;
-        std::vector<VariantValue> values;
-        std::getline(ss, address, ' ');
-        std::getline(ss, type, ' ');
-        std::string value;
-        auto currentType = type.begin();
-        // FIXME parse strings correctly to allow spaces in strings
-        while (std::getline(ss, value, ' ')) {
-          if (currentType == type.end()) {
-            std::cerr << "ERROR: Inconsistent type tags. Ingnoring extra values"
-                      << std::endl;
-            break;
-          }
-          if (*currentType == 'f') {
-            values.push_back(std::stof(value));
-          } else if (*currentType == 's') {
-            values.push_back(value);
-          } else if (*currentType == 'i') {
-            values.push_back(std::stoi(value));
-          }
-          ++currentType;
-        }
-
-        if (address.size() > 0 && address[0] != '#' && type.size() > 0 &&
-            std::find(mSkipParameters.begin(), mSkipParameters.end(),
-                      address) == mSkipParameters.end()) {
-          // Address is not in ignore list, so add to values loaded
-          // Should we make sure the address corresponds to an existing
-          // preset?
-          preset[address] = values;
-        }
+  {
+    std::lock_guard<std::mutex> lock(mFileLock); // Protect loading and saving
+    if (mPresetBank) {
+      mPresetBank->get(name, preset);
+    } else {
+      std::string path = getCurrentPath();
+      if (path.back() != '/') {
+        path += "/";
       }
+      PresetBank::readPresetFile(path + name + ".preset", preset, mVerbose);
     }
   }
-  if (f.bad()) {
-    if (mVerbose) {
-      std::cout << "Error while writing preset file: "
-                << path + name + ".preset" << std::endl;
-    }
+  std::lock_guard<std::mutex> lock2(mSkipParametersLock); // Protect skip list
+  for (const auto &address : mSkipParameters) {
+    preset.erase(address);
   }
-  f.close();
   return preset;
 }
 
 bool PresetHandler::savePresetValues(const ParameterStates &values,
                                      std::string presetName, bool overwrite) {
-  bool ok = true;
+  std::lock_guard<std::mutex> lk(mFileLock); // Protect loading and saving
+  return writePresetValues(values, presetName, overwrite);
+}
+
+bool PresetHandler::writePresetValues(const ParameterStates &values,
+                                      std::string presetName, bool overwrite) {
+  if (mPresetBank) {
+    std::string name = presetName;
+    int number = 0;
+    while (!overwrite && mPresetBank->contains(name)) {
+      name = presetName + "_" + std::to_string(number);
+      number++;
+    }
+    mPresetBank->store(name, values);
+    return true;
+  }
   std::string path = getCurrentPath();
   std::string fileName = path + presetName + ".preset";
   std::ifstream infile(fileName);
@@ -1286,42 +1254,20 @@ bool PresetHandler::savePresetValues(const ParameterStates &values,
     number++;
   }
   infile.close();
-  std::ofstream f(fileName);
-  if (!f.is_open()) {
-    if (mVerbose) {
-      std::cout << "Error while opening preset file for write: " << fileName
-                << std::endl;
-    }
-    return false;
-  }
-  f << "::" + presetName << std::endl;
-  for (const auto &value : values) {
-    std::string types, valueString;
-    for (auto &value2 : value.second) {
-      if (value2.type() == VariantType::VARIANT_FLOAT) {
-        types += "f";
-        valueString += std::to_string(value2.get<float>()) + " ";
-      } else if (value2.type() == VariantType::VARIANT_STRING) {
-        types += "s";
-        valueString += value2.get<std::string>() + " ";
-      } else if (value2.type() == VariantType::VARIANT_INT32) {
-        types += "i";
-        valueString += std::to_string(value2.get<int32_t>()) + " ";
-      }
-    }
-    // TODO chop last blank space
-    std::string line = value.first + " " + types + " " + valueString;
-    f << line << std::endl;
-  }
-  f << "::" << std::endl;
-  if (f.bad()) {
-    if (mVerbose) {
-      std::cout << "Error while writing preset file: " << fileName << std::endl;
+  return PresetBank::writePresetFile(fileName, presetName, values, mVerbose);
+}
+
+void PresetHandler::usePresetBank(bool use) {
+  // Loading and saving use the bank under this lock
+  std::lock_guard<std::mutex> lk(mFileLock);
+  if (use) {
+    if (!mPresetBank) {
+      mPresetBank = std::make_unique<PresetBank>(mVerbose);
     }
-    ok = false;
+    mPresetBank->load(getCurrentPath());
+  } else {
+    mPresetBank = nullptr;
   }
-  f.close();
-  return ok;
 }
 
 void PresetHandler::setTimeMaster(TimeMasterMode masterMode) {
@@ -0,0 +1,113 @@
+// Replaces the global operator new to count allocations, so these tests
+// are built as their own executable instead of into al_tests.
+
+#include "al/scene/al_DynamicScene.hpp"
+#include "al/scene/al_PolySynth.hpp"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace al;
+
+namespace {
+
+// Counts heap allocations while enabled
+std::atomic<bool> gCountAllocations{false};
+std::atomic<int> gAllocations{0};
+
+class LevelVoice : public SynthVoice {
+public:
+  void onProcess(AudioIOData &io) override {
+    while (io()) {
+      io.out(0) += 0.1f;
+    }
+  }
+
+  void onTriggerOff() override { free(); }
+};
+
+class PositionedLevelVoice : public PositionedVoice {
+public:
+  void onProcess(AudioIOData &io) override {
+    while (io()) {
+      io.out(0) += 0.1f;
+    }
+  }
+
+  void onTriggerOff() override { free(); }
+};
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  if (gCountAllocations.load(std::memory_order_relaxed)) {
+    gAllocations++;
+  }
+  void *p = std::malloc(size > 0 ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { std::free(p); }
+
+TEST(PolySynth, NoAllocationInRender) {
+  PolySynth synth;
+  ASSERT_TRUE(
+      synth.reserveVoices<LevelVoice>(16, PolySynth::VoiceStealing::QUIETEST));
+  AudioIOData io;
+  io.channelsOut(2);
+  io.framesPerBuffer(128);
+  synth.prepare(io);
+
+  for (int i = 0; i < 16; i++) {
+    synth.triggerOn(synth.getVoice<LevelVoice>(), i);
+  }
+  io.zeroOut();
+  gAllocations = 0;
+  gCountAllocations = true;
+  synth.render(io);
+  gCountAllocations = false;
+  EXPECT_EQ(gAllocations.load(), 0);
+
+  // Steal, stop and free voices between blocks
+  int id = synth.triggerOn(synth.getVoice<LevelVoice>());
+  synth.triggerOff(id);
+  gCountAllocations = true;
+  for (int block = 0; block < 8; block++) {
+    io.zeroOut();
+    synth.render(io);
+  }
+  gCountAllocations = false;
+  EXPECT_EQ(gAllocations.load(), 0);
+}
+
+TEST(DynamicScene, NoAllocationInRender) {
+  DynamicScene scene;
+  ASSERT_TRUE(scene.reserveVoices<PositionedLevelVoice>(16));
+  AudioIOData io;
+  io.channelsOut(2);
+  io.framesPerBuffer(128);
+  scene.prepare(io);
+
+  for (int i = 0; i < 16; i++) {
+    auto *voice = scene.getVoice<PositionedLevelVoice>();
+    voice->setPose(Pose({float(i - 8), 0, -4}));
+    scene.triggerOn(voice);
+  }
+  gAllocations = 0;
+  gCountAllocations = true;
+  for (int block = 0; block < 8; block++) {
+    io.zeroOut();
+    scene.render(io);
+  }
+  gCountAllocations = false;
+  EXPECT_EQ(gAllocations.load(), 0);
+}
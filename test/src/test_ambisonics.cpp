@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/sound/al_Ambisonics.hpp"
+#include "gtest/gtest.h"
+
+using namespace al;
+
+TEST(Ambisonics, ACNFirstOrder) {
+  float ws[4];
+  AmbiBase::encodeWeightsACN(ws, 3, 1, 0.6f, 0.0f, 0.8f);
+  // ACN order W Y Z X
+  EXPECT_NEAR(ws[0], 1.0f, 1e-6);
+  EXPECT_NEAR(ws[1], 0.0f, 1e-6);
+  EXPECT_NEAR(ws[2], 0.8f, 1e-6);
+  EXPECT_NEAR(ws[3], 0.6f, 1e-6);
+
+  float ws9[9];
+  AmbiBase::encodeWeightsACN(ws9, 3, 2, 0.6f, 0.0f, 0.8f);
+  EXPECT_NEAR(ws9[6], 0.5f * (3.0f * 0.64f - 1.0f), 1e-6); // R
+  EXPECT_NEAR(ws9[7], std::sqrt(3.0f) * 0.6f * 0.8f, 1e-6); // S
+  EXPECT_NEAR(ws9[8], 0.5f * std::sqrt(3.0f) * 0.36f, 1e-6); // U
+}
+
+// With SN3D the harmonics of degree l summed over m give the Legendre
+// polynomial of the angle between the two directions (addition theorem).
+TEST(Ambisonics, ACNAdditionTheorem) {
+  const int order = 7;
+  const int channels = AmbiBase::orderToChannels(3, order);
+  EXPECT_EQ(channels, 64);
+  EXPECT_EQ(AmbiBase::channelsToOrder(channels), order);
+  EXPECT_EQ(AmbiBase::channelsToDimensions(channels), 3);
+
+  std::vector<float> a(channels), b(channels);
+  Vec3f da = Vec3f(0.3f, -0.5f, 0.7f).normalize();
+  Vec3f db = Vec3f(-0.2f, 0.9f, 0.1f).normalize();
+  AmbiBase::encodeWeightsACN(a.data(), 3, order, da.x, da.y, da.z);
+  AmbiBase::encodeWeightsACN(b.data(), 3, order, db.x, db.y, db.z);
+
+  double x = da.dot(db);
+  double p0 = 1.0, p1 = x;
+  for (int l = 0; l <= order; l++) {
+    double legendre = l == 0 ? p0 : p1;
+    if (l > 1) {
+      legendre = ((2 * l - 1) * x * p1 - (l - 1) * p0) / l;
+      p0 = p1;
+      p1 = legendre;
+    }
+    double sum = 0;
+    for (int c = l * l; c < (l + 1) * (l + 1); c++) {
+      EXPECT_EQ(AmbiBase::channelDegree(AmbiBase::ACN_SN3D, 3, order, c), l);
+      sum += a[c] * b[c];
+    }
+    EXPECT_NEAR(sum, legendre, 1e-5);
+  }
+}
+
+TEST(Ambisonics, ChannelsToOrder) {
+  EXPECT_EQ(AmbiBase::channelsToOrder(3), 1);
+  EXPECT_EQ(AmbiBase::channelsToDimensions(3), 2);
+  EXPECT_EQ(AmbiBase::channelsToOrder(16), 3);
+  EXPECT_EQ(AmbiBase::channelsToDimensions(16), 3);
+  EXPECT_EQ(AmbiBase::channelsToOrder(1), 0);
+  EXPECT_EQ(AmbiBase::channelsToOrder(0), -1);
+  EXPECT_EQ(AmbiBase::channelsToOrder(6), -1);
+
+  // Odd squares are 2D and 3D layouts of different orders
+  for (int root : {3, 5, 7, 9}) {
+    const int channels = root * root;
+    EXPECT_EQ(AmbiBase::channelsToOrder(channels), -1);
+    EXPECT_EQ(AmbiBase::channelsToDimensions(channels), -1);
+    EXPECT_EQ(AmbiBase::channelsToOrder(3, channels), root - 1);
+    EXPECT_EQ(AmbiBase::channelsToOrder(2, channels), (channels - 1) / 2);
+  }
+  EXPECT_EQ(AmbiBase::channelsToOrder(2, 16), -1);
+  EXPECT_EQ(AmbiBase::channelsToOrder(3, 7), -1);
+}
+
+TEST(Ambisonics, DecodeMatchesReference) {
+  const int order = 5;
+  const int numFrames = 100; // not a multiple of the tile size
+  Speakers speakers;
+  for (int i = 0; i < 22; i++) {
+    speakers.emplace_back(i, i * 360.f / 22, (i % 3) * 30.f - 30.f);
+  }
+  speakers[4].gain = 0.0f;
+
+  AmbiDecode decoder(3, order, speakers.size());
+  EXPECT_EQ(decoder.convention(), AmbiBase::ACN_SN3D);
+  decoder.setSpeakers(speakers);
+
+  const int channels = decoder.channels();
+  std::vector<float> ambi(channels * numFrames);
+  for (size_t i = 0; i < ambi.size(); i++) {
+    ambi[i] = std::sin(i * 0.37f);
+  }
+
+  std::vector<float> out(speakers.size() * numFrames, 0.5f);
+  decoder.decode(out.data(), ambi.data(), numFrames);
+
+  for (size_t s = 0; s < speakers.size(); s++) {
+    for (int i = 0; i < numFrames; i++) {
+      double expected = 0.5;
+      if (s != 4) {
+        for (int c = 0; c < channels; c++) {
+          expected += decoder.decodeWeight(s, c) * ambi[c * numFrames + i];
+        }
+      }
+      EXPECT_NEAR(out[s * numFrames + i], expected, 1e-4);
+    }
+  }
+
+  // Speakers set one at a time are picked up by the next decode
+  decoder.setSpeaker(4, 4, 45.f, 10.f);
+  decoder.setSpeaker(5, 5, -20.f, 0.f, 0.0f);
+  std::fill(out.begin(), out.end(), 0.0f);
+  decoder.decode(out.data(), ambi.data(), numFrames);
+  for (int s = 4; s < 6; s++) {
+    double expected = 0.0;
+    if (s == 4) {
+      for (int c = 0; c < channels; c++) {
+        expected += decoder.decodeWeight(s, c) * ambi[c * numFrames];
+      }
+    }
+    EXPECT_NEAR(out[s * numFrames], expected, 1e-4);
+  }
+}
+
+// Rotating an encoded direction must give the encoding of the rotated
+// direction, for every convention and dimension.
+TEST(Ambisonics, Rotation) {
+  Quatd q;
+  q.fromAxisAngle(0.9, Vec3d(0.2, -0.7, 0.4).normalize());
+  Quatd yaw;
+  yaw.fromAxisAngle(-1.3, Vec3d(0, 0, 1));
+  const int numFrames = 3;
+
+  struct Config {
+    int dim;
+    int order;
+    AmbiBase::Convention convention;
+  };
+  for (auto config : {Config{3, 7, AmbiBase::ACN_SN3D},
+                      Config{3, 3, AmbiBase::FUMA},
+                      Config{2, 5, AmbiBase::ACN_SN3D},
+                      Config{2, 3, AmbiBase::FUMA}}) {
+    const Quatd &rotation = config.dim == 3 ? q : yaw;
+    AmbiRotate rotate(config.dim, config.order);
+    rotate.convention(config.convention);
+    rotate.rotation(rotation);
+    rotate.numFrames(numFrames);
+
+    const int channels = rotate.channels();
+    std::vector<float> ambi(channels * numFrames), expected(channels);
+    Vec3d dirs[numFrames] = {Vec3d(0.3, -0.5, 0.7).normalize(),
+                             Vec3d(1, 0, 0),
+                             Vec3d(-0.2, 0.9, -0.1).normalize()};
+    std::vector<float> ws(channels);
+    for (int i = 0; i < numFrames; i++) {
+      AmbiBase::encodeWeights(ws.data(), config.convention, config.dim,
+                              config.order, dirs[i].x, dirs[i].y, dirs[i].z);
+      for (int c = 0; c < channels; c++) {
+        ambi[c * numFrames + i] = ws[c];
+      }
+    }
+    rotate.rotate(ambi.data(), numFrames);
+
+    for (int i = 0; i < numFrames; i++) {
+      Vec3d r = rotation.rotate(dirs[i]);
+      AmbiBase::encodeWeights(expected.data(), config.convention, config.dim,
+                              config.order, r.x, r.y, r.z);
+      for (int c = 0; c < channels; c++) {
+        EXPECT_NEAR(ambi[c * numFrames + i], expected[c], 1e-4);
+      }
+    }
+  }
+}
+
+// A spatializer rotating its mix must match one given rotated positions.
+TEST(Ambisonics, SoundfieldRotation) {
+  const int numFrames = 8;
+  Speakers speakers;
+  for (int i = 0; i < 16; i++) {
+    speakers.emplace_back(i, i * 360.f / 16, (i % 2) * 40.f - 20.f);
+  }
+  AudioIOData io, ioRotated;
+  for (auto *data : {&io, &ioRotated}) {
+    data->framesPerBuffer(numFrames);
+    data->framesPerSecond(44100);
+    data->channelsOut(speakers.size());
+    data->zeroOut();
+  }
+
+  AmbisonicsSpatializer perSource(speakers, 3, 4);
+  AmbisonicsSpatializer soundfield(speakers, 3, 4);
+  soundfield.soundfieldRotation(true);
+  for (auto *s : {&perSource, &soundfield}) {
+    s->sceneCoordinates(true);
+    s->compile();
+    s->numFrames(numFrames);
+  }
+
+  Quatd orientation;
+  orientation.fromAxisAngle(0.7, Vec3d(0.3, 1, -0.2).normalize());
+  float samples[numFrames];
+  for (int i = 0; i < numFrames; i++) {
+    samples[i] = 1.0f - i * 0.1f;
+  }
+  Vec3d positions[2] = {Vec3d(1, 0.5, -3), Vec3d(-2, -1, 1)};
+
+  perSource.prepare(io);
+  soundfield.prepare(ioRotated);
+  EXPECT_TRUE(soundfield.rotatesSoundfield());
+  soundfield.listenerOrientation(orientation);
+  for (auto &pos : positions) {
+    perSource.renderBuffer(io, orientation.rotate(pos), samples, numFrames);
+    soundfield.renderBuffer(ioRotated, pos, samples, numFrames);
+  }
+  perSource.finalize(io);
+  soundfield.finalize(ioRotated);
+
+  float energy = 0;
+  for (size_t c = 0; c < speakers.size(); c++) {
+    for (int i = 0; i < numFrames; i++) {
+      EXPECT_NEAR(io.out(c, i), ioRotated.out(c, i), 1e-4);
+      energy += io.out(c, i) * io.out(c, i);
+    }
+  }
+  EXPECT_GT(energy, 0.1f);
+}
+
+// The default mapping passes positions to the encoder unchanged and reads
+// speaker azimuths as anti-clockwise. sceneCoordinates() converts from
+// graphics coordinates and reads them as clockwise, like Speaker documents.
+TEST(Ambisonics, SpatializerConventions) {
+  const int numFrames = 4;
+  Speakers speakers;
+  for (int i = 0; i < 4; i++) {
+    speakers.emplace_back(i, i * 90.f, 0.f);
+  }
+  float samples[numFrames] = {1, 1, 1, 1};
+
+  auto loudest = [&](AmbisonicsSpatializer &spatializer, const Vec3f &pos) {
+    AudioIOData io;
+    io.framesPerBuffer(numFrames);
+    io.channelsOut(speakers.size());
+    io.zeroOut();
+    spatializer.compile();
+    spatializer.numFrames(numFrames);
+    spatializer.prepare(io);
+    spatializer.renderBuffer(io, pos, samples, numFrames);
+    spatializer.finalize(io);
+    int index = 0;
+    for (int c = 1; c < int(speakers.size()); c++) {
+      if (io.out(c, 0) > io.out(index, 0)) {
+        index = c;
+      }
+    }
+    return index;
+  };
+
+  AmbisonicsSpatializer legacy(speakers, 2, 1);
+  legacy.soundfieldRotation(true);
+  EXPECT_FALSE(legacy.rotatesSoundfield());
+  EXPECT_EQ(loudest(legacy, Vec3f(0, 1, 0)), 1); // Ambisonic +y, azimuth 90
+  EXPECT_EQ(loudest(legacy, Vec3f(-1, 0, 0)), 2);
+
+  AmbisonicsSpatializer scene(speakers, 2, 1);
+  scene.sceneCoordinates(true);
+  scene.soundfieldRotation(true);
+  EXPECT_TRUE(scene.rotatesSoundfield());
+  EXPECT_EQ(loudest(scene, Vec3f(1, 0, 0)), 1); // right, clockwise 90
+  EXPECT_EQ(loudest(scene, Vec3f(0, 0, 1)), 2); // behind
+}
@@ -1,9 +1,15 @@
 
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <vector>
 
 #include "gtest/gtest.h"
 
 #include "al/io/al_AudioIO.hpp"
+#include "al/io/al_AudioProfiler.hpp"
+#include "al/io/al_HeadlessAudio.hpp"
+#include "al/sound/al_SoundFile.hpp"
 #include "al/math/al_Constants.hpp"
 #include "al/system/al_Time.hpp"
 
@@ -79,3 +85,218 @@ TEST(Audio, VirtualChannels) {
 #else
 
 #endif // TRAVIS_BUILD
+
+static void rampCallback(AudioIOData &io) {
+  float &value = io.user<float>();
+  while (io()) {
+    io.out(0) = value;
+    io.out(1) = -value;
+    value += 1.0f / 524288; // stays below the clipping level
+  }
+}
+
+TEST(Audio, HeadlessFreewheel) {
+  float value = 0;
+  AudioIO audioIO;
+  audioIO.init(rampCallback, &value, 64, 44100.0, 2, 0);
+
+  const char *path = "headless_test.wav";
+  HeadlessAudio headless(audioIO, HeadlessAudio::Clock::FREEWHEEL);
+  headless.record(path);
+  // Far faster than real time and not a multiple of the buffer size
+  EXPECT_TRUE(headless.render(441000 + 10));
+  EXPECT_TRUE(headless.framesProcessed() == 441010);
+  EXPECT_TRUE(headless.deadlineMisses() == 0);
+
+  SoundFile file;
+  EXPECT_TRUE(file.open(path));
+  EXPECT_TRUE(file.frameCount == 441010);
+  EXPECT_TRUE(file.channels == 2);
+  EXPECT_TRUE(file.sampleRate == 44100);
+  for (int i = 0; i < 441010; i += 997) {
+    EXPECT_NEAR(file.getFrame(i)[0], i / 524288.0, 1e-6);
+    EXPECT_NEAR(file.getFrame(i)[1], -file.getFrame(i)[0], 1e-9);
+  }
+  std::remove(path);
+}
+
+// The fused output pass must match separate gain, NaN and clip passes
+TEST(Audio, OutputPass) {
+  const int channels = 3;
+  const unsigned frames = 37; // not a multiple of the block size
+  std::vector<float> src(channels * frames);
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = 2.0f * std::sin(i * 0.3f);
+  }
+  src[5] = std::nanf("");
+  src[frames + 20] = std::nanf("");
+
+  for (bool clip : {false, true}) {
+    AudioOutputPass pass;
+    pass.gainStart = 0.25f;
+    pass.gainEnd = 0.75f;
+    pass.clip = clip;
+
+    std::vector<float> expected(src);
+    float dgain = (pass.gainEnd - pass.gainStart) / frames;
+    for (int c = 0; c < channels; c++) {
+      float gain = pass.gainStart;
+      for (unsigned i = 0; i < frames; i++) {
+        float &s = expected[c * frames + i];
+        s *= gain;
+        gain += dgain;
+        if (s != s) {
+          s = 0;
+        }
+        if (clip) {
+          s = s < -1.f ? -1.f : (s > 1.f ? 1.f : s);
+        }
+      }
+    }
+
+    std::vector<float> planar(src), interleaved(src.size());
+    for (int c = 0; c < channels; c++) {
+      float *channel = planar.data() + c * frames;
+      pass.process(channel, channel, frames);
+    }
+    pass.processInterleaved(src.data(), interleaved.data(), channels, frames);
+    for (int c = 0; c < channels; c++) {
+      for (unsigned i = 0; i < frames; i++) {
+        EXPECT_NEAR(planar[c * frames + i], expected[c * frames + i], 1e-5);
+        EXPECT_NEAR(interleaved[i * channels + c], expected[c * frames + i],
+                    1e-5);
+      }
+    }
+  }
+}
+
+// The output buffers hold the finalized samples as well as the device
+TEST(Audio, FinalizeOutputInPlace) {
+  AudioIO audioIO;
+  audioIO.init(nullptr, nullptr, 16, 44100.0, 2, 0);
+  const int channels = audioIO.channelsOutDevice();
+  const unsigned frames = audioIO.framesPerBuffer();
+  for (int c = 0; c < channels; c++) {
+    for (unsigned i = 0; i < frames; i++) {
+      audioIO.outBuffer(c)[i] = i % 2 ? std::nanf("") : 2.0f;
+    }
+  }
+  std::vector<float> device(channels * frames);
+  audioIO.finalizeOutput(device.data(), true);
+  for (int c = 0; c < channels; c++) {
+    for (unsigned i = 0; i < frames; i++) {
+      const float expected = i % 2 ? 0.0f : 1.0f;
+      EXPECT_EQ(audioIO.outBuffer(c)[i], expected);
+      EXPECT_EQ(device[i * channels + c], expected);
+    }
+  }
+}
+
+TEST(Audio, HeadlessRealtime) {
+  float value = 0;
+  AudioIO audioIO;
+  audioIO.init(rampCallback, &value, 256, 44100.0, 2, 0);
+
+  HeadlessAudio headless(audioIO);
+  EXPECT_TRUE(headless.start(4410));
+  headless.wait();
+  EXPECT_TRUE(!headless.isRunning());
+  EXPECT_TRUE(headless.framesProcessed() == 4410); // 18 blocks
+
+  EXPECT_TRUE(headless.start());
+  al_sleep(0.2);
+  headless.stop();
+  // Loose bounds, as timing depends on the machine
+  EXPECT_TRUE(headless.framesProcessed() > 44100 * 0.1);
+  EXPECT_TRUE(headless.framesProcessed() < 44100 * 0.4);
+}
+
+struct ProfiledData {
+  int block{0};
+  int customStage{-1};
+};
+
+static void busyWait(double seconds) {
+  auto end = std::chrono::steady_clock::now() +
+             std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                 std::chrono::duration<double>(seconds));
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+static void profiledCallback(AudioIOData &io) {
+  auto &data = io.user<ProfiledData>();
+  const double period = io.framesPerBuffer() / io.framesPerSecond();
+  AudioProfiler::Scope scope(data.customStage);
+  // Every tenth block misses its deadline
+  busyWait(data.block % 10 == 0 ? period * 1.5 : period * 0.1);
+  data.block++;
+}
+
+TEST(Audio, Profiler) {
+  ProfiledData data;
+  AudioIO audioIO;
+  audioIO.init(profiledCallback, &data, 64, 44100.0, 2, 0);
+
+  AudioProfiler profiler(64);
+  data.customStage = profiler.addStage("custom");
+  EXPECT_TRUE(data.customStage == AudioProfiler::NUM_BUILTIN_STAGES);
+  audioIO.profiler(&profiler);
+
+  HeadlessAudio headless(audioIO, HeadlessAudio::Clock::FREEWHEEL);
+  headless.render(64 * 50);
+
+  const double period = 64 / 44100.0;
+  EXPECT_TRUE(profiler.blocks() == 50);
+  EXPECT_TRUE(profiler.deadlineMisses() == 5);
+  EXPECT_TRUE(profiler.dropped() == 0);
+
+  auto block = profiler.blockStats();
+  EXPECT_TRUE(block.count == 50);
+  EXPECT_TRUE(block.p50 < period);
+  EXPECT_TRUE(block.p90 < period);
+  EXPECT_TRUE(block.max > period);
+  auto callback = profiler.stageStats(AudioProfiler::IO_CALLBACK);
+  auto custom = profiler.stageStats(data.customStage);
+  EXPECT_TRUE(custom.p50 >= period * 0.1 && custom.p50 <= callback.p50);
+  EXPECT_TRUE(callback.p50 <= block.p50);
+  EXPECT_TRUE(profiler.stageStats(AudioProfiler::VOICES).max == 0);
+  EXPECT_TRUE(profiler.load() > 0.2 && profiler.load() < 1.0);
+
+  // Only the last 64 blocks are kept
+  headless.render(64 * 100);
+  EXPECT_TRUE(profiler.blockStats().count == 64);
+  EXPECT_TRUE(profiler.blocks() == 150);
+  EXPECT_TRUE(profiler.dropped() == 36);
+}
+
+TEST(Audio, ProfilerEmptyHistory) {
+  // A history size of 0 keeps the last block
+  AudioProfiler profiler(0);
+  for (int i = 0; i < 3; i++) {
+    profiler.beginBlock(0.01);
+    profiler.endBlock();
+  }
+  EXPECT_TRUE(profiler.blockStats().count == 1);
+  EXPECT_TRUE(profiler.blocks() == 3);
+}
+
+TEST(Audio, ProfilerInvalidStage) {
+  AudioProfiler profiler;
+  while (profiler.numStages() < AudioProfiler::kMaxStages) {
+    profiler.addStage("stage");
+  }
+  const int full = profiler.addStage("full");
+  EXPECT_TRUE(full == -1);
+  EXPECT_TRUE(profiler.stageName(full).empty());
+  EXPECT_TRUE(profiler.stageName(AudioProfiler::kMaxStages).empty());
+
+  // Timing stages the profiler does not have does nothing
+  profiler.beginBlock(0.01);
+  {
+    AudioProfiler::Scope scope(full);
+    AudioProfiler::Scope outOfRange(AudioProfiler::kMaxStages);
+  }
+  profiler.endBlock();
+  EXPECT_TRUE(profiler.blockStats().count == 1);
+}
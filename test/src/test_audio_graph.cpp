@@ -0,0 +1,167 @@
+#include "al/io/al_AudioGraph.hpp"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace al;
+
+namespace {
+
+// Multiplies all input channels by a gain
+class Gain : public AudioCallback {
+public:
+  Gain(float gain = 1.0f) : mGain(gain) {}
+
+  void onAudioCB(AudioIOData &io) override {
+    while (io()) {
+      for (unsigned int c = 0; c < io.channelsOut(); c++) {
+        io.out(c) = io.in(c) * mGain;
+      }
+    }
+  }
+
+private:
+  float mGain;
+};
+
+void fillHost(AudioIOData &io) {
+  for (unsigned int c = 0; c < io.channelsOut(); c++) {
+    for (unsigned int i = 0; i < io.framesPerBuffer(); i++) {
+      io.outBuffer(c)[i] = float(c + 1) + 0.001f * float(i);
+    }
+  }
+}
+
+} // namespace
+
+TEST(AudioGraph, Chains) {
+  const int numChains = 8;
+  const int chainLength = 4;
+  AudioIOData io;
+  io.framesPerBuffer(128);
+  io.channelsOut(numChains + 1);
+
+  for (unsigned int workers : {0u, 2u}) {
+    AudioGraph graph(workers);
+    std::vector<Gain> gains(numChains * chainLength, Gain(0.5f));
+    for (int chain = 0; chain < numChains; chain++) {
+      int node = graph.input(chain, 1);
+      for (int i = 0; i < chainLength; i++) {
+        node = graph.addNode(gains[chain * chainLength + i], {node}, 1);
+        ASSERT_GE(node, 0);
+      }
+      graph.output(node, chain);
+    }
+    graph.prepare(io);
+    // Each chain only needs two buffers
+    EXPECT_EQ(graph.totalChannels(), size_t(numChains * chainLength));
+    EXPECT_EQ(graph.bufferChannels(), size_t(numChains * 2));
+
+    for (int block = 0; block < 10; block++) {
+      fillHost(io);
+      graph.onAudioCB(io);
+      for (int c = 0; c < numChains; c++) {
+        for (int i = 0; i < 128; i += 17) {
+          EXPECT_FLOAT_EQ(io.outBuffer(c)[i],
+                          (float(c + 1) + 0.001f * float(i)) / 16.0f);
+        }
+      }
+      // Channels that are not graph outputs are left as they were
+      EXPECT_FLOAT_EQ(io.outBuffer(numChains)[3], float(numChains + 1) + 0.003f);
+    }
+  }
+}
+
+TEST(AudioGraph, MergeAndSplit) {
+  AudioIOData io;
+  io.framesPerBuffer(64);
+  io.channelsOut(4);
+
+  AudioGraph graph(2);
+  int in = graph.input(0, 2);
+  // Two branches on the same input
+  Gain doubler(2.0f), halver(0.5f);
+  int a = graph.addNode(doubler, {in}, 2);
+  int b = graph.addNode(halver, {in}, 2);
+  // Mix the four channels of both branches down to one
+  int mix = graph.addNode(
+      [](AudioIOData &io) {
+        while (io()) {
+          float sum = 0.0f;
+          for (unsigned int c = 0; c < io.channelsIn(); c++) {
+            sum += io.in(c);
+          }
+          io.out(0) = sum;
+        }
+      },
+      {a, b}, 1);
+  // Node writing nothing, as a meter would
+  float peak = 0.0f;
+  graph.addNode(
+      [&](AudioIOData &io) {
+        while (io()) {
+          peak = std::max(peak, io.in(0));
+        }
+      },
+      {mix}, 0);
+  EXPECT_TRUE(graph.output(mix, 2));
+  EXPECT_TRUE(graph.output(a, 2)); // Summed with mix on channel 2
+  EXPECT_FALSE(graph.output(in, 0));
+  EXPECT_EQ(graph.addNode(doubler, {12}, 1), -1);
+
+  graph.prepare(io);
+  fillHost(io);
+  graph.onAudioCB(io);
+  for (int i = 0; i < 64; i++) {
+    const float in0 = 1.0f + 0.001f * i;
+    const float in1 = 2.0f + 0.001f * i;
+    const float mixed = 2.5f * (in0 + in1);
+    EXPECT_FLOAT_EQ(io.outBuffer(2)[i], mixed + 2.0f * in0);
+    EXPECT_FLOAT_EQ(io.outBuffer(3)[i], 2.0f * in1);
+    EXPECT_FLOAT_EQ(io.outBuffer(0)[i], in0);
+  }
+  EXPECT_FLOAT_EQ(peak, 2.5f * (3.0f + 0.002f * 63));
+}
+
+TEST(AudioGraph, MissingInputChannels) {
+  AudioIOData io;
+  io.framesPerBuffer(32);
+  io.channelsOut(2);
+
+  AudioGraph graph(0);
+  Gain gain;
+  int in = graph.input(1, 4); // Only channel 1 exists
+  int node = graph.addNode(gain, {in}, 1);
+  graph.output(node, 0);
+  graph.prepare(io);
+  fillHost(io);
+  graph.onAudioCB(io);
+  EXPECT_EQ(io.outBuffer(0)[10], 0.0f);
+  EXPECT_FLOAT_EQ(io.outBuffer(1)[10], 2.01f);
+}
+
+TEST(AudioGraph, Unprepared) {
+  AudioIOData io;
+  io.framesPerBuffer(32);
+  io.channelsOut(1);
+
+  AudioGraph graph(1);
+  Gain gain(2.0f);
+  int node = graph.addNode(gain, {graph.input(0, 1)}, 1);
+  graph.output(node, 0);
+
+  // Blocks the graph was not prepared for are left as they are
+  fillHost(io);
+  graph.onAudioCB(io);
+  EXPECT_FLOAT_EQ(io.outBuffer(0)[10], 1.01f);
+
+  graph.prepare(io);
+  graph.onAudioCB(io);
+  EXPECT_FLOAT_EQ(io.outBuffer(0)[10], 2.02f);
+
+  io.framesPerBuffer(64);
+  fillHost(io);
+  graph.onAudioCB(io);
+  EXPECT_FLOAT_EQ(io.outBuffer(0)[10], 1.01f);
+}
@@ -0,0 +1,130 @@
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/sound/al_BassManagement.hpp"
+#include "gtest/gtest.h"
+
+using namespace al;
+
+namespace {
+
+const int kFrames = 256;
+const double kSampleRate = 48000;
+
+// Process numBlocks of the io channels with an impulse on channel at frame 0
+std::vector<std::vector<float>> impulseResponses(BassManagement &bass,
+                                                 int numChannels, int channel,
+                                                 int numBlocks) {
+  AudioIOData io;
+  io.framesPerSecond(kSampleRate);
+  io.framesPerBuffer(kFrames);
+  io.channelsOut(numChannels);
+  bass.prepare(io);
+  std::vector<std::vector<float>> responses(numChannels);
+  for (int block = 0; block < numBlocks; block++) {
+    io.zeroOut();
+    if (block == 0) {
+      io.outBuffer(channel)[0] = 1.f;
+    }
+    bass.onAudioCB(io);
+    for (int c = 0; c < numChannels; c++) {
+      responses[c].insert(responses[c].end(), io.outBuffer(c),
+                          io.outBuffer(c) + kFrames);
+    }
+  }
+  return responses;
+}
+
+double magnitude(const std::vector<float> &response, double freq) {
+  std::complex<double> sum;
+  for (size_t i = 0; i < response.size(); i++) {
+    sum += double(response[i]) *
+           std::polar(1.0, -2.0 * M_PI * freq * i / kSampleRate);
+  }
+  return std::abs(sum);
+}
+
+} // namespace
+
+// Speakers and subwoofers together sum to an allpass
+TEST(BassManagement, Flatness) {
+  Speakers speakers;
+  for (int i = 0; i < 11; i++) {
+    speakers.emplace_back(i, i * 30.f);
+  }
+  BassManagement bass(100.f, kSampleRate);
+  bass.setSpeakers(speakers, {11, 12});
+
+  auto responses = impulseResponses(bass, 13, 9, 32);
+  std::vector<float> sum(responses[0].size(), 0.f);
+  for (auto &response : responses) {
+    for (size_t i = 0; i < sum.size(); i++) {
+      sum[i] += response[i];
+    }
+  }
+  for (double freq : {20.0, 50.0, 100.0, 200.0, 1000.0, 5000.0, 15000.0}) {
+    EXPECT_NEAR(magnitude(sum, freq), 1.0, 1e-3);
+  }
+
+  // Lows go to the subwoofers, highs stay on the speaker
+  EXPECT_NEAR(magnitude(responses[11], 20), 0.5, 0.05);
+  EXPECT_NEAR(magnitude(responses[12], 20), 0.5, 0.05);
+  EXPECT_TRUE(magnitude(responses[9], 20) < 0.1);
+  EXPECT_NEAR(magnitude(responses[9], 5000), 1.0, 0.01);
+  EXPECT_TRUE(magnitude(responses[11], 5000) < 0.01);
+  for (int c = 0; c < 11; c++) {
+    if (c != 9) {
+      EXPECT_NEAR(magnitude(responses[c], 1000), 0.0, 1e-4);
+    }
+  }
+}
+
+TEST(BassManagement, DelayAndGain) {
+  Speakers speakers;
+  speakers.emplace_back(0, 0.f, 0.f, 0, 2.f);
+  speakers.emplace_back(1, 90.f, 0.f, 0, 4.f);
+  BassManagement bass(80.f, kSampleRate);
+  bass.setSpeakers(speakers, {2});
+  bass.compensateDistances();
+  EXPECT_NEAR(bass.delay(0), 280 / kSampleRate, 1e-9);
+  EXPECT_NEAR(bass.gain(0), 0.5, 1e-6);
+  EXPECT_NEAR(bass.delay(1), 0.0, 1e-9);
+  EXPECT_NEAR(bass.gain(1), 1.0, 1e-6);
+
+  // Shorter and longer than a block
+  for (int frames : {100, 300}) {
+    bass.delay(2, frames / kSampleRate);
+    bass.gain(2, 0.25f);
+    auto responses = impulseResponses(bass, 3, 2, 3);
+    for (size_t i = 0; i < responses[2].size(); i++) {
+      EXPECT_NEAR(responses[2][i], int(i) == frames ? 0.25f : 0.f, 1e-6);
+    }
+  }
+}
+
+TEST(BassManagement, SampleRateChange) {
+  Speakers speakers;
+  speakers.emplace_back(0, 0.f, 0.f);
+  BassManagement bass(80.f, kSampleRate);
+  bass.setSpeakers(speakers, {1});
+  bass.delay(1, 100 / kSampleRate);
+
+  // Delay time is kept when the rate changes
+  AudioIOData io;
+  io.framesPerSecond(kSampleRate / 2);
+  io.framesPerBuffer(64);
+  io.channelsOut(2);
+  bass.prepare(io);
+  EXPECT_NEAR(bass.delay(1), 100 / kSampleRate, 1e-9);
+
+  // Blocks longer than the prepared one are processed in parts
+  io.framesPerBuffer(kFrames);
+  io.zeroOut();
+  io.outBuffer(1)[0] = 1.f;
+  bass.onAudioCB(io);
+  for (int i = 0; i < kFrames; i++) {
+    EXPECT_NEAR(io.outBuffer(1)[i], i == 50 ? 1.f : 0.f, 1e-6);
+  }
+}
@@ -0,0 +1,323 @@
+#include "al/protocol/al_CommandConnection.hpp"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+using namespace al;
+
+#ifndef AL_WINDOWS
+
+namespace {
+
+enum {
+  ECHO = CommandConnection::COMMAND_LAST_INTERNAL,
+  ECHO_REPLY,
+  BLOB // Large command that arrives in pieces
+};
+
+class EchoServer : public CommandServer {
+public:
+  bool processIncomingMessage(Message &m, Socket *src) override {
+    uint8_t command = m.getByte();
+    if (command == ECHO) {
+      uint32_t id = m.get<uint32_t>();
+      uint8_t reply[5] = {ECHO_REPLY};
+      memcpy(reply + 1, &id, 4);
+      sendMessage(reply, 5, src);
+      echoes++;
+      return true;
+    } else if (command == BLOB) {
+      blobBytes += m.remainingBytes();
+      m.pushReadIndex(m.remainingBytes());
+      blobs++;
+      return true;
+    }
+    return false;
+  }
+
+  std::atomic<int> echoes{0};
+  std::atomic<int> blobs{0};
+  std::atomic<size_t> blobBytes{0};
+};
+
+class EchoClient : public CommandClient {
+public:
+  bool processIncomingMessage(Message &m, Socket * /*src*/) override {
+    if (m.getByte() == ECHO_REPLY) {
+      m.get<uint32_t>();
+      replies++;
+      return true;
+    }
+    return false;
+  }
+
+  std::atomic<int> replies{0};
+};
+
+// Command as sent on the wire, after its size
+std::vector<uint8_t> frame(const std::vector<uint8_t> &command) {
+  const uint32_t size = uint32_t(command.size());
+  std::vector<uint8_t> bytes = {uint8_t(size), uint8_t(size >> 8),
+                                uint8_t(size >> 16), uint8_t(size >> 24)};
+  bytes.insert(bytes.end(), command.begin(), command.end());
+  return bytes;
+}
+
+// Connect a plain socket and handshake, to send raw bytes to a server
+bool connectPeer(Socket &peer, uint16_t port) {
+  if (!peer.open(port, "127.0.0.1", 1.0, Socket::TCP) || !peer.connect()) {
+    return false;
+  }
+  const char handshake[5] = {CommandConnection::HANDSHAKE, 0, 0, 0, 0};
+  if (peer.send(handshake, 5) != 5) {
+    return false;
+  }
+  char ack[5];
+  size_t received = 0;
+  while (received < 5) {
+    size_t bytes = peer.recv(ack + received, 5 - received);
+    if (bytes == 0 || bytes == SIZE_MAX) {
+      return false;
+    }
+    received += bytes;
+  }
+  return ack[0] == CommandConnection::HANDSHAKE_ACK;
+}
+
+bool waitFor(const std::function<bool()> &condition, double timeout = 5.0) {
+  double start = al_steady_time();
+  while (!condition()) {
+    if (al_steady_time() - start > timeout) {
+      return false;
+    }
+    al_sleep(0.005);
+  }
+  return true;
+}
+
+} // namespace
+
+TEST(CommandConnection, LoopbackClients) {
+  const int numClients = 100;
+  const uint16_t port = 16110;
+  EchoServer server;
+  ASSERT_TRUE(server.start(port, "127.0.0.1"));
+
+  // All clients on one thread
+  auto loop = std::make_shared<CommandLoop>();
+  loop->start();
+  std::vector<std::unique_ptr<EchoClient>> clients;
+  for (int i = 0; i < numClients; i++) {
+    clients.emplace_back(new EchoClient);
+    clients.back()->setEventLoop(loop);
+    ASSERT_TRUE(clients.back()->start(port, "127.0.0.1"));
+  }
+  EXPECT_EQ(server.waitForConnections(numClients, 5.0), numClients);
+  EXPECT_EQ(loop->numConnections(), size_t(numClients));
+
+  const int echoesPerClient = 10;
+  for (int n = 0; n < echoesPerClient; n++) {
+    for (int i = 0; i < numClients; i++) {
+      uint8_t message[5] = {ECHO};
+      uint32_t id = uint32_t(i * echoesPerClient + n);
+      memcpy(message + 1, &id, 4);
+      EXPECT_TRUE(clients[i]->sendMessage(message, 5));
+    }
+  }
+  EXPECT_TRUE(waitFor([&]() {
+    for (auto &client : clients) {
+      if (client->replies < echoesPerClient) {
+        return false;
+      }
+    }
+    return true;
+  }));
+  EXPECT_EQ(server.echoes.load(), numClients * echoesPerClient);
+
+  // Disconnected clients are removed from the server
+  for (int i = 0; i < numClients / 2; i++) {
+    clients[i]->stop();
+  }
+  EXPECT_TRUE(waitFor(
+      [&]() { return server.connectionCount() == size_t(numClients / 2); }));
+
+  for (int i = numClients / 2; i < numClients; i++) {
+    clients[i]->stop();
+  }
+  loop->stop();
+  server.stop();
+}
+
+TEST(CommandConnection, SplitCommands) {
+  const uint16_t port = 16111;
+  EchoServer server;
+  ASSERT_TRUE(server.start(port, "127.0.0.1"));
+  Socket peer;
+  ASSERT_TRUE(connectPeer(peer, port));
+  ASSERT_EQ(server.waitForConnections(1, 5.0), 1);
+
+  // One command split across two reads is handled once it is complete
+  const std::vector<uint8_t> echo = frame({ECHO, 1, 0, 0, 0});
+  EXPECT_EQ(peer.send((const char *)echo.data(), 5), 5u);
+  al_sleep(0.05);
+  EXPECT_EQ(server.echoes.load(), 0);
+  EXPECT_EQ(peer.send((const char *)echo.data() + 5, echo.size() - 5),
+            echo.size() - 5);
+  EXPECT_TRUE(waitFor([&]() { return server.echoes == 1; }));
+
+  // Larger than the initial buffer and sent in pieces, so the server has to
+  // wait for the rest and grow its buffer
+  const size_t size = 100000;
+  std::vector<uint8_t> blob(size, 7);
+  blob[0] = BLOB;
+  blob = frame(blob);
+  const size_t pieces[] = {3, 1000, 50000};
+  size_t sent = 0;
+  for (size_t end : pieces) {
+    EXPECT_EQ(peer.send((const char *)blob.data() + sent, end - sent),
+              end - sent);
+    sent = end;
+    al_sleep(0.02);
+    EXPECT_EQ(server.blobs.load(), 0);
+  }
+  EXPECT_EQ(peer.send((const char *)blob.data() + sent, blob.size() - sent),
+            blob.size() - sent);
+
+  // Two commands in a single send
+  std::vector<uint8_t> echoes = frame({ECHO, 2, 0, 0, 0});
+  const std::vector<uint8_t> second = frame({ECHO, 3, 0, 0, 0});
+  echoes.insert(echoes.end(), second.begin(), second.end());
+  EXPECT_EQ(peer.send((const char *)echoes.data(), echoes.size()),
+            echoes.size());
+
+  EXPECT_TRUE(waitFor([&]() { return server.echoes == 3; }));
+  EXPECT_EQ(server.blobs.load(), 1);
+  EXPECT_EQ(server.blobBytes.load(), size - 1);
+
+  peer.close();
+  server.stop();
+}
+
+TEST(CommandConnection, MessageBounds) {
+  uint8_t data[3] = {ECHO, 1, 2};
+  Message m(data, 3);
+  EXPECT_EQ(m.getByte(), ECHO);
+  // Reading past the end gives zeros instead of reading out of the command
+  EXPECT_EQ(m.get<uint32_t>(), 0u);
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(m.getByte(), 0);
+}
+
+TEST(CommandConnection, HandshakeTimeout) {
+  const uint16_t port = 16114;
+  // Connections complete in the listen backlog but are never answered
+  Socket listener;
+  ASSERT_TRUE(listener.open(port, "127.0.0.1", 0.5, Socket::TCP));
+  ASSERT_TRUE(listener.bind());
+  ASSERT_TRUE(listener.listen());
+  EchoClient client;
+  double start = al_steady_time();
+  EXPECT_FALSE(client.start(port, "127.0.0.1"));
+  EXPECT_LT(al_steady_time() - start, 10.0);
+  EXPECT_FALSE(client.isConnected());
+}
+
+TEST(CommandConnection, QueuedSends) {
+  const uint16_t port = 16112;
+  CommandLoop loop;
+  Socket listener;
+  ASSERT_TRUE(listener.open(port, "127.0.0.1", 0.5, Socket::TCP));
+  ASSERT_TRUE(listener.bind());
+  ASSERT_TRUE(listener.listen());
+  std::shared_ptr<Socket> accepted;
+  loop.listen(listener, [&](std::shared_ptr<Socket> socket) {
+    accepted = socket;
+    loop.add(socket, [](Socket &, uint8_t *, size_t size) { return size; });
+  });
+
+  Socket peer;
+  ASSERT_TRUE(peer.open(port, "127.0.0.1", 1.0, Socket::TCP));
+  ASSERT_TRUE(peer.connect());
+  for (int i = 0; i < 100 && !accepted; i++) {
+    loop.poll(0.01);
+  }
+  ASSERT_TRUE(accepted != nullptr);
+
+  // The peer is not reading, so sends fill the socket buffers and the rest
+  // is queued without blocking
+  std::vector<uint8_t> data(1 << 20, 1);
+  for (int i = 0; i < 16; i++) {
+    EXPECT_TRUE(loop.send(accepted.get(), data.data(), data.size()));
+  }
+  EXPECT_GT(loop.queuedBytes(accepted.get()), 0u);
+  EXPECT_GT(loop.stats().sendsQueued, 0u);
+
+  // Draining the peer lets the loop write the queue
+  loop.start();
+  size_t received = 0;
+  std::vector<char> buffer(1 << 16);
+  while (received < 16 * data.size()) {
+    size_t bytes = peer.recv(buffer.data(), buffer.size());
+    if (bytes == 0 || bytes == SIZE_MAX) {
+      break;
+    }
+    received += bytes;
+  }
+  EXPECT_EQ(received, 16 * data.size());
+  EXPECT_EQ(loop.queuedBytes(accepted.get()), 0u);
+  loop.stop();
+}
+
+TEST(CommandConnection, InputOverrun) {
+  const uint16_t port = 16113;
+  const size_t maxBufferSize = 16 * 1024;
+  CommandLoop loop(maxBufferSize);
+  Socket listener;
+  ASSERT_TRUE(listener.open(port, "127.0.0.1", 0.5, Socket::TCP));
+  ASSERT_TRUE(listener.bind());
+  ASSERT_TRUE(listener.listen());
+  std::atomic<size_t> consumed{0};
+  std::atomic<int> accepted{0};
+  std::atomic<int> closed{0};
+  loop.listen(listener, [&](std::shared_ptr<Socket> socket) {
+    // The first connection takes 100 byte commands, the second never
+    // completes one
+    bool consumes = accepted++ == 0;
+    loop.add(
+        socket,
+        [&, consumes](Socket &, uint8_t *, size_t size) -> size_t {
+          if (!consumes) {
+            return 0;
+          }
+          consumed += size - size % 100;
+          return size - size % 100;
+        },
+        [&](Socket &) { closed++; });
+  });
+  loop.start();
+
+  // More than the buffer holds is fine while commands are consumed
+  std::vector<uint8_t> data(100 * 1000, 1);
+  Socket peer;
+  ASSERT_TRUE(peer.open(port, "127.0.0.1", 1.0, Socket::TCP));
+  ASSERT_TRUE(peer.connect());
+  EXPECT_EQ(peer.send((const char *)data.data(), data.size()), data.size());
+  EXPECT_TRUE(waitFor([&]() { return consumed == data.size(); }));
+  EXPECT_EQ(closed.load(), 0);
+
+  // A command larger than the buffer closes the connection instead of
+  // dropping part of it
+  Socket overrunPeer;
+  ASSERT_TRUE(overrunPeer.open(port, "127.0.0.1", 1.0, Socket::TCP));
+  ASSERT_TRUE(overrunPeer.connect());
+  overrunPeer.send((const char *)data.data(), maxBufferSize * 2);
+  EXPECT_TRUE(waitFor([&]() { return closed == 1; }));
+  EXPECT_EQ(loop.numConnections(), 1u);
+  loop.stop();
+}
+
+#endif
@@ -16,6 +16,22 @@ public:
   }
 };
 
+// Counts processed blocks
+class CountingVoice : public al::PositionedVoice {
+public:
+  void onProcess(al::AudioIOData &io) override {
+    blocks++;
+    while (io()) {
+      io.out(0) = 0.3f;
+    }
+  }
+
+  // Keeps sounding until freed
+  void onTriggerOff() override {}
+
+  int blocks{0};
+};
+
 TEST(DynamicScene, SpatializerLbapAllosphere2Voices) {
   al::AudioIOData io;
   io.channelsOut(64);
@@ -361,3 +377,84 @@ TEST(DynamicScene, SpatializerLbap2D) {
     EXPECT_NEAR(io.out(7, samp), 0.3, 1e-6);
   }
 }
+
+namespace {
+std::vector<int> drawOrder;
+
+class DrawVoice : public al::PositionedVoice {
+public:
+  int index{0};
+  void onProcess(al::Graphics & /*g*/) override {
+    drawOrder.push_back(index);
+  }
+};
+} // namespace
+
+TEST(DynamicScene, DrawCullingAndSorting) {
+  al::DynamicScene scene(0, al::TimeMasterMode::TIME_MASTER_FREE);
+  scene.sortDrawingByDistance(true);
+
+  // Listener at the origin looking down -z with a 90 degree field of view
+  al::Graphics g;
+  g.projMatrix(al::Matrix4f::perspective(90, 1, 0.1, 100));
+  g.viewMatrix(al::Matrix4f::lookAt(al::Vec3f(0, 0, 0), al::Vec3f(0, 0, -1),
+                                    al::Vec3f(0, 1, 0)));
+
+  const al::Vec3f positions[] = {{0, 0, -5},  {0, 0, -20}, {0, 0, 6},
+                                 {12, 0, -10}, {0, 0, -2},  {0, 0, 8}};
+  const float radii[] = {1, 1, 1, 3, 1, -1};
+  for (int i = 0; i < 6; i++) {
+    auto *voice = scene.getVoice<DrawVoice>();
+    voice->index = i;
+    voice->setPose(al::Pose(positions[i]));
+    voice->setBoundingRadius(radii[i]);
+    scene.triggerOn(voice);
+  }
+  scene.processVoices();
+
+  // 2 is behind the listener, 3 intersects the right plane, 5 has no bounds
+  drawOrder.clear();
+  scene.render(g);
+  EXPECT_EQ(drawOrder, std::vector<int>({1, 3, 5, 0, 4}));
+
+  scene.cullDrawing(false);
+  drawOrder.clear();
+  scene.render(g);
+  EXPECT_EQ(drawOrder, std::vector<int>({1, 3, 5, 2, 0, 4}));
+}
+
+TEST(DynamicScene, AudibilityCulling) {
+  al::DynamicScene scene;
+  scene.audibilityThreshold(scene.distanceAttenuation().attenuation(50.0f));
+  al::AudioIOData io;
+  io.channelsOut(2);
+  io.framesPerBuffer(64);
+  scene.prepare(io);
+
+  auto *nearVoice = scene.getVoice<CountingVoice>();
+  nearVoice->setPose(al::Pose({0, 0, -2}));
+  auto *farVoice = scene.getVoice<CountingVoice>();
+  farVoice->setPose(al::Pose({0, 0, -100}));
+  scene.triggerOn(nearVoice);
+  int farId = scene.triggerOn(farVoice);
+  scene.render(io);
+  scene.render(io);
+  EXPECT_EQ(nearVoice->blocks, 2);
+  EXPECT_EQ(farVoice->blocks, 0);
+  EXPECT_FALSE(nearVoice->isVirtual());
+  EXPECT_TRUE(farVoice->isVirtual());
+  EXPECT_TRUE(farVoice->active());
+
+  // Processed again once it comes close
+  farVoice->setPose(al::Pose({0, 0, -10}));
+  scene.render(io);
+  EXPECT_EQ(farVoice->blocks, 1);
+  EXPECT_FALSE(farVoice->isVirtual());
+
+  // Freed when triggered off while inaudible
+  farVoice->setPose(al::Pose({0, 0, -100}));
+  scene.triggerOff(farId);
+  scene.render(io);
+  EXPECT_FALSE(farVoice->active());
+  EXPECT_EQ(farVoice->blocks, 1);
+}
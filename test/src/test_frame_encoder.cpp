@@ -0,0 +1,176 @@
+#include "al/graphics/al_FrameEncoder.hpp"
+#include "al/graphics/al_Image.hpp"
+#include "al/io/al_File.hpp"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+using namespace al;
+
+namespace {
+
+const int kWidth = 33;
+const int kHeight = 17;
+
+// Synthetic frame with a pattern that differs per frame and per row
+void fillFrame(unsigned char *pixels, int frame) {
+  for (int y = 0; y < kHeight; y++) {
+    for (int x = 0; x < kWidth * 3; x++) {
+      pixels[y * kWidth * 3 + x] = (unsigned char)(frame * 31 + y * 7 + x);
+    }
+  }
+}
+
+std::vector<unsigned char> readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<unsigned char>(std::istreambuf_iterator<char>(file),
+                                    std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+TEST(FrameEncoder, Raw) {
+  const std::string path = "frame_encoder_test.raw";
+  const int numFrames = 12;
+  FrameEncoder encoder;
+  encoder.flipVertically(false);
+  ASSERT_TRUE(encoder.open(FrameEncoder::Format::RAW, path, kWidth, kHeight));
+  for (int i = 0; i < numFrames; i++) {
+    auto *frame = encoder.acquire();
+    ASSERT_TRUE(frame != nullptr);
+    fillFrame(frame->pixels.data(), i);
+    encoder.submit(frame);
+  }
+  EXPECT_TRUE(encoder.close());
+
+  auto metrics = encoder.metrics();
+  EXPECT_EQ(metrics.framesSubmitted, uint64_t(numFrames));
+  EXPECT_EQ(metrics.framesWritten, uint64_t(numFrames));
+  EXPECT_EQ(metrics.bytesEncoded, uint64_t(numFrames) * encoder.frameBytes());
+  EXPECT_EQ(metrics.errors, 0u);
+
+  auto data = readFile(path);
+  ASSERT_EQ(data.size(), numFrames * encoder.frameBytes());
+  std::vector<unsigned char> expected(encoder.frameBytes());
+  for (int i = 0; i < numFrames; i++) {
+    fillFrame(expected.data(), i);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                           data.begin() + i * encoder.frameBytes()));
+  }
+  File::remove(path);
+}
+
+TEST(FrameEncoder, RawFlip) {
+  const std::string path = "frame_encoder_flip_test.raw";
+  FrameEncoder encoder;
+  ASSERT_TRUE(encoder.open(FrameEncoder::Format::RAW, path, kWidth, kHeight));
+  std::vector<unsigned char> pixels(encoder.frameBytes());
+  fillFrame(pixels.data(), 3);
+  encoder.write(pixels.data());
+  EXPECT_TRUE(encoder.close());
+
+  auto data = readFile(path);
+  ASSERT_EQ(data.size(), encoder.frameBytes());
+  const size_t rowBytes = kWidth * 3;
+  for (int y = 0; y < kHeight; y++) {
+    EXPECT_TRUE(std::equal(data.begin() + y * rowBytes,
+                           data.begin() + (y + 1) * rowBytes,
+                           pixels.begin() + (kHeight - 1 - y) * rowBytes));
+  }
+  File::remove(path);
+}
+
+TEST(FrameEncoder, PNG) {
+  const std::string prefix = "frame_encoder_test_";
+  const int numFrames = 8;
+  FrameEncoder encoder;
+  encoder.flipVertically(false);
+  ASSERT_TRUE(encoder.open(FrameEncoder::Format::PNG, prefix, kWidth, kHeight,
+                           3, 4));
+  std::vector<unsigned char> pixels(encoder.frameBytes());
+  for (int i = 0; i < numFrames; i++) {
+    fillFrame(pixels.data(), i);
+    encoder.write(pixels.data());
+  }
+  EXPECT_TRUE(encoder.close());
+  EXPECT_EQ(encoder.metrics().framesWritten, uint64_t(numFrames));
+
+  for (int i = 0; i < numFrames; i++) {
+    std::string path = prefix + std::to_string(i) + ".png";
+    Image image;
+    ASSERT_TRUE(image.load(path));
+    EXPECT_EQ(image.width(), unsigned(kWidth));
+    EXPECT_EQ(image.height(), unsigned(kHeight));
+    fillFrame(pixels.data(), i);
+    // Loaded as RGBA
+    const int x = 5, y = 9;
+    for (int c = 0; c < 3; c++) {
+      EXPECT_EQ(image.array()[(y * kWidth + x) * 4 + c],
+                pixels[(y * kWidth + x) * 3 + c]);
+    }
+    File::remove(path);
+  }
+}
+
+TEST(FrameEncoder, BackPressure) {
+  const std::string path = "frame_encoder_pressure_test.raw";
+  FrameEncoder encoder;
+  ASSERT_TRUE(encoder.open(FrameEncoder::Format::RAW, path, kWidth, kHeight,
+                           3, 1, 2));
+  EXPECT_EQ(encoder.numBuffers(), 2u);
+  auto *frame1 = encoder.acquire();
+  auto *frame2 = encoder.acquire();
+  EXPECT_NE(frame1, frame2);
+
+  // The pool is empty, so the next acquire() waits for a written frame
+  std::atomic<bool> acquired{false};
+  std::thread producer([&]() {
+    auto *frame3 = encoder.acquire();
+    acquired = true;
+    encoder.submit(frame3);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(acquired.load());
+  encoder.submit(frame1);
+  producer.join();
+  EXPECT_TRUE(acquired.load());
+  encoder.submit(frame2);
+  EXPECT_TRUE(encoder.close());
+
+  auto metrics = encoder.metrics();
+  EXPECT_EQ(metrics.framesWritten, 3u);
+  EXPECT_GT(metrics.stallTime, 0.0);
+  File::remove(path);
+}
+
+#ifndef AL_WINDOWS
+TEST(FrameEncoder, Pipe) {
+  const std::string path = "frame_encoder_pipe_test.raw";
+  const int numFrames = 10;
+  FrameEncoder encoder;
+  encoder.flipVertically(false);
+  ASSERT_TRUE(encoder.open(FrameEncoder::Format::PIPE, "cat > " + path, kWidth,
+                           kHeight));
+  std::vector<unsigned char> pixels(encoder.frameBytes());
+  for (int i = 0; i < numFrames; i++) {
+    fillFrame(pixels.data(), i);
+    encoder.write(pixels.data());
+  }
+  EXPECT_TRUE(encoder.close());
+
+  auto data = readFile(path);
+  ASSERT_EQ(data.size(), numFrames * encoder.frameBytes());
+  for (int i = 0; i < numFrames; i++) {
+    fillFrame(pixels.data(), i);
+    EXPECT_TRUE(std::equal(pixels.begin(), pixels.end(),
+                           data.begin() + i * encoder.frameBytes()));
+  }
+  File::remove(path);
+}
+#endif
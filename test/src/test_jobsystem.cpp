@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+
+#include "al/system/al_JobSystem.hpp"
+
+#include <atomic>
+#include <vector>
+
+using namespace al;
+
+TEST(JobSystem, ParallelFor) {
+  for (unsigned int workers : {0u, 1u, 3u}) {
+    JobSystem jobs(workers);
+    EXPECT_EQ(jobs.numWorkers(), workers);
+    std::vector<int> values(10000, 0);
+    jobs.parallelFor(0, values.size(), [&](size_t i) { values[i] += int(i); });
+    for (size_t i = 0; i < values.size(); i++) {
+      EXPECT_EQ(values[i], int(i));
+    }
+
+    // Uneven grain and empty range
+    std::atomic<int> count{0};
+    jobs.parallelFor(5, 1000, [&](size_t) { count++; }, 7);
+    jobs.parallelFor(10, 10, [&](size_t) { count++; });
+    EXPECT_EQ(count.load(), 995);
+  }
+}
+
+TEST(JobSystem, TaskGroupNested) {
+  JobSystem jobs(2);
+  std::atomic<int> count{0};
+  {
+    TaskGroup group(jobs);
+    for (int i = 0; i < 50; i++) {
+      group.run([&]() {
+        // Jobs can wait for other jobs
+        jobs.parallelFor(0, 100, [&](size_t) { count++; }, 10);
+      });
+    }
+    group.wait();
+    EXPECT_EQ(count.load(), 5000);
+    group.run([&]() { count++; });
+  }
+  EXPECT_EQ(count.load(), 5001);
+}
+
+TEST(JobSystem, QueueOverflow) {
+  JobSystem jobs(1);
+  // More jobs than fit in the shared queue. The rest run in submit().
+  std::atomic<int> count{0};
+  std::vector<JobSystem::Job> batch(1000);
+  std::atomic<int> pending{int(batch.size())};
+  for (auto &job : batch) {
+    job = JobSystem::Job{[](void *context, size_t, size_t) {
+                           (*static_cast<std::atomic<int> *>(context))++;
+                         },
+                         &count, 0, 0, &pending};
+  }
+  jobs.submit(batch.data(), batch.size());
+  jobs.wait(pending);
+  EXPECT_EQ(count.load(), 1000);
+  EXPECT_EQ(pending.load(), 0);
+}
@@ -11,6 +11,7 @@
 #include "al/math/al_Complex.hpp"
 #include "al/math/al_Frustum.hpp"
 #include "al/math/al_Interval.hpp"
+#include "al/math/al_Matrix4.hpp"
 
 //  Synchronized to AlloSystem commit:
 //  0ddb8ec6594ca66d34dc18849bc2b433e5f67016
@@ -1176,5 +1177,21 @@ EXPECT_TRUE(eq(m(2,2),i));\
     EXPECT_TRUE(f.testSphere(Vec3d(0, 0, 0), 0.9) == Frustumd::INSIDE);
     EXPECT_TRUE(f.testSphere(Vec3d(0, 0, 0), 1.1) == Frustumd::INTERSECT);
     EXPECT_TRUE(f.testSphere(Vec3d(2, 2, 2), 0.5) == Frustumd::OUTSIDE);
+
+    // From a camera at the origin looking down -z with a 90 degree field
+    Matrix4d proj = Matrix4d::perspective(90, 1, 0.5, 100);
+    Matrix4d view = Matrix4d::lookAt(Vec3d(0, 0, 0), Vec3d(0, 0, -1),
+                                     Vec3d(0, 1, 0));
+    f.fromMatrix(proj * view);
+    EXPECT_TRUE(eq(f.ntl, Vec3d(-0.5, 0.5, -0.5), 1e-9));
+    EXPECT_TRUE(eq(f.fbr, Vec3d(100, -100, -100), 1e-6));
+    EXPECT_TRUE(f.testPoint(Vec3d(0, 0, -10)) == Frustumd::INSIDE);
+    EXPECT_TRUE(f.testPoint(Vec3d(0, 0, 10)) == Frustumd::OUTSIDE);
+    EXPECT_TRUE(f.testPoint(Vec3d(0, 0, -0.4)) == Frustumd::OUTSIDE);
+    EXPECT_TRUE(f.testPoint(Vec3d(0, 0, -101)) == Frustumd::OUTSIDE);
+    EXPECT_TRUE(f.testPoint(Vec3d(9, 0, -10)) == Frustumd::INSIDE);
+    EXPECT_TRUE(f.testPoint(Vec3d(11, 0, -10)) == Frustumd::OUTSIDE);
+    EXPECT_TRUE(f.testSphere(Vec3d(11, 0, -10), 2) == Frustumd::INTERSECT);
+    EXPECT_TRUE(f.testSphere(Vec3d(0, -12, -10), 1) == Frustumd::OUTSIDE);
   }
 }
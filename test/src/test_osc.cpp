@@ -2,6 +2,9 @@
 #include "gtest/gtest.h"
 
 #include "al/protocol/al_OSC.hpp"
+#include "al/protocol/al_OSCRecvGroup.hpp"
+
+#include <cstring>
 
 using namespace al;
 
@@ -78,4 +81,217 @@ TEST(OSC, MultipleReceivers) {
   EXPECT_TRUE(handler2.inString == "world4");
 }
 
+TEST(OSC, PacketWriterMatchesPacket) {
+  const char blobData[] = {1, 2, 3, 4, 5};
+  osc::Blob blob(blobData, sizeof(blobData));
+
+  osc::Packet packet(1024);
+  packet.addMessage("/empty");
+  packet.clear();
+  packet.beginBundle(12345);
+  packet.addMessage("/empty");
+  packet.addMessage("/args", 1, 2.5f, 3.25, 'x', "text", blob, int64_t(-7));
+  packet.beginBundle(678);
+  packet.addMessage("/nested/address", std::string("ab"), 0.5f);
+  packet.endBundle();
+  packet.endBundle();
+
+  char buffer[1024];
+  osc::PacketWriter writer(buffer, sizeof(buffer));
+  writer.beginBundle(12345);
+  writer.addMessage("/empty");
+  writer.addMessage("/args", 1, 2.5f, 3.25, 'x', "text", blob, int64_t(-7));
+  writer.beginBundle(678);
+  writer.addMessage("/nested/address", std::string("ab"), 0.5f);
+  writer.endBundle();
+  writer.endBundle();
+
+  EXPECT_FALSE(writer.overflow());
+  ASSERT_EQ(writer.size(), packet.size());
+  EXPECT_EQ(memcmp(writer.data(), packet.data(), packet.size()), 0);
+
+  // Reuse for a single message
+  packet.clear();
+  packet.addMessage("/voice/3/frequency", 440.0f, 12, "sine");
+  writer.clear();
+  writer.addMessage("/voice/3/frequency", 440.0f, 12, "sine");
+  ASSERT_EQ(writer.size(), packet.size());
+  EXPECT_EQ(memcmp(writer.data(), packet.data(), packet.size()), 0);
+}
+
+TEST(OSC, PacketWriterOverflow) {
+  char buffer[24];
+  osc::PacketWriter writer(buffer, sizeof(buffer));
+  writer.addMessage("/a", 1.0f);
+  EXPECT_FALSE(writer.overflow());
+  EXPECT_EQ(writer.size(), 12u);
+  writer.addMessage("/b", 1.0f, 2.0f);
+  EXPECT_TRUE(writer.overflow());
+  EXPECT_LE(writer.size(), sizeof(buffer));
+
+  writer.clear();
+  EXPECT_FALSE(writer.overflow());
+  // Fills the buffer exactly
+  writer.addMessage("/abcdefg", 1, 2);
+  EXPECT_FALSE(writer.overflow());
+  osc::Packet packet(64);
+  packet.addMessage("/abcdefg", 1, 2);
+  ASSERT_EQ(writer.size(), packet.size());
+  EXPECT_EQ(memcmp(writer.data(), packet.data(), packet.size()), 0);
+}
+
+TEST(OSC, MessageView) {
+  const char blobData[] = {9, 8, 7};
+  osc::Packet packet(1024);
+  packet.addMessage("/view/test", 42, 1.5f, 2.25, 'q', "hello",
+                    osc::Blob(blobData, sizeof(blobData)), int64_t(1) << 40);
+
+  osc::MessageView view;
+  ASSERT_TRUE(view.parse(packet.data(), packet.size()));
+  EXPECT_TRUE(view.addressIs("/view/test"));
+  EXPECT_EQ(view.addressPatternSize(), 10u);
+  EXPECT_EQ(std::string(view.typeTags()), "ifdcsbh");
+  EXPECT_EQ(view.argumentCount(), 7);
+
+  int i = 0;
+  float f = 0;
+  double d = 0;
+  char c = 0;
+  const char *s = nullptr;
+  osc::Blob b;
+  int64_t h = 0;
+  view >> i >> f >> d >> c >> s >> b >> h;
+  EXPECT_TRUE(view.good());
+  EXPECT_EQ(i, 42);
+  EXPECT_EQ(f, 1.5f);
+  EXPECT_EQ(d, 2.25);
+  EXPECT_EQ(c, 'q');
+  EXPECT_EQ(std::string(s), "hello");
+  EXPECT_EQ(b.size, 3u);
+  EXPECT_EQ(memcmp(b.data, blobData, 3), 0);
+  EXPECT_EQ(h, int64_t(1) << 40);
+  EXPECT_EQ(view.nextType(), '\0');
+
+  // Wrong type leaves the value and stream position untouched
+  view.resetStream();
+  f = -1;
+  view >> f;
+  EXPECT_FALSE(view.good());
+  EXPECT_EQ(f, -1.0f);
+  EXPECT_EQ(view.nextType(), 'i');
+
+  // Truncated message
+  EXPECT_FALSE(view.parse(packet.data(), packet.size() - 4));
+  EXPECT_FALSE(view.parse(packet.data(), 3));
+}
+
+class ViewHandler : public osc::PacketHandler {
+public:
+  void onMessage(osc::Message &m) override {
+    messages++;
+    senderPort = m.senderPort();
+  }
+  bool onMessageView(osc::MessageView &m) override {
+    if (!takeViews) {
+      return false;
+    }
+    float v = 0;
+    m >> v;
+    sum += v;
+    views++;
+    senderPort = m.senderPort();
+    return true;
+  }
+
+  bool takeViews{true};
+  int views{0};
+  int messages{0};
+  float sum{0};
+  uint16_t senderPort{0};
+};
+
+TEST(OSC, RecvDispatch) {
+  char buffer[512];
+  osc::PacketWriter writer(buffer, sizeof(buffer));
+  writer.beginBundle();
+  for (int i = 0; i < 4; i++) {
+    writer.addMessage("/value", float(i));
+  }
+  writer.beginBundle();
+  writer.addMessage("/value", 10.0f);
+  writer.endBundle();
+  writer.endBundle();
+
+  ViewHandler viewHandler;
+  ViewHandler messageHandler;
+  messageHandler.takeViews = false;
+  osc::Recv recv;
+  recv.handler(viewHandler);
+  recv.appendHandler(messageHandler);
+  recv.parse(writer.data(), int(writer.size()), "127.0.0.1", 9000);
+
+  EXPECT_EQ(viewHandler.views, 5);
+  EXPECT_EQ(viewHandler.messages, 0);
+  EXPECT_EQ(viewHandler.sum, 16.0f);
+  EXPECT_EQ(viewHandler.senderPort, 9000);
+  EXPECT_EQ(messageHandler.views, 0);
+  EXPECT_EQ(messageHandler.messages, 5);
+  EXPECT_EQ(messageHandler.senderPort, 9000);
+
+  int count = 0;
+  EXPECT_TRUE(osc::Recv::forEachMessage(
+      writer.data(), writer.size(),
+      [&](osc::MessageView &m) { count += m.addressIs("/value"); }));
+  EXPECT_EQ(count, 5);
+}
+
+#ifndef AL_WINDOWS
+TEST(OSC, RecvGroup) {
+  Handler handler1;
+  Handler handler2;
+  ViewHandler viewHandler1;
+  ViewHandler viewHandler2;
+
+  osc::RecvGroup group;
+  EXPECT_TRUE(group.open(10830, handler1, "localhost"));
+  EXPECT_TRUE(group.open(10831, viewHandler1, "localhost"));
+  EXPECT_TRUE(group.open(10831, viewHandler2, "localhost"));
+  EXPECT_TRUE(group.open(10832, handler2, "localhost"));
+  EXPECT_EQ(group.numPorts(), 3u);
+  // Port in use
+  osc::RecvGroup other;
+  EXPECT_FALSE(other.open(10830, handler1, "localhost"));
+
+  // Queued in the sockets before starting, so they are read in batches
+  osc::Send(10830, "localhost").send("/hello1", "world1");
+  osc::Send sender(10831, "localhost");
+  for (int i = 0; i < 100; i++) {
+    sender.send("/value", float(i));
+  }
+  osc::Send(10832, "localhost").send("/hello2", "world2");
+  group.start();
+  al_sleep(0.1);
+  group.stop();
+
+  EXPECT_TRUE(handler1.address == "/hello1");
+  EXPECT_TRUE(handler1.inString == "world1");
+  EXPECT_TRUE(handler2.address == "/hello2");
+  EXPECT_TRUE(handler2.inString == "world2");
+  EXPECT_EQ(viewHandler1.views, 100);
+  EXPECT_EQ(viewHandler1.sum, 4950.0f);
+  EXPECT_NE(viewHandler1.senderPort, 0);
+  EXPECT_EQ(viewHandler2.views, 100);
+
+  auto stats = group.stats();
+  EXPECT_EQ(stats.packets, 102u);
+  EXPECT_EQ(stats.malformed, 0u);
+  EXPECT_LT(stats.receiveCalls, stats.packets);
+
+  // Polling from this thread after stop()
+  osc::Send(10830, "localhost").send("/hello3", "world3");
+  EXPECT_EQ(group.poll(1.0), 1);
+  EXPECT_TRUE(handler1.address == "/hello3");
+}
+#endif
+
 // #endif
@@ -0,0 +1,175 @@
+#include "al/ui/al_Parameter.hpp"
+#include "al/ui/al_ParameterAutomation.hpp"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace al;
+
+TEST(ParameterAutomation, ScheduledFrames) {
+  const unsigned int blockSize = 64;
+  ParameterAutomation automation(0.0f, 48000.0, blockSize, 0.0f);
+
+  // Changes inside blocks and on block boundaries, out of order
+  const uint64_t frames[] = {10, 100, 64, 200, 255};
+  const float values[] = {1.0f, 3.0f, 2.0f, 4.0f, 5.0f};
+  for (int i = 0; i < 5; i++) {
+    EXPECT_TRUE(automation.schedule(values[i], frames[i], 0.0f));
+  }
+
+  std::vector<float> output;
+  for (int block = 0; block < 5; block++) {
+    const float *block_values = automation.process(blockSize);
+    output.insert(output.end(), block_values, block_values + blockSize);
+  }
+  for (uint64_t frame = 0; frame < output.size(); frame++) {
+    float expected = 0.0f;
+    if (frame >= 255) {
+      expected = 5.0f;
+    } else if (frame >= 200) {
+      expected = 4.0f;
+    } else if (frame >= 100) {
+      expected = 3.0f;
+    } else if (frame >= 64) {
+      expected = 2.0f;
+    } else if (frame >= 10) {
+      expected = 1.0f;
+    }
+    EXPECT_EQ(output[frame], expected);
+  }
+  EXPECT_EQ(automation.stats().events, 5u);
+  EXPECT_EQ(automation.stats().late, 0u);
+}
+
+TEST(ParameterAutomation, Ramp) {
+  const double sampleRate = 1000.0;
+  ParameterAutomation automation(0.0f, sampleRate, 32);
+
+  // 40 frame ramp starting at frame 20, crossing a block boundary
+  automation.schedule(1.0f, 20, 0.04f);
+  std::vector<float> output;
+  for (int block = 0; block < 3; block++) {
+    const float *values = automation.process(32);
+    output.insert(output.end(), values, values + 32);
+  }
+  for (int frame = 0; frame < 20; frame++) {
+    EXPECT_EQ(output[frame], 0.0f);
+  }
+  for (int step = 0; step < 40; step++) {
+    EXPECT_NEAR(output[20 + step], (step + 1) / 40.0f, 1e-5);
+  }
+  for (size_t frame = 60; frame < output.size(); frame++) {
+    EXPECT_EQ(output[frame], 1.0f);
+  }
+
+  // A late event is applied at the start of the next block
+  automation.schedule(2.0f, 10, 0.0f);
+  EXPECT_EQ(automation.process(32)[0], 2.0f);
+  EXPECT_EQ(automation.stats().late, 1u);
+}
+
+TEST(ParameterAutomation, ParameterSet) {
+  const double sampleRate = 48000.0;
+  const unsigned int blockSize = 256;
+  Parameter param("automated", "", 0.0f, 0.0f, 10.0f);
+  ParameterAutomation automation(param, sampleRate, blockSize, 0.0f);
+  EXPECT_EQ(param.automation(), &automation);
+
+  std::vector<float> output;
+  automation.process(blockSize);
+  output.resize(blockSize, 0.0f);
+
+  // Each set() lands between the frames of the clock readings around it,
+  // one block after the audio clock
+  uint64_t before = automation.frameAt(al_steady_time());
+  param.set(20.0f); // Clamped before reaching the automation
+  uint64_t after = automation.frameAt(al_steady_time());
+  EXPECT_EQ(param.get(), 10.0f);
+  EXPECT_GE(before, uint64_t(blockSize));
+  ASSERT_LE(after, uint64_t(2 * blockSize));
+
+  for (int block = 0; block < 3; block++) {
+    const float *values = automation.process(blockSize);
+    output.insert(output.end(), values, values + blockSize);
+  }
+  uint64_t changed = 0;
+  while (changed < output.size() && output[changed] != 10.0f) {
+    changed++;
+  }
+  EXPECT_GE(changed, before);
+  EXPECT_LE(changed, after);
+  for (uint64_t frame = changed; frame < output.size(); frame++) {
+    EXPECT_EQ(output[frame], 10.0f);
+  }
+
+  // Values set without callbacks are automated too
+  param.setNoCalls(3.0f);
+  for (int block = 0; block < 3; block++) {
+    automation.process(blockSize);
+  }
+  EXPECT_EQ(automation.value(), 3.0f);
+
+  automation.detach();
+  EXPECT_EQ(param.automation(), nullptr);
+  param.set(5.0f);
+  automation.process(blockSize);
+  automation.process(blockSize);
+  EXPECT_EQ(automation.value(), 3.0f);
+}
+
+TEST(ParameterAutomation, ConcurrentSetters) {
+  const int numThreads = 4;
+  const int valuesPerThread = 1000;
+  ParameterAutomation automation(0.0f, 48000.0, 128, 0.0f, 256);
+
+  std::atomic<int> done{0};
+  std::atomic<int> pushed{0};
+  std::atomic<int> full{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < valuesPerThread; i++) {
+        while (!automation.schedule(float(t), uint64_t(i), 0.0f)) {
+          full++;
+          std::this_thread::yield();
+        }
+        pushed++;
+      }
+      done++;
+    });
+  }
+  while (done < numThreads || automation.stats().events < uint64_t(pushed)) {
+    automation.process(128);
+    std::this_thread::yield();
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(automation.stats().events, uint64_t(numThreads * valuesPerThread));
+  EXPECT_EQ(automation.stats().dropped, uint64_t(full));
+}
+
+TEST(ParameterAutomation, DestroyWhileSetting) {
+  Parameter param{"param", "", 0.0f, 0.0f, 1.0f};
+  std::atomic<bool> running{true};
+  std::thread setter([&]() {
+    float value = 0.0f;
+    while (running) {
+      param.set(value);
+      value = value > 0.5f ? 0.0f : 1.0f;
+    }
+  });
+  // Each automation is freed while the parameter is being set
+  for (int i = 0; i < 1000; i++) {
+    std::unique_ptr<ParameterAutomation> automation(
+        new ParameterAutomation(param, 48000.0, 128, 0.0f, 16));
+    EXPECT_EQ(param.automation(), automation.get());
+    automation.reset();
+    EXPECT_TRUE(param.automation() == nullptr);
+  }
+  running = false;
+  setter.join();
+}
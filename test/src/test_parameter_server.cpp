@@ -3,7 +3,11 @@
 
 #include "al/ui/al_ParameterServer.hpp"
 
+#include <algorithm>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 TEST(ParameterSever, Handshake) {
   al::ParameterServer s;
@@ -30,3 +34,102 @@ TEST(ParameterSever, Handshake) {
   c.stopServer();
   s.stopServer();
 }
+
+namespace {
+struct NotificationHandler : public al::osc::PacketHandler {
+  void onMessage(al::osc::Message &m) override {
+    float value;
+    m >> value;
+    std::unique_lock<std::mutex> lk(lock);
+    values.push_back(value);
+  }
+  size_t count() {
+    std::unique_lock<std::mutex> lk(lock);
+    return values.size();
+  }
+  std::mutex lock;
+  std::vector<float> values;
+};
+} // namespace
+
+TEST(ParameterSever, NotifyListeners) {
+  const int numListeners = 3;
+  const int numNotifications = 500;
+  const uint16_t firstPort = 10840;
+
+  NotificationHandler handlers[numListeners];
+  std::vector<std::unique_ptr<al::osc::Recv>> receivers;
+  {
+    al::ParameterServer server("", 9012, false);
+    for (int i = 0; i < numListeners; i++) {
+      receivers.emplace_back(new al::osc::Recv(firstPort + i, "127.0.0.1"));
+      receivers.back()->handler(handlers[i]);
+      receivers.back()->start();
+      server.addListener("127.0.0.1", firstPort + i);
+    }
+    // The same listener by another name is not added twice
+    server.addListener("localhost", firstPort);
+
+    for (int i = 0; i < numNotifications; i++) {
+      server.notifyListeners("/value", float(i));
+    }
+    server.flush();
+    double start = al::al_steady_time();
+    while (handlers[numListeners - 1].count() < numNotifications &&
+           al::al_steady_time() - start < 2.0) {
+      al::al_sleep(0.01);
+    }
+  }
+  for (auto &r : receivers) {
+    r->stop();
+  }
+
+  for (int i = 0; i < numListeners; i++) {
+    // UDP on loopback may drop under load, but never reorders
+    ASSERT_GT(handlers[i].values.size(), 0u);
+    EXPECT_LE(handlers[i].values.size(), size_t(numNotifications));
+    EXPECT_TRUE(std::is_sorted(handlers[i].values.begin(),
+                               handlers[i].values.end()));
+    EXPECT_EQ(std::adjacent_find(handlers[i].values.begin(),
+                                 handlers[i].values.end()),
+              handlers[i].values.end());
+  }
+}
+
+// Counts the messages that were not taken as views
+class CountingServer : public al::ParameterServer {
+public:
+  CountingServer() : al::ParameterServer("", 9013, false) {}
+
+  void onMessage(al::osc::Message &m) override {
+    messages++;
+    al::ParameterServer::onMessage(m);
+  }
+
+  int messages{0};
+};
+
+TEST(ParameterSever, MessageView) {
+  al::Parameter value{"value", "", 0.0f, 0.0f, 10.0f};
+  al::ParameterVec3 position{"position"};
+  al::ParameterString text{"text"};
+  CountingServer server;
+  server << value << position << text;
+
+  char buffer[256];
+  al::osc::PacketWriter writer(buffer, sizeof(buffer));
+  writer.beginBundle();
+  writer.addMessage("/value", 2.5f);
+  writer.addMessage("/position", 1.0f, 2.0f, 3.0f);
+  writer.addMessage("/text", "hello");
+  writer.endBundle();
+
+  // Plain parameters take the view, strings go through onMessage()
+  al::osc::Recv recv;
+  recv.handler(server);
+  recv.parse(writer.data(), int(writer.size()), "127.0.0.1", 9000);
+  EXPECT_EQ(value.get(), 2.5f);
+  EXPECT_EQ(position.get(), al::Vec3f(1.0f, 2.0f, 3.0f));
+  EXPECT_EQ(text.get(), "hello");
+  EXPECT_EQ(server.messages, 1);
+}
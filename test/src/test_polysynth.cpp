@@ -0,0 +1,268 @@
+#include "al/scene/al_PolySynth.hpp"
+#include "gtest/gtest.h"
+
+using namespace al;
+
+namespace {
+
+class LevelVoice : public SynthVoice {
+public:
+  void onProcess(AudioIOData &io) override {
+    while (io()) {
+      io.out(0) += level;
+    }
+  }
+
+  void onTriggerOff() override { free(); }
+
+  float level{0.1f};
+};
+
+// Counts processed blocks. Its release is silent but never calls free()
+class CountingVoice : public SynthVoice {
+public:
+  void onProcess(AudioIOData &io) override {
+    blocks++;
+    while (io()) {
+      io.out(0) += level;
+    }
+  }
+
+  void onTriggerOff() override { level = 0.0f; }
+
+  float level{0.0f};
+  int blocks{0};
+};
+
+class StereoVoice : public SynthVoice {
+public:
+  void init() override { setNumOutChannels(2); }
+
+  void onProcess(AudioIOData &io) override {
+    while (io()) {
+      io.out(0) += 0.5f;
+      io.out(1) += 0.25f;
+    }
+  }
+};
+
+// Only writes to a bus, for example to feed a reverb
+class BusVoice : public SynthVoice {
+public:
+  void onProcess(AudioIOData &io) override {
+    while (io()) {
+      io.bus(0) += level;
+    }
+  }
+
+  float level{0.5f};
+};
+
+} // namespace
+
+TEST(PolySynth, ReservedVoices) {
+  PolySynth synth;
+  synth.registerSynthClass<LevelVoice>("level");
+  EXPECT_FALSE(synth.reserveVoices("unregistered", 2));
+  ASSERT_TRUE(synth.reserveVoices("level", 2));
+  EXPECT_FALSE(synth.reserveVoices("level", 2));
+  EXPECT_EQ(synth.voicesInUse("level"), 0);
+
+  auto *voice1 = synth.getVoice("level");
+  auto *voice2 = synth.getVoice("level");
+  ASSERT_TRUE(voice1 != nullptr);
+  ASSERT_TRUE(voice2 != nullptr);
+  EXPECT_NE(voice1, voice2);
+  // Exhausted, and no allocation
+  EXPECT_TRUE(synth.getVoice("level") == nullptr);
+  EXPECT_EQ(synth.voicesInUse("level"), 2);
+
+  // Returned voices can be taken again
+  synth.insertFreeVoice(voice2);
+  EXPECT_EQ(synth.voicesInUse("level"), 1);
+  EXPECT_EQ(synth.getVoice("level"), voice2);
+
+  // Freed voices return to the pool
+  AudioIOData io;
+  io.channelsOut(2);
+  io.framesPerBuffer(64);
+  synth.prepare(io);
+  int id = synth.triggerOn(voice1);
+  synth.render(io);
+  synth.triggerOff(id);
+  synth.render(io);
+  synth.render(io);
+  EXPECT_FALSE(voice1->active());
+  EXPECT_EQ(synth.voicesInUse("level"), 1);
+}
+
+TEST(PolySynth, StealOldest) {
+  const std::string name = demangle(typeid(LevelVoice).name());
+  PolySynth synth;
+  ASSERT_TRUE(synth.reserveVoices<LevelVoice>(
+      4, PolySynth::VoiceStealing::OLDEST, 1));
+  AudioIOData io;
+  io.channelsOut(2);
+  io.framesPerBuffer(64);
+  synth.prepare(io);
+
+  LevelVoice *voices[4];
+  for (auto &voice : voices) {
+    voice = synth.getVoice<LevelVoice>();
+    ASSERT_TRUE(voice != nullptr);
+    synth.triggerOn(voice);
+  }
+  io.zeroOut();
+  synth.render(io);
+  EXPECT_NEAR(io.outBuffer(0)[0], 0.4f, 1e-6);
+
+  // Pool is full, so the oldest voice is stolen and a spare handed out
+  auto *extra = synth.getVoice<LevelVoice>();
+  ASSERT_TRUE(extra != nullptr);
+  EXPECT_EQ(synth.voicesInUse(name), 5);
+  // The only spare is in use until the stolen voice is stopped
+  EXPECT_TRUE(synth.getVoice<LevelVoice>() == nullptr);
+  synth.triggerOn(extra);
+
+  // The stolen voice fades out over the block instead of stopping at once
+  io.zeroOut();
+  synth.render(io);
+  EXPECT_FALSE(voices[0]->active());
+  for (int i = 1; i < 4; i++) {
+    EXPECT_TRUE(voices[i]->active());
+  }
+  EXPECT_TRUE(extra->active());
+  EXPECT_EQ(synth.voicesInUse(name), 4);
+  for (int i = 0; i < 64; i++) {
+    EXPECT_NEAR(io.outBuffer(0)[i], 0.4f + 0.1f * (63 - i) / 64.0f, 1e-6);
+  }
+  io.zeroOut();
+  synth.render(io);
+  EXPECT_NEAR(io.outBuffer(0)[0], 0.4f, 1e-6);
+}
+
+TEST(PolySynth, StealQuietest) {
+  PolySynth synth;
+  ASSERT_TRUE(
+      synth.reserveVoices<LevelVoice>(4, PolySynth::VoiceStealing::QUIETEST));
+  AudioIOData io;
+  io.channelsOut(2);
+  io.framesPerBuffer(64);
+  synth.prepare(io);
+
+  const float levels[4] = {0.4f, 0.1f, 0.3f, 0.2f};
+  LevelVoice *voices[4];
+  for (int i = 0; i < 4; i++) {
+    voices[i] = synth.getVoice<LevelVoice>();
+    ASSERT_TRUE(voices[i] != nullptr);
+    voices[i]->level = levels[i];
+    synth.triggerOn(voices[i]);
+  }
+  synth.render(io);
+
+  auto *extra = synth.getVoice<LevelVoice>();
+  ASSERT_TRUE(extra != nullptr);
+  synth.triggerOn(extra);
+  synth.render(io);
+  EXPECT_FALSE(voices[1]->active());
+  EXPECT_TRUE(voices[0]->active());
+  EXPECT_TRUE(voices[2]->active());
+  EXPECT_TRUE(voices[3]->active());
+}
+
+TEST(PolySynth, MixChannelMapAndOffset) {
+  PolySynth synth;
+  synth.setVoiceMaxOutputChannels(2);
+  synth.setChannelMap({3, 1});
+  AudioIOData io;
+  io.channelsOut(4);
+  io.framesPerBuffer(100); // Not a multiple of the mixing tile
+  synth.prepare(io);
+
+  const int offset = 10;
+  synth.triggerOn(synth.getVoice<StereoVoice>(), offset);
+  io.zeroOut();
+  synth.render(io);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(io.outBuffer(0)[i], 0.0f);
+    EXPECT_EQ(io.outBuffer(2)[i], 0.0f);
+    EXPECT_EQ(io.outBuffer(3)[i], i < offset ? 0.0f : 0.5f);
+    EXPECT_EQ(io.outBuffer(1)[i], i < offset ? 0.0f : 0.25f);
+  }
+
+  // Whole buffer from the second block
+  io.zeroOut();
+  synth.render(io);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(io.outBuffer(3)[i], 0.5f);
+    EXPECT_EQ(io.outBuffer(1)[i], 0.25f);
+  }
+}
+
+TEST(PolySynth, SilenceDetection) {
+  PolySynth synth;
+  AudioIOData io;
+  io.channelsOut(2);
+  io.framesPerBuffer(64);
+  synth.prepare(io);
+
+  auto *voice = synth.getVoice<CountingVoice>();
+  voice->silenceDetection(0.001f, 2);
+  int id = synth.triggerOn(voice);
+  synth.render(io);
+  synth.render(io);
+  EXPECT_TRUE(voice->isVirtual());
+  EXPECT_EQ(voice->blocks, 2);
+
+  // Processed again every second block while silent
+  synth.render(io);
+  EXPECT_EQ(voice->blocks, 2);
+  synth.render(io);
+  EXPECT_EQ(voice->blocks, 3);
+  EXPECT_TRUE(voice->isVirtual());
+
+  // Becomes real when the check finds it audible
+  voice->level = 0.5f;
+  synth.render(io);
+  synth.render(io);
+  EXPECT_EQ(voice->blocks, 4);
+  EXPECT_FALSE(voice->isVirtual());
+  io.zeroOut();
+  synth.render(io);
+  EXPECT_EQ(voice->blocks, 5);
+  EXPECT_NEAR(io.outBuffer(0)[0], 0.5f, 1e-6);
+
+  // A silent release tail is freed
+  synth.triggerOff(id);
+  synth.render(io);
+  synth.render(io);
+  EXPECT_FALSE(voice->active());
+  synth.render(io);
+  EXPECT_EQ(voice->blocks, 7);
+}
+
+TEST(PolySynth, SilenceDetectionBusOnly) {
+  PolySynth synth;
+  synth.setVoiceBusChannels(1);
+  AudioIOData io;
+  io.channelsOut(2);
+  io.channelsBus(1);
+  io.framesPerBuffer(64);
+  synth.prepare(io);
+
+  auto *voice = synth.getVoice<BusVoice>();
+  voice->silenceDetection(0.001f, 2);
+  synth.triggerOn(voice);
+  for (int i = 0; i < 4; i++) {
+    io.zeroBus();
+    synth.render(io);
+  }
+  // Audible on the bus, so not made virtual
+  EXPECT_FALSE(voice->isVirtual());
+  EXPECT_NEAR(io.busBuffer(0)[0], 0.5f, 1e-6);
+
+  voice->level = 0.0f;
+  synth.render(io);
+  synth.render(io);
+  EXPECT_TRUE(voice->isVirtual());
+}
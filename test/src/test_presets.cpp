@@ -4,6 +4,7 @@
 #include "al/ui/al_PresetHandler.hpp"
 #include "al/ui/al_PresetSequencer.hpp"
 
+#include <cstdio>
 #include <fstream>
 
 TEST(Presets, ParameterValues) {
@@ -361,3 +362,56 @@ TEST(Presets, PresetDifferingParams) {
   EXPECT_FLOAT_EQ(pcolor.get().g, 0.73f);
   EXPECT_FLOAT_EQ(pcolor.get().b, 0.8f);
 }
+
+TEST(Presets, PresetBank) {
+  al::Parameter p{"param", "group", 0.5f, 0.0, 1.0};
+  al::ParameterInt pint{"paramint", "group", 3, 1, 10};
+
+  al::PresetHandler ph{"presetbank"};
+  ph << p << pint;
+  ph.usePresetBank();
+  ASSERT_NE(ph.presetBank(), nullptr);
+
+  ph.storePreset("1");
+  p.set(0.8f);
+  pint.set(9);
+  ph.storePreset("2");
+
+  ph.recallPresetSynchronous("1");
+  EXPECT_FLOAT_EQ(p.get(), 0.5f);
+  EXPECT_EQ(pint.get(), 3);
+
+  // Written files are loaded by a new bank
+  ph.presetBank()->flush();
+  al::PresetBank bank;
+  bank.load(ph.getCurrentPath());
+  al::PresetBank::ParameterStates values;
+  ASSERT_TRUE(bank.get("2", values));
+  EXPECT_FLOAT_EQ(values["/group/param"][0].get<float>(), 0.8f);
+  EXPECT_EQ(values["/group/paramint"][0].get<int32_t>(), 9);
+
+  // External modification is picked up after notification
+  values["/group/param"] = {0.25f};
+  std::string path = ph.presetBank()->presetPath("2");
+  al::PresetBank::writePresetFile(path, "2", values);
+  al::Watcher::notify(path, "modified");
+  ph.recallPresetSynchronous("2");
+  EXPECT_FLOAT_EQ(p.get(), 0.25f);
+  EXPECT_EQ(pint.get(), 9);
+
+  // Non overwriting stores get a unique name in the bank
+  ph.storePreset(3, "1", false);
+  EXPECT_TRUE(ph.presetBank()->get("1_0", values));
+
+  // Missing presets are not reread until reloaded
+  EXPECT_FALSE(bank.get("new", values));
+  al::PresetBank::writePresetFile(bank.presetPath("new"), "new", values);
+  EXPECT_FALSE(bank.get("new", values));
+  bank.reload("new");
+  EXPECT_TRUE(bank.get("new", values));
+
+  // Deleted presets leave the bank
+  std::remove(bank.presetPath("new").c_str());
+  al::Watcher::notify(bank.presetPath("new"), "deleted");
+  EXPECT_FALSE(bank.get("new", values));
+}
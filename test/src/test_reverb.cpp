@@ -0,0 +1,77 @@
+#include <cmath>
+#include <vector>
+
+#include "al/sound/al_Reverb.hpp"
+#include "gtest/gtest.h"
+
+using namespace al;
+
+namespace {
+
+std::vector<float> noise(int numFrames, int seed) {
+  std::vector<float> samples(numFrames);
+  unsigned int state = 12345 + seed;
+  for (auto &s : samples) {
+    state = state * 1664525u + 1013904223u;
+    s = float(state >> 8) / float(1 << 24) - 0.5f;
+  }
+  return samples;
+}
+
+} // namespace
+
+TEST(Reverb, ProcessBlock) {
+  const int numFrames = 3000;
+  Reverb<float> reverb, reference;
+  std::vector<float> in = noise(numFrames, 0);
+  std::vector<float> out1(numFrames), out2(in);
+
+  // Input may be an output
+  reverb.processBlock(out2.data(), out1.data(), out2.data(), numFrames, 0.5f);
+  for (int i = 0; i < numFrames; i++) {
+    float o1, o2;
+    reference(in[i], o1, o2, 0.5f);
+    EXPECT_EQ(out1[i], o1);
+    EXPECT_EQ(out2[i], o2);
+  }
+}
+
+// Every instance sounds like a Reverb with the same settings
+TEST(Reverb, MultiReverb) {
+  const int numInstances = 8;
+  const int numFrames = 5000; // longer than the longest delay-line
+  MultiReverb<numInstances> reverbs;
+  MultiReverb<numInstances>::Lanes decays(0.85f), dampings(0.4f);
+  std::vector<Reverb<float>> references(numInstances);
+  for (int k = 0; k < numInstances; k++) {
+    decays[k] = 0.3f + 0.08f * k;
+    dampings[k] = 0.1f * k;
+    references[k].decay(decays[k]).damping(dampings[k]);
+  }
+  reverbs.decay(decays).damping(dampings);
+  EXPECT_EQ(reverbs.size(), numInstances);
+
+  std::vector<float> in(numInstances * numFrames);
+  for (int k = 0; k < numInstances; k++) {
+    std::vector<float> channel = noise(numFrames, k);
+    std::copy(channel.begin(), channel.end(), in.begin() + k * numFrames);
+  }
+  std::vector<float> out1(in.size()), out2(in.size());
+  // Two blocks to carry state over
+  const int half = numFrames / 2;
+  reverbs.processBlock(in.data(), out1.data(), out2.data(), half, numFrames);
+  reverbs.processBlock(in.data() + half, out1.data() + half,
+                       out2.data() + half, numFrames - half, numFrames);
+
+  float energy = 0;
+  for (int k = 0; k < numInstances; k++) {
+    for (int i = 0; i < numFrames; i++) {
+      float o1, o2;
+      references[k](in[k * numFrames + i], o1, o2);
+      EXPECT_NEAR(out1[k * numFrames + i], o1, 1e-6);
+      EXPECT_NEAR(out2[k * numFrames + i], o2, 1e-6);
+      energy += o1 * o1;
+    }
+  }
+  EXPECT_GT(energy, 1.f);
+}
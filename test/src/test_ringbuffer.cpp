@@ -0,0 +1,124 @@
+#include "gtest/gtest.h"
+
+#include "al/types/al_SingleRWRingBuffer.hpp"
+
+#include <thread>
+
+using namespace al;
+
+TEST(RingBuffer, SingleRW) {
+  SingleRWRingBuffer ring(100);
+  // One byte is kept free
+  EXPECT_EQ(ring.writeSpace(), 127u);
+  EXPECT_EQ(ring.readSpace(), 0u);
+
+  const char data[] = "0123456789";
+  EXPECT_EQ(ring.write(data, 10), 10u);
+  EXPECT_EQ(ring.readSpace(), 10u);
+
+  char out[16];
+  EXPECT_EQ(ring.peek(out, 4), 4u);
+  EXPECT_EQ(std::string(out, 4), "0123");
+  EXPECT_EQ(ring.read(out, 16), 10u);
+  EXPECT_EQ(std::string(out, 10), "0123456789");
+  EXPECT_EQ(ring.readSpace(), 0u);
+
+  ring.write(data, 10);
+  ring.clear();
+  EXPECT_EQ(ring.readSpace(), 0u);
+  EXPECT_EQ(ring.writeSpace(), 127u);
+
+  char fill[200] = {};
+  EXPECT_EQ(ring.write(fill, 200), 127u);
+  EXPECT_EQ(ring.writeSpace(), 0u);
+}
+
+TEST(RingBuffer, Regions) {
+  SPSCRingBuffer<float> ring(8);
+  // Move indices so the next region wraps
+  float values[6] = {0, 1, 2, 3, 4, 5};
+  EXPECT_EQ(ring.push(values, 6), 6u);
+  EXPECT_EQ(ring.pop(values, 6), 6u);
+
+  auto region = ring.writeRegions(16);
+  EXPECT_EQ(region.size(), 8u);
+  EXPECT_EQ(region.firstSize, 2u);
+  EXPECT_EQ(region.secondSize, 6u);
+  for (size_t i = 0; i < region.size(); i++) {
+    region[i] = float(i);
+  }
+  EXPECT_EQ(ring.readSpace(), 0u);
+  ring.commitWrite(region.size());
+  EXPECT_EQ(ring.readSpace(), 8u);
+  EXPECT_FALSE(ring.push(1.0f));
+
+  auto readRegion = ring.readRegions(5);
+  EXPECT_EQ(readRegion.size(), 5u);
+  for (size_t i = 0; i < readRegion.size(); i++) {
+    EXPECT_EQ(readRegion[i], float(i));
+  }
+  ring.commitRead(5);
+  float value;
+  EXPECT_TRUE(ring.pop(value));
+  EXPECT_EQ(value, 5.0f);
+  EXPECT_EQ(ring.readSpace(), 2u);
+}
+
+// Run under ThreadSanitizer to check the memory ordering of the indices.
+TEST(RingBuffer, Stress) {
+  const uint64_t count = 1000000;
+  SPSCRingBuffer<uint64_t> ring(512);
+
+  std::thread producer([&]() {
+    uint64_t next = 0;
+    uint64_t batch[37];
+    while (next < count) {
+      if (ring.writeSpace() == 0) {
+        std::this_thread::yield();
+      } else if (next % 3 == 0) {
+        if (ring.push(next)) {
+          next++;
+        }
+      } else if (next % 3 == 1) {
+        size_t n = 0;
+        while (n < 37 && next + n < count) {
+          batch[n] = next + n;
+          n++;
+        }
+        next += ring.push(batch, n);
+      } else {
+        auto region = ring.writeRegions(64);
+        size_t n = std::min<uint64_t>(region.size(), count - next);
+        for (size_t i = 0; i < n; i++) {
+          region[i] = next + i;
+        }
+        ring.commitWrite(n);
+        next += n;
+      }
+    }
+  });
+
+  uint64_t expected = 0;
+  bool ok = true;
+  uint64_t batch[29];
+  while (expected < count) {
+    if (ring.readSpace() == 0) {
+      std::this_thread::yield();
+    } else if (expected % 2 == 0) {
+      size_t n = ring.pop(batch, 29);
+      for (size_t i = 0; i < n; i++) {
+        ok &= batch[i] == expected++;
+      }
+    } else {
+      auto region = ring.readRegions(100);
+      for (size_t i = 0; i < region.size(); i++) {
+        ok &= region[i] == expected++;
+      }
+      ring.commitRead(region.size());
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(ok);
+  EXPECT_EQ(expected, count);
+  EXPECT_EQ(ring.readSpace(), 0u);
+}
@@ -4,6 +4,7 @@
 #include "al/math/al_Functions.hpp"
 #include "al/sound/al_DownMixer.hpp"
 #include "al/sound/al_Lbap.hpp"
+#include "al/sound/al_SpeakerAdjustment.hpp"
 #include "al/sphere/al_AlloSphereSpeakerLayout.hpp"
 
 #include "gtest/gtest.h"
@@ -168,3 +169,173 @@ TEST(Speakers, DownMixAllosphere) {
     }
   }
 }
+
+TEST(Speakers, DownMixMatrix) {
+  const int numInputs = 7;
+  const int numFrames = 100; // Not a multiple of the mixing tile
+  AudioIOData io;
+  io.framesPerBuffer(numFrames);
+  io.channelsOut(numInputs);
+  io.channelsBus(1); // Application bus before the downmix buses
+
+  std::vector<std::vector<float>> gains = {
+      {1.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.25f, 0.0f},
+      {0.0f, 1.0f, 0.5f, 0.0f, 0.0f, 0.25f, 0.0f},
+      {0.0f, 0.0f, 0.0f, 0.7f, 0.7f, 0.0f, 2.0f}};
+  DownMixer downMixer;
+  downMixer.setMatrix(gains, io);
+  EXPECT_EQ(io.channelsBus(), 4);
+  EXPECT_EQ(downMixer.numOutputs(), 3u);
+
+  for (int c = 0; c < numInputs; c++) {
+    for (int i = 0; i < numFrames; i++) {
+      io.outBuffer(c)[i] = float(c + 1) * 0.01f * float(i % 13);
+    }
+  }
+  io.busBuffer(0)[0] = 5.0f;
+  std::vector<float> inputs(io.outBuffer(0),
+                            io.outBuffer(0) + numInputs * numFrames);
+
+  // Outputs 1, 0 and 3 are also inputs
+  downMixer.setOutputs({1, 0, 3});
+  downMixer.downMix(io);
+  EXPECT_EQ(io.busBuffer(0)[0], 5.0f);
+  for (size_t o = 0; o < gains.size(); o++) {
+    const uint32_t outputChannel = o == 0 ? 1 : (o == 1 ? 0 : 3);
+    for (int i = 0; i < numFrames; i++) {
+      float expected = 0.0f;
+      for (int c = 0; c < numInputs; c++) {
+        expected += gains[o][c] * inputs[c * numFrames + i];
+      }
+      EXPECT_NEAR(io.busBuffer(1 + int(o))[i], expected, 1e-6);
+      EXPECT_NEAR(io.outBuffer(int(outputChannel))[i], expected, 1e-6);
+    }
+  }
+  // Channels that are not outputs are untouched
+  EXPECT_EQ(io.outBuffer(2)[5], inputs[2 * numFrames + 5]);
+}
+
+TEST(Speakers, DownMixLayoutToLayout) {
+  Speakers sl = AlloSphereSpeakerLayout();
+  Speakers quad;
+  quad.emplace_back(0, 45.f, 0.f);
+  quad.emplace_back(1, -45.f, 0.f);
+  quad.emplace_back(2, -135.f, 0.f);
+  quad.emplace_back(3, 135.f, 0.f);
+
+  AudioIOData io;
+  io.channelsOut(64);
+  DownMixer downMixer;
+  downMixer.layoutToLayout(sl, quad, io);
+  EXPECT_EQ(io.channelsBus(), 4);
+
+  for (const auto &spkr : sl) {
+    io.zeroOut();
+    io.outBuffer(spkr.deviceChannel)[0] = 1.0f;
+    downMixer.downMixToBus(io);
+    float power = 0.0f;
+    int loudest = 0;
+    for (int b = 0; b < 4; b++) {
+      power += io.busBuffer(b)[0] * io.busBuffer(b)[0];
+      if (io.busBuffer(b)[0] > io.busBuffer(loudest)[0]) {
+        loudest = b;
+      }
+    }
+    EXPECT_NEAR(power, 1.0f, 1e-5) << "speaker " << spkr.deviceChannel;
+
+    // The closest target speaker gets the most signal
+    float closest = -2.0f;
+    int closestIndex = 0;
+    for (int b = 0; b < 4; b++) {
+      float cosine = float(spkr.vec().normalized().dot(quad[b].vec()));
+      if (cosine > closest + 1e-4f) {
+        closest = cosine;
+        closestIndex = b;
+      }
+    }
+    EXPECT_NEAR(io.busBuffer(loudest)[0], io.busBuffer(closestIndex)[0],
+                1e-5);
+  }
+}
+
+TEST(Speakers, DistanceTimeAdjustment) {
+  const int numFrames = 64;
+  Speakers layout;
+  layout.emplace_back(0, 0.f, 0.f, 0, 4.f);
+  layout.emplace_back(2, 90.f, 0.f, 0, 3.5f);
+  layout.emplace_back(4, 180.f, 0.f, 0, 2.f);
+
+  // Blocks longer than configured are processed in parts
+  for (int configuredFrames : {numFrames, 24}) {
+    SpeakerDistanceTimeAdjustmentProcessor adjustment;
+    adjustment.configure(layout, 44100, configuredFrames);
+    EXPECT_NEAR(adjustment.mDelays[0], 0.f, 1e-6);
+    EXPECT_NEAR(adjustment.mDelays[1], 0.5 / 343 * 44100, 1e-3);
+    EXPECT_NEAR(adjustment.mDelays[2], 2.0 / 343 * 44100, 1e-3);
+
+    AudioIOData io;
+    io.framesPerSecond(44100);
+    io.framesPerBuffer(numFrames);
+    io.channelsOut(5);
+    std::vector<std::vector<float>> responses(5);
+    for (int block = 0; block < 6; block++) {
+      io.zeroOut();
+      if (block == 0) {
+        for (int c = 0; c < 5; c++) {
+          io.out(c, 0) = 1.f;
+        }
+      }
+      adjustment.onAudioCB(io);
+      for (int c = 0; c < 5; c++) {
+        for (int i = 0; i < numFrames; i++) {
+          responses[c].push_back(io.out(c, i));
+        }
+      }
+    }
+
+    // Channels outside the layout are untouched
+    for (int c : {1, 3}) {
+      EXPECT_NEAR(responses[c][0], 1.f, 1e-6);
+    }
+    // The impulse is split between the frames around the fractional delay
+    for (size_t s = 0; s < layout.size(); s++) {
+      const auto &response = responses[layout[s].deviceChannel];
+      float delay = adjustment.mDelays[s];
+      int frame = int(std::floor(delay));
+      float fraction = delay - frame;
+      for (int i = 0; i < int(response.size()); i++) {
+        float expected = 0.f;
+        if (i == frame) {
+          expected = 1.f - fraction;
+        } else if (i == frame + 1) {
+          expected = fraction;
+        }
+        EXPECT_NEAR(response[i], expected, 1e-5);
+      }
+    }
+  }
+}
+
+TEST(Speakers, DistanceGainAdjustment) {
+  Speakers layout;
+  layout.emplace_back(0, 0.f, 0.f, 0, 2.f);
+  layout.emplace_back(1, 90.f, 0.f, 0, 4.f);
+
+  SpeakerDistanceGainAdjustmentProcessor adjustment;
+  adjustment.configure(layout, 1.0);
+
+  // Any channel count, not only 60
+  AudioIOData io;
+  io.framesPerBuffer(8);
+  io.channelsOut(3);
+  for (int c = 0; c < 3; c++) {
+    for (int i = 0; i < 8; i++) {
+      io.out(c, i) = 1.f;
+    }
+  }
+  adjustment.onAudioCB(io);
+  EXPECT_NEAR(io.out(0, 3), adjustment.mGains[0], 1e-6);
+  EXPECT_NEAR(io.out(1, 3), adjustment.mGains[1], 1e-6);
+  EXPECT_NEAR(io.out(1, 3), 2.f, 1e-6);
+  EXPECT_NEAR(io.out(2, 3), 1.f, 1e-6);
+}